@@ -0,0 +1,432 @@
+#include "AudioStream.h"
+#include "ErrorMessage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static uint16_t ReadU16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t ReadU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static void WriteU16(uint8_t* p, uint16_t value) { p[0] = (uint8_t)value; p[1] = (uint8_t)(value >> 8); }
+static void WriteU32(uint8_t* p, uint32_t value) { WriteU16(p, (uint16_t)value); WriteU16(p + 2, (uint16_t)(value >> 16)); }
+
+// RIFF header, a 16 byte PCM format chunk and the data chunk's header
+static void FillWavHeader(uint8_t* header, const AudioFormat& format, uint32_t dataBytes)
+{
+	memcpy(header, "RIFF", 4);
+	WriteU32(header + 4, 36 + dataBytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	WriteU32(header + 16, 16);
+	WriteU16(header + 20, WAVE_FORMAT_PCM_TAG);
+	WriteU16(header + 22, (uint16_t)format.channels);
+	WriteU32(header + 24, (uint32_t)format.sampleRate);
+	WriteU32(header + 28, (uint32_t)(format.sampleRate * format.channels * 2));
+	WriteU16(header + 32, (uint16_t)(format.channels * 2));
+	WriteU16(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	WriteU32(header + 40, dataBytes);
+}
+
+MemoryStream::MemoryStream() : samples(0), frameCount(0), position(0)
+{
+	format.sampleRate = 0;
+	format.channels = 1;
+}
+
+void MemoryStream::Reset(const int16_t* samples, size_t frames, const AudioFormat& format)
+{
+	this->samples = samples;
+	this->frameCount = frames;
+	this->format = format;
+	position = 0;
+}
+
+size_t MemoryStream::Read(int16_t* out, size_t frames)
+{
+	size_t count = std::min(frames, frameCount - position);
+	memcpy(out, samples + position * format.channels, count * format.channels * sizeof(int16_t));
+	position += count;
+	return count;
+}
+
+static const int16_t ADPCM_DEFAULT_COEFFICIENTS[7][2] =
+{
+	{ 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 }
+};
+
+static const int ADPCM_ADAPTATION[16] =
+{
+	230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230
+};
+
+const int ADPCM_MAX_DELTA = 1 << 20;
+
+int GetAdpcmSamplesPerBlock(int blockAlign, int channels)
+{
+	return (blockAlign - 7 * channels) * 8 / (4 * channels) + 2;
+}
+
+void SetDefaultAdpcmCoefficients(AdpcmFormat& format)
+{
+	format.coefficientCount = 7;
+	memcpy(format.coefficients, ADPCM_DEFAULT_COEFFICIENTS, sizeof(ADPCM_DEFAULT_COEFFICIENTS));
+}
+
+bool ParseAdpcmFormat(const uint8_t* extra, size_t size, int channels, int blockAlign, AdpcmFormat& format, std::string* error)
+{
+	if (channels < 1 || channels > 2)
+		return Fail(error, "ADPCM has to be mono or stereo");
+	if (blockAlign < 7 * channels + 1)
+		return Fail(error, "ADPCM blocks are too small");
+	if (size < 4)
+		return Fail(error, "ADPCM format is truncated");
+
+	format.channels = channels;
+	format.blockAlign = blockAlign;
+	format.samplesPerBlock = ReadU16(extra);
+	format.coefficientCount = ReadU16(extra + 2);
+	if (format.samplesPerBlock != GetAdpcmSamplesPerBlock(blockAlign, channels))
+		return Fail(error, "ADPCM samples per block don't match the block size");
+	if (format.coefficientCount < 7 || format.coefficientCount > 32 || size < 4 + (size_t)format.coefficientCount * 4)
+		return Fail(error, "ADPCM coefficient table is bad");
+
+	for (int i = 0; i < format.coefficientCount; i++)
+	{
+		format.coefficients[i][0] = (int16_t)ReadU16(extra + 4 + i * 4);
+		format.coefficients[i][1] = (int16_t)ReadU16(extra + 6 + i * 4);
+	}
+	return true;
+}
+
+size_t DecodeAdpcmBlock(const uint8_t* block, size_t bytes, const AdpcmFormat& format, int16_t* samples)
+{
+	int channels = format.channels;
+	if (bytes < (size_t)(7 * channels))
+		return 0;
+
+	int coefficient1[2];
+	int coefficient2[2];
+	int delta[2];
+	int sample1[2];
+	int sample2[2];
+	for (int c = 0; c < channels; c++)
+	{
+		int predictor = std::min((int)block[c], format.coefficientCount - 1);
+		coefficient1[c] = format.coefficients[predictor][0];
+		coefficient2[c] = format.coefficients[predictor][1];
+		delta[c] = (int16_t)ReadU16(block + channels + c * 2);
+		sample1[c] = (int16_t)ReadU16(block + channels * 3 + c * 2);
+		sample2[c] = (int16_t)ReadU16(block + channels * 5 + c * 2);
+		samples[c] = (int16_t)sample2[c];
+		samples[channels + c] = (int16_t)sample1[c];
+	}
+
+	// Nibbles run high then low, alternating channels in stereo
+	size_t frames = std::min((size_t)format.samplesPerBlock, (bytes - 7 * channels) * 2 / channels + 2);
+	const uint8_t* data = block + 7 * channels;
+	for (size_t i = 2 * channels; i < frames * channels; i++)
+	{
+		size_t n = i - 2 * channels;
+		int nibble = (n & 1) ? data[n >> 1] & 0x0F : data[n >> 1] >> 4;
+		int c = (int)(i % channels);
+
+		int signedNibble = nibble >= 8 ? nibble - 16 : nibble;
+		int predicted = ((sample1[c] * coefficient1[c]) + (sample2[c] * coefficient2[c])) / 256;
+		predicted += signedNibble * delta[c];
+		predicted = std::max(-32768, std::min(32767, predicted));
+
+		samples[i] = (int16_t)predicted;
+		sample2[c] = sample1[c];
+		sample1[c] = predicted;
+		// Real encoders never get near the cap; a damaged block
+		// would otherwise grow its step without bound
+		delta[c] = std::max(16, std::min(ADPCM_MAX_DELTA, (ADPCM_ADAPTATION[nibble] * delta[c]) / 256));
+	}
+	return frames;
+}
+
+// One channel of a block with one predictor, stepping exactly as
+// the decoder will; returns the squared error
+static double EncodeAdpcmChannel(const int16_t* samples, const AdpcmFormat& format, int c, int predictor, int& firstDelta, uint8_t* nibbles)
+{
+	int channels = format.channels;
+	int coefficient1 = format.coefficients[predictor][0];
+	int coefficient2 = format.coefficients[predictor][1];
+	int sample2 = samples[c];
+	int sample1 = samples[channels + c];
+
+	// Start the step near the size of the first prediction's miss
+	int firstMiss = samples[2 * channels + c] - (sample1 * coefficient1 + sample2 * coefficient2) / 256;
+	int delta = std::max(16, std::abs(firstMiss) / 4);
+	firstDelta = delta;
+
+	double error = 0;
+	for (int i = 2; i < format.samplesPerBlock; i++)
+	{
+		int predicted = (sample1 * coefficient1 + sample2 * coefficient2) / 256;
+		int actual = samples[i * channels + c];
+		int nibble = (int)std::floor((double)(actual - predicted) / delta + 0.5);
+		nibble = std::max(-8, std::min(7, nibble));
+		int decoded = std::max(-32768, std::min(32767, predicted + nibble * delta));
+
+		error += (double)(decoded - actual) * (decoded - actual);
+		nibbles[i - 2] = (uint8_t)(nibble & 0x0F);
+		sample2 = sample1;
+		sample1 = decoded;
+		delta = std::max(16, (ADPCM_ADAPTATION[nibble & 0x0F] * delta) / 256);
+	}
+	return error;
+}
+
+void EncodeAdpcmBlock(const int16_t* samples, const AdpcmFormat& format, uint8_t* block)
+{
+	int channels = format.channels;
+	std::vector<uint8_t> nibbles[2];
+	std::vector<uint8_t> trial(format.samplesPerBlock);
+	for (int c = 0; c < channels; c++)
+	{
+		double best = -1;
+		for (int p = 0; p < format.coefficientCount; p++)
+		{
+			int delta;
+			double error = EncodeAdpcmChannel(samples, format, c, p, delta, trial.data());
+			if (best < 0 || error < best)
+			{
+				best = error;
+				nibbles[c] = trial;
+				block[c] = (uint8_t)p;
+				WriteU16(block + channels + c * 2, (uint16_t)delta);
+			}
+		}
+		WriteU16(block + channels * 3 + c * 2, (uint16_t)samples[channels + c]);
+		WriteU16(block + channels * 5 + c * 2, (uint16_t)samples[c]);
+	}
+
+	// High nibble first, channels taking turns
+	uint8_t* data = block + 7 * channels;
+	size_t count = (size_t)(format.samplesPerBlock - 2) * channels;
+	for (size_t n = 0; n < count; n += 2)
+	{
+		uint8_t high = nibbles[n % channels][n / channels];
+		uint8_t low = n + 1 < count ? nibbles[(n + 1) % channels][(n + 1) / channels] : 0;
+		data[n / 2] = (uint8_t)((high << 4) | low);
+	}
+}
+
+WavFileStream::WavFileStream() : file(0), formatTag(0), dataOffset(0), dataBytes(0), dataRead(0), bytesRead(0), decodedFrames(0), decodedPosition(0)
+{
+	format.sampleRate = 0;
+	format.channels = 1;
+}
+
+WavFileStream::~WavFileStream()
+{
+	Close();
+}
+
+void WavFileStream::Close()
+{
+	if (file)
+		fclose(file);
+	file = 0;
+}
+
+// Walks the chunks for fmt and data; anything else is skipped
+bool WavFileStream::Open(const char* fileName, std::string* error)
+{
+	Close();
+	file = fopen(fileName, "rb");
+	if (!file)
+		return Fail(error, std::string("could not open ") + fileName);
+
+	uint8_t riff[12];
+	if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0)
+	{
+		Close();
+		return Fail(error, std::string(fileName) + " is not a .wav file");
+	}
+
+	bool haveFormat = false;
+	uint8_t chunk[8];
+	while (fread(chunk, 1, 8, file) == 8)
+	{
+		uint32_t size = ReadU32(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			std::vector<uint8_t> fmt(size);
+			if (size < 16 || fread(fmt.data(), 1, size, file) != size)
+				break;
+			formatTag = ReadU16(&fmt[0]);
+			format.channels = ReadU16(&fmt[2]);
+			format.sampleRate = (int)ReadU32(&fmt[4]);
+			int blockAlign = ReadU16(&fmt[12]);
+			int bits = ReadU16(&fmt[14]);
+
+			if (format.channels < 1 || format.channels > 2 || format.sampleRate <= 0)
+				break;
+			if (formatTag == WAVE_FORMAT_PCM_TAG && bits == 16)
+				haveFormat = true;
+			else if (formatTag == WAVE_FORMAT_ADPCM_TAG && size >= 18)
+			{
+				std::string adpcmError;
+				if (!ParseAdpcmFormat(&fmt[18], size - 18, format.channels, blockAlign, adpcm, &adpcmError))
+				{
+					Close();
+					return Fail(error, std::string(fileName) + ": " + adpcmError);
+				}
+				haveFormat = true;
+			}
+			else
+			{
+				Close();
+				return Fail(error, std::string(fileName) + " is neither 16 bit PCM nor MS-ADPCM");
+			}
+			if (size & 1)
+				fseek(file, 1, SEEK_CUR);
+		}
+		else if (memcmp(chunk, "data", 4) == 0)
+		{
+			if (!haveFormat)
+				break;
+			dataOffset = ftell(file);
+			dataBytes = size;
+			Rewind();
+			return true;
+		}
+		else
+			fseek(file, (long)(size + (size & 1)), SEEK_CUR);
+	}
+
+	Close();
+	return Fail(error, std::string(fileName) + " has no usable format and data");
+}
+
+void WavFileStream::Rewind()
+{
+	fseek(file, dataOffset, SEEK_SET);
+	dataRead = 0;
+	decodedFrames = 0;
+	decodedPosition = 0;
+}
+
+size_t WavFileStream::Read(int16_t* samples, size_t frames)
+{
+	if (!file)
+		return 0;
+
+	int channels = format.channels;
+	if (formatTag == WAVE_FORMAT_PCM_TAG)
+	{
+		size_t bytes = std::min(frames * channels * sizeof(int16_t), (size_t)(dataBytes - dataRead));
+		size_t got = fread(samples, 1, bytes, file);
+		dataRead += (uint32_t)got;
+		bytesRead += got;
+		return got / (channels * sizeof(int16_t));
+	}
+
+	// Whole blocks at a time, handing out what's asked for
+	block.resize(adpcm.blockAlign);
+	decoded.resize(adpcm.samplesPerBlock * channels);
+	size_t done = 0;
+	while (done < frames)
+	{
+		if (decodedPosition == decodedFrames)
+		{
+			size_t bytes = std::min((size_t)adpcm.blockAlign, (size_t)(dataBytes - dataRead));
+			size_t got = bytes > 0 ? fread(block.data(), 1, bytes, file) : 0;
+			dataRead += (uint32_t)got;
+			bytesRead += got;
+			decodedFrames = DecodeAdpcmBlock(block.data(), got, adpcm, decoded.data());
+			decodedPosition = 0;
+			if (decodedFrames == 0)
+				break;
+		}
+
+		size_t count = std::min(frames - done, decodedFrames - decodedPosition);
+		memcpy(samples + done * channels, &decoded[decodedPosition * channels], count * channels * sizeof(int16_t));
+		decodedPosition += count;
+		done += count;
+	}
+	return done;
+}
+
+WavFileOutput::WavFileOutput(const char* fileName) : fileName(fileName), file(0), dataBytes(0), clipped(0)
+{
+}
+
+WavFileOutput::~WavFileOutput()
+{
+	Close();
+}
+
+bool WavFileOutput::Open(int sampleRate, std::string* error)
+{
+	file = fopen(fileName.c_str(), "wb");
+	if (!file)
+		return Fail(error, "could not create " + fileName);
+
+	AudioFormat format;
+	format.sampleRate = sampleRate;
+	format.channels = 2;
+	uint8_t header[44];
+	FillWavHeader(header, format, 0);
+	fwrite(header, 1, sizeof(header), file);
+	dataBytes = 0;
+	return true;
+}
+
+void WavFileOutput::Write(const float* left, const float* right, size_t frames)
+{
+	if (!file)
+		return;
+
+	interleaved.resize(frames * 2);
+	for (size_t i = 0; i < frames; i++)
+	{
+		for (int c = 0; c < 2; c++)
+		{
+			float sample = (c == 0 ? left[i] : right[i]) * 32768.0f;
+			if (sample > 32767.0f || sample < -32768.0f)
+			{
+				sample = std::max(-32768.0f, std::min(32767.0f, sample));
+				clipped++;
+			}
+			interleaved[i * 2 + c] = (int16_t)sample;
+		}
+	}
+	fwrite(interleaved.data(), sizeof(int16_t), interleaved.size(), file);
+	dataBytes += (uint32_t)(interleaved.size() * sizeof(int16_t));
+}
+
+void WavFileOutput::Close()
+{
+	if (!file)
+		return;
+
+	uint8_t sizes[4];
+	WriteU32(sizes, 36 + dataBytes);
+	fseek(file, 4, SEEK_SET);
+	fwrite(sizes, 1, 4, file);
+	WriteU32(sizes, dataBytes);
+	fseek(file, 40, SEEK_SET);
+	fwrite(sizes, 1, 4, file);
+	fclose(file);
+	file = 0;
+}
+
+bool SaveWavFile(const char* fileName, const int16_t* samples, size_t frames, const AudioFormat& format, std::string* error)
+{
+	FILE* out = fopen(fileName, "wb");
+	if (!out)
+		return Fail(error, std::string("could not create ") + fileName);
+
+	uint32_t dataBytes = (uint32_t)(frames * format.channels * sizeof(int16_t));
+	uint8_t header[44];
+	FillWavHeader(header, format, dataBytes);
+	bool ok = fwrite(header, 1, sizeof(header), out) == sizeof(header) &&
+		fwrite(samples, 1, dataBytes, out) == dataBytes;
+	fclose(out);
+	return ok ? true : Fail(error, std::string("could not write ") + fileName);
+}
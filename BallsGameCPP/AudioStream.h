@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Sound data for the software mixer (SoftwareMixer.h), read a
+// chunk at a time rather than loaded whole, and where mixed
+// sound goes.
+//
+// A stream is a cursor: each voice playing a sound has its own.
+// Streams hand out 16 bit interleaved frames whatever they hold
+// - WavFileStream decodes MS-ADPCM (what wave banks usually
+// hold) a block at a time as it reads.  Outputs take the
+// mixer's float bus a block at a time, as left and right.
+//
+// Files go through stdio, and MS-ADPCM is decoded here rather
+// than by the Windows codecs, so the Linux tools use these too.
+// --------------------------------------------------------
+
+const uint16_t WAVE_FORMAT_PCM_TAG = 1;
+const uint16_t WAVE_FORMAT_ADPCM_TAG = 2;
+
+struct AudioFormat
+{
+	int sampleRate;
+	int channels;		// 1 or 2
+};
+
+class AudioStream
+{
+public:
+	virtual ~AudioStream() {}
+
+	virtual const AudioFormat& GetFormat() const = 0;
+
+	// Up to frames frames, fewer only at the end
+	virtual size_t Read(int16_t* samples, size_t frames) = 0;
+
+	// Back to the first frame, to loop
+	virtual void Rewind() = 0;
+
+	// Never touches a disk, so the mixer may read it itself
+	// rather than wait for the feeder thread
+	virtual bool CanReadInline() const { return false; }
+};
+
+// Plays frames someone else owns
+class MemoryStream : public AudioStream
+{
+public:
+	MemoryStream();
+
+	void Reset(const int16_t* samples, size_t frames, const AudioFormat& format);
+
+	const AudioFormat& GetFormat() const { return format; }
+	size_t Read(int16_t* samples, size_t frames);
+	void Rewind() { position = 0; }
+	bool CanReadInline() const { return true; }
+
+private:
+	const int16_t* samples;
+	size_t frameCount;
+	size_t position;
+	AudioFormat format;
+};
+
+// --------------------------------------------------------
+// MS-ADPCM: blocks of 4 bit deltas, each block starting from
+// two whole samples, so any block decodes on its own
+// --------------------------------------------------------
+struct AdpcmFormat
+{
+	int channels;
+	int blockAlign;			// Bytes per block
+	int samplesPerBlock;	// Frames per block
+	int coefficientCount;
+	int16_t coefficients[32][2];
+};
+
+// Frames a block of this many bytes holds
+int GetAdpcmSamplesPerBlock(int blockAlign, int channels);
+
+// The standard seven predictors every encoder writes
+void SetDefaultAdpcmCoefficients(AdpcmFormat& format);
+
+// Reads the format chunk's ADPCM extension (after the 16 byte
+// WAVEFORMAT and the cbSize field)
+bool ParseAdpcmFormat(const uint8_t* extra, size_t size, int channels, int blockAlign, AdpcmFormat& format, std::string* error = 0);
+
+// Decodes one whole block into samplesPerBlock interleaved frames.
+// A short last block decodes as far as its bytes go; returns frames.
+size_t DecodeAdpcmBlock(const uint8_t* block, size_t bytes, const AdpcmFormat& format, int16_t* samples);
+
+// Encodes samplesPerBlock interleaved frames into one whole block,
+// trying every predictor on each channel - for tools, not quick
+void EncodeAdpcmBlock(const int16_t* samples, const AdpcmFormat& format, uint8_t* block);
+
+// --------------------------------------------------------
+// A .wav file, PCM16 or MS-ADPCM, read as it plays
+// --------------------------------------------------------
+class WavFileStream : public AudioStream
+{
+public:
+	WavFileStream();
+	~WavFileStream();
+
+	bool Open(const char* fileName, std::string* error = 0);
+	void Close();
+
+	const AudioFormat& GetFormat() const { return format; }
+	size_t Read(int16_t* samples, size_t frames);
+	void Rewind();
+
+	bool IsAdpcm() const { return formatTag == WAVE_FORMAT_ADPCM_TAG; }
+	uint64_t GetBytesRead() const { return bytesRead; }
+
+private:
+	FILE* file;
+	AudioFormat format;
+	uint16_t formatTag;
+	AdpcmFormat adpcm;
+	long dataOffset;
+	uint32_t dataBytes;
+	uint32_t dataRead;
+	uint64_t bytesRead;
+
+	// An ADPCM block decodes whole; what's left of it waits here
+	std::vector<uint8_t> block;
+	std::vector<int16_t> decoded;
+	size_t decodedFrames;
+	size_t decodedPosition;
+};
+
+// --------------------------------------------------------
+// Where the mixer's output goes
+// --------------------------------------------------------
+class MixerOutput
+{
+public:
+	virtual ~MixerOutput() {}
+
+	virtual bool Open(int sampleRate, std::string* error) = 0;
+	virtual void Write(const float* left, const float* right, size_t frames) = 0;
+	virtual void Close() {}
+};
+
+// Throws it away, counting frames
+class NullMixerOutput : public MixerOutput
+{
+public:
+	NullMixerOutput() : frames(0) {}
+
+	bool Open(int, std::string*) { return true; }
+	void Write(const float*, const float*, size_t count) { frames += count; }
+
+	uint64_t frames;
+};
+
+// 16 bit stereo .wav, clipped; the header's sizes are filled in
+// on Close
+class WavFileOutput : public MixerOutput
+{
+public:
+	explicit WavFileOutput(const char* fileName);
+	~WavFileOutput();
+
+	bool Open(int sampleRate, std::string* error);
+	void Write(const float* left, const float* right, size_t frames);
+	void Close();
+
+	uint32_t GetClippedCount() const { return clipped; }
+
+private:
+	std::string fileName;
+	FILE* file;
+	uint32_t dataBytes;
+	uint32_t clipped;
+	std::vector<int16_t> interleaved;
+};
+
+// Writes frames out as a .wav, PCM16 - for tools and tests
+bool SaveWavFile(const char* fileName, const int16_t* samples, size_t frames, const AudioFormat& format, std::string* error = 0);
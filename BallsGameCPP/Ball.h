@@ -1,8 +1,7 @@
 #pragma once
 
-#include <DirectXMath.h>
-#include "GameEntity.h"
-#include "Game.h"
+#include <cmath>
+#include "SimRandom.h"
 
 struct myVector
 {
@@ -14,19 +13,18 @@ struct myVector
 
 	myVector(float x, float y, float z) : x(x), y(y), z(z) {}
 
-	myVector(const myVector& other) : x(other.x), y(other.y), z(other.z) {}
-
 	float magnitude() { return std::sqrt(this->magSquared()); }
 
 	float magSquared() { return (this->x * this->x) + (this->y * this->y) + (this->z * this->z); }
 
 	float dot(myVector other) { return (this->x * other.x) + (this->y * other.y) + (this->z * other.z); }
 
-	static myVector randVector()
+	static myVector randVector(SimRandom& random)
 	{
-		return myVector((static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / 2))) - 1,
-						(static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / 2))) - 1,
-						(static_cast <float> (rand()) / (static_cast <float> (RAND_MAX / 2))) - 1);
+		float x = random.NextSigned();
+		float y = random.NextSigned();
+		float z = random.NextSigned();
+		return myVector(x, y, z);
 	}
 #pragma region Operators
 	friend myVector operator+(const myVector &v1, const myVector &v2)
@@ -59,7 +57,7 @@ struct myVector
 		return myVector(v.x / scalar, v.y / scalar, v.z / scalar);
 	}
 
-	myVector& myVector::operator+=(const myVector& rhs)
+	myVector& operator+=(const myVector& rhs)
 	{
 		this->x += rhs.x;
 		this->y += rhs.y;
@@ -67,7 +65,7 @@ struct myVector
 		return *this;
 	}
 
-	myVector& myVector::operator-=(const myVector& rhs)
+	myVector& operator-=(const myVector& rhs)
 	{
 		this->x -= rhs.x;
 		this->y -= rhs.y;
@@ -75,7 +73,7 @@ struct myVector
 		return *this;
 	}
 
-	myVector& myVector::operator*=(const float& rhs)
+	myVector& operator*=(const float& rhs)
 	{
 		this->x *= rhs;
 		this->y *= rhs;
@@ -83,24 +81,35 @@ struct myVector
 		return *this;
 	}
 
-	myVector& myVector::operator/=(const float& rhs)
+	myVector& operator/=(const float& rhs)
 	{
 		this->x /= rhs;
 		this->y /= rhs;
 		this->z /= rhs;
 		return *this;
 	}
-
-	void operator = (const myVector &V)
-	{
-		this->x = V.x;
-		this->y = V.y;
-		this->z = V.z;
-	}
 #pragma endregion
 };
 
 
+// Half the size of the field; balls bounce off the top and bottom
+// and score or leave through the sides
+const float FIELD_X_BOUND = 2.8f;
+const float FIELD_Y_BOUND = 1.6f;
+
+// What a ball's update did, for BallManager to keep score with
+enum BallEvent
+{
+	BALL_EVENT_NONE,
+	BALL_EVENT_P1_GOAL,		// Soccer ball went in on the right
+	BALL_EVENT_P2_GOAL,		// Soccer ball went in on the left
+	BALL_EVENT_P1_RETURN,	// A ball left on the left, player 1 gets it back
+	BALL_EVENT_P2_RETURN,	// A ball left on the right, player 2 gets it back
+	BALL_EVENT_WALL			// Bounced off the top or bottom, and nothing else
+};
+
+// Plain data (no pointers), so a whole vector of these can be
+// copied in and out of a snapshot with memcpy
 class Ball
 {
 	myVector position;
@@ -113,43 +122,27 @@ class Ball
 	float xBound;
 	float yBound;
 
-	GameEntity* mesh;
-
 	bool despawn;
 	bool isSoccerBall; 
-	
-	int* p1Score;
-	int* p2Score;
-	int* p1Balls;
-	int* p2Balls;
+
+	uint32_t id;	// Stays the same while the ball lives, unlike its index
 
 public:
-	Ball(GameEntity* mesh, myVector position, myVector velocity, float mass, float radius, bool isMain, int* p1Score, int* p2Score, int* p1Balls, int* p2Balls)
+	Ball() {}
+	Ball(myVector position, myVector velocity, float mass, float radius, bool isMain, uint32_t id)
 	{
-		this->mesh = new GameEntity(mesh);
+		this->id = id;
 		this->position = position;
 		this->velocity = velocity;
 		this->acceleration = myVector(0.f, 0.f, 0.f);
 		this->mass = mass;
 		this->radius = radius;
 
-		this->xBound = 2.8;
-		this->yBound = 1.6;
-
-		this->mesh->SetScale(radius * 2, radius * 2, radius * 2);
+		this->xBound = FIELD_X_BOUND;
+		this->yBound = FIELD_Y_BOUND;
 
 		this->despawn = false;
 		this->isSoccerBall = isMain;
-
-		this->p1Score = p1Score;
-		this->p2Score = p2Score;
-		this->p1Balls = p1Balls;
-		this->p2Balls = p2Balls;
-	}
-
-	~Ball()
-	{
-		delete mesh;
 	}
 
 	void applyForce(myVector force)
@@ -157,28 +150,26 @@ public:
 		this->acceleration += force;
 	}
 
-	bool update(float deltaTime)
+	BallEvent update(float deltaTime)
 	{
-		bool hasScored = false;
+		BallEvent event = BALL_EVENT_NONE;
 		this->velocity += this->acceleration * deltaTime;
 		this->position += this->velocity * deltaTime;
 
 		this->acceleration = { 0,0,0 };
-		this->mesh->SetTranslation(this->position.x, this->position.y, this->position.z);
 
 		// Check if walls are hit - bounce back
 		if (this->position.x + this->radius > this->xBound) {
 			if (!this->isSoccerBall)
 			{
 				this->despawn = true;
-				*p2Balls += 1;
+				event = BALL_EVENT_P2_RETURN;
 			}
 			else
 			{
-				this->position = myVector(0, 0.1, 0.65f);
+				this->position = myVector(0, 0.1f, 0.65f);
 				this->velocity = myVector();
-				hasScored = true;
-				*p1Score += 1;
+				event = BALL_EVENT_P1_GOAL;
 			}
 			this->velocity.x *= -1;
 			this->position += this->velocity * deltaTime;
@@ -188,14 +179,13 @@ public:
 			if (!this->isSoccerBall)
 			{
 				this->despawn = true;
-				*p1Balls += 1;
+				event = BALL_EVENT_P1_RETURN;
 			}
 			else
 			{
-				this->position = myVector(0, 0.1, 0.65);
+				this->position = myVector(0, 0.1f, 0.65f);
 				this->velocity = myVector();
-				hasScored = true;
-				*p2Score += 1;
+				event = BALL_EVENT_P2_GOAL;
 			}
 			this->velocity.x *= -1;
 			this->position += this->velocity * deltaTime;
@@ -205,10 +195,12 @@ public:
 		{
 			this->velocity.y *= -1;
 			this->position += this->velocity * deltaTime;
+			if (event == BALL_EVENT_NONE)
+				event = BALL_EVENT_WALL;
 		}
 
 		this->position.z = -.65f;
-		return hasScored;
+		return event;
 	}
 
 	void unUpdate(float deltaTime)
@@ -241,13 +233,30 @@ public:
 		return this->mass;
 	}
 	
-	GameEntity* getMesh()
+	bool getIsSoccerBall()
 	{
-		return this->mesh;
+		return this->isSoccerBall;
 	}
 
 	bool getDespawn() 
 	{
 		return this->despawn;
 	}
-};
\ No newline at end of file
+
+	uint32_t getId()
+	{
+		return this->id;
+	}
+
+	// Folds everything that affects the simulation into a running hash
+	uint32_t hash(uint32_t hash)
+	{
+		hash = SimHash(hash, &this->position, sizeof(myVector));
+		hash = SimHash(hash, &this->velocity, sizeof(myVector));
+		hash = SimHash(hash, &this->acceleration, sizeof(myVector));
+		hash = SimHash(hash, &this->mass, sizeof(float));
+		hash = SimHash(hash, &this->radius, sizeof(float));
+		hash = SimHash(hash, &this->despawn, sizeof(bool));
+		return SimHash(hash, &this->isSoccerBall, sizeof(bool));
+	}
+};
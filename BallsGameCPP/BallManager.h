@@ -4,143 +4,230 @@
 #include <cmath>
 #include "Ball.h"
 #include "Emitter.h"
-#include "Mesh.h"
-#include "Material.h"
+#include "Profiler.h"
+#include "SimRandom.h"
+#include "SoundEvent.h"
 
+const int BALLS_PER_PLAYER = 8;
 
+// How long a collision's explosion lasts
+const float EXPLOSION_SECONDS = 1.0f;
+
+// Goals and balls left in hand for both players
+struct MatchScore
+{
+	int p1Score;
+	int p2Score;
+	int p1Balls;
+	int p2Balls;
+};
+
+// Balls and explosions are held by value and are plain data,
+// so the whole simulation can be snapshotted with a few memcpys
 class BallManager
 {
-	std::vector<Ball*>* balls;
-	std::vector<Emitter*> explosions;
-	Mesh* explosionMesh;
-	Material* explosionMaterial;
+	std::vector<Ball> balls;
+	std::vector<Emitter> explosions;
+	MatchScore score;
+	uint32_t nextBallId;
 	float maxSpeed;
+	int ballsPerPlayer;
+	bool explosionsEnabled;
+	SimRandom* random;
+	std::vector<SoundEvent>* sounds;
 
-	int* p1Score;
-	int* p2Score;
-	int* p1Balls;
-	int* p2Balls;
 public:
-	BallManager(int* p1Score, int* p2Score, int* p1Balls, int* p2Balls)
+	BallManager(SimRandom* random)
 	{
-		balls = new std::vector<Ball*>();
 		maxSpeed = 2;
-		this->p1Score = p1Score;
-		this->p2Score = p2Score;
-		this->p1Balls = p1Balls;
-		this->p2Balls = p2Balls;
+		ballsPerPlayer = BALLS_PER_PLAYER;
+		explosionsEnabled = true;
+		this->random = random;
+		this->sounds = 0;
+		clear();
 	}
 
-	~BallManager()
+	// Collision speed cap and how many balls each player holds
+	// after a goal; the magazine refills to the new size on clear
+	void setRules(float maxSpeed, int ballsPerPlayer)
 	{
-		for (int i = 0; i < this->balls->size(); ++i)
-		{
-			delete (*balls)[i];
-		}
-		delete balls;
-		for (int i = 0; i < this->explosions.size(); ++i)
-		{
-			delete this->explosions[i];
-		}
+		this->maxSpeed = maxSpeed;
+		this->ballsPerPlayer = ballsPerPlayer;
+	}
+
+	// Explosions are only for show and are all the random numbers
+	// are used for, so a headless run can skip them and play out
+	// exactly the same (only Hash() notices)
+	void setExplosionsEnabled(bool enabled)
+	{
+		this->explosionsEnabled = enabled;
 	}
 
-	void setExpMesh(Mesh* explosionMesh)
+	// Where to add a SoundEvent for every hit, bounce and goal,
+	// or null for silence.  Never copied, so forks stay quiet.
+	void setSoundLog(std::vector<SoundEvent>* sounds)
 	{
-		this->explosionMesh = explosionMesh;
+		this->sounds = sounds;
 	}
 
-	void setExpMat(Material* explosionMaterial)
+	// Back to an empty field with a fresh score
+	void clear()
 	{
-		this->explosionMaterial = explosionMaterial;
+		this->balls.clear();
+		this->explosions.clear();
+		this->nextBallId = 0;
+		this->score.p1Score = 0;
+		this->score.p2Score = 0;
+		this->score.p1Balls = this->ballsPerPlayer;
+		this->score.p2Balls = this->ballsPerPlayer;
 	}
 
-	void addBall(GameEntity* ballMesh, myVector position, myVector velocity, float mass, float radius, bool isMain)
+	// Takes on another manager's balls, score and rules but none of
+	// its explosions, reusing our own storage
+	void copyPlayState(const BallManager& other)
 	{
-		this->balls->push_back(new Ball(ballMesh, position, velocity, mass, radius, isMain, p1Score, p2Score, p1Balls, p2Balls)); 
+		this->balls = other.balls;
+		this->explosions.clear();
+		this->score = other.score;
+		this->nextBallId = other.nextBallId;
+		this->maxSpeed = other.maxSpeed;
+		this->ballsPerPlayer = other.ballsPerPlayer;
 	}
 
-	std::vector<GameEntity*> getActiveParticles()
+	void addBall(myVector position, myVector velocity, float mass, float radius, bool isMain)
+	{
+		this->balls.push_back(Ball(position, velocity, mass, radius, isMain, this->nextBallId++)); 
+	}
+
+	// Ids come from a counter that has to be saved with the balls
+	uint32_t getNextBallId() { return this->nextBallId; }
+	void setNextBallId(uint32_t id) { this->nextBallId = id; }
+
+	void getActiveParticles(std::vector<myVector>& positions, std::vector<float>* fades = 0)
 	{
-		std::vector<GameEntity*> toReturn = std::vector<GameEntity*>();
 		for (auto& emitter : this->explosions)
 		{
-			std::vector<GameEntity*> temp = emitter->getActiveParticles();
-			toReturn.insert(toReturn.end(), temp.begin(), temp.end());
+			emitter.getActiveParticles(positions, fades);
 		}
-		return toReturn;
+	}
+
+	// Keeps score for something a ball did, true if it was a goal
+	bool applyEvent(BallEvent event)
+	{
+		switch (event)
+		{
+		case BALL_EVENT_P1_GOAL: this->score.p1Score += 1; return true;
+		case BALL_EVENT_P2_GOAL: this->score.p2Score += 1; return true;
+		case BALL_EVENT_P1_RETURN: this->score.p1Balls += 1; return false;
+		case BALL_EVENT_P2_RETURN: this->score.p2Balls += 1; return false;
+		default: return false;
+		}
+	}
+
+	void addSound(SoundKind kind, myVector position, float strength)
+	{
+		if (!this->sounds)
+			return;
+		SoundEvent sound;
+		sound.kind = (uint8_t)kind;
+		sound.x = position.x;
+		sound.y = position.y;
+		sound.strength = strength < 1 ? strength : 1;
+		this->sounds->push_back(sound);
+	}
+
+	// Logs a sound for what a ball's update did, then keeps score for it
+	bool handleEvent(Ball& ball, BallEvent event)
+	{
+		switch (event)
+		{
+		case BALL_EVENT_WALL: addSound(SOUND_WALL, ball.getPosition(), std::fabs(ball.getVelocity().y) / this->maxSpeed); break;
+		case BALL_EVENT_P1_GOAL: addSound(SOUND_GOAL, myVector(FIELD_X_BOUND, 0, 0), 1); break;
+		case BALL_EVENT_P2_GOAL: addSound(SOUND_GOAL, myVector(-FIELD_X_BOUND, 0, 0), 1); break;
+		default: break;
+		}
+		return applyEvent(event);
 	}
 
 	void Update(float deltaTime)
 	{
+		PROFILE_SCOPE("BallManager::Update");
 		bool hasScored = false;
-		for (int i = 0; i < this->explosions.size(); ++i)
 		{
-			if (!(this->explosions[i]->isAlive()))
+			PROFILE_SCOPE("Explosions");
+			for (int i = 0; i < this->explosions.size(); ++i)
 			{
-				delete this->explosions[i];
-				this->explosions.erase(this->explosions.begin() + i);
-				i--;
+				if (!(this->explosions[i].isAlive()))
+				{
+					this->explosions.erase(this->explosions.begin() + i);
+					i--;
+				}
+			}
+			for (auto& emitter : explosions)
+			{
+				emitter.update(deltaTime);
 			}
-		}
-		for (auto& emitter : explosions)
-		{
-			emitter->update(deltaTime);
 		}
 
-		for (int i = 0; i < this->balls->size(); ++i)
 		{
-			Ball* ball = (*(this->balls))[i];
-			hasScored = ball->update(deltaTime);
-			if (hasScored) break;
-			if (ball->getDespawn())
+			PROFILE_SCOPE("Integrate");
+			for (int i = 0; i < this->balls.size(); ++i)
 			{
-					//Despawn the ball here
-					delete ball;
-					this->balls->erase(this->balls->begin() + i);
+				Ball& ball = this->balls[i];
+				hasScored = handleEvent(ball, ball.update(deltaTime));
+				if (hasScored) break;
+				if (ball.getDespawn())
+				{
+						//Despawn the ball here
+						this->balls.erase(this->balls.begin() + i);
+				}
 			}
 		}
 		
 		if (hasScored)
 		{
-			for (int i = 1; i < this->balls->size(); ++i) 
-			{
-				delete (*balls)[i];
-				this->balls->erase(this->balls->begin() + i);
-				i--;
-			}
-			*p1Balls = 8;
-			*p2Balls = 8;
+			// Everything but the soccer ball goes
+			this->balls.erase(this->balls.begin() + 1, this->balls.end());
+			this->score.p1Balls = this->ballsPerPlayer;
+			this->score.p2Balls = this->ballsPerPlayer;
 		}
 
 
-		for (int i = 0; i < this->balls->size();++i)
+		// Every pair is tested, so this covers the broad and narrow
+		// phase both.  Hits aren't scoped one by one - a pile-up
+		// would push the rest of the frame out of the ring.
+		PROFILE_SCOPE("Collisions");
+		for (int i = 0; i < this->balls.size();++i)
 		{
-			for (int j = i + 1; j < this->balls->size();++j)
+			for (int j = i + 1; j < this->balls.size();++j)
 			{
-				if (isColliding((*balls)[i], (*balls)[j]))
+				if (isColliding(balls[i], balls[j]))
 				{
 
-					(*balls)[i]->unUpdate(deltaTime);
-					(*balls)[j]->unUpdate(deltaTime);
+					balls[i].unUpdate(deltaTime);
+					balls[j].unUpdate(deltaTime);
 
 
-					myVector ballOneVel = (*balls)[i]->getVelocity();
-					myVector ballTwoVel = (*balls)[j]->getVelocity();
+					myVector ballOneVel = balls[i].getVelocity();
+					myVector ballTwoVel = balls[j].getVelocity();
 
 					if (ballOneVel.magSquared() == 0)
-						ballOneVel.x = 0.000000000001;
+						ballOneVel.x = 0.000000000001f;
 					if (ballTwoVel.magSquared() == 0)
-						ballTwoVel.x = 0.000000000001;
+						ballTwoVel.x = 0.000000000001f;
 
-					myVector ballOnePos = (*balls)[i]->getPosition(); 
-					myVector ballTwoPos = (*balls)[j]->getPosition();
+					myVector ballOnePos = balls[i].getPosition(); 
+					myVector ballTwoPos = balls[j].getPosition();
 
-					float ballOneMass = (*balls)[i]->getMass();
-					float ballTwoMass = (*balls)[j]->getMass();
+					float ballOneMass = balls[i].getMass();
+					float ballTwoMass = balls[j].getMass();
 
 					myVector normal = ballOnePos - ballTwoPos;
 					normal /= normal.magnitude();
 
+					if (this->sounds)
+						addSound(SOUND_COLLISION, (ballOnePos + ballTwoPos) / 2, std::fabs(normal.dot(ballOneVel - ballTwoVel)) / (2 * this->maxSpeed));
+
 					myVector ballOneCollisionComp = normal * normal.dot(ballOneVel);
 					myVector ballOneOrthoComp = ballOneVel - ballOneCollisionComp;
 
@@ -168,34 +255,29 @@ public:
 					if (newVelTwo.magnitude() > this->maxSpeed)
 						newVelTwo /= newVelTwo.magnitude() / this->maxSpeed;
 
-					(*balls)[i]->setVelocity(myVector(newVelOne.x, newVelOne.y, 0.f));
-					(*balls)[j]->setVelocity(myVector(newVelTwo.x, newVelTwo.y, 0.f));
+					balls[i].setVelocity(myVector(newVelOne.x, newVelOne.y, 0.f));
+					balls[j].setVelocity(myVector(newVelTwo.x, newVelTwo.y, 0.f));
 
 
-					(*balls)[i]->update(deltaTime);
-					(*balls)[j]->update(deltaTime);
+					handleEvent(balls[i], balls[i].update(deltaTime));
+					handleEvent(balls[j], balls[j].update(deltaTime));
 
-					myVector collisionPoint = (ballOnePos + ballTwoPos) / 2;
-
-					std::vector<GameEntity*> temp = std::vector<GameEntity*>();
-					for (int i = 0; i < 10; ++i)
+					if (this->explosionsEnabled)
 					{
-						temp.push_back(new GameEntity(explosionMesh, explosionMaterial));
-						temp[i]->SetScale(0.1, 0.1, 0.1);
+						myVector collisionPoint = (ballOnePos + ballTwoPos) / 2;
+						explosions.push_back(Emitter(0.5f, 10, collisionPoint, 0.01f, EXPLOSION_SECONDS, *random));
 					}
-
-					explosions.push_back(new Emitter(0.5, &temp, collisionPoint, 0.01, 1));
 				}
 			}
 		}
 	}
 
-	bool isColliding(Ball* ballOne, Ball* ballTwo)
+	bool isColliding(Ball& ballOne, Ball& ballTwo)
 	{
-		myVector dif = ballOne->getPosition() - ballTwo->getPosition();
+		myVector dif = ballOne.getPosition() - ballTwo.getPosition();
 		float magSquared = (dif.x * dif.x) + (dif.y * dif.y) + (dif.z * dif.z);
 
-		float distanceSquared = (ballOne->getRadius() + ballTwo->getRadius()) * (ballOne->getRadius() + ballTwo->getRadius());
+		float distanceSquared = (ballOne.getRadius() + ballTwo.getRadius()) * (ballOne.getRadius() + ballTwo.getRadius());
 
 		if (magSquared <= distanceSquared)
 		{
@@ -204,14 +286,38 @@ public:
 		return false;
 	}
 
-	std::vector<GameEntity*> getBallGameEntities() {
-		std::vector<GameEntity*> entities;
+	std::vector<Ball>& getBalls()
+	{
+		return balls;
+	}
+
+	std::vector<Emitter>& getExplosions()
+	{
+		return explosions;
+	}
+
+	MatchScore& getScore()
+	{
+		return score;
+	}
 
-		for (auto i = balls->begin(); i != balls->end(); i++) {
-			Ball* b = *i;
-			entities.push_back(b->getMesh());
+	uint32_t hash(uint32_t hash)
+	{
+		hash = SimHash(hash, &this->score, sizeof(MatchScore));
+
+		uint32_t count = (uint32_t)this->balls.size();
+		hash = SimHash(hash, &count, sizeof(count));
+		for (auto& ball : this->balls)
+		{
+			hash = ball.hash(hash);
 		}
 
-		return entities;
+		count = (uint32_t)this->explosions.size();
+		hash = SimHash(hash, &count, sizeof(count));
+		for (auto& emitter : this->explosions)
+		{
+			hash = emitter.hash(hash);
+		}
+		return hash;
 	}
-};
\ No newline at end of file
+};
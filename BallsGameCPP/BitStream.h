@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Packs values of any width from 1 to 32 bits back to back,
+// lowest bit first, into a byte vector
+// --------------------------------------------------------
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<uint8_t>& out) : out(out), scratch(0), scratchBits(0), bitCount(0) {}
+
+	void Write(uint32_t value, int bits)
+	{
+		if (bits < 32)
+			value &= (1u << bits) - 1;
+		scratch |= (uint64_t)value << scratchBits;
+		scratchBits += bits;
+		bitCount += bits;
+		while (scratchBits >= 8)
+		{
+			out.push_back((uint8_t)scratch);
+			scratch >>= 8;
+			scratchBits -= 8;
+		}
+	}
+
+	void WriteBool(bool value) { Write(value ? 1 : 0, 1); }
+
+	// Writes out the last partial byte, padded with zeros
+	void Flush()
+	{
+		if (scratchBits > 0)
+			out.push_back((uint8_t)scratch);
+		scratch = 0;
+		scratchBits = 0;
+	}
+
+	size_t GetBitCount() const { return bitCount; }
+
+private:
+	std::vector<uint8_t>& out;
+	uint64_t scratch;
+	int scratchBits;
+	size_t bitCount;
+};
+
+// --------------------------------------------------------
+// Reads what a BitWriter wrote.  Reading past the end returns
+// zeros and sets the overflow flag rather than touching memory
+// it shouldn't, so a decoder can read a whole packet and check
+// once at the end.
+// --------------------------------------------------------
+class BitReader
+{
+public:
+	BitReader(const uint8_t* data, size_t size) : data(data), size(size), bitPosition(0), overflowed(false) {}
+
+	uint32_t Read(int bits)
+	{
+		if (bitPosition + bits > size * 8)
+		{
+			overflowed = true;
+			bitPosition = size * 8;
+			return 0;
+		}
+
+		uint32_t value = 0;
+		for (int done = 0; done < bits; )
+		{
+			size_t byte = bitPosition >> 3;
+			int offset = (int)(bitPosition & 7);
+			int take = 8 - offset;
+			if (take > bits - done)
+				take = bits - done;
+			uint32_t piece = (data[byte] >> offset) & ((1u << take) - 1);
+			value |= piece << done;
+			done += take;
+			bitPosition += take;
+		}
+		return value;
+	}
+
+	bool ReadBool() { return Read(1) != 0; }
+
+	bool IsOverflowed() const { return overflowed; }
+	size_t GetBitsLeft() const { return size * 8 - bitPosition; }
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t bitPosition;
+	bool overflowed;
+};
@@ -0,0 +1,13 @@
+// Turns the live count into the simulate shader's group count,
+// for DispatchIndirect; the draw's instance count is copied in
+// separately with CopyStructureCount
+
+ByteAddressBuffer Counts		: register(t0);		// [0] live particles
+RWByteAddressBuffer Args		: register(u0);		// Dispatch args at 0
+
+[numthreads(1, 1, 1)]
+void main()
+{
+	uint live = Counts.Load(0);
+	Args.Store3(0, uint3((live + 255) / 256, 1, 1));
+}
@@ -0,0 +1,34 @@
+#include "ParticleCommon.hlsli"
+
+cbuffer externalData : register(b0)
+{
+	float lifetime;
+	uint capacity;
+	uint emitCount;
+	uint newCount;
+};
+
+StructuredBuffer<Emit> Emits			: register(t0);
+ByteAddressBuffer Counts				: register(t1);		// [1] particles that survived this step
+AppendStructuredBuffer<Particle> Next	: register(u0);
+
+// --------------------------------------------------------
+// One thread per new particle.  Anything past the capacity is
+// dropped, the last ones first, as ParticleSim does.
+// --------------------------------------------------------
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	uint live = Counts.Load(4);
+	if (id.x >= newCount || live + id.x >= capacity)
+		return;
+
+	// Bursts are in order of where they start; at most
+	// PARTICLE_MAX_EMITS of them
+	uint e = 0;
+	while (e + 1 < emitCount && Emits[e + 1].first <= id.x)
+		e++;
+
+	Emit emit = Emits[e];
+	Next.Append(SpawnParticle(emit, id.x - emit.first, lifetime));
+}
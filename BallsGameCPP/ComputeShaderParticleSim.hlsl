@@ -0,0 +1,26 @@
+#include "ParticleCommon.hlsli"
+
+cbuffer externalData : register(b0)
+{
+	float deltaTime;
+	float drag;
+};
+
+ConsumeStructuredBuffer<Particle> Current	: register(u0);
+AppendStructuredBuffer<Particle> Next		: register(u1);
+ByteAddressBuffer Counts					: register(t0);		// [0] particles in Current
+
+// --------------------------------------------------------
+// One thread per live particle: moves it, ages it and keeps
+// it if it's still alive
+// --------------------------------------------------------
+[numthreads(256, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+	if (id.x >= Counts.Load(0))
+		return;
+
+	Particle p = Current.Consume();
+	if (StepParticle(p, deltaTime, drag))
+		Next.Append(p);
+}
@@ -0,0 +1,79 @@
+#include "D3D11GpuTimestamps.h"
+
+D3D11GpuTimestamps::D3D11GpuTimestamps(ID3D11Device* device, ID3D11DeviceContext* context)
+	: context(context)
+{
+	available = true;
+
+	D3D11_QUERY_DESC desc = {};
+	for (int f = 0; f < GPU_PROFILER_FRAMES; f++)
+	{
+		desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		disjoint[f] = 0;
+		if (FAILED(device->CreateQuery(&desc, &disjoint[f])))
+			available = false;
+
+		desc.Query = D3D11_QUERY_TIMESTAMP;
+		for (int i = 0; i < GPU_PROFILER_MAX_TIMESTAMPS; i++)
+		{
+			timestamps[f][i] = 0;
+			if (FAILED(device->CreateQuery(&desc, &timestamps[f][i])))
+				available = false;
+		}
+	}
+}
+
+D3D11GpuTimestamps::~D3D11GpuTimestamps()
+{
+	for (int f = 0; f < GPU_PROFILER_FRAMES; f++)
+	{
+		if (disjoint[f]) disjoint[f]->Release();
+		for (int i = 0; i < GPU_PROFILER_MAX_TIMESTAMPS; i++)
+			if (timestamps[f][i]) timestamps[f][i]->Release();
+	}
+}
+
+void D3D11GpuTimestamps::BeginFrame(int frame)
+{
+	if (available)
+		context->Begin(disjoint[frame]);
+}
+
+void D3D11GpuTimestamps::Timestamp(int frame, int index)
+{
+	// Timestamps only have an end
+	if (available)
+		context->End(timestamps[frame][index]);
+}
+
+void D3D11GpuTimestamps::EndFrame(int frame)
+{
+	if (available)
+		context->End(disjoint[frame]);
+}
+
+GpuTimestampStatus D3D11GpuTimestamps::Read(int frame, int count, uint64_t* ticks, uint64_t& frequency)
+{
+	if (!available)
+		return GPU_TIMESTAMPS_UNAVAILABLE;
+
+	// The disjoint query ends last, so once it's done the rest are
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT clock;
+	HRESULT hr = context->GetData(disjoint[frame], &clock, sizeof(clock), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+	if (hr == S_FALSE)
+		return GPU_TIMESTAMPS_PENDING;
+	if (FAILED(hr))
+		return GPU_TIMESTAMPS_UNAVAILABLE;
+
+	for (int i = 0; i < count; i++)
+	{
+		hr = context->GetData(timestamps[frame][i], &ticks[i], sizeof(UINT64), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (hr == S_FALSE)
+			return GPU_TIMESTAMPS_PENDING;
+		if (FAILED(hr))
+			return GPU_TIMESTAMPS_UNAVAILABLE;
+	}
+
+	frequency = clock.Frequency;
+	return clock.Disjoint ? GPU_TIMESTAMPS_DISJOINT : GPU_TIMESTAMPS_READY;
+}
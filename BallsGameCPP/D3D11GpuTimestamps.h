@@ -0,0 +1,33 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "GpuProfiler.h"
+
+// --------------------------------------------------------
+// GpuProfiler's timestamps from D3D11 queries: a
+// TIMESTAMP_DISJOINT query around each frame and a TIMESTAMP
+// query per index, GPU_PROFILER_FRAMES sets of them.
+//
+// Read() asks with DONOTFLUSH, so checking on a frame never
+// pushes the command buffer out early or waits on the GPU.  If
+// the device won't make the queries, every frame is UNAVAILABLE
+// and the profiler stops asking.
+// --------------------------------------------------------
+class D3D11GpuTimestamps : public IGpuTimestamps
+{
+public:
+	D3D11GpuTimestamps(ID3D11Device* device, ID3D11DeviceContext* context);
+	~D3D11GpuTimestamps();
+
+	void BeginFrame(int frame);
+	void Timestamp(int frame, int index);
+	void EndFrame(int frame);
+	GpuTimestampStatus Read(int frame, int count, uint64_t* ticks, uint64_t& frequency);
+
+private:
+	ID3D11DeviceContext* context;
+	ID3D11Query* disjoint[GPU_PROFILER_FRAMES];
+	ID3D11Query* timestamps[GPU_PROFILER_FRAMES][GPU_PROFILER_MAX_TIMESTAMPS];
+	bool available;
+};
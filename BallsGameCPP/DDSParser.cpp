@@ -0,0 +1,425 @@
+#include "DDSParser.h"
+#include "ErrorMessage.h"
+
+#include <cstring>
+
+// Hardware limits from the D3D11 spec (D3D11_REQ_*), repeated here
+// so this file doesn't need the Windows SDK
+static const size_t MAX_MIP_LEVELS = 15;
+static const size_t MAX_TEXTURE1D_DIMENSION = 16384;
+static const size_t MAX_TEXTURE2D_DIMENSION = 16384;
+static const size_t MAX_TEXTURECUBE_DIMENSION = 16384;
+static const size_t MAX_TEXTURE3D_DIMENSION = 2048;
+static const size_t MAX_ARRAY_SIZE = 2048;
+
+// --------------------------------------------------------
+// Returns the bits per pixel of a format, or 0 if unsupported.
+// Takes the raw DXGI value so a format read from a file can be
+// checked before it's made a DDSFormat.
+// --------------------------------------------------------
+size_t DDSBitsPerPixel(uint32_t format)
+{
+	switch (format)
+	{
+	case DDS_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+
+	case DDS_FORMAT_R16G16B16A16_FLOAT:
+	case DDS_FORMAT_R16G16B16A16_UNORM:
+	case DDS_FORMAT_R32G32_FLOAT:
+		return 64;
+
+	case DDS_FORMAT_R10G10B10A2_UNORM:
+	case DDS_FORMAT_R8G8B8A8_UNORM:
+	case DDS_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DDS_FORMAT_R16G16_FLOAT:
+	case DDS_FORMAT_R16G16_UNORM:
+	case DDS_FORMAT_R32_FLOAT:
+	case DDS_FORMAT_B8G8R8A8_UNORM:
+	case DDS_FORMAT_B8G8R8X8_UNORM:
+	case DDS_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DDS_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return 32;
+
+	case DDS_FORMAT_R8G8_UNORM:
+	case DDS_FORMAT_R16_FLOAT:
+	case DDS_FORMAT_R16_UNORM:
+	case DDS_FORMAT_B5G6R5_UNORM:
+	case DDS_FORMAT_B5G5R5A1_UNORM:
+	case DDS_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	case DDS_FORMAT_R8_UNORM:
+	case DDS_FORMAT_A8_UNORM:
+	case DDS_FORMAT_BC2_UNORM:
+	case DDS_FORMAT_BC2_UNORM_SRGB:
+	case DDS_FORMAT_BC3_UNORM:
+	case DDS_FORMAT_BC3_UNORM_SRGB:
+	case DDS_FORMAT_BC5_UNORM:
+	case DDS_FORMAT_BC5_SNORM:
+	case DDS_FORMAT_BC6H_UF16:
+	case DDS_FORMAT_BC6H_SF16:
+	case DDS_FORMAT_BC7_UNORM:
+	case DDS_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	case DDS_FORMAT_BC1_UNORM:
+	case DDS_FORMAT_BC1_UNORM_SRGB:
+	case DDS_FORMAT_BC4_UNORM:
+	case DDS_FORMAT_BC4_SNORM:
+		return 4;
+
+	default:
+		return 0;
+	}
+}
+
+bool DDSIsBlockCompressed(DDSFormat format)
+{
+	return (format >= DDS_FORMAT_BC1_UNORM && format <= DDS_FORMAT_BC5_SNORM) ||
+		(format >= DDS_FORMAT_BC6H_UF16 && format <= DDS_FORMAT_BC7_UNORM_SRGB);
+}
+
+const char* DDSFormatName(DDSFormat format)
+{
+	switch (format)
+	{
+	case DDS_FORMAT_R32G32B32A32_FLOAT: return "R32G32B32A32_FLOAT";
+	case DDS_FORMAT_R16G16B16A16_FLOAT: return "R16G16B16A16_FLOAT";
+	case DDS_FORMAT_R16G16B16A16_UNORM: return "R16G16B16A16_UNORM";
+	case DDS_FORMAT_R32G32_FLOAT: return "R32G32_FLOAT";
+	case DDS_FORMAT_R10G10B10A2_UNORM: return "R10G10B10A2_UNORM";
+	case DDS_FORMAT_R8G8B8A8_UNORM: return "R8G8B8A8_UNORM";
+	case DDS_FORMAT_R8G8B8A8_UNORM_SRGB: return "R8G8B8A8_UNORM_SRGB";
+	case DDS_FORMAT_R16G16_FLOAT: return "R16G16_FLOAT";
+	case DDS_FORMAT_R16G16_UNORM: return "R16G16_UNORM";
+	case DDS_FORMAT_R32_FLOAT: return "R32_FLOAT";
+	case DDS_FORMAT_R8G8_UNORM: return "R8G8_UNORM";
+	case DDS_FORMAT_R16_FLOAT: return "R16_FLOAT";
+	case DDS_FORMAT_R16_UNORM: return "R16_UNORM";
+	case DDS_FORMAT_R8_UNORM: return "R8_UNORM";
+	case DDS_FORMAT_A8_UNORM: return "A8_UNORM";
+	case DDS_FORMAT_BC1_UNORM: return "BC1_UNORM";
+	case DDS_FORMAT_BC1_UNORM_SRGB: return "BC1_UNORM_SRGB";
+	case DDS_FORMAT_BC2_UNORM: return "BC2_UNORM";
+	case DDS_FORMAT_BC2_UNORM_SRGB: return "BC2_UNORM_SRGB";
+	case DDS_FORMAT_BC3_UNORM: return "BC3_UNORM";
+	case DDS_FORMAT_BC3_UNORM_SRGB: return "BC3_UNORM_SRGB";
+	case DDS_FORMAT_BC4_UNORM: return "BC4_UNORM";
+	case DDS_FORMAT_BC4_SNORM: return "BC4_SNORM";
+	case DDS_FORMAT_BC5_UNORM: return "BC5_UNORM";
+	case DDS_FORMAT_BC5_SNORM: return "BC5_SNORM";
+	case DDS_FORMAT_B5G6R5_UNORM: return "B5G6R5_UNORM";
+	case DDS_FORMAT_B5G5R5A1_UNORM: return "B5G5R5A1_UNORM";
+	case DDS_FORMAT_B8G8R8A8_UNORM: return "B8G8R8A8_UNORM";
+	case DDS_FORMAT_B8G8R8X8_UNORM: return "B8G8R8X8_UNORM";
+	case DDS_FORMAT_B8G8R8A8_UNORM_SRGB: return "B8G8R8A8_UNORM_SRGB";
+	case DDS_FORMAT_B8G8R8X8_UNORM_SRGB: return "B8G8R8X8_UNORM_SRGB";
+	case DDS_FORMAT_BC6H_UF16: return "BC6H_UF16";
+	case DDS_FORMAT_BC6H_SF16: return "BC6H_SF16";
+	case DDS_FORMAT_BC7_UNORM: return "BC7_UNORM";
+	case DDS_FORMAT_BC7_UNORM_SRGB: return "BC7_UNORM_SRGB";
+	case DDS_FORMAT_B4G4R4A4_UNORM: return "B4G4R4A4_UNORM";
+	default: return "UNKNOWN";
+	}
+}
+
+// --------------------------------------------------------
+// Gets the byte size, row pitch and row count of one surface.
+// Block compressed formats count rows of 4x4 blocks.
+//
+// Returns false if the format isn't supported
+// --------------------------------------------------------
+bool DDSGetSurfaceInfo(size_t width, size_t height, DDSFormat format, size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows)
+{
+	size_t bpp = DDSBitsPerPixel(format);
+	if (bpp == 0)
+		return false;
+
+	size_t rowBytes = 0;
+	size_t numRows = 0;
+	if (DDSIsBlockCompressed(format))
+	{
+		size_t bytesPerBlock = (bpp == 4) ? 8 : 16;
+		size_t blocksWide = width > 0 ? ((width + 3) / 4) : 0;
+		size_t blocksHigh = height > 0 ? ((height + 3) / 4) : 0;
+		if (blocksWide < 1) blocksWide = 1;
+		if (blocksHigh < 1) blocksHigh = 1;
+		rowBytes = blocksWide * bytesPerBlock;
+		numRows = blocksHigh;
+	}
+	else
+	{
+		rowBytes = (width * bpp + 7) / 8; // Round up to the nearest byte
+		numRows = height;
+	}
+
+	if (outNumBytes) *outNumBytes = rowBytes * numRows;
+	if (outRowBytes) *outRowBytes = rowBytes;
+	if (outNumRows) *outNumRows = numRows;
+	return true;
+}
+
+// --------------------------------------------------------
+// Maps a legacy (pre-DX10) pixel format to a DXGI format
+// --------------------------------------------------------
+static DDSFormat GetLegacyFormat(const DDSPixelFormat& ddpf)
+{
+#define ISBITMASK(r, g, b, a) (ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a)
+
+	if (ddpf.flags & DDS_RGB)
+	{
+		switch (ddpf.RGBBitCount)
+		{
+		case 32:
+			if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DDS_FORMAT_R8G8B8A8_UNORM;
+			if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DDS_FORMAT_B8G8R8A8_UNORM;
+			if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000)) return DDS_FORMAT_B8G8R8X8_UNORM;
+			if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return DDS_FORMAT_R10G10B10A2_UNORM; // D3DX writes this backwards
+			if (ISBITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000)) return DDS_FORMAT_R16G16_UNORM;
+			if (ISBITMASK(0xffffffff, 0x00000000, 0x00000000, 0x00000000)) return DDS_FORMAT_R32_FLOAT;
+			break;
+
+		case 16:
+			if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000)) return DDS_FORMAT_B5G5R5A1_UNORM;
+			if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0x0000)) return DDS_FORMAT_B5G6R5_UNORM;
+			if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000)) return DDS_FORMAT_B4G4R4A4_UNORM;
+			break;
+		}
+	}
+	else if (ddpf.flags & DDS_LUMINANCE)
+	{
+		if (ddpf.RGBBitCount == 8 && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000)) return DDS_FORMAT_R8_UNORM;
+		if (ddpf.RGBBitCount == 16 && ISBITMASK(0x0000ffff, 0x00000000, 0x00000000, 0x00000000)) return DDS_FORMAT_R16_UNORM;
+		if (ddpf.RGBBitCount == 16 && ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00)) return DDS_FORMAT_R8G8_UNORM;
+	}
+	else if (ddpf.flags & DDS_ALPHA)
+	{
+		if (ddpf.RGBBitCount == 8) return DDS_FORMAT_A8_UNORM;
+	}
+	else if (ddpf.flags & DDS_FOURCC)
+	{
+		switch (ddpf.fourCC)
+		{
+		case DDS_MAKEFOURCC('D', 'X', 'T', '1'): return DDS_FORMAT_BC1_UNORM;
+		case DDS_MAKEFOURCC('D', 'X', 'T', '2'):
+		case DDS_MAKEFOURCC('D', 'X', 'T', '3'): return DDS_FORMAT_BC2_UNORM;
+		case DDS_MAKEFOURCC('D', 'X', 'T', '4'):
+		case DDS_MAKEFOURCC('D', 'X', 'T', '5'): return DDS_FORMAT_BC3_UNORM;
+		case DDS_MAKEFOURCC('A', 'T', 'I', '1'):
+		case DDS_MAKEFOURCC('B', 'C', '4', 'U'): return DDS_FORMAT_BC4_UNORM;
+		case DDS_MAKEFOURCC('B', 'C', '4', 'S'): return DDS_FORMAT_BC4_SNORM;
+		case DDS_MAKEFOURCC('A', 'T', 'I', '2'):
+		case DDS_MAKEFOURCC('B', 'C', '5', 'U'): return DDS_FORMAT_BC5_UNORM;
+		case DDS_MAKEFOURCC('B', 'C', '5', 'S'): return DDS_FORMAT_BC5_SNORM;
+
+		// D3DFORMAT enums stored in the FourCC
+		case 36: return DDS_FORMAT_R16G16B16A16_UNORM;
+		case 111: return DDS_FORMAT_R16_FLOAT;
+		case 112: return DDS_FORMAT_R16G16_FLOAT;
+		case 113: return DDS_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DDS_FORMAT_R32_FLOAT;
+		case 115: return DDS_FORMAT_R32G32_FLOAT;
+		case 116: return DDS_FORMAT_R32G32B32A32_FLOAT;
+		}
+	}
+
+#undef ISBITMASK
+	return DDS_FORMAT_UNKNOWN;
+}
+
+// --------------------------------------------------------
+// Validates the DDS header(s) at the start of a file and fills
+// out the texture description.  Nothing past the headers is read.
+//
+// data  - The whole file (or at least its headers)
+// size  - Size of the file in bytes
+// info  - Receives the texture description
+// error - Optional, receives a reason on failure
+// --------------------------------------------------------
+bool DDSParseHeader(const uint8_t* data, size_t size, DDSTextureInfo& info, std::string* error)
+{
+	memset(&info, 0, sizeof(info));
+
+	if (!data || size < sizeof(uint32_t) + sizeof(DDSHeader))
+		return Fail(error, "File too small for a DDS header");
+
+	uint32_t magic;
+	memcpy(&magic, data, sizeof(magic));
+	if (magic != DDS_MAGIC)
+		return Fail(error, "Missing DDS magic number");
+
+	DDSHeader header;
+	memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+	if (header.size != sizeof(DDSHeader) || header.ddspf.size != sizeof(DDSPixelFormat))
+		return Fail(error, "Bad DDS header size");
+
+	info.width = header.width;
+	info.height = header.height;
+	info.depth = header.depth;
+	info.mipCount = header.mipMapCount ? header.mipMapCount : 1;
+	info.arraySize = 1;
+	info.dataOffset = sizeof(uint32_t) + sizeof(DDSHeader);
+
+	if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == DDS_MAKEFOURCC('D', 'X', '1', '0'))
+	{
+		if (size < info.dataOffset + sizeof(DDSHeaderDXT10))
+			return Fail(error, "File too small for a DX10 header");
+
+		DDSHeaderDXT10 dx10;
+		memcpy(&dx10, data + info.dataOffset, sizeof(dx10));
+		info.dataOffset += sizeof(DDSHeaderDXT10);
+
+		info.arraySize = dx10.arraySize;
+		if (info.arraySize == 0)
+			return Fail(error, "Array size of zero");
+
+		if (DDSBitsPerPixel(dx10.dxgiFormat) == 0)
+			return Fail(error, "Unsupported DXGI format");
+		info.format = (DDSFormat)dx10.dxgiFormat;
+
+		info.alphaMode = dx10.miscFlags2 & 0x7;
+
+		switch (dx10.resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			if ((header.flags & 0x2) && info.height != 1) // DDS_HEIGHT
+				return Fail(error, "1D texture with a height");
+			info.height = info.depth = 1;
+			break;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			if (dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				info.arraySize *= 6;
+				info.isCubeMap = true;
+			}
+			info.depth = 1;
+			break;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (!(header.flags & DDS_HEADER_FLAGS_VOLUME))
+				return Fail(error, "3D texture without the volume flag");
+			if (info.arraySize > 1)
+				return Fail(error, "3D texture arrays aren't supported");
+			break;
+
+		default:
+			return Fail(error, "Unknown resource dimension");
+		}
+
+		info.dimension = (DDSDimension)dx10.resourceDimension;
+	}
+	else
+	{
+		info.format = GetLegacyFormat(header.ddspf);
+		if (info.format == DDS_FORMAT_UNKNOWN)
+			return Fail(error, "Unsupported legacy pixel format");
+
+		if (header.flags & DDS_HEADER_FLAGS_VOLUME)
+		{
+			info.dimension = DDS_DIMENSION_TEXTURE3D;
+		}
+		else
+		{
+			if (header.caps2 & DDS_CUBEMAP)
+			{
+				// We require all six faces to be defined
+				if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+					return Fail(error, "Partial cube maps aren't supported");
+
+				info.arraySize = 6;
+				info.isCubeMap = true;
+			}
+
+			info.depth = 1;
+			info.dimension = DDS_DIMENSION_TEXTURE2D;
+		}
+	}
+
+	// Don't trust metadata larger than the hardware limits
+	if (info.mipCount > MAX_MIP_LEVELS)
+		return Fail(error, "Too many mip levels");
+
+	if (info.width == 0 || info.height == 0 || info.depth == 0)
+		return Fail(error, "Zero sized texture");
+
+	switch (info.dimension)
+	{
+	case DDS_DIMENSION_TEXTURE1D:
+		if (info.arraySize > MAX_ARRAY_SIZE || info.width > MAX_TEXTURE1D_DIMENSION)
+			return Fail(error, "1D texture exceeds hardware limits");
+		break;
+
+	case DDS_DIMENSION_TEXTURE2D:
+		if (info.arraySize > MAX_ARRAY_SIZE ||
+			info.width > (info.isCubeMap ? MAX_TEXTURECUBE_DIMENSION : MAX_TEXTURE2D_DIMENSION) ||
+			info.height > (info.isCubeMap ? MAX_TEXTURECUBE_DIMENSION : MAX_TEXTURE2D_DIMENSION))
+			return Fail(error, "2D texture exceeds hardware limits");
+		break;
+
+	case DDS_DIMENSION_TEXTURE3D:
+		if (info.width > MAX_TEXTURE3D_DIMENSION || info.height > MAX_TEXTURE3D_DIMENSION || info.depth > MAX_TEXTURE3D_DIMENSION)
+			return Fail(error, "3D texture exceeds hardware limits");
+		break;
+
+	default:
+		return Fail(error, "Unknown resource dimension");
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Builds the list of surfaces (array slice major, then mip)
+// pointing directly into the file data - this is the same
+// ordering D3D11_SUBRESOURCE_DATA arrays use, and nothing
+// is copied.
+//
+// Returns false if the file is too short for its header
+// --------------------------------------------------------
+bool DDSGetSurfaces(const DDSTextureInfo& info, const uint8_t* data, size_t size, std::vector<DDSSurface>& surfaces, std::string* error)
+{
+	surfaces.clear();
+	surfaces.reserve(info.mipCount * info.arraySize);
+
+	if (size < info.dataOffset)
+		return Fail(error, "File too small for its headers");
+
+	const uint8_t* bits = data + info.dataOffset;
+	const uint8_t* end = data + size;
+
+	for (size_t slice = 0; slice < info.arraySize; slice++)
+	{
+		size_t w = info.width;
+		size_t h = info.height;
+		size_t d = info.depth;
+		for (size_t mip = 0; mip < info.mipCount; mip++)
+		{
+			size_t numBytes = 0;
+			size_t rowBytes = 0;
+			if (!DDSGetSurfaceInfo(w, h, info.format, &numBytes, &rowBytes, 0))
+				return Fail(error, "Unsupported format");
+
+			if ((size_t)(end - bits) < numBytes * d)
+				return Fail(error, "File is truncated");
+
+			DDSSurface surface;
+			surface.data = bits;
+			surface.rowPitch = rowBytes;
+			surface.slicePitch = numBytes;
+			surface.width = w;
+			surface.height = h;
+			surface.depth = d;
+			surfaces.push_back(surface);
+
+			bits += numBytes * d;
+
+			w = w > 1 ? w >> 1 : 1;
+			h = h > 1 ? h >> 1 : 1;
+			d = d > 1 ? d >> 1 : 1;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Platform-neutral DDS header parsing and validation.
+//
+// Nothing in here touches Direct3D, so the same code is used
+// by the game's texture loader and by the Linux tools.  The
+// format values are numerically identical to DXGI_FORMAT and
+// the dimensions to D3D11_RESOURCE_DIMENSION, so they can be
+// cast straight across on the D3D side.
+// --------------------------------------------------------
+
+#pragma pack(push, 1)
+struct DDSPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t RGBBitCount;
+	uint32_t RBitMask;
+	uint32_t GBitMask;
+	uint32_t BBitMask;
+	uint32_t ABitMask;
+};
+
+struct DDSHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat ddspf;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct DDSHeaderDXT10
+{
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+#pragma pack(pop)
+
+#define DDS_MAKEFOURCC(a, b, c, d) \
+	((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+// Header flags
+const uint32_t DDS_HEADER_FLAGS_TEXTURE = 0x00001007; // CAPS | HEIGHT | WIDTH | PIXELFORMAT
+const uint32_t DDS_HEADER_FLAGS_MIPMAP = 0x00020000;
+const uint32_t DDS_HEADER_FLAGS_VOLUME = 0x00800000;
+const uint32_t DDS_HEADER_FLAGS_LINEARSIZE = 0x00080000;
+
+// Pixel format flags
+const uint32_t DDS_FOURCC = 0x00000004;
+const uint32_t DDS_RGB = 0x00000040;
+const uint32_t DDS_LUMINANCE = 0x00020000;
+const uint32_t DDS_ALPHA = 0x00000002;
+
+// Caps
+const uint32_t DDS_SURFACE_FLAGS_TEXTURE = 0x00001000;
+const uint32_t DDS_SURFACE_FLAGS_MIPMAP = 0x00400008; // COMPLEX | MIPMAP
+const uint32_t DDS_CUBEMAP = 0x00000200;
+const uint32_t DDS_CUBEMAP_ALLFACES = 0x0000FE00;
+
+const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+// Same values as D3D11_RESOURCE_DIMENSION
+enum DDSDimension
+{
+	DDS_DIMENSION_UNKNOWN = 0,
+	DDS_DIMENSION_TEXTURE1D = 2,
+	DDS_DIMENSION_TEXTURE2D = 3,
+	DDS_DIMENSION_TEXTURE3D = 4
+};
+
+// The subset of DXGI_FORMAT values this loader understands
+enum DDSFormat
+{
+	DDS_FORMAT_UNKNOWN = 0,
+	DDS_FORMAT_R32G32B32A32_FLOAT = 2,
+	DDS_FORMAT_R16G16B16A16_FLOAT = 10,
+	DDS_FORMAT_R16G16B16A16_UNORM = 11,
+	DDS_FORMAT_R32G32_FLOAT = 16,
+	DDS_FORMAT_R10G10B10A2_UNORM = 24,
+	DDS_FORMAT_R8G8B8A8_UNORM = 28,
+	DDS_FORMAT_R8G8B8A8_UNORM_SRGB = 29,
+	DDS_FORMAT_R16G16_FLOAT = 34,
+	DDS_FORMAT_R16G16_UNORM = 35,
+	DDS_FORMAT_R32_FLOAT = 41,
+	DDS_FORMAT_R8G8_UNORM = 49,
+	DDS_FORMAT_R16_FLOAT = 54,
+	DDS_FORMAT_R16_UNORM = 56,
+	DDS_FORMAT_R8_UNORM = 61,
+	DDS_FORMAT_A8_UNORM = 65,
+	DDS_FORMAT_BC1_UNORM = 71,
+	DDS_FORMAT_BC1_UNORM_SRGB = 72,
+	DDS_FORMAT_BC2_UNORM = 74,
+	DDS_FORMAT_BC2_UNORM_SRGB = 75,
+	DDS_FORMAT_BC3_UNORM = 77,
+	DDS_FORMAT_BC3_UNORM_SRGB = 78,
+	DDS_FORMAT_BC4_UNORM = 80,
+	DDS_FORMAT_BC4_SNORM = 81,
+	DDS_FORMAT_BC5_UNORM = 83,
+	DDS_FORMAT_BC5_SNORM = 84,
+	DDS_FORMAT_B5G6R5_UNORM = 85,
+	DDS_FORMAT_B5G5R5A1_UNORM = 86,
+	DDS_FORMAT_B8G8R8A8_UNORM = 87,
+	DDS_FORMAT_B8G8R8X8_UNORM = 88,
+	DDS_FORMAT_B8G8R8A8_UNORM_SRGB = 91,
+	DDS_FORMAT_B8G8R8X8_UNORM_SRGB = 93,
+	DDS_FORMAT_BC6H_UF16 = 95,
+	DDS_FORMAT_BC6H_SF16 = 96,
+	DDS_FORMAT_BC7_UNORM = 98,
+	DDS_FORMAT_BC7_UNORM_SRGB = 99,
+	DDS_FORMAT_B4G4R4A4_UNORM = 115
+};
+
+// --------------------------------------------------------
+// Everything needed to create the texture, pulled from the header
+// --------------------------------------------------------
+struct DDSTextureInfo
+{
+	DDSDimension dimension;
+	DDSFormat format;
+	size_t width;
+	size_t height;
+	size_t depth;
+	size_t mipCount;
+	size_t arraySize;		// Already multiplied by 6 for cube maps
+	bool isCubeMap;
+	uint32_t alphaMode;		// DDS_ALPHA_MODE from the DX10 header, 0 if unknown
+	size_t dataOffset;		// Byte offset of the first surface in the file
+};
+
+// --------------------------------------------------------
+// One mip level of one array slice, pointing into the file data
+// --------------------------------------------------------
+struct DDSSurface
+{
+	const uint8_t* data;
+	size_t rowPitch;
+	size_t slicePitch;
+	size_t width;
+	size_t height;
+	size_t depth;
+};
+
+size_t DDSBitsPerPixel(uint32_t format);
+bool DDSIsBlockCompressed(DDSFormat format);
+const char* DDSFormatName(DDSFormat format);
+
+bool DDSGetSurfaceInfo(size_t width, size_t height, DDSFormat format, size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows);
+
+bool DDSParseHeader(const uint8_t* data, size_t size, DDSTextureInfo& info, std::string* error = 0);
+bool DDSGetSurfaces(const DDSTextureInfo& info, const uint8_t* data, size_t size, std::vector<DDSSurface>& surfaces, std::string* error = 0);
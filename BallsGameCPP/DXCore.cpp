@@ -1,4 +1,5 @@
 #include "DXCore.h"
+#include "Profiler.h"
 
 #include <WindowsX.h>
 #include <sstream>
@@ -48,8 +49,6 @@ DXCore::DXCore(
 	this->titleBarStats = debugTitleBarStats;
 
 	// Initialize fields
-	fpsFrameCount = 0;
-	fpsTimeElapsed = 0.0f;
 	
 	device = 0;
 	context = 0;
@@ -353,8 +352,10 @@ HRESULT DXCore::Run()
 	// Give subclass a chance to initialize
 	Init();
 
-	// Our overall game and message loop
+	// Our overall game and message loop.  The first frame's time
+	// includes Init, so it's left out of the stats.
 	MSG msg = {};
+	bool firstFrame = true;
 	while (msg.message != WM_QUIT)
 	{
 		// Determine if there is a message waiting
@@ -367,14 +368,23 @@ HRESULT DXCore::Run()
 		}
 		else
 		{
-			// Update timer and title bar (if necessary)
+			// Update timer
 			UpdateTimer();
-			if(titleBarStats)
-				UpdateTitleBarStats();
 
 			// The game loop
+			PROFILE_SCOPE("Frame");
+			__int64 updateStart, drawStart, drawEnd;
+			QueryPerformanceCounter((LARGE_INTEGER*)&updateStart);
 			Update(deltaTime, totalTime);
+			QueryPerformanceCounter((LARGE_INTEGER*)&drawStart);
 			Draw(deltaTime, totalTime);
+			QueryPerformanceCounter((LARGE_INTEGER*)&drawEnd);
+
+			// Title bar too, whenever the stats' window closes
+			if (!firstFrame && frameStats.AddFrame(deltaTime,
+				(drawStart - updateStart) * perfCounterSeconds, (drawEnd - drawStart) * perfCounterSeconds) && titleBarStats)
+				UpdateTitleBarStats();
+			firstFrame = false;
 		}
 	}
 
@@ -419,32 +429,29 @@ void DXCore::UpdateTimer()
 
 
 // --------------------------------------------------------
-// Updates the window's title bar with several stats once
-// per second, including:
+// Updates the window's title bar with several stats each
+// time frameStats closes a window (once per second), including:
 //  - The window's width & height
-//  - The current FPS and ms/frame
+//  - The FPS, and the frame time's median, 99th percentile
+//    and worst - an average hides the hitches
 //  - The version of DirectX actually being used (usually 11)
 // --------------------------------------------------------
 void DXCore::UpdateTitleBarStats()
 {
-	fpsFrameCount++;
-
-	// Only calc FPS and update title bar once per second
-	float timeDiff = totalTime - fpsTimeElapsed;
-	if (timeDiff < 1.0f)
+	const FrameStatsWindow& stats = frameStats.GetLastWindow();
+	if (stats.seconds <= 0)
 		return;
 
-	// How long did each frame take?  (Approx)
-	float mspf = 1000.0f / (float)fpsFrameCount;
-
 	// Quick and dirty title bar text (mostly for debugging)
 	std::ostringstream output;
-	output.precision(6);
+	output.precision(4);
 	output << titleBarText <<
 		"    Width: "		<< width <<
 		"    Height: "		<< height <<
-		"    FPS: "			<< fpsFrameCount <<
-		"    Frame Time: "	<< mspf << "ms";
+		"    FPS: "			<< (int)(stats.frames / stats.seconds + 0.5) <<
+		"    Frame Time: "	<< stats.p50Ms[FRAME_STATS_FRAME] << "ms" <<
+		"  p99: "			<< stats.p99Ms[FRAME_STATS_FRAME] << "ms" <<
+		"  max: "			<< stats.maxMs[FRAME_STATS_FRAME] << "ms";
 
 	// Append the version of DirectX the app is using
 	switch (dxFeatureLevel)
@@ -459,10 +466,8 @@ void DXCore::UpdateTitleBarStats()
 	default:                     output << "    DX ???";  break;
 	}
 
-	// Actually update the title bar and reset fps data
+	// Actually update the title bar
 	SetWindowText(hWnd, output.str().c_str());
-	fpsFrameCount = 0;
-	fpsTimeElapsed += 1.0f;
 }
 
 // --------------------------------------------------------
@@ -4,6 +4,8 @@
 #include <d3d11.h>
 #include <string>
 
+#include "FrameStats.h"
+
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
@@ -69,6 +71,9 @@ protected:
 	ID3D11RenderTargetView* backBufferRTV;
 	ID3D11DepthStencilView* depthStencilView;
 
+	// Frame, update and draw time percentiles, filled by Run()
+	FrameStats frameStats;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
@@ -81,10 +86,6 @@ private:
 	__int64 currentTime;
 	__int64 previousTime;
 
-	// FPS calculation
-	int fpsFrameCount;
-	float fpsTimeElapsed;
-	
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
 };
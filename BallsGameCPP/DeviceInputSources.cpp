@@ -0,0 +1,110 @@
+#include "DeviceInputSources.h"
+
+using namespace DirectX;
+
+KeyboardInputSource::KeyboardInputSource()
+{
+	lastPollNs = 0;
+	rawInput = new RawInputThread(queue);
+}
+
+KeyboardInputSource::~KeyboardInputSource()
+{
+	delete rawInput;
+}
+
+bool KeyboardInputSource::Start(std::string* error)
+{
+	return rawInput->Start(error);
+}
+
+// Take the raw input thread's presses every frame so its queue
+// never fills, whether or not a match wants them
+void KeyboardInputSource::BeginFrame(int64_t frameNs)
+{
+	if (rawInput->IsRunning())
+		schedule.Drain(queue);
+	else
+		Poll(frameNs);
+}
+
+uint8_t KeyboardInputSource::TakeStep(Match& /*match*/, int64_t stepEndNs, std::vector<InputEvent>* presses)
+{
+	return schedule.Take(stepEndNs, presses);
+}
+
+void KeyboardInputSource::Clear()
+{
+	schedule.Drain(queue);
+	schedule.Clear();
+}
+
+// Without the raw input thread, presses since the last poll are
+// all stamped with that poll's time.  The frame's first step
+// ends after it, so they go on that step, as they always used
+// to; stamped with this frame's time they'd wait for the next.
+void KeyboardInputSource::Poll(int64_t frameNs)
+{
+	InputEvent event;
+	event.timeNs = lastPollNs ? lastPollNs : frameNs;
+	event.buttons = 0;
+	lastPollNs = frameNs;
+	if (GetAsyncKeyState('W') & 0x1)
+		event.buttons |= MATCH_P1_UP;
+	if (GetAsyncKeyState('S') & 0x1)
+		event.buttons |= MATCH_P1_DOWN;
+	if (GetAsyncKeyState(VK_SPACE) & 0x1)
+		event.buttons |= MATCH_P1_FIRE;
+	if (GetAsyncKeyState(VK_UP) & 0x1)
+		event.buttons |= MATCH_P2_UP;
+	if (GetAsyncKeyState(VK_DOWN) & 0x1)
+		event.buttons |= MATCH_P2_DOWN;
+	if (GetAsyncKeyState(VK_RCONTROL) & 0x1)
+		event.buttons |= MATCH_P2_FIRE;
+	if (event.buttons)
+		schedule.Add(event);
+}
+
+GamePadInputSource::GamePadInputSource()
+{
+	gamePad.reset(new GamePad());
+	lastPollNs = 0;
+}
+
+// Only fresh presses count, as with the keyboard, and they're
+// stamped the same way
+void GamePadInputSource::BeginFrame(int64_t frameNs)
+{
+	int64_t pressNs = lastPollNs ? lastPollNs : frameNs;
+	lastPollNs = frameNs;
+
+	for (int player = 0; player < 2; player++)
+	{
+		GamePad::State state = gamePad->GetState(player);
+		GamePad::ButtonStateTracker& tracker = trackers[player];
+		if (!state.IsConnected())
+		{
+			tracker.Reset();
+			continue;
+		}
+		tracker.Update(state);
+
+		InputEvent event;
+		event.timeNs = pressNs;
+		event.buttons = 0;
+		if (tracker.dpadUp == GamePad::ButtonStateTracker::PRESSED || tracker.leftStickUp == GamePad::ButtonStateTracker::PRESSED)
+			event.buttons |= MATCH_P1_UP;
+		if (tracker.dpadDown == GamePad::ButtonStateTracker::PRESSED || tracker.leftStickDown == GamePad::ButtonStateTracker::PRESSED)
+			event.buttons |= MATCH_P1_DOWN;
+		if (tracker.a == GamePad::ButtonStateTracker::PRESSED)
+			event.buttons |= MATCH_P1_FIRE;
+		event.buttons <<= player * 3;
+		if (event.buttons)
+			schedule.Add(event);
+	}
+}
+
+uint8_t GamePadInputSource::TakeStep(Match& /*match*/, int64_t stepEndNs, std::vector<InputEvent>* presses)
+{
+	return schedule.Take(stepEndNs, presses);
+}
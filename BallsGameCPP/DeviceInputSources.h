@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Windows.h>
+#include <memory>
+#include <string>
+
+#include "GamePad.h"
+#include "InputSource.h"
+#include "RawInputThread.h"
+
+// --------------------------------------------------------
+// The keyboard: presses stamped on the raw input thread the
+// moment they arrive, or polled once a frame if that thread
+// won't start.  A polled press is stamped with the frame before's
+// time, the earliest it could have been, so it goes on the
+// frame's first step as it always did.
+// --------------------------------------------------------
+class KeyboardInputSource : public InputSource
+{
+public:
+	KeyboardInputSource();
+	~KeyboardInputSource();
+
+	// False, with why in error, if it fell back to polling
+	bool Start(std::string* error = 0);
+
+	const char* GetName() const { return "keyboard"; }
+	void BeginFrame(int64_t frameNs);
+	uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses);
+	void Clear();
+	uint32_t GetDropped() const { return queue.GetDropped(); }
+
+private:
+	void Poll(int64_t frameNs);
+
+	InputQueue queue;			//Presses from the raw input thread, with when they happened
+	InputSchedule schedule;		//Presses waiting for the step they fall in
+	RawInputThread* rawInput;
+	int64_t lastPollNs;			//When Poll last ran
+};
+
+// --------------------------------------------------------
+// Xbox pads through DirectXTK: the first pad plays player 1
+// and the second player 2, with the d-pad or left stick for
+// rows and A to fire.  XInput has no events, so pads are
+// polled once a frame, and presses stamped like the keyboard's
+// polled ones so they go on the frame's first step.
+// --------------------------------------------------------
+class GamePadInputSource : public InputSource
+{
+public:
+	GamePadInputSource();
+
+	const char* GetName() const { return "gamepad"; }
+	void BeginFrame(int64_t frameNs);
+	uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses);
+	void Clear() { schedule.Clear(); }
+
+private:
+	std::unique_ptr<DirectX::GamePad> gamePad;
+	DirectX::GamePad::ButtonStateTracker trackers[2];
+	InputSchedule schedule;
+	int64_t lastPollNs;
+};
@@ -2,22 +2,25 @@
 
 #include "Ball.h"
 #include <vector>
-#include "GameEntity.h"
+
+// Particles live inside the emitter so it stays plain data
+const int EMITTER_MAX_PARTICLES = 10;
 
 struct particle
 {
 	myVector position;
 	myVector direction;
 	float lifetime;
-	GameEntity* quad;
 
-	particle(myVector position, myVector direction, float lifetime, GameEntity* quad) : position(position), direction(direction), lifetime(lifetime), quad(quad) {}
+	particle() {}
+	particle(myVector position, myVector direction, float lifetime) : position(position), direction(direction), lifetime(lifetime) {}
 };
 
 
 class Emitter
 {
-	std::vector<particle>* particles;
+	particle particles[EMITTER_MAX_PARTICLES];
+	int particleCount;
 	float maxLifetime;
 	float period;
 	int numLiveParticles;
@@ -28,52 +31,55 @@ class Emitter
 
 
 public:
-	Emitter(float maxLifetime, std::vector<GameEntity*>* quads, myVector origin, float particleVelocity)
+	Emitter() {}
+	Emitter(float maxLifetime, int particleCount, myVector origin, float particleVelocity, SimRandom& random)
 	{
 		this->maxLifetime = maxLifetime;
-		this->numLiveParticles = quads->size() / 2; 
+		this->numLiveParticles = particleCount / 2; 
 		this->period = this->maxLifetime / this->numLiveParticles;
 		this->origin = origin;
-		this->particles = new std::vector<particle>();
+		this->particleCount = particleCount < EMITTER_MAX_PARTICLES ? particleCount : EMITTER_MAX_PARTICLES;
 		this->index = 0;
 		this->timer = 0;
-		for (int i = 0; i < quads->size(); ++i)
+		for (int i = 0; i < this->particleCount; ++i)
 		{
-			this->particles->push_back(particle(myVector(0,0,0.65), myVector::randVector() * particleVelocity, 0, (*quads)[i]));
+			this->particles[i] = particle(myVector(0,0,0.65f), myVector::randVector(random) * particleVelocity, 0);
 		}
-		(*(this->particles))[0].lifetime = this->maxLifetime;
-		(*(this->particles))[0].position = origin;
+		this->particles[0].lifetime = this->maxLifetime;
+		this->particles[0].position = origin;
 		this->emitterTimer = 0;
 	}
 
-	Emitter(float maxLifetime, std::vector<GameEntity*>* quads, myVector origin, float particleVelocity, float emitterTimer)
+	Emitter(float maxLifetime, int particleCount, myVector origin, float particleVelocity, float emitterTimer, SimRandom& random)
 	{
 		this->maxLifetime = maxLifetime;
-		this->numLiveParticles = quads->size() / 2;
+		this->numLiveParticles = particleCount / 2;
 		this->period = this->maxLifetime / this->numLiveParticles;
 		this->origin = origin;
-		this->particles = new std::vector<particle>();
+		this->particleCount = particleCount < EMITTER_MAX_PARTICLES ? particleCount : EMITTER_MAX_PARTICLES;
 		this->index = 0;
 		this->timer = 0;
-		for (int i = 0; i < quads->size(); ++i)
+		for (int i = 0; i < this->particleCount; ++i)
 		{
-			this->particles->push_back(particle(myVector(0, 0, 0.65), myVector::randVector() * particleVelocity, 0, (*quads)[i]));
+			this->particles[i] = particle(myVector(0, 0, 0.65f), myVector::randVector(random) * particleVelocity, 0);
 		}
-		(*(this->particles))[0].lifetime = this->maxLifetime;
-		(*(this->particles))[0].position = origin;
+		this->particles[0].lifetime = this->maxLifetime;
+		this->particles[0].position = origin;
 		this->emitterTimer = emitterTimer;
 	}
 
-	std::vector<GameEntity*> getActiveParticles()
+	// fades gets how much of each one's life is left, 1 to 0
+	void getActiveParticles(std::vector<myVector>& positions, std::vector<float>* fades = 0)
 	{
-		std::vector<GameEntity*> toReturn = std::vector<GameEntity*>();
-		for (auto& particle : *(this->particles))
+		for (int i = 0; i < this->particleCount; ++i)
 		{
-			if (particle.lifetime > 0)
-				toReturn.push_back(particle.quad);
-			
+			if (this->particles[i].lifetime > 0)
+			{
+				positions.push_back(this->particles[i].position);
+				if (fades)
+					fades->push_back(this->particles[i].lifetime / this->maxLifetime);
+			}
 		}
-		return toReturn;
 	}
 
 	void update(float deltaTime)
@@ -83,19 +89,19 @@ public:
 		{
 			this->timer = 0;
 			this->index++;
-			if (this->index >= this->particles->size())
+			if (this->index >= this->particleCount)
 				this->index = 0;
-			(*(this->particles))[index].lifetime = this->maxLifetime;
-			(*(this->particles))[index].position = origin;
+			this->particles[index].lifetime = this->maxLifetime;
+			this->particles[index].position = origin;
 		}
 
-		for (auto& particle : *(this->particles))
+		for (int i = 0; i < this->particleCount; ++i)
 		{
+			particle& particle = this->particles[i];
 			if (particle.lifetime > 0)
 			{
 				particle.position += particle.direction;
 				particle.lifetime -= deltaTime;
-				particle.quad->SetTranslation(particle.position.x, particle.position.y, particle.position.z);
 			}
 		}
 		if (this->emitterTimer > 0)
@@ -107,17 +113,34 @@ public:
 	}
 
 	bool isAlive()
+	{
+		return this->emitterTimer != 0;
+	}
+
+	// Seconds until the emitter goes; counts down from the
+	// emitterTimer it was made with
+	float getTimeLeft()
 	{
 		return this->emitterTimer;
 	}
 
-	~Emitter()
+	myVector getOrigin()
+	{
+		return this->origin;
+	}
+
+	uint32_t hash(uint32_t hash)
 	{
-		for (int i = 0; i < this->particles->size(); ++i)
+		for (int i = 0; i < this->particleCount; ++i)
 		{
-			delete (*(this->particles))[i].quad;
+			const particle& particle = this->particles[i];
+			hash = SimHash(hash, &particle.position, sizeof(myVector));
+			hash = SimHash(hash, &particle.direction, sizeof(myVector));
+			hash = SimHash(hash, &particle.lifetime, sizeof(float));
 		}
-		delete this->particles;
+		hash = SimHash(hash, &this->index, sizeof(int));
+		hash = SimHash(hash, &this->timer, sizeof(float));
+		return SimHash(hash, &this->emitterTimer, sizeof(float));
 	}
 };
 
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+
+// --------------------------------------------------------
+// For functions that return false on failure and take an
+// optional std::string* for the reason: fills it in if one was
+// given, and returns false, so a failure is one line -
+//   return Fail(error, "what went wrong");
+// --------------------------------------------------------
+inline bool Fail(std::string* error, const std::string& message)
+{
+	if (error) *error = message;
+	return false;
+}
@@ -0,0 +1,124 @@
+#include "FileWatcher.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+FileWatcher::FileWatcher(Callback onChange, int pollMilliseconds)
+{
+	this->onChange = onChange;
+	this->pollMilliseconds = pollMilliseconds;
+	running = false;
+}
+
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+// --------------------------------------------------------
+// Gets a file's last write time and size.
+//
+// Returns false if the file doesn't exist (or is locked)
+// --------------------------------------------------------
+bool FileWatcher::GetFileStamp(const std::string& file, int64_t& lastWrite, int64_t& size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(file.c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	lastWrite = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	size = ((int64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0)
+		return false;
+
+	lastWrite = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	size = (int64_t)st.st_size;
+#endif
+	return true;
+}
+
+void FileWatcher::AddFile(const std::string& file)
+{
+	WatchedFile watched;
+	watched.path = file;
+	watched.lastWrite = 0;
+	watched.size = 0;
+	watched.changing = false;
+	GetFileStamp(file, watched.lastWrite, watched.size);
+
+	std::lock_guard<std::mutex> lock(filesMutex);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (files[i].path == file)
+			return;
+	}
+	files.push_back(watched);
+}
+
+void FileWatcher::Start()
+{
+	if (running)
+		return;
+
+	running = true;
+	thread = std::thread(&FileWatcher::Run, this);
+}
+
+void FileWatcher::Stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+void FileWatcher::Run()
+{
+	std::vector<std::string> changed;
+	std::vector<Clock::time_point> detectedTimes;
+
+	while (running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(pollMilliseconds));
+
+		changed.clear();
+		detectedTimes.clear();
+		{
+			std::lock_guard<std::mutex> lock(filesMutex);
+			for (size_t i = 0; i < files.size(); i++)
+			{
+				WatchedFile& file = files[i];
+
+				int64_t lastWrite, size;
+				if (!GetFileStamp(file.path, lastWrite, size))
+					continue; // Probably being replaced, try again next poll
+
+				if (lastWrite != file.lastWrite || size != file.size)
+				{
+					// Still being written - restart the settle timer
+					if (!file.changing)
+						file.detected = Clock::now();
+					file.changing = true;
+					file.lastWrite = lastWrite;
+					file.size = size;
+				}
+				else if (file.changing)
+				{
+					// Unchanged for a whole poll, report it
+					file.changing = false;
+					changed.push_back(file.path);
+					detectedTimes.push_back(file.detected);
+				}
+			}
+		}
+
+		// Callbacks run outside the lock so they can take as long as they need
+		for (size_t i = 0; i < changed.size(); i++)
+			onChange(changed[i], detectedTimes[i]);
+	}
+}
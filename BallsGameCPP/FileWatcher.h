@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// Watches a list of files for changes on a background thread.
+//
+// Polls each file's last write time and size, and only reports
+// a change once the file has stopped changing for one poll, so
+// half-written files (an editor or the shader compiler still
+// writing) aren't picked up.  The game only watches a couple of
+// dozen files, so polling is cheaper and simpler than keeping a
+// directory change handle per folder.
+//
+// The callback runs on the watcher thread.
+// --------------------------------------------------------
+class FileWatcher
+{
+public:
+	typedef std::chrono::high_resolution_clock Clock;
+	typedef std::function<void(const std::string& file, Clock::time_point detected)> Callback;
+
+	FileWatcher(Callback onChange, int pollMilliseconds = 100);
+	~FileWatcher();
+
+	// Safe to call while the watcher is running
+	void AddFile(const std::string& file);
+
+	void Start();
+	void Stop();
+
+private:
+	struct WatchedFile
+	{
+		std::string path;
+		int64_t lastWrite;
+		int64_t size;
+		bool changing;				// Saw a new stamp, waiting for it to settle
+		Clock::time_point detected;	// When the change was first seen
+	};
+
+	static bool GetFileStamp(const std::string& file, int64_t& lastWrite, int64_t& size);
+	void Run();
+
+	Callback onChange;
+	int pollMilliseconds;
+
+	std::mutex filesMutex;
+	std::vector<WatchedFile> files;
+
+	std::thread thread;
+	std::atomic<bool> running;
+};
@@ -0,0 +1,230 @@
+#include "FrameStats.h"
+#include "ErrorMessage.h"
+
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Default window, as often as the title bar used to update
+const double FRAME_STATS_WINDOW_SECONDS = 1.0;
+
+// Index of the highest set bit; value must not be 0
+static int HighestBit(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (int)index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+		return (int)index + 32;
+	_BitScanReverse(&index, (unsigned long)value);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+int TimeHistogram::GetBucket(uint64_t ns)
+{
+	if (ns < (uint64_t)TIME_HISTOGRAM_SUB_BUCKETS)
+		return (int)ns;
+
+	// The top TIME_HISTOGRAM_SUB_BUCKET_BITS + 1 bits pick the
+	// bucket, so each row splits its power of two evenly
+	int shift = HighestBit(ns) - TIME_HISTOGRAM_SUB_BUCKET_BITS;
+	int subBucket = (int)(ns >> shift) - TIME_HISTOGRAM_SUB_BUCKETS;
+	return (shift + 1) * TIME_HISTOGRAM_SUB_BUCKETS + subBucket;
+}
+
+uint64_t TimeHistogram::GetBucketValue(int bucket)
+{
+	if (bucket < TIME_HISTOGRAM_SUB_BUCKETS)
+		return (uint64_t)bucket;
+
+	int shift = bucket / TIME_HISTOGRAM_SUB_BUCKETS - 1;
+	uint64_t low = (uint64_t)(bucket % TIME_HISTOGRAM_SUB_BUCKETS + TIME_HISTOGRAM_SUB_BUCKETS) << shift;
+	return low + ((uint64_t)1 << shift) / 2;
+}
+
+void TimeHistogram::Reset()
+{
+	memset(counts, 0, sizeof(counts));
+	count = 0;
+	max = 0;
+}
+
+void TimeHistogram::Add(const TimeHistogram& other)
+{
+	for (int i = 0; i < TIME_HISTOGRAM_BUCKETS; i++)
+		counts[i] += other.counts[i];
+	count += other.count;
+	if (other.max > max) max = other.max;
+}
+
+uint64_t TimeHistogram::GetPercentile(double fraction) const
+{
+	if (count == 0)
+		return 0;
+
+	// The rank'th smallest value, 1-based
+	uint64_t rank = (uint64_t)(fraction * count + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > count) rank = count;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < TIME_HISTOGRAM_BUCKETS; i++)
+	{
+		seen += counts[i];
+		if (seen >= rank)
+		{
+			// Never report past what was actually recorded
+			uint64_t value = GetBucketValue(i);
+			return value < max ? value : max;
+		}
+	}
+	return max;
+}
+
+FrameStats::FrameStats()
+{
+	windowSeconds = FRAME_STATS_WINDOW_SECONDS;
+	windowElapsed = 0;
+	sessionElapsed = 0;
+	memset(&lastWindow, 0, sizeof(lastWindow));
+	windowCount = 0;
+	log = 0;
+}
+
+FrameStats::~FrameStats()
+{
+	CloseLog();
+}
+
+const char* FrameStats::GetChannelName(int channel)
+{
+	switch (channel)
+	{
+	case FRAME_STATS_FRAME: return "Frame";
+	case FRAME_STATS_UPDATE: return "Update";
+	case FRAME_STATS_DRAW: return "Draw";
+	default: return "?";
+	}
+}
+
+bool FrameStats::OpenLog(const char* fileName, std::string* error)
+{
+	CloseLog();
+	log = fopen(fileName, "w");
+	if (!log)
+		return Fail(error, "Could not create file");
+
+	fprintf(log, "window,seconds,frames");
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		const char* name = GetChannelName(c);
+		fprintf(log, ",%s p50 ms,%s p95 ms,%s p99 ms,%s max ms", name, name, name, name);
+	}
+	fprintf(log, "\n");
+	fflush(log);
+	return true;
+}
+
+void FrameStats::CloseLog()
+{
+	if (!log)
+		return;
+
+	WriteRow("session", GetSession());
+	fclose(log);
+	log = 0;
+}
+
+bool FrameStats::AddFrame(double frameSeconds, double updateSeconds, double drawSeconds)
+{
+	window[FRAME_STATS_FRAME].Record((uint64_t)(frameSeconds * 1e9));
+	window[FRAME_STATS_UPDATE].Record((uint64_t)(updateSeconds * 1e9));
+	window[FRAME_STATS_DRAW].Record((uint64_t)(drawSeconds * 1e9));
+
+	windowElapsed += frameSeconds;
+	if (windowElapsed < windowSeconds)
+		return false;
+
+	CloseWindow();
+	return true;
+}
+
+void FrameStats::CloseWindow()
+{
+	Summarize(window, windowElapsed, lastWindow);
+	sessionElapsed += windowElapsed;
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		session[c].Add(window[c]);
+		window[c].Reset();
+	}
+	windowElapsed = 0;
+	windowCount++;
+
+	if (log)
+	{
+		char label[32];
+		snprintf(label, sizeof(label), "%.3f", sessionElapsed);
+		WriteRow(label, lastWindow);
+	}
+}
+
+FrameStatsWindow FrameStats::GetSession() const
+{
+	// The window still open counts too
+	TimeHistogram total[FRAME_STATS_CHANNELS];
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		total[c].Add(session[c]);
+		total[c].Add(window[c]);
+	}
+
+	FrameStatsWindow result;
+	Summarize(total, sessionElapsed + windowElapsed, result);
+	return result;
+}
+
+void FrameStats::Summarize(const TimeHistogram* histograms, double seconds, FrameStatsWindow& out)
+{
+	out.seconds = seconds;
+	out.frames = (uint32_t)histograms[FRAME_STATS_FRAME].GetCount();
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		out.p50Ms[c] = histograms[c].GetPercentile(0.50) / 1e6f;
+		out.p95Ms[c] = histograms[c].GetPercentile(0.95) / 1e6f;
+		out.p99Ms[c] = histograms[c].GetPercentile(0.99) / 1e6f;
+		out.maxMs[c] = histograms[c].GetMax() / 1e6f;
+	}
+}
+
+void FrameStats::WriteRow(const char* label, const FrameStatsWindow& window)
+{
+	fprintf(log, "%s,%.3f,%u", label, window.seconds, window.frames);
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+		fprintf(log, ",%.3f,%.3f,%.3f,%.3f", window.p50Ms[c], window.p95Ms[c], window.p99Ms[c], window.maxMs[c]);
+	fprintf(log, "\n");
+	fflush(log);
+}
+
+std::string FrameStats::GetSummary() const
+{
+	std::string text;
+	char line[128];
+	snprintf(line, sizeof(line), "%u frames in %.1f s\n", lastWindow.frames, lastWindow.seconds);
+	text += line;
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		snprintf(line, sizeof(line), "%-6s  p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms\n", GetChannelName(c),
+			lastWindow.p50Ms[c], lastWindow.p95Ms[c], lastWindow.p99Ms[c], lastWindow.maxMs[c]);
+		text += line;
+	}
+	return text;
+}
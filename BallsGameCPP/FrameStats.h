@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// --------------------------------------------------------
+// A histogram of durations that keeps ~3% precision from a
+// nanosecond up to centuries, HdrHistogram style.
+//
+// Each power of two gets TIME_HISTOGRAM_SUB_BUCKETS linear
+// buckets, so recording is a bit scan, a shift and an increment
+// into a fixed table - no allocation, no sorting - and a
+// percentile is one walk over the table.  The largest value is
+// kept exactly, since that's the hitch being looked for.
+// --------------------------------------------------------
+
+const int TIME_HISTOGRAM_SUB_BUCKET_BITS = 5;
+const int TIME_HISTOGRAM_SUB_BUCKETS = 1 << TIME_HISTOGRAM_SUB_BUCKET_BITS;
+
+// Values below TIME_HISTOGRAM_SUB_BUCKETS are exact; every
+// other power of two up to 2^63 gets its own row
+const int TIME_HISTOGRAM_BUCKETS = (64 - TIME_HISTOGRAM_SUB_BUCKET_BITS + 1) * TIME_HISTOGRAM_SUB_BUCKETS;
+
+class TimeHistogram
+{
+public:
+	TimeHistogram() { Reset(); }
+
+	void Record(uint64_t ns)
+	{
+		counts[GetBucket(ns)]++;
+		count++;
+		if (ns > max) max = ns;
+	}
+
+	void Add(const TimeHistogram& other);
+	void Reset();
+
+	// The value at or below which fraction (0 to 1) of the
+	// recorded values fall, to within a bucket; 0 if empty
+	uint64_t GetPercentile(double fraction) const;
+	uint64_t GetMax() const { return max; }
+	uint64_t GetCount() const { return count; }
+
+	static int GetBucket(uint64_t ns);
+
+	// The middle of a bucket - what its values are reported as
+	static uint64_t GetBucketValue(int bucket);
+
+private:
+	uint32_t counts[TIME_HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t max;
+};
+
+// --------------------------------------------------------
+// Frame, update and draw times, as percentiles over a fixed
+// window rather than an average over it.
+//
+// DXCore calls AddFrame once a frame.  Every windowSeconds of
+// frames the window closes: its p50/p95/p99/max become what
+// GetSummary and the title bar show, and if a log is open they
+// are appended to it as a CSV row.  The session as a whole is
+// kept too, and written as a last row when the log closes.
+// --------------------------------------------------------
+
+enum FrameStatsChannel
+{
+	FRAME_STATS_FRAME,		// Start of one frame to the start of the next
+	FRAME_STATS_UPDATE,
+	FRAME_STATS_DRAW,		// Including Present
+	FRAME_STATS_CHANNELS
+};
+
+struct FrameStatsWindow
+{
+	double seconds;
+	uint32_t frames;
+	float p50Ms[FRAME_STATS_CHANNELS];
+	float p95Ms[FRAME_STATS_CHANNELS];
+	float p99Ms[FRAME_STATS_CHANNELS];
+	float maxMs[FRAME_STATS_CHANNELS];
+};
+
+class FrameStats
+{
+public:
+	FrameStats();
+	~FrameStats();
+
+	// Appends a row to fileName every window from now on,
+	// replacing anything already there
+	bool OpenLog(const char* fileName, std::string* error = 0);
+	void CloseLog();
+
+	void SetWindowSeconds(double seconds) { windowSeconds = seconds; }
+
+	// Times in seconds; true when this frame closed a window
+	bool AddFrame(double frameSeconds, double updateSeconds, double drawSeconds);
+
+	// The last window closed, and everything so far
+	const FrameStatsWindow& GetLastWindow() const { return lastWindow; }
+	FrameStatsWindow GetSession() const;
+	uint32_t GetWindowCount() const { return windowCount; }
+
+	static const char* GetChannelName(int channel);
+
+	// Lines like "Frame  p50 16.67  p95 16.90  p99 17.20  max 33.10 ms"
+	// for the last window, for an overlay or the title bar
+	std::string GetSummary() const;
+
+private:
+	void CloseWindow();
+	static void Summarize(const TimeHistogram* histograms, double seconds, FrameStatsWindow& out);
+	void WriteRow(const char* label, const FrameStatsWindow& window);
+
+	TimeHistogram window[FRAME_STATS_CHANNELS];
+	TimeHistogram session[FRAME_STATS_CHANNELS];
+	double windowSeconds;
+	double windowElapsed;
+	double sessionElapsed;
+	FrameStatsWindow lastWindow;
+	uint32_t windowCount;
+	FILE* log;
+};
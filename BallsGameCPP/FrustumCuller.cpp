@@ -0,0 +1,240 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define FRUSTUM_CULLER_SSE 1
+#include <emmintrin.h>
+#else
+#define FRUSTUM_CULLER_SSE 0
+#endif
+
+// Big enough to reach every plane, small enough not to overflow
+const float ALWAYS_VISIBLE_SIZE = 1e30f;
+
+MeshBounds ComputeMeshBounds(const float* vertices, size_t vertexCount, size_t vertexStride)
+{
+	MeshBounds bounds = {};
+	if (vertexCount == 0)
+		return bounds;
+
+	float lo[3] = { vertices[0], vertices[1], vertices[2] };
+	float hi[3] = { vertices[0], vertices[1], vertices[2] };
+	for (size_t i = 1; i < vertexCount; i++)
+	{
+		const float* v = (const float*)((const char*)vertices + i * vertexStride);
+		for (int a = 0; a < 3; a++)
+		{
+			lo[a] = std::min(lo[a], v[a]);
+			hi[a] = std::max(hi[a], v[a]);
+		}
+	}
+
+	for (int a = 0; a < 3; a++)
+	{
+		bounds.center[a] = (lo[a] + hi[a]) * 0.5f;
+		bounds.extents[a] = (hi[a] - lo[a]) * 0.5f;
+	}
+
+	// Around the box's centre rather than the origin; tighter for
+	// anything modelled off centre
+	float radiusSquared = 0;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* v = (const float*)((const char*)vertices + i * vertexStride);
+		float dx = v[0] - bounds.center[0];
+		float dy = v[1] - bounds.center[1];
+		float dz = v[2] - bounds.center[2];
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	bounds.radius = sqrtf(radiusSquared);
+	return bounds;
+}
+
+// --------------------------------------------------------
+// Gribb and Hartmann: with clip = M * position, each plane is
+// the w row plus or minus another row.  D3D's depth runs 0 to
+// w, so near is just the z row.  Normalised so a plane's
+// distance is in world units, which the sphere test needs.
+// --------------------------------------------------------
+Frustum FrustumFromViewProjection(const float* view, const float* projection)
+{
+	float m[4][4];
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			m[r][c] =
+				projection[r * 4 + 0] * view[0 * 4 + c] +
+				projection[r * 4 + 1] * view[1 * 4 + c] +
+				projection[r * 4 + 2] * view[2 * 4 + c] +
+				projection[r * 4 + 3] * view[3 * 4 + c];
+		}
+	}
+
+	Frustum frustum;
+	for (int c = 0; c < 4; c++)
+	{
+		frustum.planes[0][c] = m[3][c] + m[0][c];	// Left
+		frustum.planes[1][c] = m[3][c] - m[0][c];	// Right
+		frustum.planes[2][c] = m[3][c] + m[1][c];	// Bottom
+		frustum.planes[3][c] = m[3][c] - m[1][c];	// Top
+		frustum.planes[4][c] = m[2][c];				// Near
+		frustum.planes[5][c] = m[3][c] - m[2][c];	// Far
+	}
+
+	for (int p = 0; p < 6; p++)
+	{
+		float* plane = frustum.planes[p];
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0)
+		{
+			for (int c = 0; c < 4; c++)
+				plane[c] /= length;
+		}
+	}
+	return frustum;
+}
+
+FrustumCuller::FrustumCuller()
+{
+	count = 0;
+}
+
+void FrustumCuller::Clear()
+{
+	count = 0;
+}
+
+// The arrays only ever grow by four, so there's always a whole
+// group to load; what's past count is left over and ignored
+void FrustumCuller::Push(float cx, float cy, float cz, float ex, float ey, float ez, float r)
+{
+	if (count == centerX.size())
+	{
+		size_t size = count + 4;
+		centerX.resize(size); centerY.resize(size); centerZ.resize(size);
+		extentX.resize(size); extentY.resize(size); extentZ.resize(size);
+		radius.resize(size);
+	}
+
+	centerX[count] = cx; centerY[count] = cy; centerZ[count] = cz;
+	extentX[count] = ex; extentY[count] = ey; extentZ[count] = ez;
+	radius[count] = r;
+	count++;
+}
+
+size_t FrustumCuller::Add(const MeshBounds& bounds, const float* world)
+{
+	const float* c = bounds.center;
+	const float* e = bounds.extents;
+	float worldCenter[3];
+	float worldExtent[3];
+	float scaleSquared = 0;
+	for (int r = 0; r < 3; r++)
+	{
+		const float* row = world + r * 4;
+		worldCenter[r] = row[0] * c[0] + row[1] * c[1] + row[2] * c[2] + row[3];
+
+		// The box around the transformed box
+		worldExtent[r] = fabsf(row[0]) * e[0] + fabsf(row[1]) * e[1] + fabsf(row[2]) * e[2];
+
+		// Longest axis after scaling, for the sphere
+		scaleSquared = std::max(scaleSquared, world[0 * 4 + r] * world[0 * 4 + r] + world[1 * 4 + r] * world[1 * 4 + r] + world[2 * 4 + r] * world[2 * 4 + r]);
+	}
+
+	Push(worldCenter[0], worldCenter[1], worldCenter[2], worldExtent[0], worldExtent[1], worldExtent[2], bounds.radius * sqrtf(scaleSquared));
+	return count - 1;
+}
+
+size_t FrustumCuller::AddAlwaysVisible()
+{
+	Push(0, 0, 0, ALWAYS_VISIBLE_SIZE, ALWAYS_VISIBLE_SIZE, ALWAYS_VISIBLE_SIZE, ALWAYS_VISIBLE_SIZE);
+	return count - 1;
+}
+
+static CullStats CountVisible(const std::vector<uint8_t>& visible, size_t count)
+{
+	CullStats stats;
+	stats.tested = (uint32_t)count;
+	stats.visible = 0;
+	for (size_t i = 0; i < count; i++)
+		stats.visible += visible[i];
+	stats.culled = stats.tested - stats.visible;
+	return stats;
+}
+
+CullStats FrustumCuller::CullScalar(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+	visible.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+		{
+			const float* plane = frustum.planes[p];
+			// Added up in the same order as the SSE version
+			float distance = (plane[0] * centerX[i] + plane[1] * centerY[i]) + (plane[2] * centerZ[i] + plane[3]);
+			float boxReach = (fabsf(plane[0]) * extentX[i] + fabsf(plane[1]) * extentY[i]) + fabsf(plane[2]) * extentZ[i];
+			inside = distance >= -radius[i] && distance >= -boxReach;
+		}
+		visible[i] = inside ? 1 : 0;
+	}
+	return CountVisible(visible, count);
+}
+
+CullStats FrustumCuller::Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const
+{
+#if FRUSTUM_CULLER_SSE
+	visible.resize(count);
+
+	// Each plane's parts in every lane
+	__m128 planeA[6], planeB[6], planeC[6], planeD[6];
+	__m128 absA[6], absB[6], absC[6];
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (int p = 0; p < 6; p++)
+	{
+		planeA[p] = _mm_set1_ps(frustum.planes[p][0]);
+		planeB[p] = _mm_set1_ps(frustum.planes[p][1]);
+		planeC[p] = _mm_set1_ps(frustum.planes[p][2]);
+		planeD[p] = _mm_set1_ps(frustum.planes[p][3]);
+		absA[p] = _mm_andnot_ps(signMask, planeA[p]);
+		absB[p] = _mm_andnot_ps(signMask, planeB[p]);
+		absC[p] = _mm_andnot_ps(signMask, planeC[p]);
+	}
+
+	for (size_t i = 0; i < count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&centerX[i]);
+		__m128 cy = _mm_loadu_ps(&centerY[i]);
+		__m128 cz = _mm_loadu_ps(&centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&extentX[i]);
+		__m128 ey = _mm_loadu_ps(&extentY[i]);
+		__m128 ez = _mm_loadu_ps(&extentZ[i]);
+		__m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&radius[i]), signMask);
+
+		// Lanes fully behind any plane, by sphere or by box
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeA[p], cx), _mm_mul_ps(planeB[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planeC[p], cz), planeD[p]));
+			__m128 boxReach = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(absA[p], ex), _mm_mul_ps(absB[p], ey)),
+				_mm_mul_ps(absC[p], ez));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_xor_ps(boxReach, signMask)));
+		}
+
+		int outsideBits = _mm_movemask_ps(outside);
+		size_t lanes = std::min((size_t)4, count - i);
+		for (size_t lane = 0; lane < lanes; lane++)
+			visible[i + lane] = (outsideBits >> lane) & 1 ? 0 : 1;
+	}
+	return CountVisible(visible, count);
+#else
+	return CullScalar(frustum, visible);
+#endif
+}
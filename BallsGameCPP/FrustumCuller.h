@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Frustum culling for entities, a view at a time.
+//
+// Every mesh gets a box and a sphere when it's loaded.  Each
+// frame the entities' world space versions go into a
+// FrustumCuller once, in arrays, and then every view (the
+// camera and each shadow light) tests all of them against its
+// six planes four at a time with SSE: the sphere rules out
+// most of what's off screen, and the box catches thin things
+// (the field, the walls) whose sphere pokes into the view.
+// Nothing that can be seen is ever culled; a few things that
+// can't may still be drawn.
+//
+// Matrices are taken as the shaders get them - transposed, so
+// a row of the stored matrix is a row of the column vector
+// matrix - which is how Camera and the shadow lights keep
+// them.  Works for perspective and orthographic views alike.
+//
+// Matrices come in as 16 floats and bounds as the plain structs
+// below, and the only intrinsics are SSE, so Tools/CullBench.cpp
+// links it as it is.
+// --------------------------------------------------------
+
+// In the mesh's own space
+struct MeshBounds
+{
+	float center[3];	// Of the box, and the sphere
+	float extents[3];	// Half the box's size on each axis
+	float radius;		// Sphere around center holding every vertex
+};
+
+// Box and sphere of vertices, each starting with a float3
+// position.  All zero if there are none.
+MeshBounds ComputeMeshBounds(const float* vertices, size_t vertexCount, size_t vertexStride);
+
+// Six planes (a, b, c, d), facing in, for ax + by + cz + d >= 0
+struct Frustum
+{
+	float planes[6][4];
+};
+
+// view and projection - 16 floats each, as the shaders get them
+Frustum FrustumFromViewProjection(const float* view, const float* projection);
+
+struct CullStats
+{
+	uint32_t tested;
+	uint32_t visible;
+	uint32_t culled;
+};
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Clear();
+
+	// world - 16 floats, as the shaders get it.  Returns the
+	// index the entity's result will have.
+	size_t Add(const MeshBounds& bounds, const float* world);
+
+	// Always drawn - for things with no bounds
+	size_t AddAlwaysVisible();
+
+	size_t GetCount() const { return count; }
+
+	// visible gets 1 or 0 for each entity added, in order
+	CullStats Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+	// Same results one at a time, to check the SSE version by
+	CullStats CullScalar(const Frustum& frustum, std::vector<uint8_t>& visible) const;
+
+private:
+	// World space, padded to a multiple of four
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+	size_t count;
+
+	void Push(float cx, float cy, float cz, float ex, float ey, float ez, float r);
+};
@@ -8,6 +8,16 @@ using namespace DirectX;
 
 #define PI 3.14159265359f
 
+// Most match steps run in one frame (a quarter second of play)
+#define MAX_STEPS_PER_FRAME 30
+
+// Each explosion's GPU burst, and how fast its particles leave
+#define GPU_PARTICLES_PER_EXPLOSION 1000
+#define GPU_PARTICLE_SPEED 1.2f
+
+// Furthest the GPU's particles may be from the CPU's and still match
+#define PARTICLE_PARITY_TOLERANCE 0.001f
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -22,13 +32,47 @@ Game::Game(HINSTANCE hInstance)
 		"Ball Game",	   // Text for the window's title bar
 		1280,			   // Width of the window's client area
 		720,			   // Height of the window's client area
-		true)			   // Show extra stats (fps) in title bar?
+		true),			   // Show extra stats (fps) in title bar?
+	frameStatsRun(256)
 {
 
 	vertexShader = 0;
 	pixelShader = 0;
 	vertexShaderNormal = 0;
 	pixelShaderNormal = 0;
+	hotReloader = 0;
+	gpuProfiler = 0;
+	vertexShaderSprite = 0;
+	pixelShaderSprite = 0;
+	vertexShaderParticle = 0;
+	pixelShaderParticle = 0;
+	computeShaderParticleSim = 0;
+	computeShaderParticleEmit = 0;
+	computeShaderParticleArgs = 0;
+	vertexShaderGpuParticle = 0;
+	particleRenderer = 0;
+	gpuParticleSystem = 0;
+	particleReference = 0;
+	gpuParticles = false;
+	particleParity = false;
+	particleParityFrames = 0;
+	spriteRenderer = 0;
+	hudFont = 0;
+	showFrameStats = false;
+	frameStatsShown = 0;
+	for (int i = 0; i < 4; i++)
+		shadowCullStats[i] = CullStats();
+	match = 0;
+	netSession = 0;
+	spectator = 0;
+	botPool = 0;
+	computer = 0;
+	input = 0;
+	soundPlayer = 0;
+	vsComputer = false;
+	spectatorView.p1Selection = 0;
+	spectatorView.p2Selection = 0;
+	gameState = 0;
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -44,6 +88,10 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
+	// Stop watching first, the reloader writes into the fields below
+	delete hotReloader;
+	delete input;
+
 	// Delete our simple shader objects, which
 	// will clean up their own internal DirectX stuff
 	delete vertexShader;
@@ -54,8 +102,19 @@ Game::~Game()
 	delete pixelShaderSky;
 	delete pixelShaderShiny;
 	delete vertexShaderShadow;
+	delete vertexShaderSprite;
+	delete pixelShaderSprite;
+	delete vertexShaderParticle;
+	delete pixelShaderParticle;
+	delete computeShaderParticleSim;
+	delete computeShaderParticleEmit;
+	delete computeShaderParticleArgs;
+	delete vertexShaderGpuParticle;
 
 	delete renderer;
+	delete particleRenderer;
+	delete gpuParticleSystem;
+	delete particleReference;
 	delete mainCamera;
 
 	shadowRasterizer->Release();
@@ -79,17 +138,17 @@ Game::~Game()
 	p1Win->Release();
 	p2Win->Release();
 
-	if (p1Score) delete p1Score;
-	if (p2Score) delete p2Score;
-	if (p1Balls) delete p1Balls;
-	if (p2Balls) delete p2Balls;
-	
+	//Keep a match that was quit part way through
+	if (gameState == 1 && !netSession && !spectator)
+		SaveReplay();
+	if (spectator) delete spectator;
+	if (computer) delete computer;
+	if (botPool) delete botPool;
+	if (gpuProfiler) delete gpuProfiler;
+	if (soundPlayer) delete soundPlayer;
+	if (netSession) delete netSession;
+	else if (match) delete match;
 
-	if (ballManager) delete ballManager;
-	for each (Emitter* e in emitters)
-	{
-		delete e;
-	}
 	//Deleting materials
 	for each (Material* name in materials)
 	{
@@ -125,6 +184,10 @@ Game::~Game()
 	{
 		delete name;
 	}
+	for each(GameEntity* name in ballEntities)
+	{
+		delete name;
+	}
 
 	for each(ID3D11ShaderResourceView* name in shadowSRVs)
 	{
@@ -137,8 +200,9 @@ Game::~Game()
 	}
 
 	// Clean up font
+	if (hudFont) delete hudFont;
+	if (spriteRenderer) delete spriteRenderer;
 	m_font.reset();
-	m_spriteBatch.reset();
 }
 
 // --------------------------------------------------------
@@ -147,28 +211,70 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
-	gameState = 0;
-	p1Selection = 3;
-	p2Selection = 3;
-
-	firePeriod = 0.35;
-	p2shootTimer = 0;
-	p1shootTimer = 0;
+	Profiler::RegisterThread("Main");
+	gpuProfiler = new GpuProfiler(new D3D11GpuTimestamps(device, context));
 
-	p1Balls = new int(8);
-	p2Balls = new int(8);
+	//Frame time percentiles, a row a second
+	std::string logError;
+	if (!frameStats.OpenLog("frametimes.csv", &logError))
+		printf("Could not open frametimes.csv: %s\n", logError.c_str());
 
-	p1Score = new int(0);
-	p2Score = new int(0);
+	//A network match skips the menu and starts as soon as the other side answers
+	if (netSession)
+	{
+		gameState = 1;
+		match = &netSession->GetMatch();
+	}
+	//So does watching one - the match is only a place to put what the server sends
+	else if (spectator)
+	{
+		gameState = 1;
+		match = new Match(0);
+	}
+	else
+	{
+		gameState = 0;
+		match = new Match(0);
+	}
+	stepAccumulator = 0;
+	activeBallEntities = 0;
 
-	ballSpeed = 3.1;
+	//Anything that needs someone at the controls gets the keyboard,
+	//its presses read and timestamped off the frame, and the pads
+	if (!input || !input->IsUnattended())
+	{
+		KeyboardInputSource* keyboard = new KeyboardInputSource();
+		std::string inputError;
+		if (!keyboard->Start(&inputError))
+			printf("Raw input: %s, polling the keyboard each frame instead\n", inputError.c_str());
+
+		CombinedInputSource* devices = new CombinedInputSource();
+		devices->Add(keyboard);
+		devices->Add(new GamePadInputSource());
+		if (input)
+			devices->Add(input);
+		input = devices;
+	}
+	printf("Input: %s\n", input->GetName());
+
+	//Sounds are played on their own thread; without audio the game stays quiet.
+	//A rolled-back network step would sound twice and a spectator has no
+	//steps, so only local matches make any
+	if (soundFile.empty())
+		soundPlayer = new SoundPlayer(new XAudioSink());
+	else
+		soundPlayer = new SoundPlayer(new MixerAudioSink(new WavFileOutput(soundFile.c_str())));
+	std::string soundError;
+	if (!soundPlayer->Start(&soundError))
+		printf("Sound: %s, playing without it\n", soundError.c_str());
+	if (!netSession && !spectator)
+		match->SetSoundLog(&stepSounds);
 
 	shadowMapSize = 1024;
 
-	ballManager = new BallManager(p1Score, p2Score, p1Balls, p2Balls);
-	emitters = std::vector<Emitter*>();
 
-	
+	// Everything loaded below registers its file with this
+	hotReloader = new HotReloader(device, context);
 
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
@@ -187,6 +293,9 @@ void Game::Init()
 	renderer = new Renderer(context);
 	renderer->SetSkybox(skyboxBall);
 	renderer->SetPaticleInfo(particleDepthState, bsAlphaBlend);
+	particleRenderer = new ParticleRenderer(device, context);
+	gpuParticleSystem = new GpuParticleSystem(device, context, ParticleSimConfig());
+	particleReference = new ParticleSim(gpuParticleSystem->GetConfig());
 
 	mainCamera = new Camera(width, height);
 
@@ -202,7 +311,8 @@ void Game::Init()
 
 	// Initialize font related objects
 	m_font.reset(new SpriteFont(device, L"myfile.spritefont"));
-	m_spriteBatch.reset(new SpriteBatch(context));
+	spriteRenderer = new SpriteRenderer(device, context);
+	hudFont = new HudFont(m_font.get(), spriteRenderer);
 
 	// Position of the first font object
 	m_p1FontPos.x = width / 6;
@@ -212,7 +322,16 @@ void Game::Init()
 	m_p2FontPos.x = width * 5 / 6;
 	m_p2FontPos.y = height / 16;
 
+	// Frame time overlay, top left
+	m_statsFontPos.x = 8;
+	m_statsFontPos.y = 8;
+
 	DEBUG_MODE = false;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Only watch for asset changes while developing
+	hotReloader->Start();
+#endif
 }
 
 // --------------------------------------------------------
@@ -223,38 +342,67 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	// One precompiled bundle (see Tools/ShaderBundler.cpp) replaces
+	// reading and reflecting every .cso separately
+	ShaderBundle bundle;
+	if (!bundle.Open("Debug/Shaders.bundle"))
+		bundle.Open("Shaders.bundle");
+
+	int fromBundle = 0;
 	vertexShader = new SimpleVertexShader(device, context);
-	if (!vertexShader->LoadShaderFile(L"Debug/VertexShader.cso"))
-		vertexShader->LoadShaderFile(L"VertexShader.cso");		
+	fromBundle += LoadShader(vertexShader, bundle, "VertexShader");
 
 	pixelShader = new SimplePixelShader(device, context);
-	if(!pixelShader->LoadShaderFile(L"Debug/PixelShader.cso"))	
-		pixelShader->LoadShaderFile(L"PixelShader.cso");
+	fromBundle += LoadShader(pixelShader, bundle, "PixelShader");
 
 	vertexShaderNormal = new SimpleVertexShader(device, context);
-	if (!vertexShaderNormal->LoadShaderFile(L"Debug/VertexShaderNormal.cso"))
-		vertexShaderNormal->LoadShaderFile(L"VertexShaderNormal.cso");
+	fromBundle += LoadShader(vertexShaderNormal, bundle, "VertexShaderNormal");
 
 	pixelShaderNormal = new SimplePixelShader(device, context);
-	if (!pixelShaderNormal->LoadShaderFile(L"Debug/PixelShaderNormal.cso"))
-		pixelShaderNormal->LoadShaderFile(L"PixelShaderNormal.cso");
+	fromBundle += LoadShader(pixelShaderNormal, bundle, "PixelShaderNormal");
 
 	vertexShaderShadow = new SimpleVertexShader(device, context);
-	if (!vertexShaderShadow->LoadShaderFile(L"Debug/vertexShaderShadow.cso"))
-		vertexShaderShadow->LoadShaderFile(L"vertexShaderShadow.cso");
+	fromBundle += LoadShader(vertexShaderShadow, bundle, "vertexShaderShadow");
 
 	vertexShaderSky = new SimpleVertexShader(device, context);
-	if (!vertexShaderSky->LoadShaderFile(L"Debug/VertexShaderSky.cso"))
-		vertexShaderSky->LoadShaderFile(L"VertexShaderSky.cso");
+	fromBundle += LoadShader(vertexShaderSky, bundle, "VertexShaderSky");
 
 	pixelShaderSky = new SimplePixelShader(device, context);
-	if (!pixelShaderSky->LoadShaderFile(L"Debug/PixelShaderSky.cso"))
-		pixelShaderSky->LoadShaderFile(L"PixelShaderSky.cso");
+	fromBundle += LoadShader(pixelShaderSky, bundle, "PixelShaderSky");
 
 	pixelShaderShiny = new SimplePixelShader(device, context);
-	if (!pixelShaderShiny->LoadShaderFile(L"Debug/pixelShaderShiny.cso"))
-		pixelShaderShiny->LoadShaderFile(L"pixelShaderShiny.cso");
-	// You'll notice that the code above attempts to load each
+	fromBundle += LoadShader(pixelShaderShiny, bundle, "pixelShaderShiny");
+
+	vertexShaderSprite = new SimpleVertexShader(device, context);
+	fromBundle += LoadShader(vertexShaderSprite, bundle, "VertexShaderSprite");
+
+	pixelShaderSprite = new SimplePixelShader(device, context);
+	fromBundle += LoadShader(pixelShaderSprite, bundle, "PixelShaderSprite");
+
+	vertexShaderParticle = new SimpleVertexShader(device, context);
+	fromBundle += LoadShader(vertexShaderParticle, bundle, "VertexShaderParticle");
+
+	pixelShaderParticle = new SimplePixelShader(device, context);
+	fromBundle += LoadShader(pixelShaderParticle, bundle, "PixelShaderParticle");
+
+	computeShaderParticleSim = new SimpleComputeShader(device, context);
+	fromBundle += LoadShader(computeShaderParticleSim, bundle, "ComputeShaderParticleSim");
+
+	computeShaderParticleEmit = new SimpleComputeShader(device, context);
+	fromBundle += LoadShader(computeShaderParticleEmit, bundle, "ComputeShaderParticleEmit");
+
+	computeShaderParticleArgs = new SimpleComputeShader(device, context);
+	fromBundle += LoadShader(computeShaderParticleArgs, bundle, "ComputeShaderParticleArgs");
+
+	vertexShaderGpuParticle = new SimpleVertexShader(device, context);
+	fromBundle += LoadShader(vertexShaderGpuParticle, bundle, "VertexShaderGpuParticle");
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Shaders: 16 loaded in %.2f ms (%d from bundle, %d from .cso)\n", ms, fromBundle, 16 - fromBundle);
+
+	// You'll notice that LoadShader() attempts to load each
 	// compiled shader file (.cso) from two different relative paths.
 
 	// This is because the "working directory" (where relative paths begin)
@@ -264,6 +412,42 @@ void Game::LoadShaders()
 
 	// Checking both paths is the easiest way to ensure both 
 	// scenarios work correctly, although others exist
+
+	// Rebuilt .cso files get swapped in while the game runs
+	hotReloader->WatchVertexShader(L"VertexShader.cso", &vertexShader);
+	hotReloader->WatchPixelShader(L"PixelShader.cso", &pixelShader);
+	hotReloader->WatchVertexShader(L"VertexShaderNormal.cso", &vertexShaderNormal);
+	hotReloader->WatchPixelShader(L"PixelShaderNormal.cso", &pixelShaderNormal);
+	hotReloader->WatchVertexShader(L"vertexShaderShadow.cso", &vertexShaderShadow);
+	hotReloader->WatchVertexShader(L"VertexShaderSky.cso", &vertexShaderSky);
+	hotReloader->WatchPixelShader(L"PixelShaderSky.cso", &pixelShaderSky);
+	hotReloader->WatchPixelShader(L"pixelShaderShiny.cso", &pixelShaderShiny);
+	hotReloader->WatchVertexShader(L"VertexShaderSprite.cso", &vertexShaderSprite);
+	hotReloader->WatchPixelShader(L"PixelShaderSprite.cso", &pixelShaderSprite);
+	hotReloader->WatchVertexShader(L"VertexShaderParticle.cso", &vertexShaderParticle);
+	hotReloader->WatchPixelShader(L"PixelShaderParticle.cso", &pixelShaderParticle);
+	hotReloader->WatchComputeShader(L"ComputeShaderParticleSim.cso", &computeShaderParticleSim);
+	hotReloader->WatchComputeShader(L"ComputeShaderParticleEmit.cso", &computeShaderParticleEmit);
+	hotReloader->WatchComputeShader(L"ComputeShaderParticleArgs.cso", &computeShaderParticleArgs);
+	hotReloader->WatchVertexShader(L"VertexShaderGpuParticle.cso", &vertexShaderGpuParticle);
+}
+
+// --------------------------------------------------------
+// Loads one shader, from the bundle if it has it and from
+// its .cso file otherwise (no bundle, or a newly added shader)
+//
+// Returns 1 if the bundle was used, 0 if not
+// --------------------------------------------------------
+int Game::LoadShader(ISimpleShader* shader, const ShaderBundle& bundle, const char* name)
+{
+	if (shader->LoadFromBundle(bundle, name))
+		return 1;
+
+	std::string file(name);
+	std::wstring path = L"Debug/" + std::wstring(file.begin(), file.end()) + L".cso";
+	if (!shader->LoadShaderFile(path.c_str()))
+		shader->LoadShaderFile(path.substr(6).c_str());
+	return 0;
 }
 
 
@@ -328,101 +512,52 @@ void Game::CreateMatrices()
 }
 
 
+// --------------------------------------------------------
+// Loads a texture from Assets/Textures.  If the texture cooker
+// (Tools/TextureCooker.cpp) has produced a block compressed copy
+// in Assets/Textures/Cooked, that DDS is loaded instead, which
+// skips the PNG/JPEG decode and keeps its precomputed mip chain.
+// DDS files are memory mapped and uploaded without a copy.
+// Whichever file is used is watched for hot reloading.
+//
+// file - The source image name, like L"grass.png"
+// srv  - Receives the shader resource view
+// --------------------------------------------------------
+HRESULT Game::LoadTexture(std::wstring file, ID3D11ShaderResourceView** srv)
+{
+	std::wstring cooked = L"Assets/Textures/Cooked/" + file.substr(0, file.find_last_of(L'.')) + L".dds";
+	HRESULT hr = CreateDDSTextureFromFileMapped(device, cooked.c_str(), 0, srv);
+	if (SUCCEEDED(hr))
+	{
+		hotReloader->WatchTexture(cooked, srv);
+		return hr;
+	}
+
+	std::wstring source = L"Assets/Textures/" + file;
+	hr = CreateWICTextureFromFile(device, context, source.c_str(), 0, srv);
+	if (SUCCEEDED(hr))
+		hotReloader->WatchTexture(source, srv);
+	return hr;
+}
+
 // --------------------------------------------------------
 // Creates the geometry we're going to draw - a single triangle for now
 // --------------------------------------------------------
 void Game::CreateBasicGeometry()
 {
 
-	//Creating Textures
-	HRESULT check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/grass.png",
-		0,
-		&gamefield
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/grassNormal.png",
-		0,
-		&gamefieldNormal
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/p1Win.png",
-		0,
-		&p1Win
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/p2Win.png",
-		0,
-		&p2Win
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/soccer.png",
-		0,
-		&bricks
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/mainmenu.png",
-		0,
-		&menu
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/wood.jpg",
-		0,
-		&woodTexture
-	);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/blueTexture.jpg",
-		0,
-		&blueTexture
-		);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/redTexture.jpg",
-		0,
-		&redTexture
-		);
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/ballmaterial.jpg",
-		0,
-		&regularBall
-	);
-
-
-	check = CreateWICTextureFromFile(
-		device,
-		context,
-		L"Assets/Textures/cloud.png",
-		0,
-		&explosion
-	);
+	//Creating Textures - cooked DDS versions are used when they exist
+	LoadTexture(L"grass.png", &gamefield);
+	LoadTexture(L"grassNormal.png", &gamefieldNormal);
+	LoadTexture(L"p1Win.png", &p1Win);
+	LoadTexture(L"p2Win.png", &p2Win);
+	LoadTexture(L"soccer.png", &bricks);
+	LoadTexture(L"mainmenu.png", &menu);
+	LoadTexture(L"wood.jpg", &woodTexture);
+	LoadTexture(L"blueTexture.jpg", &blueTexture);
+	LoadTexture(L"redTexture.jpg", &redTexture);
+	LoadTexture(L"ballmaterial.jpg", &regularBall);
+	LoadTexture(L"cloud.png", &explosion);
 
 	// A depth state for the particles
 	D3D11_DEPTH_STENCIL_DESC dsDesc = {};
@@ -454,11 +589,13 @@ void Game::CreateBasicGeometry()
 	samplerDesc.MaxAnisotropy = 16;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	check = device->CreateSamplerState(&samplerDesc, &sampler);
+	HRESULT check = device->CreateSamplerState(&samplerDesc, &sampler);
 
 	//Creating Meshes
 	meshes.push_back(new Mesh("../Assets/Models/cube.obj", device));									//meshes[0] - > Cube Model
 	meshes.push_back(new Mesh("../Assets/Models/sphere.obj", device));									//meshes[1] - > Sphere Model
+	hotReloader->WatchMesh("../Assets/Models/cube.obj", meshes[0]);
+	hotReloader->WatchMesh("../Assets/Models/sphere.obj", meshes[1]);
 
 	Vertex vertices[] =
 	{
@@ -521,19 +658,6 @@ void Game::CreateBasicGeometry()
 	p2SelectEntities.push_back(new GameEntity(meshes[0], materials[4])); //5
 	p2SelectEntities.push_back(new GameEntity(meshes[0], materials[4])); //6
 
-	/*
-	std::vector<GameEntity*> temp = std::vector<GameEntity*>();
-	for (int i = 0; i < 100; ++i)
-	{
-		temp.push_back(new GameEntity(meshes[1], materials[4]));
-		temp[i]->SetScale(0.1, 0.1, 0.1);
-	}
-
-	emitters.push_back(new Emitter(0.5, &temp, myVector(0, 0, -2), 0.01));
-	*/
-	ballManager->setExpMesh(meshes[2]);
-	ballManager->setExpMat(materials[7]);
-
 
 	//Creating MenuEntities
 	menuEntities.push_back(new GameEntity(meshes[0], materials[2]));									// menuEntities[0] -> Menu
@@ -542,9 +666,6 @@ void Game::CreateBasicGeometry()
 
 	gameOver2Entities.push_back(new GameEntity(meshes[0], materials[9]));
 
-	//Adding balls to the manager
-	ballManager->addBall(gameEntities[5], myVector(0, 0.1, .65f), myVector(0,0,0), 1, .25, true);
-	
 
 	//Setting Scales
 	/*for(int i = 0; i < gameEntities.size(); i++)
@@ -699,6 +820,9 @@ void Game::CreateLights() {
 }
 
 void Game::SortCurrentEntities() {
+	PROFILE_SCOPE("Game::SortCurrentEntities");
+	SyncMatchEntities();
+
 	currentGameEntities.clear();
 	currentGameEntities.push_back(gameEntities[0]); //gamefield
 	currentGameEntities.push_back(gameEntities[1]); //top wall
@@ -713,30 +837,263 @@ void Game::SortCurrentEntities() {
 		currentGameEntities.push_back(e);
 	
 
-	//getting all the ball Game Entities and adding them to the current entity list
-	std::vector<GameEntity*> list = ballManager->getBallGameEntities(); 
-	for each(auto e in list) {
-		currentGameEntities.push_back(e);
-	}
+	//adding the ball Game Entities to the current entity list
+	for (int i = 0; i < activeBallEntities; i++)
+		currentGameEntities.push_back(ballEntities[i]);
 
+	//Particles are drawn on their own, after the skybox
 	transparentIndex = currentGameEntities.size();
+}
+
+//Moves the pooled ball entities to where the match has them, and
+//gathers the particles for the particle renderer
+void Game::SyncMatchEntities() {
+	std::vector<Ball>& balls = match->GetBallManager()->getBalls();
+	while (ballEntities.size() < balls.size())
+		ballEntities.push_back(new GameEntity(gameEntities[6]));
+
+	for (unsigned int i = 0; i < balls.size(); i++)
+	{
+		myVector position = balls[i].getPosition();
+		float size = balls[i].getRadius() * 2;
+		ballEntities[i]->SetMaterial(balls[i].getIsSoccerBall() ? gameEntities[5]->getMaterial() : gameEntities[6]->getMaterial());
+		ballEntities[i]->SetTranslation(position.x, position.y, position.z);
+		ballEntities[i]->SetScale(size, size, size);
+	}
+	activeBallEntities = balls.size();
+
+	particlePositions.clear();
+	particleFades.clear();
+	match->GetBallManager()->getActiveParticles(particlePositions, &particleFades);
+	particleInstances.resize(particlePositions.size());
+	for (unsigned int i = 0; i < particlePositions.size(); i++)
+	{
+		ParticleInstance& particle = particleInstances[i];
+		particle.x = particlePositions[i].x;
+		particle.y = particlePositions[i].y;
+		particle.z = particlePositions[i].z;
+		particle.size = 0.1f;
+		particle.fade = particleFades[i];
+	}
+}
+
+//Starts a fresh match and its recording, from the input's seed if it has one
+void Game::StartMatch() {
+	uint64_t seed;
+	if (!input->GetSeed(seed))
+		seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	match->Reset(seed);
+	replayWriter.Begin(seed);
+	pendingInput = MatchInput();
+	input->Clear();
+	stepSounds.clear();
+	unseenFirePresses.clear();
+	inputToStep.Reset();
+	inputToSpawn.Reset();
+	stepAccumulator = 0;
+	gpuParticleSystem->Clear();
+	particleReference->Clear();
+}
 
-	for each(auto e in emitters)
+//Sets up a two-player match against another copy of the game
+bool Game::StartNetPlay(int player, uint16_t localPort, const NetAddress& remote, const LinkConditions& conditions) {
+	uint64_t seed = (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	netSession = new RollbackSession(player, seed, 2);
+	netSession->SetConditions(conditions);
+	if (!netSession->Start(localPort, remote))
 	{
-		std::vector<GameEntity*> activeParticles = e->getActiveParticles();
-		for each(auto e in activeParticles)
+		delete netSession;
+		netSession = 0;
+		return false;
+	}
+	pendingInput = MatchInput();
+	return true;
+}
+
+//Sets up watching a match on a server
+bool Game::StartSpectating(const NetAddress& server, uint16_t matchId) {
+	spectator = new SpectatorClient();
+	if (!spectator->Connect(server, matchId))
+	{
+		delete spectator;
+		spectator = 0;
+		return false;
+	}
+	return true;
+}
+
+//Init wraps it with the keyboard and pads if it needs a person too
+void Game::SetInputSource(InputSource* source) {
+	delete input;
+	input = source;
+}
+
+void Game::SetSoundFile(const char* fileName) {
+	soundFile = fileName;
+}
+
+//Replaces the match's balls and score with the spectator's view of the server's match
+void Game::SyncSpectatorView() {
+	spectator->Update(totalTime * 1000.0);
+	if (!spectator->GetView(totalTime * 1000.0, spectatorView))
+		return;
+
+	BallManager* ballManager = match->GetBallManager();
+	std::vector<Ball>& balls = ballManager->getBalls();
+	balls.clear();
+	for each (const SpectatorBall& ball in spectatorView.balls)
+	{
+		//Snapshots are flat; the match keeps every ball at this depth
+		myVector position(ball.x, ball.y, -0.65f);
+		balls.push_back(Ball(position, myVector(0, 0, 0), 1.0f, ball.soccer ? SOCCER_BALL_RADIUS : BALL_RADIUS, ball.soccer, ball.id));
+	}
+
+	MatchScore& score = ballManager->getScore();
+	score.p1Score = spectatorView.p1Score;
+	score.p2Score = spectatorView.p2Score;
+	score.p1Balls = spectatorView.p1Balls;
+	score.p2Balls = spectatorView.p2Balls;
+}
+
+//Reports how much rollback the match needed
+void Game::PrintNetStats() {
+	const RollbackStats& stats = netSession->GetStats();
+	printf("Net: %u frames simulated, %u re-simulated in %u rollbacks (max depth %u), %u stalls\n",
+		stats.framesSimulated, stats.framesResimulated, stats.rollbacks, stats.maxRollbackDepth, stats.stalls);
+	printf("Net: re-simulating took %.2f ms total, %.3f ms at worst\n", stats.resimulateMs, stats.maxResimulateMs);
+	printf("Net: sent %llu bytes in %u packets, received %llu bytes in %u packets\n",
+		(unsigned long long)stats.bytesSent, stats.packetsSent, (unsigned long long)stats.bytesReceived, stats.packetsReceived);
+	if (stats.desyncFrame >= 0)
+		printf("Net: DESYNC first seen at frame %d\n", stats.desyncFrame);
+}
+
+//Reports how hard the computer player thought
+void Game::PrintComputerStats() {
+	const LookaheadStats& stats = computer->GetStats();
+	if (stats.decisions == 0)
+		return;
+	printf("Computer: %u decisions, %.2f ms average, %.2f ms worst, %.0f rollouts/s on %d threads\n",
+		stats.decisions, stats.searchMs / stats.decisions, stats.maxSearchMs,
+		stats.rollouts / (stats.searchMs / 1000.0), botPool->GetThreadCount());
+}
+
+//Reports how long presses took to reach the match and the screen
+void Game::PrintInputLatency() {
+	printf("Input: %llu presses (%u dropped), to their step p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		(unsigned long long)inputToStep.GetCount(), input->GetDropped(),
+		inputToStep.GetPercentile(0.5) / 1e6, inputToStep.GetPercentile(0.99) / 1e6, inputToStep.GetMax() / 1e6);
+	if (inputToSpawn.GetCount() > 0)
+		printf("Input: %llu shots, fire to ball on screen p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			(unsigned long long)inputToSpawn.GetCount(),
+			inputToSpawn.GetPercentile(0.5) / 1e6, inputToSpawn.GetPercentile(0.99) / 1e6, inputToSpawn.GetMax() / 1e6);
+	std::string summary = input->GetSummary();
+	if (!summary.empty())
+		printf("Input: %s\n", summary.c_str());
+}
+
+//Reports how the voice pool coped with the match's sounds
+void Game::PrintSoundStats() {
+	if (!soundPlayer->IsRunning())
+		return;
+	VoiceStats stats = soundPlayer->GetStats();
+	printf("Sound: %llu sounds, %llu played, %llu merged, %llu stolen, %llu dropped (%u queue full), at most %u of %d voices\n",
+		(unsigned long long)stats.sounds, (unsigned long long)stats.played, (unsigned long long)stats.merged,
+		(unsigned long long)stats.stolen, (unsigned long long)stats.dropped, soundPlayer->GetQueueDropped(), stats.maxPlaying, VOICE_COUNT);
+}
+
+//Writes what the profiler holds next to the executable, for chrome://tracing
+void Game::SaveProfile() {
+	std::string error;
+	if (Profiler::ExportChromeTrace("profile.json", &error))
+		printf("Profiler: saved profile.json (%llu scopes recorded so far)\n", (unsigned long long)Profiler::GetEventCount());
+	else
+		printf("Profiler: could not save profile.json (%s)\n", error.c_str());
+}
+
+//Prints how long the GPU spends on each pass, averaged since the last print
+void Game::PrintGpuProfile() {
+	const GpuProfilerStats& stats = gpuProfiler->GetStats();
+	if (stats.framesTimed == 0) {
+		printf("GPU: no frames timed yet (%u dropped, %u disjoint)\n", stats.framesDropped, stats.framesDisjoint);
+		return;
+	}
+
+	printf("GPU: %.3f ms a frame over %u frames, %u frames behind (%u dropped, %u disjoint)\n",
+		stats.averageFrameMs, stats.framesTimed, stats.lastLatency, stats.framesDropped, stats.framesDisjoint);
+	for each (const GpuPassTime& pass in gpuProfiler->GetPassTimes())
+		printf("  %*s%-20s %7.3f ms average, %7.3f ms worst\n", pass.depth * 2, "", pass.name, pass.averageMs, pass.maxMs);
+	printf("  %s\n", GetCullSummary().c_str());
+	gpuProfiler->ResetStats();
+}
+
+//The hot reloader may have swapped any of these since last time
+GpuParticleShaders Game::GetGpuParticleShaders() {
+	GpuParticleShaders shaders;
+	shaders.simulate = computeShaderParticleSim;
+	shaders.emit = computeShaderParticleEmit;
+	shaders.args = computeShaderParticleArgs;
+	shaders.vertex = vertexShaderGpuParticle;
+	shaders.pixel = pixelShaderParticle;
+	return shaders;
+}
+
+//Turns explosions the match started this frame into GPU bursts,
+//then steps the GPU particles by the frame's time.  A match step
+//ages explosions before making new ones, so one made k steps
+//before the end of the frame is k - 1 steps old
+void Game::StepGpuParticles(float deltaTime, int steps) {
+	if (!gpuParticles || !gpuParticleSystem->IsAvailable())
+		return;
+
+	particleEmits.Clear();
+	float newest = (steps - 0.5f) * MATCH_TIMESTEP;
+	for each (Emitter& emitter in match->GetBallManager()->getExplosions())
+	{
+		if (steps > 0 && EXPLOSION_SECONDS - emitter.getTimeLeft() < newest)
 		{
-			currentGameEntities.push_back(e);
+			myVector origin = emitter.getOrigin();
+			particleEmits.Add(origin.x, origin.y, origin.z, GPU_PARTICLES_PER_EXPLOSION, GPU_PARTICLE_SPEED);
 		}
 	}
 
-	std::vector<GameEntity*> ballParticles = ballManager->getActiveParticles();
-	for each(auto e in ballParticles)
+	gpuParticleSystem->Step(deltaTime, particleEmits.GetEmits(), GetGpuParticleShaders());
+
+	if (particleParity)
 	{
-		currentGameEntities.push_back(e);
+		particleReference->Step(deltaTime, particleEmits.GetEmits());
+		if (++particleParityFrames % 60 == 0)
+			CheckParticleParity();
 	}
 }
 
+//Reads the GPU's particles back and compares them with the CPU's,
+//which have had exactly the same bursts and steps.  Stalls the
+//GPU, so only while F6 is on
+void Game::CheckParticleParity() {
+	std::vector<ParticleState> gpu;
+	if (!gpuParticleSystem->ReadBack(gpu))
+	{
+		printf("Particle parity: could not read the GPU's particles\n");
+		return;
+	}
+
+	std::vector<ParticleState> cpu = particleReference->GetParticles();
+	ParticleParityResult result = CompareParticles(gpu, cpu);
+	printf("Particle parity: %s - %u GPU, %u CPU, %u unmatched, worst %.2g position %.2g velocity %.2g life\n",
+		ParticlesMatch(result, PARTICLE_PARITY_TOLERANCE) ? "match" : "MISMATCH",
+		(unsigned)result.countA, (unsigned)result.countB, (unsigned)result.unmatched,
+		result.maxPositionError, result.maxVelocityError, result.maxLifeError);
+}
+
+//Writes the current match's replay next to the executable
+void Game::SaveReplay() {
+	std::string error;
+	if (replayWriter.Save("last_match.replay", &error))
+		printf("Replay: %u steps saved to last_match.replay\n", replayWriter.GetStepCount());
+	else
+		printf("Replay: could not save last_match.replay (%s)\n", error.c_str());
+}
+
 //Creates the Shadow Map components
 void Game::CreateShadowMap()
 {
@@ -812,9 +1169,12 @@ void Game::CreateShadowMap()
 
 void Game::CreateSkybox() {
 	
-	HRESULT I = CreateDDSTextureFromFile(device, L"Assets/Textures/nightSky.dds", 0, &skybox);
+	HRESULT I = CreateDDSTextureFromFileMapped(device, L"Assets/Textures/nightSky.dds", 0, &skybox);
+
+	I = CreateDDSTextureFromFileMapped(device, L"Assets/Textures/nightSkytest.dds", 0, &skyboxBall);
 
-	I = CreateDDSTextureFromFile(device, L"Assets/Textures/nightSkytest.dds", 0, &skyboxBall);
+	hotReloader->WatchTexture(L"Assets/Textures/nightSky.dds", &skybox);
+	hotReloader->WatchTexture(L"Assets/Textures/nightSkytest.dds", &skyboxBall);
 
 	// Create a rasterizer state so we can render backfaces
 	D3D11_RASTERIZER_DESC rsDesc = {};
@@ -853,80 +1213,94 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Game::Update");
+
 	// Quit if the escape key is pressed
 	if (GetAsyncKeyState(VK_ESCAPE))
 		Quit();
 
-	if (gameState == 0) {
-		if (GetAsyncKeyState(VK_SPACE) & 0x8000) 
-		{
-			gameState = 1;
-			*p1Balls = 8;
-			*p1Score = 0;
-			*p2Balls = 8;
-			*p2Score = 0;
-		}
+	//F2 saves the last few seconds of profiling scopes, F3 prints the GPU's passes
+	if (GetAsyncKeyState(VK_F2) & 0x1)
+		SaveProfile();
+	if (GetAsyncKeyState(VK_F3) & 0x1)
+		PrintGpuProfile();
+
+	//F4 shows frame, update and draw time percentiles over the last second
+	if (GetAsyncKeyState(VK_F4) & 0x1)
+		showFrameStats = !showFrameStats;
+
+	//F5 runs explosion particles on the GPU, F6 checks them against the CPU once a second
+	if (GetAsyncKeyState(VK_F5) & 0x1)
+	{
+		gpuParticles = !gpuParticles;
+		gpuParticleSystem->Clear();
+		printf("Particles: %s\n", !gpuParticles ? "CPU" : gpuParticleSystem->IsAvailable() ? "GPU" : "GPU (unavailable)");
 	}
-	if (gameState == 2 || gameState == 3) {
-		if (GetAsyncKeyState(VK_RETURN) & 0x8000)
-		{
-			gameState = 0;
-		}
+	if (GetAsyncKeyState(VK_F6) & 0x1)
+	{
+		particleParity = !particleParity;
+		particleParityFrames = 0;
+		gpuParticleSystem->Clear();
+		particleReference->Clear();
+		printf("Particle parity: %s\n", particleParity ? "on" : "off");
 	}
-	if (gameState == 1) {
-		if (p1shootTimer > 0)
-			p1shootTimer -= deltaTime;
-		if (p2shootTimer > 0)
-			p2shootTimer -= deltaTime;
 
-		if (GetAsyncKeyState('W') & 0x1)
-		{
-			if (p1Selection > 0) {
-				p1SelectEntities[p1Selection]->SetMaterial(materials[4]);
-				p1Selection--;
-				p1SelectEntities[p1Selection]->SetMaterial(materials[5]);
-			}
-		}
-		if (GetAsyncKeyState('S') & 0x1)
-		{
-			if (p1Selection < 6) {
-				p1SelectEntities[p1Selection]->SetMaterial(materials[4]);
-				p1Selection++;
-				p1SelectEntities[p1Selection]->SetMaterial(materials[5]);
-			}
-		}
-		if (GetAsyncKeyState(VK_SPACE) & 0x1 && p1shootTimer <= 0 && *p1Balls > 0)
+	// Swap in any assets that changed on disk - the renderer
+	// keeps its own skybox pointer, so refresh that too
+	if (hotReloader->ApplyPending(materials) > 0)
+		renderer->SetSkybox(skyboxBall);
+
+	if (gameState == 0) {
+		//A replay or bots start straight away
+		if (input->IsUnattended() || (GetAsyncKeyState(VK_SPACE) & 0x8000))
 		{
-			ballManager->addBall(gameEntities[6], myVector(p1SelectEntities[p1Selection]->getPosition().x, p1SelectEntities[p1Selection]->getPosition().y, p1SelectEntities[p1Selection]->getPosition().z), 
-				myVector(ballSpeed, 0, 0), 1, .125, false);
-			p1shootTimer = firePeriod;
-			*p1Balls -= 1;
+			gameState = 1;
+			vsComputer = false;
+			StartMatch();
 		}
-		if (GetAsyncKeyState(VK_UP) & 0x1)
+		//C plays against the computer, which takes player 2's row
+		else if (GetAsyncKeyState('C') & 0x8000)
 		{
-			if (p2Selection > 0) {
-				p2SelectEntities[p2Selection]->SetMaterial(materials[4]);
-				p2Selection--;
-				p2SelectEntities[p2Selection]->SetMaterial(materials[5]);
+			if (!computer)
+			{
+				botPool = new JobPool(0);
+				computer = new LookaheadBot(2, LookaheadConfig(), *botPool, (uint64_t)std::chrono::high_resolution_clock::now().time_since_epoch().count());
 			}
+			computer->ResetStats();
+			gameState = 1;
+			vsComputer = true;
+			StartMatch();
 		}
-		if (GetAsyncKeyState(VK_DOWN) & 0x1)
+	}
+	if (gameState == 2 || gameState == 3) {
+		//Keep answering the other side so it can confirm the end too
+		if (netSession)
+			netSession->Poll(totalTime * 1000.0);
+
+		//Unattended, the next match starts by itself until the input runs out
+		if (input->IsUnattended())
 		{
-			if (p2Selection < 6) {
-				p2SelectEntities[p2Selection]->SetMaterial(materials[4]);
-				p2Selection++;
-				p2SelectEntities[p2Selection]->SetMaterial(materials[5]);
-			}
+			if (netSession || input->IsFinished())
+				Quit();
+			else
+				gameState = 0;
 		}
-		if (GetAsyncKeyState(VK_RCONTROL) & 0x1 && p2shootTimer <= 0 && *p2Balls > 0)
+		else if (GetAsyncKeyState(VK_RETURN) & 0x8000)
 		{
-			ballManager->addBall(gameEntities[6], myVector(p2SelectEntities[p2Selection]->getPosition().x, p2SelectEntities[p2Selection]->getPosition().y, p2SelectEntities[p2Selection]->getPosition().z),
-				myVector(-ballSpeed, 0, 0), 1, .125, false);
-			p2shootTimer = firePeriod;
-			*p2Balls -= 1;
+			if (netSession)
+				Quit();
+			else
+				gameState = 0;
 		}
+	}
+	//The input gets every frame so nothing backs up, but only a
+	//running match keeps its presses
+	int64_t frameNs = InputNow();
+	input->BeginFrame(frameNs);
+	if (gameState != 1)
+		input->Clear();
 
-
+	if (gameState == 1) {
 		if (DEBUG_MODE) {
 			mainCamera->Update(deltaTime);
 		}
@@ -935,18 +1309,102 @@ void Game::Update(float deltaTime, float totalTime)
 			DEBUG_MODE = !DEBUG_MODE;
 		}
 
-		ballManager->Update(deltaTime);
-		for each (auto e in emitters)
+		//Step the match at its fixed rate however long the frame took,
+		//recording each step.  After a long stall the leftover time is
+		//dropped rather than trying to catch up all at once.
+		//Over the network the session steps the match instead, and a
+		//predicted win can still be rolled back, so it keeps running.
+		//A spectator has nothing to step - the server does that - and
+		//keeps watching as the server starts the next match
+		stepAccumulator += deltaTime;
+		int steps = 0;
+		if (spectator)
+		{
+			SyncSpectatorView();
+			stepAccumulator = 0;
+		}
+		while (stepAccumulator >= MATCH_TIMESTEP && (netSession || match->GetWinner() == 0))
+		{
+			//Each step stands for a slice of the time since the last frame,
+			//and takes the presses made before its slice ended
+			int64_t stepEndNs = frameNs - (int64_t)((stepAccumulator - MATCH_TIMESTEP) * 1e9);
+			stepPresses.clear();
+			pendingInput.buttons |= input->TakeStep(*match, stepEndNs, &stepPresses);
+			uint32_t nextBallId = match->GetBallManager()->getNextBallId();
+
+			if (netSession)
+			{
+				//Either player's keys control our side
+				uint8_t buttons = (pendingInput.buttons | (pendingInput.buttons >> 3)) & PLAYER_BUTTON_MASK;
+				if (!netSession->Update(buttons, totalTime * 1000.0))
+					break;
+			}
+			else
+			{
+				if (vsComputer)
+					pendingInput.buttons = (pendingInput.buttons & PLAYER_BUTTON_MASK) | (computer->Think(*match) << 3);
+				match->Step(pendingInput);
+				replayWriter.Record(pendingInput, match->Hash());
+			}
+			input->EndStep(*match);
+			pendingInput = MatchInput();
+			stepAccumulator -= MATCH_TIMESTEP;
+
+			int64_t steppedNs = InputNow();
+			bool spawned = match->GetBallManager()->getNextBallId() != nextBallId;
+			for each (const InputEvent& press in stepPresses)
+			{
+				inputToStep.Record(steppedNs - press.timeNs);
+				if (spawned && (press.buttons & (MATCH_P1_FIRE | MATCH_P2_FIRE)))
+					unseenFirePresses.push_back(press.timeNs);
+			}
+
+			if (++steps == MAX_STEPS_PER_FRAME)
+			{
+				stepAccumulator = 0;
+				break;
+			}
+		}
+
+		int p1Selection = spectator ? spectatorView.p1Selection : match->GetSelection(1);
+		int p2Selection = spectator ? spectatorView.p2Selection : match->GetSelection(2);
+		for (int i = 0; i < MATCH_ROWS; i++)
 		{
-			e->update(deltaTime);
+			p1SelectEntities[i]->SetMaterial(materials[i == p1Selection ? 5 : 4]);
+			p2SelectEntities[i]->SetMaterial(materials[i == p2Selection ? 5 : 4]);
 		}
 		
+		StepGpuParticles(deltaTime, steps);
+
+		//Off to the audio thread without waiting; a full queue just loses the sound
+		if (soundPlayer->IsRunning())
+		{
+			for each (const SoundEvent& sound in stepSounds)
+				soundPlayer->Push(sound);
+		}
+		stepSounds.clear();
+
 		SortCurrentEntities();
 
-		if (*p1Score > 2)
-			gameState = 2;
-		if (*p2Score > 2)
-			gameState = 3;
+		int winner = spectator ? 0 : (netSession ? netSession->GetConfirmedWinner() : match->GetWinner());
+		if (winner != 0)
+		{
+			gameState = winner == 1 ? 2 : 3;
+			if (netSession)
+				PrintNetStats();
+			else
+				SaveReplay();
+			if (vsComputer)
+				PrintComputerStats();
+			PrintInputLatency();
+			PrintSoundStats();
+		}
+		//A replay that went wrong ends the run without a winner
+		else if (input->IsFinished())
+		{
+			PrintInputLatency();
+			Quit();
+		}
 	}
 }
 
@@ -955,8 +1413,11 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	PROFILE_SCOPE("Game::Draw");
+	gpuProfiler->BeginFrame();
 
 	//Rendering the shadow map, uncomment to have no shadows
+	CullShadowCasters();
 	for (int i = 1; i <= 4; i++) {
 		RenderShadowMap(i);
 	}
@@ -968,6 +1429,8 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Background color (Cornflower Blue in this case) for clearing
 	const float color[4] = {0.4f, 0.7f, 0.0f, 0.0f};
 
+	gpuProfiler->BeginPass("Main pass");
+
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
 	//  - At the beginning of Draw (before drawing *anything*)
@@ -1007,37 +1470,60 @@ void Game::Draw(float deltaTime, float totalTime)
 	renderer->SetShadowMap(shadowMatricies, shadowSRVs, shadowSampler);
 
 	renderer->Draw(mainCamera->getViewMatrix(), mainCamera->getProjectionMatrix()); 
+	gpuProfiler->EndPass();
 
 	RenderSkybox();
 
+	if (gameState == 1 && gpuParticles)
+	{
+		//However many the GPU has alive, without asking it
+		GPU_SCOPE(gpuProfiler, "GPU particles");
+		gpuParticleSystem->Draw(GetGpuParticleShaders(), explosion, sampler,
+			bsAlphaBlend, particleDepthState,
+			mainCamera->getViewMatrix(), mainCamera->getProjectionMatrix(), 0.05f);
+	}
+	else if (gameState == 1 && !particleInstances.empty())
+	{
+		//Every emitter's particles in one draw, after the sky so it
+		//doesn't cover them (they don't write depth)
+		GPU_SCOPE(gpuProfiler, "Particles");
+		particleRenderer->Draw(&particleInstances[0], particleInstances.size(),
+			vertexShaderParticle, pixelShaderParticle, explosion, sampler,
+			bsAlphaBlend, particleDepthState,
+			mainCamera->getViewMatrix(), mainCamera->getProjectionMatrix());
+	}
+
 	if (gameState == 1)
 	{
 		// Drawing font
-		m_spriteBatch->Begin();
-
-		// First text
-		std::string p1ScoreText = "Score: " + std::to_string(*p1Score) + "\nBalls: " + std::to_string(*p1Balls);
-		std::wstring str1(p1ScoreText.length(), L' ');
+		GPU_SCOPE(gpuProfiler, "Sprite HUD");
+		hudSprites.Begin(SPRITE_SORT_DEFERRED);
 
-		std::copy(p1ScoreText.begin(), p1ScoreText.end(), str1.begin());
+		//Only re-laid out when a score or ball count changes
+		char text[64];
+		HudStringBuilder(text, sizeof(text)).Append("Score: ").Append(match->GetScore(1)).Append("\nBalls: ").Append(match->GetBallsLeft(1));
+		p1HudText.Set(hudFont->GetGlyphs(), text);
+		hudFont->Draw(hudSprites, p1HudText, m_p1FontPos, Colors::Red, true);
 
-		const wchar_t* output = str1.c_str();
-		SimpleMath::Vector2 origin = m_font->MeasureString(output) / 2.0f;
-		m_font->DrawString(m_spriteBatch.get(), output,
-			m_p1FontPos, Colors::Red, 0.f, origin);
+		HudStringBuilder(text, sizeof(text)).Append("Score: ").Append(match->GetScore(2)).Append("\nBalls: ").Append(match->GetBallsLeft(2));
+		p2HudText.Set(hudFont->GetGlyphs(), text);
+		hudFont->Draw(hudSprites, p2HudText, m_p2FontPos, Colors::Blue, true);
 
-		// Second Text
-		std::string p2ScoreText = "Score: " + std::to_string(*p2Score) + "\nBalls: " + std::to_string(*p2Balls);
-		std::wstring str2(p2ScoreText.length(), L' ');
-
-		std::copy(p2ScoreText.begin(), p2ScoreText.end(), str2.begin());
+		spriteRenderer->Draw(hudSprites, vertexShaderSprite, pixelShaderSprite, (float)width, (float)height);
+	}
 
-		output = str2.c_str();
-		origin = m_font->MeasureString(output) / 2.0f;
-		m_font->DrawString(m_spriteBatch.get(), output,
-			m_p2FontPos, Colors::Blue, 0.f, origin);
+	if (showFrameStats)
+	{
+		//The text only changes when a new second of stats comes in
+		if (frameStatsShown != frameStats.GetWindowCount())
+		{
+			frameStatsRun.Set(hudFont->GetGlyphs(), (frameStats.GetSummary() + "\n" + GetCullSummary()).c_str());
+			frameStatsShown = frameStats.GetWindowCount();
+		}
 
-		m_spriteBatch->End();
+		hudSprites.Begin(SPRITE_SORT_DEFERRED);
+		hudFont->Draw(hudSprites, frameStatsRun, m_statsFontPos, Colors::White, false, 0.5f);
+		spriteRenderer->Draw(hudSprites, vertexShaderSprite, pixelShaderSprite, (float)width, (float)height);
 	}
 
 	// Reset the states!
@@ -1055,12 +1541,52 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
+	gpuProfiler->EndFrame();
+	PROFILE_SCOPE("Present");
 	swapChain->Present(0, 0);
+
+	//Any ball fired since the last frame is on screen now
+	if (!unseenFirePresses.empty())
+	{
+		int64_t presentedNs = InputNow();
+		for each (int64_t pressNs in unseenFirePresses)
+			inputToSpawn.Record(presentedNs - pressNs);
+		unseenFirePresses.clear();
+	}
+}
+
+
+//Gathers the balls' bounds once for all four shadow maps
+void Game::CullShadowCasters()
+{
+	PROFILE_SCOPE("Shadow cull");
+	shadowCuller.Clear();
+	for (int i = 0; i < activeBallEntities; i++)
+	{
+		GameEntity* ge = ballEntities[i];
+		ge->UpdateWorldMatrix();
+		XMFLOAT4X4 world = ge->getWorldMatrix();
+		shadowCuller.Add(ge->getMesh()->GetBounds(), &world._11);
+	}
 }
 
+//Culled out of tested for the camera and each light, last frame
+std::string Game::GetCullSummary()
+{
+	const CullStats& camera = renderer->GetCullStats();
+	char text[128];
+	snprintf(text, sizeof(text), "Culled: camera %u/%u, lights %u/%u %u/%u %u/%u %u/%u",
+		camera.culled, camera.tested,
+		shadowCullStats[0].culled, shadowCullStats[0].tested, shadowCullStats[1].culled, shadowCullStats[1].tested,
+		shadowCullStats[2].culled, shadowCullStats[2].tested, shadowCullStats[3].culled, shadowCullStats[3].tested);
+	return text;
+}
 
 void Game::RenderShadowMap(int lightIndex)
 {
+	static const char* scopeNames[4] = { "Shadow map 1", "Shadow map 2", "Shadow map 3", "Shadow map 4" };
+	GPU_SCOPE(gpuProfiler, scopeNames[lightIndex - 1]);
+
 	// Set up targets
 	context->OMSetRenderTargets(0, 0, shadowDSVs[lightIndex-1]);
 	context->ClearDepthStencilView(shadowDSVs[lightIndex-1], D3D11_CLEAR_DEPTH, 1.0f, 0);
@@ -1089,13 +1615,29 @@ void Game::RenderShadowMap(int lightIndex)
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
 
+	// The light's projection is orthographic, so every caster covers the
+	// same number of shadow map pixels per unit regardless of distance
+	float shadowPixelsPerUnit = shadowMatricies[index + 1]._11 * shadowMapSize * 0.5f;
+
+	//Only the balls inside this light's box
+	shadowCullStats[lightIndex - 1] = shadowCuller.Cull(FrustumFromViewProjection(&shadowMatricies[index]._11, &shadowMatricies[index + 1]._11), shadowVisible);
+
 	//Shadows on just balls
-	for (unsigned int i = 0; i < ballManager->getBallGameEntities().size(); i++)
+	for (int i = 0; i < activeBallEntities; i++)
 	{
-		// Grab the data from the first entity's mesh
-		GameEntity* ge = ballManager->getBallGameEntities()[i];
-		ID3D11Buffer* vb = ge->getMesh()->GetVertexBuffer();
-		ID3D11Buffer* ib = ge->getMesh()->GetIndexBuffer();
+		if (!shadowVisible[i])
+			continue;
+
+		// Grab the data from the first entity's mesh, at a LOD picked for
+		// its size in the shadow map
+		GameEntity* ge = ballEntities[i];
+		Mesh* mesh = ge->getMesh();
+		XMFLOAT3 scale = ge->getScale();
+		float maxScale = max(fabsf(scale.x), max(fabsf(scale.y), fabsf(scale.z)));
+		int lod = mesh->SelectLOD(mesh->GetBoundingRadius() * maxScale * shadowPixelsPerUnit, LOD_SHADOW_MAX_ERROR_PIXELS);
+
+		ID3D11Buffer* vb = mesh->GetVertexBuffer();
+		ID3D11Buffer* ib = mesh->GetIndexBuffer(lod);
 
 		// Set buffers in the input assembler
 		context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
@@ -1105,7 +1647,7 @@ void Game::RenderShadowMap(int lightIndex)
 		vertexShaderShadow->CopyAllBufferData();
 
 		// Finally do the actual drawing
-		context->DrawIndexed(ge->getMesh()->GetIndexCount(), 0, 0);
+		context->DrawIndexed(mesh->GetIndexCount(lod), 0, 0);
 	}
 
 	//vertexShaderShadow->SetMatrix4x4("view", shadowViewMatrixTwo);
@@ -1159,6 +1701,7 @@ void Game::RenderShadowMap(int lightIndex)
 }
 
 void Game::RenderSkybox() {
+	GPU_SCOPE(gpuProfiler, "Skybox");
 
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
@@ -3,17 +3,31 @@
 #include "DXCore.h"
 #include "Mesh.h"
 #include "Renderer.h"
+#include "ParticleRenderer.h"
+#include "GpuParticleSystem.h"
 #include "Camera.h"
 #include "Lights.h"
 #include <DirectXMath.h>
-#include "BallManager.h"
+#include "Match.h"
+#include "Replay.h"
+#include "RollbackSession.h"
+#include "SpectatorClient.h"
+#include "LookaheadBot.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include "D3D11GpuTimestamps.h"
 #include "SpriteFont.h"
+#include "HudFont.h"
+#include "DeviceInputSources.h"
+#include "XAudioSink.h"
+#include "SoftwareMixer.h"
 #include "SimpleMath.h"
-#include "Emitter.h"
 #include <string>
 #include "Vertex.h"
 #include "WICTextureLoader.h"
 #include "DDSTextureLoader.h"
+#include "MappedDDSLoader.h"
+#include "HotReloader.h"
 #include <algorithm>
 
 class Game 
@@ -32,6 +46,8 @@ public:
 	void Draw(float deltaTime, float totalTime);
 
 	void RenderShadowMap(int lightIndex);
+	void CullShadowCasters();
+	std::string GetCullSummary();
 
 	void RenderSkybox();
 
@@ -41,23 +57,46 @@ public:
 	void OnMouseMove (WPARAM buttonState, int x, int y);
 	void OnMouseWheel(float wheelDelta,   int x, int y);
 
-	int* p1Balls;
-	int* p2Balls;
+	// Plays against another copy of the game over UDP instead of
+	// on one keyboard.  Call before Init; player 1 picks the seed.
+	bool StartNetPlay(int player, uint16_t localPort, const NetAddress& remote, const LinkConditions& conditions);
+
+	// Watches a match hosted on a BallServer instead of playing.
+	// Call before Init.
+	bool StartSpectating(const NetAddress& server, uint16_t matchId);
+
+	// Plays from a replay or scripted bots rather than only the
+	// keyboard and pads.  Takes ownership.  Call before Init.
+	void SetInputSource(InputSource* source);
+
+	// Mixes the sounds in software into a .wav rather than playing
+	// them.  Call before Init.
+	void SetSoundFile(const char* fileName);
 
-	int* p1Score;
-	int* p2Score;
 private:
 	//Gameplay variables
 	int gameState;
-	int p1Selection;
-	int p2Selection;
-	float firePeriod;
-	float p1shootTimer;
-	float p2shootTimer;
-
 
-
-	float ballSpeed;
+	//The match itself - Game just feeds it key presses and draws it
+	Match* match;
+	MatchInput pendingInput;	//Presses since the last step
+	InputSource* input;			//Where each step's buttons come from
+	std::vector<InputEvent> stepPresses;
+	std::vector<int64_t> unseenFirePresses;	//Fired a ball that isn't on screen yet
+	TimeHistogram inputToStep;		//Press to the step that took it being simulated
+	TimeHistogram inputToSpawn;		//Fire press to its ball being presented
+	SoundPlayer* soundPlayer;		//Plays the match's sounds on its own thread
+	std::vector<SoundEvent> stepSounds;	//Made by this frame's steps
+	std::string soundFile;			//Where the sounds go instead of the speakers, if anywhere
+	float stepAccumulator;		//Frame time not yet simulated
+	ReplayWriter replayWriter;	//Records the current match
+	RollbackSession* netSession;	//Owns the match when playing over the network
+	SpectatorClient* spectator;		//Fills the match from a server's snapshots when watching
+	JobPool* botPool;				//Runs the computer player's rollouts
+	LookaheadBot* computer;			//Plays player 2 in a single-player match
+	GpuProfiler* gpuProfiler;		//Times each render pass on the GPU
+	bool vsComputer;
+	SpectatorView spectatorView;
 
 	//List of Game Entities, Meshes, and Materials
 	std::vector<GameEntity*> menuEntities;
@@ -67,6 +106,18 @@ private:
 	std::vector<GameEntity*> p1SelectEntities;
 	std::vector<GameEntity*> p2SelectEntities;
 	std::vector<GameEntity*> currentGameEntities;
+	std::vector<GameEntity*> ballEntities;		//Pool drawn in place of the match's balls, grown as needed
+	int activeBallEntities;
+	std::vector<myVector> particlePositions;	//Explosion particles, gathered every frame
+	std::vector<float> particleFades;
+	std::vector<ParticleInstance> particleInstances;
+	ParticleRenderer* particleRenderer;
+	GpuParticleSystem* gpuParticleSystem;		//F5 - explosions as GPU bursts instead
+	ParticleSim* particleReference;			//F6 - the same bursts on the CPU, to check the GPU against
+	ParticleEmitQueue particleEmits;
+	bool gpuParticles;
+	bool particleParity;
+	int particleParityFrames;
 	std::vector<Mesh*> meshes;
 	std::vector<Material*> materials;
 
@@ -100,6 +151,9 @@ private:
 	//Shadow Map
 	int shadowMapSize;
 	ID3D11RasterizerState* shadowRasterizer;
+	FrustumCuller shadowCuller;		//The balls, once a frame, tested against each light
+	std::vector<uint8_t> shadowVisible;
+	CullStats shadowCullStats[4];
 	std::vector<DirectX::XMFLOAT4X4> shadowMatricies; //nth index is the shadow view matrix, and n+1 index is the shadow projection matrix
 	std::vector<ID3D11ShaderResourceView*> shadowSRVs;
 	std::vector<ID3D11DepthStencilView*> shadowDSVs;
@@ -112,14 +166,29 @@ private:
 
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadShaders(); 
+	int LoadShader(ISimpleShader* shader, const ShaderBundle& bundle, const char* name);
 	void CreateMatrices();
 	void CreateBasicGeometry();
 	void CreateMenu();
 	void CreateGameField();
 	void CreateLights();
 	void SortCurrentEntities();
+	void SyncMatchEntities();
+	void SyncSpectatorView();
+	void StartMatch();
+	void SaveReplay();
+	void PrintNetStats();
+	void PrintComputerStats();
+	void PrintInputLatency();
+	void PrintSoundStats();
+	void SaveProfile();
+	void PrintGpuProfile();
+	void StepGpuParticles(float deltaTime, int steps);
+	void CheckParticleParity();
+	GpuParticleShaders GetGpuParticleShaders();
 	void CreateShadowMap();
 	void CreateSkybox();
+	HRESULT LoadTexture(std::wstring file, ID3D11ShaderResourceView** srv);
 
 	// Wrappers for DirectX shaders to provide simplified functionality
 	SimpleVertexShader* vertexShader;
@@ -130,6 +199,17 @@ private:
 	SimplePixelShader* pixelShaderSky;
 	SimplePixelShader* pixelShaderShiny;
 	SimpleVertexShader* vertexShaderShadow;
+	SimpleVertexShader* vertexShaderSprite;
+	SimplePixelShader* pixelShaderSprite;
+	SimpleVertexShader* vertexShaderParticle;
+	SimplePixelShader* pixelShaderParticle;
+	SimpleComputeShader* computeShaderParticleSim;
+	SimpleComputeShader* computeShaderParticleEmit;
+	SimpleComputeShader* computeShaderParticleArgs;
+	SimpleVertexShader* vertexShaderGpuParticle;
+
+	// Swaps in shaders, textures and meshes when their files change
+	HotReloader* hotReloader;
 
 	// The matrices to go from model space to screen space
 	DirectX::XMFLOAT4X4 worldMatrix;
@@ -140,16 +220,23 @@ private:
 	// determining how far the mouse moved in a single frame.
 	POINT prevMousePos;
 
-	BallManager* ballManager;
-	std::vector<Emitter*> emitters;
-
 	// Font related objects
 	std::unique_ptr<DirectX::SpriteFont> m_font;
-	std::unique_ptr<DirectX::SpriteBatch> m_spriteBatch;
+	SpriteRenderer* spriteRenderer;
+	SpriteQueue hudSprites;			//Refilled every frame, keeps its arrays
+	HudFont* hudFont;
+	HudTextRun p1HudText;
+	HudTextRun p2HudText;
 
 	// Font positions
 	DirectX::SimpleMath::Vector2 m_p1FontPos;
 	DirectX::SimpleMath::Vector2 m_p2FontPos;
+	DirectX::SimpleMath::Vector2 m_statsFontPos;
+
+	// Frame time overlay, laid out again once per stats window
+	bool showFrameStats;
+	uint32_t frameStatsShown;
+	HudTextRun frameStatsRun;
 
 	bool DEBUG_MODE;
 
@@ -0,0 +1,286 @@
+#include "GpuParticleSystem.h"
+#include "Profiler.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+// Offsets into the counts and args buffers
+const UINT COUNT_LIVE = 0;
+const UINT COUNT_SURVIVED = 4;
+const UINT COUNT_READBACK = 8;
+const UINT ARGS_DRAW = 16;
+const UINT ARGS_DRAW_INSTANCES = 20;
+
+// Leaves an append buffer's counter where it was
+const UINT KEEP_COUNT = (UINT)-1;
+
+GpuParticleSystem::GpuParticleSystem(ID3D11Device* device, ID3D11DeviceContext* context, const ParticleSimConfig& config)
+	: device(device), context(context), config(config)
+{
+	for (int i = 0; i < 2; i++)
+	{
+		particles[i] = 0;
+		particleUAVs[i] = 0;
+		particleSRVs[i] = 0;
+	}
+	current = 0;
+	resetCurrent = true;
+	emitBuffer = 0;
+	emitSRV = 0;
+	counts = 0;
+	countsSRV = 0;
+	args = 0;
+	argsUAV = 0;
+	particleStaging = 0;
+	countsStaging = 0;
+
+	available = CreateParticleBuffer(0) && CreateParticleBuffer(1);
+
+	D3D11_BUFFER_DESC ebd = {};
+	ebd.Usage = D3D11_USAGE_DYNAMIC;
+	ebd.ByteWidth = sizeof(ParticleEmit) * PARTICLE_MAX_EMITS;
+	ebd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	ebd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ebd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	ebd.StructureByteStride = sizeof(ParticleEmit);
+	D3D11_SHADER_RESOURCE_VIEW_DESC esd = {};
+	esd.Format = DXGI_FORMAT_UNKNOWN;
+	esd.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	esd.Buffer.NumElements = PARTICLE_MAX_EMITS;
+	available = available &&
+		SUCCEEDED(device->CreateBuffer(&ebd, 0, &emitBuffer)) &&
+		SUCCEEDED(device->CreateShaderResourceView(emitBuffer, &esd, &emitSRV));
+
+	// Raw, so the shaders can Load from it
+	D3D11_BUFFER_DESC cbd = {};
+	cbd.Usage = D3D11_USAGE_DEFAULT;
+	cbd.ByteWidth = 16;
+	cbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	D3D11_SHADER_RESOURCE_VIEW_DESC csd = {};
+	csd.Format = DXGI_FORMAT_R32_TYPELESS;
+	csd.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+	csd.BufferEx.NumElements = 4;
+	csd.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+	available = available &&
+		SUCCEEDED(device->CreateBuffer(&cbd, 0, &counts)) &&
+		SUCCEEDED(device->CreateShaderResourceView(counts, &csd, &countsSRV));
+
+	// Dispatch args (groups x, y, z) then draw args (vertices per
+	// instance, instances, first vertex, first instance)
+	UINT initialArgs[8] = { 0, 1, 1, 0, 4, 0, 0, 0 };
+	D3D11_BUFFER_DESC abd = {};
+	abd.Usage = D3D11_USAGE_DEFAULT;
+	abd.ByteWidth = sizeof(initialArgs);
+	abd.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	abd.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS | D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	D3D11_SUBRESOURCE_DATA initialArgsData = {};
+	initialArgsData.pSysMem = initialArgs;
+	D3D11_UNORDERED_ACCESS_VIEW_DESC aud = {};
+	aud.Format = DXGI_FORMAT_R32_TYPELESS;
+	aud.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	aud.Buffer.NumElements = 8;
+	aud.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+	available = available &&
+		SUCCEEDED(device->CreateBuffer(&abd, &initialArgsData, &args)) &&
+		SUCCEEDED(device->CreateUnorderedAccessView(args, &aud, &argsUAV));
+
+	D3D11_BUFFER_DESC sbd = {};
+	sbd.Usage = D3D11_USAGE_STAGING;
+	sbd.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	sbd.ByteWidth = sizeof(ParticleState) * config.capacity;
+	available = available && SUCCEEDED(device->CreateBuffer(&sbd, 0, &particleStaging));
+	sbd.ByteWidth = 16;
+	available = available && SUCCEEDED(device->CreateBuffer(&sbd, 0, &countsStaging));
+}
+
+GpuParticleSystem::~GpuParticleSystem()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (particles[i]) particles[i]->Release();
+		if (particleUAVs[i]) particleUAVs[i]->Release();
+		if (particleSRVs[i]) particleSRVs[i]->Release();
+	}
+	if (emitBuffer) emitBuffer->Release();
+	if (emitSRV) emitSRV->Release();
+	if (counts) counts->Release();
+	if (countsSRV) countsSRV->Release();
+	if (args) args->Release();
+	if (argsUAV) argsUAV->Release();
+	if (particleStaging) particleStaging->Release();
+	if (countsStaging) countsStaging->Release();
+}
+
+bool GpuParticleSystem::CreateParticleBuffer(int index)
+{
+	D3D11_BUFFER_DESC pbd = {};
+	pbd.Usage = D3D11_USAGE_DEFAULT;
+	pbd.ByteWidth = sizeof(ParticleState) * config.capacity;
+	pbd.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	pbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	pbd.StructureByteStride = sizeof(ParticleState);
+	if (FAILED(device->CreateBuffer(&pbd, 0, &particles[index])))
+		return false;
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.NumElements = config.capacity;
+	uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+	if (FAILED(device->CreateUnorderedAccessView(particles[index], &uavDesc, &particleUAVs[index])))
+		return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.NumElements = config.capacity;
+	return SUCCEEDED(device->CreateShaderResourceView(particles[index], &srvDesc, &particleSRVs[index]));
+}
+
+// A buffer can't be read in one place while it's written in
+// another, so every pass cleans up after itself
+void GpuParticleSystem::UnbindCompute()
+{
+	ID3D11UnorderedAccessView* noUAVs[2] = { 0, 0 };
+	ID3D11ShaderResourceView* noSRVs[2] = { 0, 0 };
+	context->CSSetUnorderedAccessViews(0, 2, noUAVs, 0);
+	context->CSSetShaderResources(0, 2, noSRVs);
+}
+
+void GpuParticleSystem::Step(float dt, const std::vector<ParticleEmit>& emits, const GpuParticleShaders& shaders)
+{
+	PROFILE_SCOPE("GpuParticleSystem::Step");
+	if (!available)
+		return;
+
+	int next = 1 - current;
+
+	// Setting an append buffer's counter only happens on binding
+	if (resetCurrent)
+	{
+		UINT zero = 0;
+		context->CSSetUnorderedAccessViews(0, 1, &particleUAVs[current], &zero);
+		UnbindCompute();
+		resetCurrent = false;
+	}
+
+	uint32_t emitCount = 0;
+	uint32_t newCount = 0;
+	if (!emits.empty())
+	{
+		emitCount = emits.size() < PARTICLE_MAX_EMITS ? (uint32_t)emits.size() : PARTICLE_MAX_EMITS;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (SUCCEEDED(context->Map(emitBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			memcpy(mapped.pData, &emits[0], sizeof(ParticleEmit) * emitCount);
+			context->Unmap(emitBuffer, 0);
+			newCount = emits[emitCount - 1].first + emits[emitCount - 1].count;
+		}
+	}
+
+	// How many are alive, and so how many groups to simulate them
+	context->CopyStructureCount(counts, COUNT_LIVE, particleUAVs[current]);
+	shaders.args->SetShader();
+	shaders.args->SetShaderResourceView("Counts", countsSRV);
+	shaders.args->SetUnorderedAccessView("Args", argsUAV);
+	shaders.args->DispatchByGroups(1, 1, 1);
+	UnbindCompute();
+
+	// Move and age them into the other buffer
+	shaders.simulate->SetFloat("deltaTime", dt);
+	shaders.simulate->SetFloat("drag", config.drag);
+	shaders.simulate->CopyAllBufferData();
+	shaders.simulate->SetShader();
+	shaders.simulate->SetShaderResourceView("Counts", countsSRV);
+	shaders.simulate->SetUnorderedAccessView("Current", particleUAVs[current], KEEP_COUNT);
+	shaders.simulate->SetUnorderedAccessView("Next", particleUAVs[next], 0);
+	context->DispatchIndirect(args, 0);
+	UnbindCompute();
+
+	// New ones after the survivors, as far as there's room
+	if (newCount > 0)
+	{
+		context->CopyStructureCount(counts, COUNT_SURVIVED, particleUAVs[next]);
+		shaders.emit->SetFloat("lifetime", config.lifetime);
+		shaders.emit->SetInt("capacity", (int)config.capacity);
+		shaders.emit->SetInt("emitCount", (int)emitCount);
+		shaders.emit->SetInt("newCount", (int)newCount);
+		shaders.emit->CopyAllBufferData();
+		shaders.emit->SetShader();
+		shaders.emit->SetShaderResourceView("Emits", emitSRV);
+		shaders.emit->SetShaderResourceView("Counts", countsSRV);
+		shaders.emit->SetUnorderedAccessView("Next", particleUAVs[next], KEEP_COUNT);
+		shaders.emit->DispatchByThreads(newCount, 1, 1);
+		UnbindCompute();
+	}
+
+	// Whatever ended up alive is what gets drawn
+	context->CopyStructureCount(args, ARGS_DRAW_INSTANCES, particleUAVs[next]);
+	current = next;
+}
+
+void GpuParticleSystem::Draw(const GpuParticleShaders& shaders, ID3D11ShaderResourceView* texture, ID3D11SamplerState* sampler,
+	ID3D11BlendState* blendState, ID3D11DepthStencilState* depthState,
+	const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float size)
+{
+	PROFILE_SCOPE("GpuParticleSystem::Draw");
+	if (!available)
+		return;
+
+	// No vertex buffers; the shader has no layout and works
+	// from SV_VertexID and SV_InstanceID
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	shaders.vertex->SetMatrix4x4("view", view);
+	shaders.vertex->SetMatrix4x4("projection", projection);
+	shaders.vertex->SetFloat("size", size);
+	shaders.vertex->SetFloat("lifetime", config.lifetime);
+	shaders.vertex->CopyAllBufferData();
+	shaders.vertex->SetShader();
+	shaders.vertex->SetShaderResourceView("Particles", particleSRVs[current]);
+
+	shaders.pixel->SetShaderResourceView("Particle", texture);
+	shaders.pixel->SetSamplerState("Sampler", sampler);
+	shaders.pixel->SetShader();
+
+	float blend[4] = { 1, 1, 1, 1 };
+	context->OMSetBlendState(blendState, blend, 0xffffffff);
+	context->OMSetDepthStencilState(depthState, 0);
+
+	context->DrawInstancedIndirect(args, ARGS_DRAW);
+
+	// The buffer is a UAV again next step
+	ID3D11ShaderResourceView* noSRV = 0;
+	context->VSSetShaderResources(0, 1, &noSRV);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->OMSetBlendState(0, blend, 0xffffffff);
+	context->OMSetDepthStencilState(0, 0);
+}
+
+bool GpuParticleSystem::ReadBack(std::vector<ParticleState>& out)
+{
+	out.clear();
+	if (!available)
+		return false;
+
+	context->CopyStructureCount(counts, COUNT_READBACK, particleUAVs[current]);
+	context->CopyResource(countsStaging, counts);
+	context->CopyResource(particleStaging, particles[current]);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(countsStaging, 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+	uint32_t live = ((const uint32_t*)mapped.pData)[COUNT_READBACK / 4];
+	context->Unmap(countsStaging, 0);
+	if (live > config.capacity)
+		return false;
+
+	if (FAILED(context->Map(particleStaging, 0, D3D11_MAP_READ, 0, &mapped)))
+		return false;
+	const ParticleState* first = (const ParticleState*)mapped.pData;
+	out.assign(first, first + live);
+	context->Unmap(particleStaging, 0);
+	return true;
+}
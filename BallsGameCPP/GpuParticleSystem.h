@@ -0,0 +1,95 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "SimpleShader.h"
+#include "ParticleSim.h"
+
+// The shaders a step and a draw need.  Handed in each time
+// since the hot reloader may have swapped any of them.
+struct GpuParticleShaders
+{
+	SimpleComputeShader* simulate;	// ComputeShaderParticleSim
+	SimpleComputeShader* emit;		// ComputeShaderParticleEmit
+	SimpleComputeShader* args;		// ComputeShaderParticleArgs
+	SimpleVertexShader* vertex;		// VertexShaderGpuParticle
+	SimplePixelShader* pixel;		// PixelShaderParticle
+};
+
+// --------------------------------------------------------
+// ParticleSim's rules run entirely on the GPU.
+//
+// Two structured buffers of config.capacity particles take
+// turns: each Step consumes the live ones from one, appends
+// the survivors and this step's new particles to the other,
+// and swaps.  The CPU never learns how many are alive - the
+// append counter is copied with CopyStructureCount into a
+// small buffer the shaders read, a one thread shader turns it
+// into the simulate shader's DispatchIndirect args, and the
+// final count goes straight into DrawInstancedIndirect's
+// instance count.  All the CPU sends is the step's bursts.
+//
+// ReadBack copies the particles out for the parity check; it
+// waits on the GPU, so nothing else should call it.
+// --------------------------------------------------------
+class GpuParticleSystem
+{
+public:
+	GpuParticleSystem(ID3D11Device* device, ID3D11DeviceContext* context, const ParticleSimConfig& config);
+	~GpuParticleSystem();
+
+	// False if the buffers couldn't be made; Step and Draw then
+	// do nothing
+	bool IsAvailable() const { return available; }
+
+	void Step(float dt, const std::vector<ParticleEmit>& emits, const GpuParticleShaders& shaders);
+
+	// size - Width of each particle's quad, in world units
+	void Draw(const GpuParticleShaders& shaders, ID3D11ShaderResourceView* texture, ID3D11SamplerState* sampler,
+		ID3D11BlendState* blendState, ID3D11DepthStencilState* depthState,
+		const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, float size);
+
+	// Every live particle, in whatever order the GPU appended
+	// them.  Stalls until the GPU has caught up.
+	bool ReadBack(std::vector<ParticleState>& particles);
+
+	// Kills everything at the next Step
+	void Clear() { resetCurrent = true; }
+
+	const ParticleSimConfig& GetConfig() const { return config; }
+
+private:
+	bool CreateParticleBuffer(int index);
+	void UnbindCompute();
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	ParticleSimConfig config;
+	bool available;
+
+	// The two particle lists; current is the live one
+	ID3D11Buffer* particles[2];
+	ID3D11UnorderedAccessView* particleUAVs[2];
+	ID3D11ShaderResourceView* particleSRVs[2];
+	int current;
+	bool resetCurrent;
+
+	// This step's bursts
+	ID3D11Buffer* emitBuffer;
+	ID3D11ShaderResourceView* emitSRV;
+
+	// [0] live before the step, [1] after simulating, [2] for
+	// reading back
+	ID3D11Buffer* counts;
+	ID3D11ShaderResourceView* countsSRV;
+
+	// Dispatch args at 0, draw args at 16
+	ID3D11Buffer* args;
+	ID3D11UnorderedAccessView* argsUAV;
+
+	// For ReadBack
+	ID3D11Buffer* particleStaging;
+	ID3D11Buffer* countsStaging;
+};
@@ -0,0 +1,195 @@
+#include "GpuProfiler.h"
+
+#include <cstring>
+
+GpuProfiler::GpuProfiler(IGpuTimestamps* timestamps) : timestamps(timestamps)
+{
+	for (int i = 0; i < GPU_PROFILER_FRAMES; i++)
+	{
+		frames[i].pending = false;
+		frames[i].passes.reserve(GPU_PROFILER_MAX_PASSES);
+	}
+	current = 0;
+	currentSlot = 0;
+	issued = 0;
+	collected = 0;
+	unavailable = false;
+	open.reserve(GPU_PROFILER_MAX_PASSES);
+	track = PROFILER_ENABLED ? Profiler::AddTrack("GPU") : 0;
+	ResetStats();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	delete timestamps;
+}
+
+void GpuProfiler::ResetStats()
+{
+	memset(&stats, 0, sizeof(stats));
+	passTimes.clear();
+}
+
+void GpuProfiler::BeginFrame()
+{
+	if (current)
+		EndFrame();
+	stats.framesBegun++;
+	Collect();
+
+	current = 0;
+	open.clear();
+	if (unavailable)
+		return;
+
+	// Never wait on the GPU - skip timing this one instead
+	Frame& frame = frames[issued % GPU_PROFILER_FRAMES];
+	if (frame.pending)
+	{
+		stats.framesDropped++;
+		return;
+	}
+
+	currentSlot = issued % GPU_PROFILER_FRAMES;
+	issued++;
+	current = &frame;
+	frame.pending = true;
+	frame.number = stats.framesBegun;
+	frame.cpuStart = Profiler::Now();
+	frame.timestamps = 1;
+	frame.end = -1;
+	frame.passes.clear();
+	timestamps->BeginFrame(currentSlot);
+	timestamps->Timestamp(currentSlot, 0);
+}
+
+void GpuProfiler::EndFrame()
+{
+	open.clear();
+	if (!current)
+		return;
+
+	current->end = current->timestamps++;
+	timestamps->Timestamp(currentSlot, current->end);
+	timestamps->EndFrame(currentSlot);
+	current = 0;
+}
+
+void GpuProfiler::BeginPass(const char* name)
+{
+	if (!current)
+		return;
+
+	// -1 keeps EndPass matched up with a pass that isn't timed
+	if ((int)current->passes.size() >= GPU_PROFILER_MAX_PASSES)
+	{
+		stats.passesDropped++;
+		open.push_back(-1);
+		return;
+	}
+
+	Pass pass;
+	pass.name = name;
+	pass.depth = (int)open.size();
+	pass.begin = current->timestamps++;
+	pass.end = -1;
+	timestamps->Timestamp(currentSlot, pass.begin);
+	open.push_back((int)current->passes.size());
+	current->passes.push_back(pass);
+}
+
+void GpuProfiler::EndPass()
+{
+	if (!current || open.empty())
+		return;
+
+	int index = open.back();
+	open.pop_back();
+	if (index < 0)
+		return;
+
+	Pass& pass = current->passes[index];
+	pass.end = current->timestamps++;
+	timestamps->Timestamp(currentSlot, pass.end);
+}
+
+// Reads back finished frames, oldest first, stopping at the
+// first the GPU hasn't got to
+void GpuProfiler::Collect()
+{
+	uint64_t ticks[GPU_PROFILER_MAX_TIMESTAMPS];
+	while (collected < issued)
+	{
+		Frame& frame = frames[collected % GPU_PROFILER_FRAMES];
+		uint64_t frequency = 0;
+		GpuTimestampStatus status = timestamps->Read(collected % GPU_PROFILER_FRAMES, frame.timestamps, ticks, frequency);
+
+		if (status == GPU_TIMESTAMPS_PENDING)
+			break;
+		if (status == GPU_TIMESTAMPS_READY && frequency > 0)
+			Report(frame, ticks, frequency);
+		else if (status == GPU_TIMESTAMPS_UNAVAILABLE)
+			unavailable = true;
+		else
+			stats.framesDisjoint++;
+
+		frame.pending = false;
+		collected++;
+	}
+}
+
+void GpuProfiler::Report(Frame& frame, const uint64_t* ticks, uint64_t frequency)
+{
+	double msPerTick = 1000.0 / frequency;
+	if (ticks[frame.end] < ticks[0])
+	{
+		stats.framesDisjoint++;
+		return;
+	}
+
+	float frameMs = (float)((ticks[frame.end] - ticks[0]) * msPerTick);
+	stats.framesTimed++;
+	stats.lastLatency = stats.framesBegun - frame.number;
+	stats.lastFrameMs = frameMs;
+	stats.totalFrameMs += frameMs;
+	stats.averageFrameMs = (float)(stats.totalFrameMs / stats.framesTimed);
+
+	// The trace's ticks, so GPU times line up with the CPU's scopes
+	double traceTicksPerTick = track ? Profiler::GetTicksPerSecond() / frequency : 0;
+	if (track)
+		Profiler::Record(track, "GPU frame", frame.cpuStart,
+			frame.cpuStart + (uint64_t)((ticks[frame.end] - ticks[0]) * traceTicksPerTick));
+
+	for (const Pass& pass : frame.passes)
+	{
+		if (pass.end < 0 || ticks[pass.end] < ticks[pass.begin])
+			continue;
+
+		float ms = (float)((ticks[pass.end] - ticks[pass.begin]) * msPerTick);
+		GpuPassTime* time = 0;
+		for (GpuPassTime& existing : passTimes)
+			if (existing.depth == pass.depth && strcmp(existing.name, pass.name) == 0)
+				time = &existing;
+		if (!time)
+		{
+			GpuPassTime added = {};
+			added.name = pass.name;
+			added.depth = pass.depth;
+			passTimes.push_back(added);
+			time = &passTimes.back();
+		}
+
+		time->frames++;
+		time->lastMs = ms;
+		time->totalMs += ms;
+		time->averageMs = (float)(time->totalMs / time->frames);
+		if (ms > time->maxMs)
+			time->maxMs = ms;
+
+		if (track)
+		{
+			uint64_t start = frame.cpuStart + (uint64_t)((ticks[pass.begin] - ticks[0]) * traceTicksPerTick);
+			Profiler::Record(track, pass.name, start, start + (uint64_t)((ticks[pass.end] - ticks[pass.begin]) * traceTicksPerTick));
+		}
+	}
+}
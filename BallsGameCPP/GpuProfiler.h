@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.h"
+
+// --------------------------------------------------------
+// GPU time per render pass.
+//
+//   gpuProfiler->BeginFrame();
+//   {
+//       GPU_SCOPE(gpuProfiler, "Shadow map 1");
+//       ...draw calls...
+//   }
+//   gpuProfiler->EndFrame();
+//
+// Each pass is bracketed by two GPU timestamps, and the whole
+// frame by a disjoint query that says whether the GPU's clock
+// held steady in between.  The GPU answers a frame or two after
+// it was drawn, so every frame has its own set of queries in a
+// ring of GPU_PROFILER_FRAMES, and BeginFrame collects whichever
+// older frames have finished.  Nothing ever waits on the GPU: if
+// the ring is still full of unanswered frames, this frame simply
+// isn't timed (it counts as dropped).
+//
+// Finished frames go to the per-pass stats below and onto a
+// "GPU" track in the CPU profiler's trace, lined up with the
+// start of the CPU frame that drew them - D3D11 can't say how
+// its clock relates to the CPU's, so the durations are right but
+// the track shows when a pass was issued, not when it ran.
+//
+// Where the timestamps come from is behind IGpuTimestamps, so
+// the ring and the bookkeeping run the same against D3D11 in the
+// game and against a fake clock in Tools/GpuProfilerSim.cpp.
+// --------------------------------------------------------
+
+// Frames that may be waiting on the GPU at once
+const int GPU_PROFILER_FRAMES = 4;
+
+// Passes timed per frame; any more aren't timed
+const int GPU_PROFILER_MAX_PASSES = 16;
+
+// A begin and end per pass, and the frame's own pair
+const int GPU_PROFILER_MAX_TIMESTAMPS = GPU_PROFILER_MAX_PASSES * 2 + 2;
+
+enum GpuTimestampStatus
+{
+	GPU_TIMESTAMPS_PENDING,		// Not done yet - ask again next frame
+	GPU_TIMESTAMPS_READY,
+	GPU_TIMESTAMPS_DISJOINT,	// Done, but the clock changed rate part way
+	GPU_TIMESTAMPS_UNAVAILABLE	// Never will be - no queries to ask
+};
+
+// Issues and reads back one frame's timestamp queries.  frame is
+// a slot in [0, GPU_PROFILER_FRAMES) and index a timestamp in
+// [0, GPU_PROFILER_MAX_TIMESTAMPS); a slot is only reused once
+// it has been read.
+class IGpuTimestamps
+{
+public:
+	virtual ~IGpuTimestamps() {}
+
+	virtual void BeginFrame(int frame) = 0;
+	virtual void Timestamp(int frame, int index) = 0;
+	virtual void EndFrame(int frame) = 0;
+
+	// Fills ticks with the frame's first count timestamps and
+	// frequency with their ticks a second, once they're READY
+	virtual GpuTimestampStatus Read(int frame, int count, uint64_t* ticks, uint64_t& frequency) = 0;
+};
+
+// Stands in where there's nothing to time - every frame is
+// UNAVAILABLE, so nothing is ever reported
+class NullGpuTimestamps : public IGpuTimestamps
+{
+public:
+	void BeginFrame(int) {}
+	void Timestamp(int, int) {}
+	void EndFrame(int) {}
+	GpuTimestampStatus Read(int, int, uint64_t*, uint64_t&) { return GPU_TIMESTAMPS_UNAVAILABLE; }
+};
+
+struct GpuPassTime
+{
+	const char* name;	// As given to BeginPass
+	int depth;			// Passes it's inside of
+	float lastMs;		// In the newest frame that had it
+	float averageMs;	// Over every frame that had it
+	float maxMs;
+	uint32_t frames;
+	double totalMs;
+};
+
+struct GpuProfilerStats
+{
+	uint32_t framesBegun;
+	uint32_t framesTimed;		// Read back and reported
+	uint32_t framesDropped;		// Not timed, the ring was full
+	uint32_t framesDisjoint;	// Read back but thrown away
+	uint32_t passesDropped;		// Over GPU_PROFILER_MAX_PASSES
+	uint32_t lastLatency;		// Frames between drawing and reading the newest timed one
+	float lastFrameMs;			// GPU time from BeginFrame to EndFrame
+	float averageFrameMs;
+	double totalFrameMs;
+};
+
+class GpuProfiler
+{
+public:
+	// Takes ownership of timestamps
+	explicit GpuProfiler(IGpuTimestamps* timestamps);
+	~GpuProfiler();
+
+	void BeginFrame();
+	void EndFrame();
+
+	// BeginFrame ends the last frame if EndFrame wasn't called.
+	// Passes may nest; every BeginPass needs an EndPass before
+	// EndFrame.  name must outlive the profiler - use literals.
+	void BeginPass(const char* name);
+	void EndPass();
+
+	// In the order each pass was first seen
+	const std::vector<GpuPassTime>& GetPassTimes() const { return passTimes; }
+	const GpuProfilerStats& GetStats() const { return stats; }
+	void ResetStats();
+
+private:
+	struct Pass
+	{
+		const char* name;
+		int depth;
+		int begin;		// Timestamp indices
+		int end;
+	};
+
+	struct Frame
+	{
+		bool pending;		// Issued and not yet read back
+		uint32_t number;
+		uint64_t cpuStart;	// Profiler::Now() at BeginFrame
+		int timestamps;		// Issued so far
+		int end;			// The frame's closing timestamp
+		std::vector<Pass> passes;
+	};
+
+	void Collect();
+	void Report(Frame& frame, const uint64_t* ticks, uint64_t frequency);
+
+	IGpuTimestamps* timestamps;
+	Frame frames[GPU_PROFILER_FRAMES];
+	Frame* current;		// Null between frames, or if this one isn't timed
+	int currentSlot;
+	uint32_t issued;		// Frames given queries, and of those read back
+	uint32_t collected;
+	std::vector<int> open;		// Indices into current->passes
+	bool unavailable;
+
+	std::vector<GpuPassTime> passTimes;
+	GpuProfilerStats stats;
+	ProfileRing* track;
+};
+
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler* profiler, const char* name) : profiler(profiler)
+	{
+		if (profiler)
+			profiler->BeginPass(name);
+	}
+
+	~GpuScope()
+	{
+		if (profiler)
+			profiler->EndPass();
+	}
+
+private:
+	GpuProfiler* profiler;
+};
+
+// Times the enclosing block on the GPU, and on the CPU alongside
+#define GPU_SCOPE(profiler, name) PROFILE_SCOPE(name); GpuScope PROFILE_CONCAT(gpuScope, __LINE__)(profiler, name)
@@ -0,0 +1,310 @@
+#include "HotReloader.h"
+#include "MappedDDSLoader.h"
+#include "WICTextureLoader.h"
+
+#include <cstdio>
+
+static bool FileExists(const std::string& file)
+{
+	FILE* f = 0;
+	if (fopen_s(&f, file.c_str(), "rb") != 0 || !f)
+		return false;
+	fclose(f);
+	return true;
+}
+
+// Asset paths are plain ASCII, so a straight widening is enough
+static std::wstring Widen(const std::string& s)
+{
+	return std::wstring(s.begin(), s.end());
+}
+
+static std::string Narrow(const std::wstring& s)
+{
+	std::string result;
+	for (size_t i = 0; i < s.size(); i++)
+		result += (char)s[i];
+	return result;
+}
+
+static double MillisecondsBetween(FileWatcher::Clock::time_point start, FileWatcher::Clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+HotReloader::HotReloader(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	this->device = device;
+	this->context = context;
+	hasPending = false;
+
+	watcher = new FileWatcher([this](const std::string& file, FileWatcher::Clock::time_point detected)
+	{
+		OnFileChanged(file, detected);
+	});
+}
+
+HotReloader::~HotReloader()
+{
+	// Stop the thread before anything it uses goes away
+	delete watcher;
+
+	// Anything loaded but never swapped in
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		delete pending[i].shader;
+		delete pending[i].mesh;
+		if (pending[i].texture) pending[i].texture->Release();
+	}
+
+	for (size_t i = 0; i < assets.size(); i++)
+		delete assets[i];
+}
+
+void HotReloader::WatchVertexShader(std::wstring file, SimpleVertexShader** shader)
+{
+	std::string path = Narrow(file);
+	Watch(ASSET_VERTEX_SHADER, FileExists("Debug/" + path) ? "Debug/" + path : path, shader);
+}
+
+void HotReloader::WatchPixelShader(std::wstring file, SimplePixelShader** shader)
+{
+	std::string path = Narrow(file);
+	Watch(ASSET_PIXEL_SHADER, FileExists("Debug/" + path) ? "Debug/" + path : path, shader);
+}
+
+void HotReloader::WatchComputeShader(std::wstring file, SimpleComputeShader** shader)
+{
+	std::string path = Narrow(file);
+	Watch(ASSET_COMPUTE_SHADER, FileExists("Debug/" + path) ? "Debug/" + path : path, shader);
+}
+
+void HotReloader::WatchTexture(std::wstring file, ID3D11ShaderResourceView** texture)
+{
+	Watch(ASSET_TEXTURE, Narrow(file), texture);
+}
+
+void HotReloader::WatchMesh(std::string file, Mesh* mesh)
+{
+	// Mesh falls back to the Debug folder if the path doesn't exist
+	Watch(ASSET_MESH, FileExists(file) ? file : "Debug/" + file, mesh);
+}
+
+void HotReloader::Watch(AssetType type, std::string path, void* target)
+{
+	WatchedAsset* asset = new WatchedAsset();
+	asset->type = type;
+	asset->path = path;
+	asset->vertexShader = (type == ASSET_VERTEX_SHADER) ? (SimpleVertexShader**)target : 0;
+	asset->pixelShader = (type == ASSET_PIXEL_SHADER) ? (SimplePixelShader**)target : 0;
+	asset->computeShader = (type == ASSET_COMPUTE_SHADER) ? (SimpleComputeShader**)target : 0;
+	asset->texture = (type == ASSET_TEXTURE) ? (ID3D11ShaderResourceView**)target : 0;
+	asset->mesh = (type == ASSET_MESH) ? (Mesh*)target : 0;
+	assets.push_back(asset);
+
+	watcher->AddFile(path);
+}
+
+void HotReloader::Start()
+{
+	watcher->Start();
+}
+
+// --------------------------------------------------------
+// Creates the new version of an asset.  Runs on the watcher
+// thread, so only the (thread safe) device is used here.
+//
+// Returns false if the file couldn't be loaded, in which case
+// the old version just stays in use
+// --------------------------------------------------------
+bool HotReloader::Load(WatchedAsset* asset, LoadedAsset& loaded)
+{
+	std::wstring widePath = Widen(asset->path);
+
+	switch (asset->type)
+	{
+	case ASSET_VERTEX_SHADER:
+	{
+		SimpleVertexShader* vs = new SimpleVertexShader(device, context);
+		if (!vs->LoadShaderFile(widePath.c_str()))
+		{
+			delete vs;
+			return false;
+		}
+		loaded.shader = vs;
+		return true;
+	}
+
+	case ASSET_PIXEL_SHADER:
+	{
+		SimplePixelShader* ps = new SimplePixelShader(device, context);
+		if (!ps->LoadShaderFile(widePath.c_str()))
+		{
+			delete ps;
+			return false;
+		}
+		loaded.shader = ps;
+		return true;
+	}
+
+	case ASSET_COMPUTE_SHADER:
+	{
+		SimpleComputeShader* cs = new SimpleComputeShader(device, context);
+		if (!cs->LoadShaderFile(widePath.c_str()))
+		{
+			delete cs;
+			return false;
+		}
+		loaded.shader = cs;
+		return true;
+	}
+
+	case ASSET_TEXTURE:
+	{
+		HRESULT hr;
+		size_t dot = asset->path.find_last_of('.');
+		if (dot != std::string::npos && _stricmp(asset->path.c_str() + dot, ".dds") == 0)
+		{
+			hr = CreateDDSTextureFromFileMapped(device, widePath.c_str(), 0, &loaded.texture);
+		}
+		else
+		{
+			// The context version generates mips but isn't thread safe, so
+			// a reloaded PNG/JPEG has a single level until the game restarts
+			hr = CreateWICTextureFromFile(device, widePath.c_str(), 0, &loaded.texture);
+		}
+		return SUCCEEDED(hr);
+	}
+
+	case ASSET_MESH:
+	{
+		Mesh* mesh = new Mesh(asset->path.c_str(), device);
+		if (!mesh->GetVertexBuffer())
+		{
+			delete mesh;
+			return false;
+		}
+		loaded.mesh = mesh;
+		return true;
+	}
+	}
+
+	return false;
+}
+
+void HotReloader::OnFileChanged(const std::string& file, FileWatcher::Clock::time_point detected)
+{
+	// WIC needs COM on whichever thread decodes the image
+	static thread_local bool comInitialized = SUCCEEDED(CoInitializeEx(0, COINIT_MULTITHREADED));
+	(void)comInitialized;
+
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (assets[i]->path != file)
+			continue;
+
+		LoadedAsset loaded = {};
+		loaded.asset = assets[i];
+		loaded.detected = detected;
+
+		FileWatcher::Clock::time_point start = FileWatcher::Clock::now();
+		if (!Load(assets[i], loaded))
+		{
+			printf("Hot reload: failed to load %s, keeping the old version\n", file.c_str());
+			continue;
+		}
+		loaded.loadMs = MillisecondsBetween(start, FileWatcher::Clock::now());
+
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		pending.push_back(loaded);
+		hasPending = true;
+	}
+}
+
+// --------------------------------------------------------
+// Swaps finished loads in.  Everything expensive already
+// happened on the watcher thread, so this is just pointer
+// updates and releasing the old versions.
+//
+// materials - Every material, so bindings to old resources
+//             can be pointed at the new ones
+// --------------------------------------------------------
+int HotReloader::ApplyPending(std::vector<Material*>& materials)
+{
+	if (!hasPending)
+		return 0;
+
+	std::vector<LoadedAsset> ready;
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		ready.swap(pending);
+		hasPending = false;
+	}
+
+	for (size_t i = 0; i < ready.size(); i++)
+	{
+		LoadedAsset& loaded = ready[i];
+		WatchedAsset* asset = loaded.asset;
+		FileWatcher::Clock::time_point start = FileWatcher::Clock::now();
+
+		switch (asset->type)
+		{
+		case ASSET_VERTEX_SHADER:
+		{
+			SimpleVertexShader* oldShader = *asset->vertexShader;
+			SimpleVertexShader* newShader = (SimpleVertexShader*)loaded.shader;
+			newShader->CopyVariablesFrom(oldShader);
+			for (size_t m = 0; m < materials.size(); m++)
+				materials[m]->ReplaceVertexShader(oldShader, newShader);
+			*asset->vertexShader = newShader;
+			delete oldShader;
+			break;
+		}
+
+		case ASSET_PIXEL_SHADER:
+		{
+			SimplePixelShader* oldShader = *asset->pixelShader;
+			SimplePixelShader* newShader = (SimplePixelShader*)loaded.shader;
+			newShader->CopyVariablesFrom(oldShader);
+			for (size_t m = 0; m < materials.size(); m++)
+				materials[m]->ReplacePixelShader(oldShader, newShader);
+			*asset->pixelShader = newShader;
+			delete oldShader;
+			break;
+		}
+
+		case ASSET_COMPUTE_SHADER:
+		{
+			// No material uses these
+			SimpleComputeShader* oldShader = *asset->computeShader;
+			SimpleComputeShader* newShader = (SimpleComputeShader*)loaded.shader;
+			newShader->CopyVariablesFrom(oldShader);
+			*asset->computeShader = newShader;
+			delete oldShader;
+			break;
+		}
+
+		case ASSET_TEXTURE:
+		{
+			ID3D11ShaderResourceView* oldTexture = *asset->texture;
+			for (size_t m = 0; m < materials.size(); m++)
+				materials[m]->ReplaceTexture(oldTexture, loaded.texture);
+			*asset->texture = loaded.texture;
+			if (oldTexture) oldTexture->Release();
+			break;
+		}
+
+		case ASSET_MESH:
+			// Entities point at the Mesh object, so keep it and take the new buffers
+			asset->mesh->SwapBuffers(loaded.mesh);
+			delete loaded.mesh;
+			break;
+		}
+
+		FileWatcher::Clock::time_point end = FileWatcher::Clock::now();
+		printf("Hot reload: %s live %.1f ms after the change (load %.1f ms off-thread, swap %.3f ms)\n",
+			asset->path.c_str(), MillisecondsBetween(loaded.detected, end), loaded.loadMs, MillisecondsBetween(start, end));
+	}
+
+	return (int)ready.size();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <d3d11.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FileWatcher.h"
+#include "SimpleShader.h"
+#include "Material.h"
+#include "Mesh.h"
+
+// --------------------------------------------------------
+// Reloads shaders, textures and meshes when their files change.
+//
+// A FileWatcher thread notices the change and builds the new
+// resource right there - the D3D11 device is free threaded, so
+// reading the file, creating the shader (and its reflection
+// tables), texture or buffers never touches the frame.  The main
+// thread then calls ApplyPending() once per frame, which only
+// swaps pointers: the owner's slot, every material using the old
+// resource, and constant buffer values carried over by name.
+//
+// Register everything before calling Start().
+// --------------------------------------------------------
+class HotReloader
+{
+public:
+	HotReloader(ID3D11Device* device, ID3D11DeviceContext* context);
+	~HotReloader();
+
+	// Shaders are looked for in Debug/ first, same as Game::LoadShaders
+	void WatchVertexShader(std::wstring file, SimpleVertexShader** shader);
+	void WatchPixelShader(std::wstring file, SimplePixelShader** shader);
+	void WatchComputeShader(std::wstring file, SimpleComputeShader** shader);
+	void WatchTexture(std::wstring file, ID3D11ShaderResourceView** texture);
+	void WatchMesh(std::string file, Mesh* mesh);
+
+	void Start();
+
+	// Call on the main thread, between frames.  Returns how many assets were swapped
+	int ApplyPending(std::vector<Material*>& materials);
+
+private:
+	enum AssetType
+	{
+		ASSET_VERTEX_SHADER,
+		ASSET_PIXEL_SHADER,
+		ASSET_COMPUTE_SHADER,
+		ASSET_TEXTURE,
+		ASSET_MESH
+	};
+
+	struct WatchedAsset
+	{
+		AssetType type;
+		std::string path;
+		SimpleVertexShader** vertexShader;
+		SimplePixelShader** pixelShader;
+		SimpleComputeShader** computeShader;
+		ID3D11ShaderResourceView** texture;
+		Mesh* mesh;
+	};
+
+	// A finished load waiting for the main thread to swap it in
+	struct LoadedAsset
+	{
+		WatchedAsset* asset;
+		ISimpleShader* shader;
+		ID3D11ShaderResourceView* texture;
+		Mesh* mesh;
+		FileWatcher::Clock::time_point detected;
+		double loadMs;
+	};
+
+	void Watch(AssetType type, std::string path, void* target);
+	void OnFileChanged(const std::string& file, FileWatcher::Clock::time_point detected);
+	bool Load(WatchedAsset* asset, LoadedAsset& loaded);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	FileWatcher* watcher;
+	std::vector<WatchedAsset*> assets;
+
+	std::mutex pendingMutex;
+	std::vector<LoadedAsset> pending;
+	std::atomic<bool> hasPending;
+};
@@ -0,0 +1,86 @@
+#include "HudFont.h"
+
+#include <vector>
+
+using namespace DirectX;
+
+static HudGlyph CopyGlyph(const SpriteFont::Glyph* glyph)
+{
+	HudGlyph copy;
+	copy.character = glyph->Character;
+	copy.left = glyph->Subrect.left;
+	copy.top = glyph->Subrect.top;
+	copy.right = glyph->Subrect.right;
+	copy.bottom = glyph->Subrect.bottom;
+	copy.xOffset = glyph->XOffset;
+	copy.yOffset = glyph->YOffset;
+	copy.xAdvance = glyph->XAdvance;
+	return copy;
+}
+
+// RGBA8 with red in the low byte, as SpriteVertex has it
+static uint32_t PackColor(FXMVECTOR color)
+{
+	XMFLOAT4 c;
+	XMStoreFloat4(&c, XMVectorSaturate(color));
+	return (uint32_t)(c.x * 255 + 0.5f) | (uint32_t)(c.y * 255 + 0.5f) << 8 |
+		(uint32_t)(c.z * 255 + 0.5f) << 16 | (uint32_t)(c.w * 255 + 0.5f) << 24;
+}
+
+HudFont::HudFont(SpriteFont* font, SpriteRenderer* renderer)
+{
+	font->GetSpriteSheet(&texture);
+	textureId = renderer->AddTexture(texture);
+
+	inverseWidth = 1;
+	inverseHeight = 1;
+	ID3D11Resource* resource = 0;
+	texture->GetResource(&resource);
+	ID3D11Texture2D* sheet = 0;
+	if (resource && SUCCEEDED(resource->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&sheet)))
+	{
+		D3D11_TEXTURE2D_DESC desc;
+		sheet->GetDesc(&desc);
+		inverseWidth = 1.0f / desc.Width;
+		inverseHeight = 1.0f / desc.Height;
+		sheet->Release();
+	}
+	if (resource) resource->Release();
+
+	// In character order, which the table needs
+	std::vector<HudGlyph> found;
+	wchar_t defaultCharacter = font->GetDefaultCharacter();
+	for (wchar_t c = 0; c < HUD_ASCII_GLYPHS; c++)
+		if (font->ContainsCharacter(c))
+			found.push_back(CopyGlyph(font->FindGlyph(c)));
+
+	// A default outside ASCII goes on the end, still in order
+	if (defaultCharacter >= HUD_ASCII_GLYPHS && font->ContainsCharacter(defaultCharacter))
+		found.push_back(CopyGlyph(font->FindGlyph(defaultCharacter)));
+
+	glyphs.Set(found.empty() ? 0 : &found[0], found.size(), font->GetLineSpacing(), defaultCharacter);
+}
+
+HudFont::~HudFont()
+{
+	if (texture) texture->Release();
+}
+
+void HudFont::Draw(SpriteQueue& queue, const HudTextRun& run, const XMFLOAT2& position,
+	FXMVECTOR color, bool centred, float scale) const
+{
+	float originX = centred ? run.GetWidth() / 2 : 0;
+	float originY = centred ? run.GetHeight() / 2 : 0;
+	uint32_t packed = PackColor(color);
+
+	const HudPlacedGlyph* placed = run.GetGlyphs();
+	for (size_t i = 0; i < run.GetGlyphCount(); i++)
+	{
+		const HudGlyph* glyph = placed[i].glyph;
+		queue.Add(textureId,
+			position.x + (placed[i].x - originX) * scale, position.y + (placed[i].y - originY) * scale,
+			(glyph->right - glyph->left) * scale, (glyph->bottom - glyph->top) * scale,
+			glyph->left * inverseWidth, glyph->top * inverseHeight,
+			glyph->right * inverseWidth, glyph->bottom * inverseHeight, packed);
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <d3d11.h>
+#include "SpriteFont.h"
+#include "HudText.h"
+#include "SpriteRenderer.h"
+
+// --------------------------------------------------------
+// Draws HudTextRuns with a SpriteFont's sprite sheet.
+//
+// The font's ASCII glyphs (and its default character) are
+// looked up once, here, into a HudGlyphTable; after that a
+// run is drawn straight from the glyphs it placed, one
+// SpriteQueue::Add each, with no lookups or allocations.  The
+// sprite sheet is registered with a SpriteRenderer up front,
+// which then draws the queue.
+// --------------------------------------------------------
+class HudFont
+{
+public:
+	// font must outlive this
+	HudFont(DirectX::SpriteFont* font, SpriteRenderer* renderer);
+	~HudFont();
+
+	const HudGlyphTable& GetGlyphs() const { return glyphs; }
+
+	// Draws run with its middle at position, as the HUD centres
+	// its text, or its top left there if centred is false
+	void Draw(SpriteQueue& queue, const HudTextRun& run, const DirectX::XMFLOAT2& position,
+		DirectX::FXMVECTOR color, bool centred, float scale = 1) const;
+
+private:
+	ID3D11ShaderResourceView* texture;
+	uint16_t textureId;
+	float inverseWidth;		// Of the sprite sheet, for texture coordinates
+	float inverseHeight;
+	HudGlyphTable glyphs;
+};
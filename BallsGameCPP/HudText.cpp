@@ -0,0 +1,159 @@
+#include "HudText.h"
+
+#include <algorithm>
+#include <cctype>
+
+HudGlyphTable::HudGlyphTable()
+{
+	for (int i = 0; i < HUD_ASCII_GLYPHS; i++)
+		ascii[i] = -1;
+	defaultGlyph = 0;
+	lineSpacing = 0;
+}
+
+void HudGlyphTable::Set(const HudGlyph* glyphs, size_t count, float lineSpacing, uint32_t defaultCharacter)
+{
+	this->glyphs.assign(glyphs, glyphs + count);
+	this->lineSpacing = lineSpacing;
+
+	for (int i = 0; i < HUD_ASCII_GLYPHS; i++)
+		ascii[i] = -1;
+	for (size_t i = 0; i < this->glyphs.size(); i++)
+		if (this->glyphs[i].character < HUD_ASCII_GLYPHS)
+			ascii[this->glyphs[i].character] = (int16_t)i;
+
+	defaultGlyph = 0;
+	defaultGlyph = FindSlow(defaultCharacter);
+}
+
+// Binary search, as SpriteFont does for everything
+const HudGlyph* HudGlyphTable::FindSlow(uint32_t character) const
+{
+	std::vector<HudGlyph>::const_iterator glyph = std::lower_bound(glyphs.begin(), glyphs.end(), character,
+		[](const HudGlyph& glyph, uint32_t character) { return glyph.character < character; });
+	if (glyph != glyphs.end() && glyph->character == character)
+		return &*glyph;
+	return defaultGlyph;
+}
+
+HudTextRun::HudTextRun(size_t capacity)
+{
+	text.assign(capacity + 1, 0);
+	placed.resize(capacity);
+	placedCount = 0;
+	laidOutWith = 0;
+	width = 0;
+	height = 0;
+	layouts = 0;
+}
+
+bool HudTextRun::Set(const HudGlyphTable& table, const char* newText)
+{
+	// Compares and copies in one pass, so an unchanged string is
+	// a single walk over it
+	size_t capacity = text.size() - 1;
+	bool changed = laidOutWith != &table;
+	size_t i = 0;
+	for (; i < capacity && newText[i]; i++)
+	{
+		if (text[i] != newText[i])
+		{
+			text[i] = newText[i];
+			changed = true;
+		}
+	}
+	if (text[i] != 0)
+	{
+		text[i] = 0;
+		changed = true;
+	}
+
+	if (!changed)
+		return false;
+	Layout(table);
+	laidOutWith = &table;
+	return true;
+}
+
+// SpriteFont's layout and measuring, done once
+void HudTextRun::Layout(const HudGlyphTable& table)
+{
+	float x = 0, y = 0;
+	placedCount = 0;
+	width = 0;
+	height = 0;
+	layouts++;
+
+	for (const char* c = &text[0]; *c; c++)
+	{
+		unsigned char character = (unsigned char)*c;
+		if (character == '\r')
+			continue;
+		if (character == '\n')
+		{
+			x = 0;
+			y += table.GetLineSpacing();
+			continue;
+		}
+
+		const HudGlyph* glyph = table.Find(character);
+		if (!glyph)
+			continue;
+
+		x += glyph->xOffset;
+		if (x < 0)
+			x = 0;
+
+		float w = (float)(glyph->right - glyph->left);
+		float h = (float)(glyph->bottom - glyph->top);
+		if (!isspace(character) || w > 1 || h > 1)
+		{
+			HudPlacedGlyph& place = placed[placedCount++];
+			place.glyph = glyph;
+			place.x = x;
+			place.y = y + glyph->yOffset;
+
+			width = std::max(width, x + w);
+			height = std::max(height, y + std::max(h + glyph->yOffset, table.GetLineSpacing()));
+		}
+
+		x += w + glyph->xAdvance;
+	}
+}
+
+HudStringBuilder::HudStringBuilder(char* buffer, size_t size) : buffer(buffer), size(size)
+{
+	length = 0;
+	if (size > 0)
+		buffer[0] = 0;
+}
+
+HudStringBuilder& HudStringBuilder::Append(const char* text)
+{
+	while (*text && length + 1 < size)
+		buffer[length++] = *text++;
+	if (size > 0)
+		buffer[length] = 0;
+	return *this;
+}
+
+HudStringBuilder& HudStringBuilder::Append(int value)
+{
+	// Digits come out backwards, so build them in a scratch buffer
+	char digits[12];
+	int count = 0;
+	uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+	do
+	{
+		digits[count++] = (char)('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0)
+		digits[count++] = '-';
+
+	char forwards[12];
+	for (int i = 0; i < count; i++)
+		forwards[i] = digits[count - 1 - i];
+	forwards[count] = 0;
+	return Append(forwards);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// HUD text that's laid out once and drawn many times.
+//
+// SpriteFont::DrawString lays its string out again on every
+// call, with a binary search through the font per character,
+// and the HUD's strings used to be rebuilt with to_string and
+// widened into a wstring first - several allocations a frame
+// for text that changes when someone scores.
+//
+// Here the text is formatted into a stack buffer with
+// HudStringBuilder, and a HudTextRun only lays it out again
+// when it differs from the last call; otherwise drawing is a
+// walk over the glyphs it already placed.  Glyphs come from a
+// HudGlyphTable, which indexes ASCII directly.  Nothing here
+// allocates after construction.
+//
+// This part has no D3D in it; HudFont fills the table from a
+// SpriteFont and draws runs into a SpriteQueue.
+// --------------------------------------------------------
+
+// One character's place on the font's sprite sheet, as
+// SpriteFont::Glyph has it
+struct HudGlyph
+{
+	uint32_t character;
+	int32_t left, top, right, bottom;	// Sub-rectangle of the sheet
+	float xOffset;
+	float yOffset;
+	float xAdvance;
+};
+
+const int HUD_ASCII_GLYPHS = 128;
+
+class HudGlyphTable
+{
+public:
+	HudGlyphTable();
+
+	// glyphs in ascending character order.  Characters the font
+	// lacks draw as defaultCharacter, or not at all if it has
+	// none either.
+	void Set(const HudGlyph* glyphs, size_t count, float lineSpacing, uint32_t defaultCharacter);
+
+	// Null if neither the character nor a default is in the font
+	const HudGlyph* Find(uint32_t character) const
+	{
+		if (character < HUD_ASCII_GLYPHS)
+			return ascii[character] < 0 ? defaultGlyph : &glyphs[ascii[character]];
+		return FindSlow(character);
+	}
+
+	float GetLineSpacing() const { return lineSpacing; }
+
+private:
+	const HudGlyph* FindSlow(uint32_t character) const;
+
+	std::vector<HudGlyph> glyphs;
+	int16_t ascii[HUD_ASCII_GLYPHS];	// Index into glyphs, or -1
+	const HudGlyph* defaultGlyph;
+	float lineSpacing;
+};
+
+struct HudPlacedGlyph
+{
+	const HudGlyph* glyph;
+	float x, y;				// Top left, from the run's top left
+};
+
+class HudTextRun
+{
+public:
+	// capacity - Most characters the run holds; longer text is cut off
+	explicit HudTextRun(size_t capacity = 64);
+
+	// Lays text out with table if it isn't what the run already
+	// holds; true if it did.  table must outlive the run.
+	bool Set(const HudGlyphTable& table, const char* text);
+
+	const HudPlacedGlyph* GetGlyphs() const { return placed.empty() ? 0 : &placed[0]; }
+	size_t GetGlyphCount() const { return placedCount; }
+	const char* GetText() const { return &text[0]; }
+
+	// As SpriteFont::MeasureString would say
+	float GetWidth() const { return width; }
+	float GetHeight() const { return height; }
+
+	// Times Set actually laid text out
+	uint32_t GetLayoutCount() const { return layouts; }
+
+private:
+	void Layout(const HudGlyphTable& table);
+
+	std::vector<char> text;
+	std::vector<HudPlacedGlyph> placed;
+	size_t placedCount;
+	const HudGlyphTable* laidOutWith;
+	float width;
+	float height;
+	uint32_t layouts;
+};
+
+// Builds a string in a buffer the caller owns, usually on the
+// stack, cutting off anything that doesn't fit:
+//
+//   char text[64];
+//   HudStringBuilder(text, sizeof(text)).Append("Score: ").Append(score);
+class HudStringBuilder
+{
+public:
+	HudStringBuilder(char* buffer, size_t size);
+
+	HudStringBuilder& Append(const char* text);
+	HudStringBuilder& Append(int value);
+
+	const char* Get() const { return buffer; }
+	size_t GetLength() const { return length; }
+
+private:
+	char* buffer;
+	size_t size;
+	size_t length;
+};
@@ -0,0 +1,40 @@
+#include "InputQueue.h"
+
+#include <algorithm>
+
+void InputSchedule::Drain(InputQueue& queue)
+{
+	InputEvent event;
+	while (queue.Pop(event))
+		Add(event);
+}
+
+static bool Earlier(const InputEvent& a, const InputEvent& b)
+{
+	return a.timeNs < b.timeNs;
+}
+
+// Almost always goes on the end; anything else is put in its place
+void InputSchedule::Add(const InputEvent& event)
+{
+	if (held.empty() || held.back().timeNs <= event.timeNs)
+		held.push_back(event);
+	else
+		held.insert(std::upper_bound(held.begin(), held.end(), event, Earlier), event);
+}
+
+uint8_t InputSchedule::Take(int64_t timeNs, std::vector<InputEvent>* taken)
+{
+	size_t count = 0;
+	uint8_t buttons = 0;
+	while (count < held.size() && held[count].timeNs <= timeNs)
+	{
+		buttons |= held[count].buttons;
+		if (taken)
+			taken->push_back(held[count]);
+		count++;
+	}
+
+	held.erase(held.begin(), held.begin() + count);
+	return buttons;
+}
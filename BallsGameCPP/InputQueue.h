@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SpscQueue.h"
+
+// --------------------------------------------------------
+// Key presses with the time they happened, on their way from
+// the input thread to the match.
+//
+// InputQueue is an SpscQueue: the input thread pushes, the
+// main thread pops, and neither ever waits on the other.  A
+// full queue drops the press and counts it rather than
+// blocking input.
+//
+// InputSchedule holds what's been popped until the match gets
+// to it.  Each fixed step takes the presses made up to the end
+// of its slice of real time, so a press lands on the step it
+// happened in rather than on the next frame's first step, and
+// presses after the frame's last step wait for the next frame.
+//
+// Times come from std::chrono's steady_clock rather than
+// QueryPerformanceCounter, so the Linux tools run this as is.
+// --------------------------------------------------------
+
+typedef std::chrono::steady_clock InputClock;
+
+// Nanoseconds on InputClock
+inline int64_t InputNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(InputClock::now().time_since_epoch()).count();
+}
+
+struct InputEvent
+{
+	int64_t timeNs;		// InputNow() when it happened
+	uint8_t buttons;	// MatchButtons pressed
+};
+
+// Most presses the queue holds; a frame has far fewer
+const size_t INPUT_QUEUE_CAPACITY = 256;
+
+typedef SpscQueue<InputEvent, INPUT_QUEUE_CAPACITY> InputQueue;
+
+class InputSchedule
+{
+public:
+	// Everything the queue has, in the order it was pressed
+	void Drain(InputQueue& queue);
+
+	// A press seen some other way (polling)
+	void Add(const InputEvent& event);
+
+	// The buttons of every press up to and including timeNs,
+	// which are then forgotten.  taken, if given, gets each of
+	// them for latency figures.
+	uint8_t Take(int64_t timeNs, std::vector<InputEvent>* taken = 0);
+
+	void Clear() { held.clear(); }
+	size_t GetHeldCount() const { return held.size(); }
+
+private:
+	std::vector<InputEvent> held;
+};
@@ -0,0 +1,212 @@
+#include "InputSource.h"
+
+#include <cstdio>
+
+ReplayInputSource::ReplayInputSource() : step(0), nextEvent(0), divergedStep(-1)
+{
+}
+
+bool ReplayInputSource::Load(const char* fileName, std::string* error)
+{
+	step = 0;
+	nextEvent = 0;
+	divergedStep = -1;
+	return replay.Load(fileName, error);
+}
+
+bool ReplayInputSource::Parse(const uint8_t* data, size_t size, std::string* error)
+{
+	step = 0;
+	nextEvent = 0;
+	divergedStep = -1;
+	return replay.Parse(data, size, error);
+}
+
+// As PlayReplay: events only exist for steps with buttons down
+uint8_t ReplayInputSource::TakeStep(Match& /*match*/, int64_t stepEndNs, std::vector<InputEvent>* presses)
+{
+	if (IsFinished())
+		return 0;
+
+	const std::vector<ReplayEvent>& events = replay.GetEvents();
+	if (nextEvent >= events.size() || events[nextEvent].step != step)
+		return 0;
+
+	uint8_t buttons = events[nextEvent++].buttons;
+	if (presses)
+	{
+		InputEvent press;
+		press.timeNs = stepEndNs;
+		press.buttons = buttons;
+		presses->push_back(press);
+	}
+	return buttons;
+}
+
+void ReplayInputSource::EndStep(Match& match)
+{
+	if (IsFinished())
+		return;
+
+	if (match.Hash() != replay.GetHash(step))
+		divergedStep = (int)step;
+	step++;
+}
+
+bool ReplayInputSource::GetSeed(uint64_t& seed) const
+{
+	seed = replay.GetSeed();
+	return true;
+}
+
+std::string ReplayInputSource::GetSummary() const
+{
+	char line[128];
+	if (divergedStep >= 0)
+		snprintf(line, sizeof(line), "replay DIVERGED at step %d of %u", divergedStep, replay.GetStepCount());
+	else
+		snprintf(line, sizeof(line), "replay %u of %u steps, all match", step, replay.GetStepCount());
+	return line;
+}
+
+// Seeded as SelfPlay seeds its bots
+BotInputSource::BotInputSource(const BotPolicy* p1, const BotPolicy* p2, uint64_t seed)
+{
+	bots[0] = p1 ? new MatchBot(1, *p1, seed ^ 0x632BE59BD9B4E019ULL) : 0;
+	bots[1] = p2 ? new MatchBot(2, *p2, seed ^ 0x85157AF5ADE4A8E3ULL) : 0;
+	policies[0] = p1 ? *p1 : BotPolicy();
+	policies[1] = p2 ? *p2 : BotPolicy();
+}
+
+BotInputSource::~BotInputSource()
+{
+	delete bots[0];
+	delete bots[1];
+}
+
+// A bot's buttons are pressed at the end of the slice they're
+// for, which is as early as the match could have seen them
+uint8_t BotInputSource::TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses)
+{
+	uint8_t buttons = 0;
+	if (bots[0])
+		buttons |= bots[0]->Think(match);
+	if (bots[1])
+		buttons |= bots[1]->Think(match) << 3;
+
+	if (buttons && presses)
+	{
+		InputEvent press;
+		press.timeNs = stepEndNs;
+		press.buttons = buttons;
+		presses->push_back(press);
+	}
+	return buttons;
+}
+
+std::string BotInputSource::GetSummary() const
+{
+	std::string line = "bots";
+	for (int i = 0; i < 2; i++)
+	{
+		line += i == 0 ? " " : " vs ";
+		if (bots[i])
+			line = line + GetBotRowPolicyName(policies[i].row) + "/" + GetBotFirePolicyName(policies[i].fire);
+		else
+			line += "nobody";
+	}
+	return line;
+}
+
+CombinedInputSource::CombinedInputSource()
+{
+}
+
+CombinedInputSource::~CombinedInputSource()
+{
+	for (size_t i = 0; i < sources.size(); i++)
+		delete sources[i];
+}
+
+void CombinedInputSource::Add(InputSource* source)
+{
+	sources.push_back(source);
+	name = sources.size() == 1 ? source->GetName() : name + "+" + source->GetName();
+}
+
+void CombinedInputSource::BeginFrame(int64_t frameNs)
+{
+	for (size_t i = 0; i < sources.size(); i++)
+		sources[i]->BeginFrame(frameNs);
+}
+
+uint8_t CombinedInputSource::TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses)
+{
+	uint8_t buttons = 0;
+	for (size_t i = 0; i < sources.size(); i++)
+		buttons |= sources[i]->TakeStep(match, stepEndNs, presses);
+	return buttons;
+}
+
+void CombinedInputSource::EndStep(Match& match)
+{
+	for (size_t i = 0; i < sources.size(); i++)
+		sources[i]->EndStep(match);
+}
+
+void CombinedInputSource::Clear()
+{
+	for (size_t i = 0; i < sources.size(); i++)
+		sources[i]->Clear();
+}
+
+// Only if nobody needs to be there for any of them
+bool CombinedInputSource::IsUnattended() const
+{
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		if (!sources[i]->IsUnattended())
+			return false;
+	}
+	return !sources.empty();
+}
+
+bool CombinedInputSource::IsFinished() const
+{
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		if (sources[i]->IsFinished())
+			return true;
+	}
+	return false;
+}
+
+bool CombinedInputSource::GetSeed(uint64_t& seed) const
+{
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		if (sources[i]->GetSeed(seed))
+			return true;
+	}
+	return false;
+}
+
+uint32_t CombinedInputSource::GetDropped() const
+{
+	uint32_t dropped = 0;
+	for (size_t i = 0; i < sources.size(); i++)
+		dropped += sources[i]->GetDropped();
+	return dropped;
+}
+
+std::string CombinedInputSource::GetSummary() const
+{
+	std::string summary;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		std::string line = sources[i]->GetSummary();
+		if (!line.empty())
+			summary += summary.empty() ? line : ", " + line;
+	}
+	return summary;
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "InputQueue.h"
+#include "Match.h"
+#include "Replay.h"
+#include "SelfPlay.h"
+
+// --------------------------------------------------------
+// Where a match's buttons come from.
+//
+// Game asks its source for each fixed step's MatchButtons -
+// the abstract actions P1 up, P1 fire and so on - and never
+// looks at a key or a pad itself.  Devices (KeyboardInputSource,
+// GamePadInputSource) hand over timestamped presses through an
+// InputSchedule; the sources here need no device at all, so a
+// benchmark or soak run plays itself, and the Linux tools drive
+// matches with exactly the code the game uses.
+//
+// A source is used from the main thread only.  Per frame:
+// BeginFrame once, then for each step TakeStep before it and
+// EndStep after it.
+// --------------------------------------------------------
+class InputSource
+{
+public:
+	virtual ~InputSource() {}
+
+	virtual const char* GetName() const = 0;
+
+	// Once a frame, before any of its steps
+	virtual void BeginFrame(int64_t /*frameNs*/) {}
+
+	// Buttons for match's next step, whose slice of real time
+	// ends at stepEndNs.  presses, if given, gets each press
+	// that went in with when it happened, for latency figures.
+	virtual uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses) = 0;
+
+	// Sees the match after the step TakeStep's buttons went into
+	virtual void EndStep(Match& /*match*/) {}
+
+	// Forgets anything pending - outside a match presses
+	// shouldn't carry over into the next one
+	virtual void Clear() {}
+
+	// Plays with nobody at the controls, so the game starts and
+	// restarts matches by itself
+	virtual bool IsUnattended() const { return false; }
+
+	// Has nothing more to play; the game quits
+	virtual bool IsFinished() const { return false; }
+
+	// The seed the next match has to start from, if it matters
+	virtual bool GetSeed(uint64_t& /*seed*/) const { return false; }
+
+	// Presses lost on the way in
+	virtual uint32_t GetDropped() const { return 0; }
+
+	// A line for the console at the end of a match, or empty
+	virtual std::string GetSummary() const { return std::string(); }
+};
+
+// --------------------------------------------------------
+// Plays a recorded match's inputs back step for step, and
+// checks every step's state against the recording as it goes.
+// Timing plays no part - step N gets step N's buttons however
+// the frames fall - so a replay drives the whole game through
+// the same match every run, which is what a benchmark wants.
+// --------------------------------------------------------
+class ReplayInputSource : public InputSource
+{
+public:
+	ReplayInputSource();
+
+	bool Load(const char* fileName, std::string* error = 0);
+	bool Parse(const uint8_t* data, size_t size, std::string* error = 0);
+
+	const char* GetName() const { return "replay"; }
+	uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses);
+	void EndStep(Match& match);
+	bool IsUnattended() const { return true; }
+	bool IsFinished() const { return step >= replay.GetStepCount() || divergedStep >= 0; }
+	bool GetSeed(uint64_t& seed) const;
+	std::string GetSummary() const;
+
+	// First step whose state didn't match the recording, -1 if none
+	int GetDivergedStep() const { return divergedStep; }
+	uint32_t GetStepsPlayed() const { return step; }
+
+private:
+	ReplayReader replay;
+	uint32_t step;
+	size_t nextEvent;
+	int divergedStep;
+};
+
+// --------------------------------------------------------
+// Scripted bots at the controls.  Either player left without
+// a policy gets no buttons from here, so a bot on one side can
+// be combined with a person on the other.
+// --------------------------------------------------------
+class BotInputSource : public InputSource
+{
+public:
+	// Null for a player nobody scripts
+	BotInputSource(const BotPolicy* p1, const BotPolicy* p2, uint64_t seed);
+	~BotInputSource();
+
+	const char* GetName() const { return "bots"; }
+	uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses);
+	bool IsUnattended() const { return bots[0] && bots[1]; }
+	std::string GetSummary() const;
+
+private:
+	BotInputSource(const BotInputSource&);
+	BotInputSource& operator=(const BotInputSource&);
+
+	MatchBot* bots[2];
+	BotPolicy policies[2];
+};
+
+// --------------------------------------------------------
+// Several sources at once, their buttons ORed together -
+// keyboard and pads, or a person against a bot.  Owns them.
+// --------------------------------------------------------
+class CombinedInputSource : public InputSource
+{
+public:
+	CombinedInputSource();
+	~CombinedInputSource();
+
+	void Add(InputSource* source);
+
+	const char* GetName() const { return name.c_str(); }
+	void BeginFrame(int64_t frameNs);
+	uint8_t TakeStep(Match& match, int64_t stepEndNs, std::vector<InputEvent>* presses);
+	void EndStep(Match& match);
+	void Clear();
+	bool IsUnattended() const;
+	bool IsFinished() const;
+	bool GetSeed(uint64_t& seed) const;
+	uint32_t GetDropped() const;
+	std::string GetSummary() const;
+
+private:
+	CombinedInputSource(const CombinedInputSource&);
+	CombinedInputSource& operator=(const CombinedInputSource&);
+
+	std::vector<InputSource*> sources;
+	std::string name;
+};
@@ -0,0 +1,170 @@
+#include "JobPool.h"
+
+JobPool::JobPool(int threadCount)
+	: stolen(0)
+{
+	if (threadCount <= 0)
+		threadCount = (int)std::thread::hardware_concurrency();
+	if (threadCount <= 0)
+		threadCount = 1;
+
+	job = 0;
+	batch = 0;
+	busyWorkers = 0;
+	quitting = false;
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		Shard* shard = new Shard();
+		shard->begin = 0;
+		shard->end = 0;
+		shards.push_back(shard);
+	}
+
+	// Worker 0 is whoever calls Run
+	for (int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(&JobPool::WorkerLoop, this, i));
+}
+
+JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(wakeLock);
+		quitting = true;
+	}
+	wake.notify_all();
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto shard : shards)
+		delete shard;
+}
+
+void JobPool::Run(int jobCount, const std::function<void(int, int)>& job)
+{
+	if (jobCount <= 0)
+		return;
+
+	// Hand each worker an even, contiguous share
+	int workers = (int)shards.size();
+	for (int i = 0; i < workers; i++)
+	{
+		std::lock_guard<std::mutex> guard(shards[i]->lock);
+		shards[i]->begin = (int)((int64_t)jobCount * i / workers);
+		shards[i]->end = (int)((int64_t)jobCount * (i + 1) / workers);
+	}
+	this->job = &job;
+
+	if (!threads.empty())
+	{
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			busyWorkers = (int)threads.size();
+			batch++;
+		}
+		wake.notify_all();
+	}
+
+	Work(0);
+
+	if (!threads.empty())
+	{
+		std::unique_lock<std::mutex> guard(wakeLock);
+		finished.wait(guard, [this] { return busyWorkers == 0; });
+	}
+	this->job = 0;
+}
+
+void JobPool::WorkerLoop(int worker)
+{
+	uint32_t seenBatch = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(wakeLock);
+			wake.wait(guard, [&] { return quitting || batch != seenBatch; });
+			if (quitting)
+				return;
+			seenBatch = batch;
+		}
+
+		Work(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> guard(wakeLock);
+			last = --busyWorkers == 0;
+		}
+		if (last)
+			finished.notify_one();
+	}
+}
+
+void JobPool::Work(int worker)
+{
+	int index;
+	while (true)
+	{
+		if (Take(worker, index))
+			(*job)(index, worker);
+		else if (!Steal(worker))
+			return;
+	}
+}
+
+bool JobPool::Take(int worker, int& index)
+{
+	Shard* shard = shards[worker];
+	std::lock_guard<std::mutex> guard(shard->lock);
+	if (shard->begin >= shard->end)
+		return false;
+	index = shard->begin++;
+	return true;
+}
+
+// Takes the back half of the fullest shard; false once there's
+// nothing left anywhere
+bool JobPool::Steal(int worker)
+{
+	int workers = (int)shards.size();
+	while (true)
+	{
+		// Pick a victim; it may have moved on by the time we take from it
+		int victim = -1, most = 0;
+		for (int i = 1; i < workers; i++)
+		{
+			Shard* shard = shards[(worker + i) % workers];
+			int left;
+			{
+				std::lock_guard<std::mutex> guard(shard->lock);
+				left = shard->end - shard->begin;
+			}
+			if (left > most)
+			{
+				most = left;
+				victim = (worker + i) % workers;
+			}
+		}
+		if (victim < 0)
+			return false;
+
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> guard(shards[victim]->lock);
+			int left = shards[victim]->end - shards[victim]->begin;
+			if (left <= 0)
+				continue;
+			end = shards[victim]->end;
+			begin = end - (left + 1) / 2;
+			shards[victim]->end = begin;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(shards[worker]->lock);
+			shards[worker]->begin = begin;
+			shards[worker]->end = end;
+		}
+		stolen += end - begin;
+		return true;
+	}
+}
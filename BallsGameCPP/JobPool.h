@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed set of worker threads that run "parallel for" batches.
+//
+// Run() splits the job indices into one contiguous shard per
+// worker.  A worker takes jobs off the front of its own shard,
+// and once that's empty it steals the back half of whichever
+// other shard has the most left, so uneven jobs (a match full
+// of balls next to an empty one) still finish together.
+//
+// The calling thread works as worker 0, so a pool of one
+// thread runs everything inline with no handoff at all.
+// --------------------------------------------------------
+class JobPool
+{
+public:
+	// threadCount - Workers including the caller; 0 uses every core
+	explicit JobPool(int threadCount);
+	~JobPool();
+
+	// Calls job(index, worker) for every index in [0, jobCount)
+	// and returns once they've all finished.  worker is in
+	// [0, GetThreadCount()), for per-thread scratch space.
+	void Run(int jobCount, const std::function<void(int, int)>& job);
+
+	int GetThreadCount() const { return (int)shards.size(); }
+
+	// Jobs run by a worker other than the one they were given to
+	uint64_t GetStolenCount() const { return stolen.load(); }
+
+private:
+	// Not copyable - the threads point back at us
+	JobPool(const JobPool&);
+	JobPool& operator=(const JobPool&);
+
+	struct Shard
+	{
+		std::mutex lock;
+		int begin;
+		int end;
+	};
+
+	void WorkerLoop(int worker);
+	void Work(int worker);
+	bool Take(int worker, int& index);
+	bool Steal(int worker);
+
+	std::vector<Shard*> shards;
+	std::vector<std::thread> threads;
+
+	// The batch being run
+	const std::function<void(int, int)>* job;
+
+	std::mutex wakeLock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	uint32_t batch;
+	int busyWorkers;
+	bool quitting;
+
+	std::atomic<uint64_t> stolen;
+};
@@ -0,0 +1,177 @@
+#include "LookaheadBot.h"
+
+#include <chrono>
+#include "Profiler.h"
+
+// Steps between row changes, in play and in rollouts alike
+const uint32_t LOOKAHEAD_MOVE_STEPS = 10;
+
+// A goal is worth more than any amount of pressure
+const float GOAL_VALUE = 10.0f;
+
+// How much the soccer ball already heading the right way counts,
+// next to where it is
+const float MOMENTUM_VALUE = 0.25f;
+
+// Keeps the current choice unless another is clearly better, so
+// the bot doesn't dither between rows that score the same
+const float STICKINESS = 0.02f;
+
+// Both choices: which row, and whether to shoot from it
+const int LOOKAHEAD_ACTIONS = MATCH_ROWS * 2;
+
+// Moves towards row at the bot's pace, and shoots once there if
+// asked to
+static uint8_t Steer(int player, Match& match, int row, bool fire, uint32_t& nextMoveStep)
+{
+	uint32_t step = match.GetStepCount();
+	int selection = match.GetSelection(player);
+
+	uint8_t buttons = 0;
+	if (row != selection && step >= nextMoveStep)
+	{
+		buttons |= row < selection ? MATCH_P1_UP : MATCH_P1_DOWN;
+		selection += row < selection ? -1 : 1;
+		nextMoveStep = step + LOOKAHEAD_MOVE_STEPS;
+	}
+	if (fire && selection == row)
+		buttons |= MATCH_P1_FIRE;
+	return buttons;
+}
+
+LookaheadBot::LookaheadBot(int player, const LookaheadConfig& config, JobPool& pool, uint64_t seed)
+	: player(player), config(config), pool(pool), random(seed)
+{
+	for (int i = 0; i < pool.GetThreadCount(); i++)
+	{
+		scratch.push_back(new Match(0));
+		scratch.back()->GetBallManager()->setExplosionsEnabled(false);
+	}
+
+	targetRow = MATCH_ROWS / 2;
+	fireAtTarget = false;
+	nextDecisionStep = 0;
+	nextMoveStep = 0;
+	lastStep = 0;
+	started = false;
+	ResetStats();
+}
+
+LookaheadBot::~LookaheadBot()
+{
+	for (Match* match : scratch)
+		delete match;
+}
+
+void LookaheadBot::ResetStats()
+{
+	stats.decisions = 0;
+	stats.rollouts = 0;
+	stats.rolloutSteps = 0;
+	stats.searchMs = 0;
+	stats.maxSearchMs = 0;
+}
+
+// Runs on a pool thread
+float LookaheadBot::Rollout(const Match& root, int action, uint64_t seed, Match& scratch, uint32_t& steps)
+{
+	int row = action / 2;
+	bool fire = (action & 1) != 0;
+	int opponent = 3 - player;
+
+	scratch.Fork(root);
+	int startFor = scratch.GetScore(player);
+	int startAgainst = scratch.GetScore(opponent);
+
+	MatchBot guess(opponent, config.opponent, seed);
+	uint32_t moveStep = nextMoveStep;
+	uint32_t horizon = (uint32_t)(config.horizonSeconds / MATCH_TIMESTEP);
+
+	// Stop at the first goal - the field resets after one, so
+	// playing on says little about this choice
+	for (steps = 0; steps < horizon; )
+	{
+		uint8_t ours = Steer(player, scratch, row, fire, moveStep);
+		uint8_t theirs = guess.Think(scratch);
+		scratch.Step(MatchInput((uint8_t)(player == 1 ? ours | (theirs << 3) : theirs | (ours << 3))));
+		steps++;
+		if (scratch.GetScore(player) != startFor || scratch.GetScore(opponent) != startAgainst)
+			break;
+	}
+
+	// Player 1 scores off the right-hand end, player 2 the left
+	float direction = player == 1 ? 1.0f : -1.0f;
+	Ball& soccer = scratch.GetBallManager()->getBalls()[0];
+	float goals = (float)((scratch.GetScore(player) - startFor) - (scratch.GetScore(opponent) - startAgainst));
+	return GOAL_VALUE * goals +
+		direction * soccer.getPosition().x / FIELD_X_BOUND +
+		MOMENTUM_VALUE * direction * soccer.getVelocity().x / scratch.GetRules().maxSpeed;
+}
+
+void LookaheadBot::Decide(Match& match)
+{
+	PROFILE_SCOPE("LookaheadBot::Decide");
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	int rollouts = config.rolloutsPerAction < 1 ? 1 : config.rolloutsPerAction;
+	int jobs = LOOKAHEAD_ACTIONS * rollouts;
+	values.resize(jobs);
+	steps.resize(jobs);
+
+	// Every choice sees the same guesses at the opponent, so
+	// they're compared on the same futures
+	uint64_t seed = ((uint64_t)random.Next() << 32) | random.Next();
+	pool.Run(jobs, [&](int job, int worker)
+	{
+		// Thousands of steps a decision would swamp the rings
+		PROFILE_PAUSE();
+		values[job] = Rollout(match, job / rollouts, seed + job % rollouts, *scratch[worker], steps[job]);
+	});
+
+	int current = targetRow * 2 + (fireAtTarget ? 1 : 0);
+	int best = current;
+	float bestValue = -1e30f;
+	for (int action = 0; action < LOOKAHEAD_ACTIONS; action++)
+	{
+		float total = 0;
+		for (int i = 0; i < rollouts; i++)
+			total += values[action * rollouts + i];
+		float value = total / rollouts + (action == current ? STICKINESS : 0);
+		if (value > bestValue)
+		{
+			bestValue = value;
+			best = action;
+		}
+	}
+	targetRow = best / 2;
+	fireAtTarget = (best & 1) != 0;
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.decisions++;
+	stats.rollouts += jobs;
+	for (uint32_t count : steps)
+		stats.rolloutSteps += count;
+	stats.searchMs += ms;
+	if (ms > stats.maxSearchMs)
+		stats.maxSearchMs = ms;
+}
+
+uint8_t LookaheadBot::Think(Match& match)
+{
+	// A match that went back in time is a fresh one
+	uint32_t step = match.GetStepCount();
+	if (started && step < lastStep)
+	{
+		started = false;
+		nextMoveStep = 0;
+	}
+	lastStep = step;
+
+	if (!started || step >= nextDecisionStep)
+	{
+		Decide(match);
+		nextDecisionStep = step + config.decisionSteps;
+		started = true;
+	}
+	return Steer(player, match, targetRow, fireAtTarget, nextMoveStep);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "JobPool.h"
+#include "Match.h"
+#include "SelfPlay.h"
+
+// --------------------------------------------------------
+// A computer opponent that plays by looking ahead.
+//
+// Every few steps it decides on a row and whether to shoot from
+// it.  For each of those choices it forks the match into
+// scratch copies (Match::Fork - the balls and score, copied
+// into storage that's reused), plays each copy a second or two
+// ahead with the choice carried out and the other player
+// guessed at by a scripted MatchBot, and scores how it ended:
+// goals for and against, then how far the soccer ball is
+// towards the other end.  Rollouts run across a JobPool, one
+// scratch match per worker, and the best average wins.
+//
+// Between decisions it just steers to the chosen row at the
+// same pace as the scripted bots.
+// --------------------------------------------------------
+
+struct LookaheadConfig
+{
+	float horizonSeconds;		// How far each rollout plays ahead
+	int rolloutsPerAction;		// Rollouts averaged for each choice
+	uint32_t decisionSteps;		// Steps between decisions
+	BotPolicy opponent;			// What the other player is assumed to do
+
+	LookaheadConfig() : horizonSeconds(1.5f), rolloutsPerAction(4), decisionSteps(12)
+	{
+		opponent.row = BOT_ROW_LEAD;
+		opponent.fire = BOT_FIRE_LINED_UP;
+	}
+};
+
+struct LookaheadStats
+{
+	uint32_t decisions;
+	uint64_t rollouts;
+	uint64_t rolloutSteps;
+	double searchMs;			// Wall time spent deciding
+	double maxSearchMs;			// Longest single decision
+};
+
+class LookaheadBot
+{
+public:
+	LookaheadBot(int player, const LookaheadConfig& config, JobPool& pool, uint64_t seed);
+	~LookaheadBot();
+
+	// This step's buttons for our player, as player 1's
+	// MatchButtons (shift player 2's up by 3)
+	uint8_t Think(Match& match);
+
+	const LookaheadStats& GetStats() const { return stats; }
+	void ResetStats();
+
+private:
+	// Not copyable - owns its scratch matches
+	LookaheadBot(const LookaheadBot&);
+	LookaheadBot& operator=(const LookaheadBot&);
+
+	void Decide(Match& match);
+	float Rollout(const Match& root, int action, uint64_t seed, Match& scratch, uint32_t& steps);
+
+	int player;
+	LookaheadConfig config;
+	JobPool& pool;
+	SimRandom random;
+
+	std::vector<Match*> scratch;		// One per pool worker
+	std::vector<float> values;			// One per rollout
+	std::vector<uint32_t> steps;
+
+	int targetRow;
+	bool fireAtTarget;
+	uint32_t nextDecisionStep;
+	uint32_t nextMoveStep;
+	uint32_t lastStep;
+	bool started;
+
+	LookaheadStats stats;
+};
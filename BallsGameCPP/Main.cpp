@@ -1,6 +1,36 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "Replay.h"
+
+// --------------------------------------------------------
+// Re-simulates a recorded match with no window or device,
+// as fast as possible, and reports whether every step still
+// produces the recorded state
+// --------------------------------------------------------
+static int RunReplay(const char* fileName)
+{
+	std::string error;
+	ReplayReader replay;
+	if (!replay.Load(fileName, &error))
+	{
+		MessageBoxA(0, error.c_str(), "Replay", MB_OK | MB_ICONERROR);
+		return 1;
+	}
+
+	ReplayResult result;
+	PlayReplay(replay, result);
+
+	char message[256];
+	if (result.divergedStep >= 0)
+		sprintf_s(message, "Diverged at step %d of %u (hash %08x, recorded %08x)",
+			result.divergedStep, replay.GetStepCount(), result.actualHash, result.expectedHash);
+	else
+		sprintf_s(message, "All %u steps match, player %d wins\n%.2f ms (%.0f steps/s)",
+			result.stepsPlayed, result.winner, result.seconds * 1000.0, result.stepsPlayed / max(result.seconds, 1e-9));
+	MessageBoxA(0, message, "Replay", MB_OK | (result.divergedStep >= 0 ? MB_ICONERROR : MB_ICONINFORMATION));
+	return result.divergedStep >= 0 ? 1 : 0;
+}
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,9 +48,97 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// "-sound-to file.wav" mixes the game's sounds in software into
+	// a file instead of playing them; the rest of the line is as usual
+	char soundFile[MAX_PATH] = "";
+	if (strncmp(lpCmdLine, "-sound-to ", 10) == 0)
+	{
+		sscanf_s(lpCmdLine + 10, "%259s", soundFile, (unsigned)sizeof(soundFile));
+		lpCmdLine += 10 + strlen(soundFile);
+		while (*lpCmdLine == ' ')
+			lpCmdLine++;
+	}
+
+	// "-replay file" checks a recording instead of running the game
+	if (strncmp(lpCmdLine, "-replay ", 8) == 0)
+		return RunReplay(lpCmdLine + 8);
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
+	if (soundFile[0])
+		dxGame.SetSoundFile(soundFile);
+
+	// "-net player localPort remote [latencyMs jitterMs lossPercent]"
+	// plays against another copy of the game, e.g.
+	// "-net 1 7001 localhost:7002" and "-net 2 7002 localhost:7001"
+	if (strncmp(lpCmdLine, "-net ", 5) == 0)
+	{
+		int player;
+		unsigned int port;
+		char remoteText[64];
+		LinkConditions conditions;
+		NetAddress remote;
+		int fields = sscanf_s(lpCmdLine + 5, "%d %u %63s %f %f %f", &player, &port, remoteText, (unsigned)sizeof(remoteText),
+			&conditions.latencyMs, &conditions.jitterMs, &conditions.lossPercent);
+		if (fields < 3 || (player != 1 && player != 2) || port == 0 || port > 65535 || !NetAddress::Parse(remoteText, remote) ||
+			!dxGame.StartNetPlay(player, (uint16_t)port, remote, conditions))
+		{
+			MessageBoxA(0, "Usage: -net <1|2> <localPort> <remoteIp:port> [latencyMs jitterMs lossPercent]", "Net", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+	}
+
+	// "-spectate server:port matchId" watches a match on a BallServer
+	if (strncmp(lpCmdLine, "-spectate ", 10) == 0)
+	{
+		char serverText[64];
+		unsigned int matchId = 0;
+		NetAddress server;
+		int fields = sscanf_s(lpCmdLine + 10, "%63s %u", serverText, (unsigned)sizeof(serverText), &matchId);
+		if (fields < 1 || matchId > 65535 || !NetAddress::Parse(serverText, server) ||
+			!dxGame.StartSpectating(server, (uint16_t)matchId))
+		{
+			MessageBoxA(0, "Usage: -spectate <serverIp:port> [matchId]", "Spectate", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+	}
+
+	// "-input replay file" plays a recording back through the game,
+	// checking every step, and quits at its end.  "-input bots
+	// policy policy" has bots play each other for as long as it's
+	// left running; "-input bot policy" puts one on player 2's row.
+	// Policies are as SelfPlay's, e.g. "lead/lined-up".
+	if (strncmp(lpCmdLine, "-input ", 7) == 0)
+	{
+		char kind[16];
+		char first[64];
+		char second[64];
+		int fields = sscanf_s(lpCmdLine + 7, "%15s %63s %63s", kind, (unsigned)sizeof(kind), first, (unsigned)sizeof(first), second, (unsigned)sizeof(second));
+		BotPolicy policies[2];
+		uint64_t seed = (uint64_t)GetTickCount64();
+		std::string error;
+		if (fields >= 2 && strcmp(kind, "replay") == 0)
+		{
+			ReplayInputSource* replay = new ReplayInputSource();
+			if (!replay->Load(lpCmdLine + 7 + strlen("replay "), &error))
+			{
+				delete replay;
+				MessageBoxA(0, error.c_str(), "Input", MB_OK | MB_ICONERROR);
+				return 1;
+			}
+			dxGame.SetInputSource(replay);
+		}
+		else if (fields == 3 && strcmp(kind, "bots") == 0 && ParseBotPolicy(first, policies[0]) && ParseBotPolicy(second, policies[1]))
+			dxGame.SetInputSource(new BotInputSource(&policies[0], &policies[1], seed));
+		else if (fields == 2 && strcmp(kind, "bot") == 0 && ParseBotPolicy(first, policies[1]))
+			dxGame.SetInputSource(new BotInputSource(0, &policies[1], seed));
+		else
+		{
+			MessageBoxA(0, "Usage: -input replay <file> | bots <policy> <policy> | bot <policy>", "Input", MB_OK | MB_ICONERROR);
+			return 1;
+		}
+	}
 
 	// Result variable for function calls below
 	HRESULT hr = S_OK;
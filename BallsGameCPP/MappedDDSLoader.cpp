@@ -0,0 +1,160 @@
+#include "MappedDDSLoader.h"
+#include "MappedFile.h"
+#include "DDSParser.h"
+
+#include <vector>
+
+HRESULT CreateDDSTextureFromFileMapped(ID3D11Device* device, const wchar_t* file, ID3D11Resource** texture, ID3D11ShaderResourceView** srv)
+{
+	if (texture) *texture = 0;
+	if (srv) *srv = 0;
+	if (!device || !file || (!texture && !srv))
+		return E_INVALIDARG;
+
+	MappedFile mapped;
+	if (!mapped.Open(file))
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	DDSTextureInfo info;
+	std::vector<DDSSurface> surfaces;
+	if (!DDSParseHeader(mapped.GetData(), mapped.GetSize(), info) ||
+		!DDSGetSurfaces(info, mapped.GetData(), mapped.GetSize(), surfaces))
+		return E_FAIL;
+
+	// Each subresource points directly into the mapping
+	std::vector<D3D11_SUBRESOURCE_DATA> initData(surfaces.size());
+	for (size_t i = 0; i < surfaces.size(); i++)
+	{
+		initData[i].pSysMem = surfaces[i].data;
+		initData[i].SysMemPitch = (UINT)surfaces[i].rowPitch;
+		initData[i].SysMemSlicePitch = (UINT)surfaces[i].slicePitch;
+	}
+
+	DXGI_FORMAT format = (DXGI_FORMAT)info.format;
+	ID3D11Resource* resource = 0;
+	HRESULT hr = E_FAIL;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = format;
+
+	switch (info.dimension)
+	{
+	case DDS_DIMENSION_TEXTURE1D:
+	{
+		D3D11_TEXTURE1D_DESC desc = {};
+		desc.Width = (UINT)info.width;
+		desc.MipLevels = (UINT)info.mipCount;
+		desc.ArraySize = (UINT)info.arraySize;
+		desc.Format = format;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ID3D11Texture1D* tex = 0;
+		hr = device->CreateTexture1D(&desc, &initData[0], &tex);
+		resource = tex;
+
+		if (info.arraySize > 1)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1DARRAY;
+			srvDesc.Texture1DArray.MipLevels = desc.MipLevels;
+			srvDesc.Texture1DArray.ArraySize = desc.ArraySize;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE1D;
+			srvDesc.Texture1D.MipLevels = desc.MipLevels;
+		}
+		break;
+	}
+
+	case DDS_DIMENSION_TEXTURE2D:
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = (UINT)info.width;
+		desc.Height = (UINT)info.height;
+		desc.MipLevels = (UINT)info.mipCount;
+		desc.ArraySize = (UINT)info.arraySize;
+		desc.Format = format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = info.isCubeMap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+		ID3D11Texture2D* tex = 0;
+		hr = device->CreateTexture2D(&desc, &initData[0], &tex);
+		resource = tex;
+
+		if (info.isCubeMap)
+		{
+			if (info.arraySize > 6)
+			{
+				srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+				srvDesc.TextureCubeArray.MipLevels = desc.MipLevels;
+				srvDesc.TextureCubeArray.NumCubes = desc.ArraySize / 6;
+			}
+			else
+			{
+				srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+				srvDesc.TextureCube.MipLevels = desc.MipLevels;
+			}
+		}
+		else if (info.arraySize > 1)
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+			srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+		}
+		else
+		{
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			srvDesc.Texture2D.MipLevels = desc.MipLevels;
+		}
+		break;
+	}
+
+	case DDS_DIMENSION_TEXTURE3D:
+	{
+		D3D11_TEXTURE3D_DESC desc = {};
+		desc.Width = (UINT)info.width;
+		desc.Height = (UINT)info.height;
+		desc.Depth = (UINT)info.depth;
+		desc.MipLevels = (UINT)info.mipCount;
+		desc.Format = format;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ID3D11Texture3D* tex = 0;
+		hr = device->CreateTexture3D(&desc, &initData[0], &tex);
+		resource = tex;
+
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+		srvDesc.Texture3D.MipLevels = desc.MipLevels;
+		break;
+	}
+
+	default:
+		return E_FAIL;
+	}
+
+	// The GPU copy has been made by now, so the mapping
+	// is released when 'mapped' goes out of scope
+	if (FAILED(hr))
+		return hr;
+
+	if (srv)
+	{
+		hr = device->CreateShaderResourceView(resource, &srvDesc, srv);
+		if (FAILED(hr))
+		{
+			resource->Release();
+			return hr;
+		}
+	}
+
+	if (texture)
+		*texture = resource;
+	else
+		resource->Release();
+
+	return S_OK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <d3d11.h>
+
+// --------------------------------------------------------
+// Loads a DDS file by memory mapping it and pointing the
+// D3D11_SUBRESOURCE_DATA straight at the mapped pages, so the
+// texel data is never copied into an intermediate heap buffer.
+// The header is parsed and validated by DDSParser.
+//
+// device  - The device to create the texture with
+// file    - Path to the .dds file
+// texture - Optional, receives the texture resource
+// srv     - Optional, receives a view of the whole texture
+// --------------------------------------------------------
+HRESULT CreateDDSTextureFromFileMapped(ID3D11Device* device, const wchar_t* file, ID3D11Resource** texture, ID3D11ShaderResourceView** srv);
@@ -0,0 +1,119 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+	mapping = 0;
+#endif
+	data = 0;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+// --------------------------------------------------------
+// Maps an already opened file handle.  The handle itself can
+// be closed afterwards, the mapping keeps the file alive.
+// --------------------------------------------------------
+bool MappedFile::MapHandle(void* fileHandle)
+{
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	mapping = CreateFileMappingW(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(fileHandle);
+	if (!mapping)
+		return false;
+
+	data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		mapping = 0;
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+	return MapHandle(CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0));
+}
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+	return MapHandle(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0));
+}
+
+void MappedFile::Close()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	data = 0;
+	mapping = 0;
+	size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const char* fileName)
+{
+	Close();
+
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps its own reference
+	if (mapped == MAP_FAILED)
+		return false;
+
+	// We read front to back, let the kernel read ahead
+	madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+	data = (const uint8_t*)mapped;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data) munmap((void*)data, size);
+	data = 0;
+	size = 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------
+// A read-only memory mapped file.
+//
+// The contents are paged in straight from the OS file cache,
+// so large assets can be handed to the GPU without first being
+// copied into a heap buffer.  Uses CreateFileMapping on Windows
+// and mmap everywhere else.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const char* fileName);
+#ifdef _WIN32
+	bool Open(const wchar_t* fileName);
+#endif
+	void Close();
+
+	bool IsOpen() { return data != 0; }
+	const uint8_t* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+private:
+	// Not copyable - the mapping has a single owner
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+	bool MapHandle(void* fileHandle);
+	void* mapping;
+#endif
+
+	const uint8_t* data;
+	size_t size;
+};
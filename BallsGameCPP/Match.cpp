@@ -0,0 +1,189 @@
+#include "Match.h"
+
+#include <cstring>
+#include <type_traits>
+
+// Snapshots copy these as raw bytes
+static_assert(std::is_trivially_copyable<Ball>::value, "Ball must stay plain data");
+static_assert(std::is_trivially_copyable<Emitter>::value, "Emitter must stay plain data");
+
+const float BALL_MASS = 1.0f;
+
+Match::Match(uint64_t seed, const MatchRules& rules)
+	: rules(rules), ballManager(&random)
+{
+	ballManager.setRules(rules.maxSpeed, rules.ballsPerPlayer);
+	Reset(seed);
+}
+
+Match::~Match()
+{
+}
+
+void Match::Reset(uint64_t seed)
+{
+	this->seed = seed;
+	stepCount = 0;
+	random.Seed(seed);
+
+	p1Selection = MATCH_ROWS / 2;
+	p2Selection = MATCH_ROWS / 2;
+	p1shootTimer = 0;
+	p2shootTimer = 0;
+
+	ballManager.clear();
+	ballManager.addBall(myVector(0, 0.1f, 0.65f), myVector(0, 0, 0), BALL_MASS, SOCCER_BALL_RADIUS, true);
+}
+
+myVector Match::GetRowPosition(int player, int row)
+{
+	return myVector(player == 1 ? -2.6f : 2.6f, 1.2f - 0.4f * row, -0.5f);
+}
+
+void Match::UpdatePlayer(int player, bool up, bool down, bool fire)
+{
+	int& selection = player == 1 ? p1Selection : p2Selection;
+	float& shootTimer = player == 1 ? p1shootTimer : p2shootTimer;
+	int& ballsLeft = player == 1 ? ballManager.getScore().p1Balls : ballManager.getScore().p2Balls;
+
+	if (up && selection > 0)
+		selection--;
+	if (down && selection < MATCH_ROWS - 1)
+		selection++;
+
+	if (fire && shootTimer <= 0 && ballsLeft > 0)
+	{
+		float speed = player == 1 ? rules.ballSpeed : -rules.ballSpeed;
+		ballManager.addBall(GetRowPosition(player, selection), myVector(speed, 0, 0), BALL_MASS, BALL_RADIUS, false);
+		shootTimer = rules.firePeriod;
+		ballsLeft--;
+	}
+}
+
+void Match::Step(MatchInput input)
+{
+	// A finished match stays put until it's reset
+	if (GetWinner() != 0)
+		return;
+
+	if (p1shootTimer > 0)
+		p1shootTimer -= MATCH_TIMESTEP;
+	if (p2shootTimer > 0)
+		p2shootTimer -= MATCH_TIMESTEP;
+
+	UpdatePlayer(1, (input.buttons & MATCH_P1_UP) != 0, (input.buttons & MATCH_P1_DOWN) != 0, (input.buttons & MATCH_P1_FIRE) != 0);
+	UpdatePlayer(2, (input.buttons & MATCH_P2_UP) != 0, (input.buttons & MATCH_P2_DOWN) != 0, (input.buttons & MATCH_P2_FIRE) != 0);
+
+	ballManager.Update(MATCH_TIMESTEP);
+	stepCount++;
+}
+
+void Match::Fork(const Match& source)
+{
+	rules = source.rules;
+	seed = source.seed;
+	stepCount = source.stepCount;
+	random.SetState(source.random.GetState());
+	ballManager.copyPlayState(source.ballManager);
+	p1Selection = source.p1Selection;
+	p2Selection = source.p2Selection;
+	p1shootTimer = source.p1shootTimer;
+	p2shootTimer = source.p2shootTimer;
+}
+
+int Match::GetWinner()
+{
+	if (ballManager.getScore().p1Score >= rules.winningScore)
+		return 1;
+	if (ballManager.getScore().p2Score >= rules.winningScore)
+		return 2;
+	return 0;
+}
+
+uint32_t Match::Hash()
+{
+	uint32_t hash = SIM_HASH_START;
+	hash = SimHash(hash, &stepCount, sizeof(stepCount));
+
+	uint64_t randomState = random.GetState();
+	hash = SimHash(hash, &randomState, sizeof(randomState));
+
+	int selections[2] = { p1Selection, p2Selection };
+	hash = SimHash(hash, selections, sizeof(selections));
+
+	float timers[2] = { p1shootTimer, p2shootTimer };
+	hash = SimHash(hash, timers, sizeof(timers));
+
+	return ballManager.hash(hash);
+}
+
+size_t Match::GetStateSize()
+{
+	return sizeof(MatchStateHeader) +
+		ballManager.getBalls().size() * sizeof(Ball) +
+		ballManager.getExplosions().size() * sizeof(Emitter);
+}
+
+void Match::SaveState(std::vector<uint8_t>& state)
+{
+	std::vector<Ball>& balls = ballManager.getBalls();
+	std::vector<Emitter>& explosions = ballManager.getExplosions();
+
+	MatchStateHeader header;
+	memset(&header, 0, sizeof(header));
+	header.seed = seed;
+	header.randomState = random.GetState();
+	header.stepCount = stepCount;
+	header.ballCount = (uint32_t)balls.size();
+	header.explosionCount = (uint32_t)explosions.size();
+	header.nextBallId = ballManager.getNextBallId();
+	header.p1Selection = p1Selection;
+	header.p2Selection = p2Selection;
+	header.p1shootTimer = p1shootTimer;
+	header.p2shootTimer = p2shootTimer;
+	header.score = ballManager.getScore();
+
+	size_t ballBytes = balls.size() * sizeof(Ball);
+	size_t explosionBytes = explosions.size() * sizeof(Emitter);
+	state.resize(sizeof(header) + ballBytes + explosionBytes);
+
+	uint8_t* out = &state[0];
+	memcpy(out, &header, sizeof(header));
+	if (ballBytes)
+		memcpy(out + sizeof(header), &balls[0], ballBytes);
+	if (explosionBytes)
+		memcpy(out + sizeof(header) + ballBytes, &explosions[0], explosionBytes);
+}
+
+bool Match::LoadState(const uint8_t* state, size_t size)
+{
+	MatchStateHeader header;
+	if (size < sizeof(header))
+		return false;
+	memcpy(&header, state, sizeof(header));
+
+	size_t ballBytes = (size_t)header.ballCount * sizeof(Ball);
+	size_t explosionBytes = (size_t)header.explosionCount * sizeof(Emitter);
+	if (sizeof(header) + ballBytes + explosionBytes != size)
+		return false;
+
+	seed = header.seed;
+	random.SetState(header.randomState);
+	stepCount = header.stepCount;
+	p1Selection = header.p1Selection;
+	p2Selection = header.p2Selection;
+	p1shootTimer = header.p1shootTimer;
+	p2shootTimer = header.p2shootTimer;
+	ballManager.getScore() = header.score;
+	ballManager.setNextBallId(header.nextBallId);
+
+	std::vector<Ball>& balls = ballManager.getBalls();
+	std::vector<Emitter>& explosions = ballManager.getExplosions();
+	balls.resize(header.ballCount);
+	explosions.resize(header.explosionCount);
+	if (ballBytes)
+		memcpy(&balls[0], state + sizeof(header), ballBytes);
+	if (explosionBytes)
+		memcpy(&explosions[0], state + sizeof(header) + ballBytes, explosionBytes);
+	return true;
+}
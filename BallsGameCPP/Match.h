@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "BallManager.h"
+#include "SimRandom.h"
+
+// --------------------------------------------------------
+// The gameplay rules of one match, stepped at a fixed rate
+// from a small input bitfield.
+//
+// Given the same seed and the same inputs on the same steps,
+// two Matches produce bit-identical state, so a match can be
+// recorded as just its inputs (see Replay) and re-simulated
+// anywhere - Game only turns key presses into MatchInputs
+// and draws whatever the Match holds.
+//
+// The whole simulation is BallManager's balls and explosions,
+// with positions in its own myVector math rather than
+// DirectXMath, and randomness from SimRandom.
+// --------------------------------------------------------
+
+// One simulation step
+const float MATCH_TIMESTEP = 1.0f / 120.0f;
+
+// Rows each player can fire from
+const int MATCH_ROWS = 7;
+
+// Ball sizes, for drawing balls known only by position
+const float BALL_RADIUS = 0.125f;
+const float SOCCER_BALL_RADIUS = 0.25f;
+
+// Buttons pressed since the last step (edges, not held state)
+enum MatchButton
+{
+	MATCH_P1_UP = 1 << 0,
+	MATCH_P1_DOWN = 1 << 1,
+	MATCH_P1_FIRE = 1 << 2,
+	MATCH_P2_UP = 1 << 3,
+	MATCH_P2_DOWN = 1 << 4,
+	MATCH_P2_FIRE = 1 << 5,
+	MATCH_BUTTON_MASK = (1 << 6) - 1
+};
+
+struct MatchInput
+{
+	uint8_t buttons;
+
+	MatchInput() : buttons(0) {}
+	explicit MatchInput(uint8_t buttons) : buttons(buttons) {}
+};
+
+// --------------------------------------------------------
+// Gameplay tuning.  The defaults are the game's rules, which
+// everything but the self-play tools uses.  Rules aren't part
+// of a saved state or a hash, so a replay or a network match
+// only reproduces if both ends play by the same ones.
+// --------------------------------------------------------
+struct MatchRules
+{
+	float firePeriod;		// Seconds between a player's shots
+	float ballSpeed;		// Speed a shot leaves its row at
+	float maxSpeed;			// Cap on a ball's speed after a collision
+	int ballsPerPlayer;		// Magazine, refilled after every goal
+	int winningScore;
+
+	MatchRules() : firePeriod(0.35f), ballSpeed(3.1f), maxSpeed(2.0f), ballsPerPlayer(BALLS_PER_PLAYER), winningScore(3) {}
+};
+
+// --------------------------------------------------------
+// Start of a saved match state.  The balls and then the
+// explosions follow straight after, copied as they are in
+// BallManager's vectors.
+// --------------------------------------------------------
+struct MatchStateHeader
+{
+	uint64_t seed;
+	uint64_t randomState;
+	uint32_t stepCount;
+	uint32_t ballCount;
+	uint32_t explosionCount;
+	uint32_t nextBallId;
+	int32_t p1Selection;
+	int32_t p2Selection;
+	float p1shootTimer;
+	float p2shootTimer;
+	MatchScore score;
+};
+
+class Match
+{
+public:
+	explicit Match(uint64_t seed, const MatchRules& rules = MatchRules());
+	~Match();
+
+	// Throws away everything and starts a fresh match under the
+	// same rules
+	void Reset(uint64_t seed);
+
+	// Advances the match by MATCH_TIMESTEP
+	void Step(MatchInput input);
+
+	// Turns this match into a copy of source to play ahead from.
+	// Explosions are left out - nothing depends on them - and our
+	// own storage is reused, so forking into the same scratch
+	// match over and over doesn't allocate.
+	void Fork(const Match& source);
+
+	// Fingerprint of the whole simulation state
+	uint32_t Hash();
+
+	// Copies the whole simulation state out and back in.  Both are
+	// a handful of memcpys and reuse the buffers' existing capacity,
+	// so saving into the same vector every step doesn't allocate.
+	size_t GetStateSize();
+	void SaveState(std::vector<uint8_t>& state);
+	bool LoadState(const uint8_t* state, size_t size);
+
+	// 0 while playing, otherwise the player who won
+	int GetWinner();
+
+	// World position of a player's row (where their balls spawn)
+	static myVector GetRowPosition(int player, int row);
+
+	uint64_t GetSeed() const { return seed; }
+	uint32_t GetStepCount() const { return stepCount; }
+	int GetScore(int player) { return player == 1 ? ballManager.getScore().p1Score : ballManager.getScore().p2Score; }
+	int GetBallsLeft(int player) { return player == 1 ? ballManager.getScore().p1Balls : ballManager.getScore().p2Balls; }
+	int GetSelection(int player) const { return player == 1 ? p1Selection : p2Selection; }
+	const MatchRules& GetRules() const { return rules; }
+	BallManager* GetBallManager() { return &ballManager; }
+
+	// Every step adds its hits, bounces and goals to sounds, if
+	// given; Fork doesn't pass it on
+	void SetSoundLog(std::vector<SoundEvent>* sounds) { ballManager.setSoundLog(sounds); }
+
+private:
+	// Not copyable - BallManager points at our random generator
+	Match(const Match&);
+	Match& operator=(const Match&);
+
+	void UpdatePlayer(int player, bool up, bool down, bool fire);
+
+	MatchRules rules;
+	uint64_t seed;
+	uint32_t stepCount;
+	SimRandom random;
+	BallManager ballManager;
+
+	int p1Selection;
+	int p2Selection;
+	float p1shootTimer;
+	float p2shootTimer;
+};
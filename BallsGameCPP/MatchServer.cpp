@@ -0,0 +1,199 @@
+#include "MatchServer.h"
+
+#include <chrono>
+#include <cstring>
+
+// Watchers and human players that go quiet this long are dropped
+const double CLIENT_TIMEOUT_MS = 5000.0;
+
+
+MatchServer::MatchServer(int matchCount, int threadCount, uint64_t seed)
+	: pool(threadCount), seeds(seed)
+{
+	tick = 0;
+	matches.resize(matchCount < 1 ? 1 : matchCount);
+	for (auto& hosted : matches)
+	{
+		uint64_t matchSeed = ((uint64_t)seeds.Next() << 32) | seeds.Next();
+		hosted.match = new Match(matchSeed);
+		hosted.bots.Seed(matchSeed ^ 0x9E3779B97F4A7C15ULL);
+		hosted.humanButtons[0] = hosted.humanButtons[1] = 0;
+		hosted.humanUntilMs[0] = hosted.humanUntilMs[1] = -1;
+		hosted.cpuMs = 0;
+		hosted.finished = false;
+	}
+	ResetStats();
+}
+
+MatchServer::~MatchServer()
+{
+	for (auto& hosted : matches)
+		delete hosted.match;
+}
+
+bool MatchServer::Open(uint16_t port)
+{
+	return socket.Open(port);
+}
+
+void MatchServer::ResetStats()
+{
+	stats.ticks = 0;
+	stats.lateTicks = 0;
+	stats.matchesFinished = 0;
+	stats.tickMs.clear();
+	stats.matchCpuMs = 0;
+	stats.bytesSent = 0;
+	stats.fullSnapshots = 0;
+	stats.packetsSent = 0;
+	stats.requestsReceived = 0;
+}
+
+void MatchServer::Tick(double nowMs, double periodMs)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	tick++;
+	Receive(nowMs);
+
+	// Matches only touch their own HostedMatch, so they need no locking
+	pool.Run((int)matches.size(), [this, nowMs](int index, int /*worker*/) { TickMatch(index, nowMs); });
+
+	// Forget watchers that went quiet, then encode everyone else's
+	// snapshot in parallel too - each is against its own baseline
+	for (size_t i = 0; i < watchers.size(); )
+	{
+		if (nowMs - watchers[i].lastHeardMs > CLIENT_TIMEOUT_MS)
+			watchers.erase(watchers.begin() + i);
+		else
+			i++;
+	}
+	pool.Run((int)watchers.size(), [this](int index, int /*worker*/) { EncodeForWatcher(index); });
+
+	for (auto& watcher : watchers)
+	{
+		socket.Send(watcher.address, &watcher.packet[0], watcher.packet.size());
+		stats.bytesSent += watcher.packet.size();
+		stats.packetsSent++;
+		if (watcher.fullSnapshot)
+			stats.fullSnapshots++;
+	}
+
+	// Restart finished matches.  Their old snapshots go, so the next
+	// ones are sent in full; new seeds come from one generator, so
+	// they're picked on this thread.
+	for (auto& hosted : matches)
+	{
+		stats.matchCpuMs += hosted.cpuMs;
+		if (hosted.finished)
+		{
+			uint64_t matchSeed = ((uint64_t)seeds.Next() << 32) | seeds.Next();
+			hosted.match->Reset(matchSeed);
+			hosted.history.Clear();
+			hosted.finished = false;
+			stats.matchesFinished++;
+		}
+	}
+
+	stats.ticks++;
+	float ms = (float)std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.tickMs.push_back(ms);
+	if (ms > periodMs)
+		stats.lateTicks++;
+}
+
+void MatchServer::Receive(double nowMs)
+{
+	uint8_t buffer[64];
+	NetAddress from;
+	size_t size;
+	while ((size = socket.Receive(buffer, sizeof(buffer), from)) > 0)
+	{
+		ServerRequest request;
+		if (!ReadServerRequest(buffer, size, request) || request.matchId >= matches.size())
+			continue;
+		bool ackValid = request.ackTick != SERVER_NO_ACK && request.ackTick < tick;
+		stats.requestsReceived++;
+
+		HostedMatch& hosted = matches[request.matchId];
+		if (request.type == SERVER_PACKET_INPUT && (request.player == 1 || request.player == 2))
+		{
+			hosted.humanButtons[request.player - 1] |= request.buttons & (MATCH_P1_UP | MATCH_P1_DOWN | MATCH_P1_FIRE);
+			hosted.humanUntilMs[request.player - 1] = nowMs + CLIENT_TIMEOUT_MS;
+		}
+
+		// Any request keeps the sender watching
+		Watcher* watcher = 0;
+		for (auto& existing : watchers)
+		{
+			if (existing.address == from)
+				watcher = &existing;
+		}
+		if (!watcher)
+		{
+			watchers.push_back(Watcher());
+			watcher = &watchers.back();
+			watcher->address = from;
+			watcher->matchId = request.matchId;
+			watcher->acked = false;
+			watcher->ackedTick = 0;
+			watcher->fullSnapshot = false;
+		}
+		watcher->lastHeardMs = nowMs;
+
+		// Acks for another match are no use as baselines for this one
+		if (watcher->matchId != request.matchId)
+		{
+			watcher->matchId = request.matchId;
+			watcher->acked = false;
+		}
+		else if (ackValid && (!watcher->acked || request.ackTick > watcher->ackedTick))
+		{
+			watcher->acked = true;
+			watcher->ackedTick = request.ackTick;
+		}
+	}
+}
+
+// Runs on a pool thread
+void MatchServer::TickMatch(int index, double nowMs)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	HostedMatch& hosted = matches[index];
+	Match& match = *hosted.match;
+
+	// Clients play their slots; bots mash the rest.  Both are
+	// worked out as player 1 buttons and shifted into place.
+	uint8_t players[2];
+	uint32_t roll = hosted.bots.Next();
+	for (int p = 0; p < 2; p++)
+	{
+		if (nowMs < hosted.humanUntilMs[p])
+			players[p] = hosted.humanButtons[p];
+		else
+		{
+			uint32_t bits = roll >> (p * 16);
+			players[p] = 0;
+			if (bits % 40 == 0) players[p] |= MATCH_P1_UP;
+			if (bits % 40 == 1) players[p] |= MATCH_P1_DOWN;
+			if ((bits >> 8) % 50 == 0) players[p] |= MATCH_P1_FIRE;
+		}
+		hosted.humanButtons[p] = 0;
+	}
+	match.Step(MatchInput((uint8_t)(players[0] | (players[1] << 3))));
+	hosted.finished = match.GetWinner() != 0;
+
+	CaptureSnapshot(match, tick, hosted.history.Add(tick));
+
+	hosted.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Runs on a pool thread
+void MatchServer::EncodeForWatcher(int index)
+{
+	Watcher& watcher = watchers[index];
+	HostedMatch& hosted = matches[watcher.matchId];
+	const Snapshot* baseline = watcher.acked ? hosted.history.Find(watcher.ackedTick) : 0;
+	EncodeSnapshot((uint16_t)watcher.matchId, *hosted.history.Find(tick), baseline, watcher.packet);
+	watcher.fullSnapshot = baseline == 0;
+}
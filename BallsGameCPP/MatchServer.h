@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "JobPool.h"
+#include "Match.h"
+#include "ServerProtocol.h"
+#include "SnapshotCodec.h"
+#include "UdpSocket.h"
+
+// --------------------------------------------------------
+// Hosts many independent matches with no window or device.
+//
+// Every Tick steps each match once, spread over a JobPool, and
+// then sends each match's changes to whoever is watching it.
+// Nobody has to be connected: a player slot with no client
+// sending inputs is played by a button-masher, so a server
+// full of bots is a load test.
+//
+// A finished match starts again straight away with a new seed.
+//
+// Clients talk to it with the packets in ServerProtocol.h.
+//
+// Every tick each watcher gets a snapshot of its match (see
+// SnapshotCodec) encoded against the newest snapshot it acked,
+// so a lost packet just means the next delta is against an
+// older baseline.  Snapshot ticks count server ticks, not match
+// steps, so they never repeat when a match restarts.
+// --------------------------------------------------------
+
+// Snapshots each match keeps to delta against
+const int SERVER_SNAPSHOT_HISTORY = 64;
+
+struct MatchServerStats
+{
+	uint32_t ticks;
+	uint32_t lateTicks;				// Took longer than the tick period
+	uint32_t matchesFinished;
+	std::vector<float> tickMs;		// Wall time of every tick
+	double matchCpuMs;				// Summed over every match, all threads
+	uint64_t bytesSent;
+	uint32_t fullSnapshots;			// Sent with no baseline
+	uint32_t packetsSent;
+	uint32_t requestsReceived;
+};
+
+class MatchServer
+{
+public:
+	// threadCount - 0 uses every core
+	MatchServer(int matchCount, int threadCount, uint64_t seed);
+	~MatchServer();
+
+	// Starts listening for clients.  Without this the matches
+	// still run, there's just nobody to stream them to.
+	bool Open(uint16_t port);
+
+	// Steps every match once.  periodMs is the tick budget, for
+	// counting late ticks; nowMs is any steadily increasing clock.
+	void Tick(double nowMs, double periodMs);
+
+	int GetMatchCount() const { return (int)matches.size(); }
+	int GetThreadCount() const { return pool.GetThreadCount(); }
+	int GetWatcherCount() const { return (int)watchers.size(); }
+	uint64_t GetStolenJobs() const { return pool.GetStolenCount(); }
+
+	MatchServerStats& GetStats() { return stats; }
+	void ResetStats();
+
+private:
+	// Not copyable - owns the matches and the socket
+	MatchServer(const MatchServer&);
+	MatchServer& operator=(const MatchServer&);
+
+	struct HostedMatch
+	{
+		Match* match;
+		SimRandom bots;
+		uint8_t humanButtons[2];	// Latched until the next tick
+		double humanUntilMs[2];		// A client controls the slot until then
+		SnapshotHistory history;
+		double cpuMs;
+		bool finished;
+
+		HostedMatch() : history(SERVER_SNAPSHOT_HISTORY) {}
+	};
+
+	struct Watcher
+	{
+		NetAddress address;
+		int matchId;
+		double lastHeardMs;
+		bool acked;
+		uint32_t ackedTick;
+		bool fullSnapshot;
+		std::vector<uint8_t> packet;
+	};
+
+	void Receive(double nowMs);
+	void TickMatch(int index, double nowMs);
+	void EncodeForWatcher(int index);
+
+	std::vector<HostedMatch> matches;
+	std::vector<Watcher> watchers;
+	JobPool pool;
+	UdpSocket socket;
+	SimRandom seeds;
+	uint32_t tick;
+	MatchServerStats stats;
+};
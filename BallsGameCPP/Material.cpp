@@ -8,6 +8,7 @@ Material::Material(SimpleVertexShader* vs, SimplePixelShader* ps, ID3D11ShaderRe
 	pixelShader = ps;
 
 	texture = tx;
+	normalMap = 0;
 	sampler = ss;
 
 	surfaceColor = XMFLOAT4(1,1,1,1);
@@ -17,6 +18,32 @@ Material::~Material()
 {
 }
 
+bool Material::ReplaceVertexShader(SimpleVertexShader* oldShader, SimpleVertexShader* newShader)
+{
+	if (vertexShader != oldShader)
+		return false;
+
+	vertexShader = newShader;
+	return true;
+}
+
+bool Material::ReplacePixelShader(SimplePixelShader* oldShader, SimplePixelShader* newShader)
+{
+	if (pixelShader != oldShader)
+		return false;
+
+	pixelShader = newShader;
+	return true;
+}
+
+bool Material::ReplaceTexture(ID3D11ShaderResourceView* oldTexture, ID3D11ShaderResourceView* newTexture)
+{
+	bool replaced = false;
+	if (texture == oldTexture) { texture = newTexture; replaced = true; }
+	if (normalMap == oldTexture) { normalMap = newTexture; replaced = true; }
+	return replaced;
+}
+
 void Material::PrepareMaterial(XMFLOAT4X4 worldMatrix, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 {
 	bool err;
@@ -26,6 +26,11 @@ public:
 	void SetSurfaceColor(XMFLOAT4 color) { surfaceColor = color; }
 	void AddNormalMap(ID3D11ShaderResourceView* n) { normalMap = n; }
 
+	// Swaps a resource for a reloaded version, if this material uses it
+	bool ReplaceVertexShader(SimpleVertexShader* oldShader, SimpleVertexShader* newShader);
+	bool ReplacePixelShader(SimplePixelShader* oldShader, SimplePixelShader* newShader);
+	bool ReplaceTexture(ID3D11ShaderResourceView* oldTexture, ID3D11ShaderResourceView* newTexture);
+
 private:
 
 	SimpleVertexShader* vertexShader;
@@ -13,12 +13,20 @@ using namespace DirectX;
 // --------------------------------------------------------
 Mesh::Mesh(Vertex vertexes[], int numVerticies, unsigned int indices[], int numberOfIndicies, ID3D11Device* device)
 {
+	vertexBuffer = 0;
+	boundingRadius = 0;
+	bounds = MeshBounds();
 	CreateBuffers(vertexes, numVerticies, indices, numberOfIndicies, device);
 }
 
 
 Mesh::Mesh(const char* objFile, ID3D11Device* device)
 {
+	// Left empty if the file can't be read
+	vertexBuffer = 0;
+	boundingRadius = 0;
+	bounds = MeshBounds();
+
 	// File input object
 	std::ifstream obj(objFile);
 
@@ -163,6 +171,8 @@ Mesh::Mesh(const char* objFile, ID3D11Device* device)
 
 	// Close the file and create the actual buffers
 	obj.close();
+	if (verts.empty())
+		return;
 	CreateBuffers(&verts[0], vertCounter, &indices[0], vertCounter, device);
 }
 
@@ -170,8 +180,20 @@ Mesh::Mesh(const char* objFile, ID3D11Device* device)
 
 Mesh::~Mesh(void)
 {
-	vertexBuffer->Release(); vertexBuffer = 0; 
-	indexBuffer->Release(); indexBuffer = 0; 
+	if (vertexBuffer) { vertexBuffer->Release(); vertexBuffer = 0; }
+	for (size_t i = 0; i < lodIndexBuffers.size(); i++)
+		if (lodIndexBuffers[i]) lodIndexBuffers[i]->Release();
+	lodIndexBuffers.clear();
+}
+
+void Mesh::SwapBuffers(Mesh* other)
+{
+	std::swap(vertexBuffer, other->vertexBuffer);
+	std::swap(lodIndexBuffers, other->lodIndexBuffers);
+	std::swap(lodIndexCounts, other->lodIndexCounts);
+	std::swap(lodErrors, other->lodErrors);
+	std::swap(boundingRadius, other->boundingRadius);
+	std::swap(bounds, other->bounds);
 }
 
 //Returns the Vertex Buffer
@@ -180,24 +202,62 @@ ID3D11Buffer * Mesh::GetVertexBuffer()
 	return vertexBuffer;
 }
 
-//Returns the Index Buffer
+//Returns the full detail Index Buffer
 ID3D11Buffer * Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return GetIndexBuffer(0);
 }
 
-//Returns the number of indicies this mesh contains
+//Returns the number of indicies the full detail mesh contains
 int Mesh::GetIndexCount()
 {
-	return numIndices;
+	return GetIndexCount(0);
 }
 
-void Mesh::CreateBuffers(Vertex * vertexes, int numVerticies, unsigned int * indices, int numberOfIndicies, ID3D11Device * device)
+int Mesh::GetLODCount()
+{
+	return (int)lodIndexBuffers.size();
+}
+
+ID3D11Buffer * Mesh::GetIndexBuffer(int lod)
+{
+	return lod < (int)lodIndexBuffers.size() ? lodIndexBuffers[lod] : 0;
+}
+
+int Mesh::GetIndexCount(int lod)
+{
+	return lod < (int)lodIndexCounts.size() ? lodIndexCounts[lod] : 0;
+}
+
+float Mesh::GetBoundingRadius()
+{
+	return boundingRadius;
+}
+
+const MeshBounds& Mesh::GetBounds()
+{
+	return bounds;
+}
+
+int Mesh::SelectLOD(float projectedRadius, float maxErrorPixels)
 {
-	numIndices = numberOfIndicies;
+	if (lodErrors.empty())
+		return 0;
+	return ::SelectLOD(&lodErrors[0], (int)lodErrors.size(), boundingRadius, projectedRadius, maxErrorPixels);
+}
 
+void Mesh::CreateBuffers(Vertex * vertexes, int numVerticies, unsigned int * indices, int numberOfIndicies, ID3D11Device * device)
+{
 	//Get tangents
-	CalculateTangents(vertexes, numVerticies, indices, numIndices);
+	CalculateTangents(vertexes, numVerticies, indices, numberOfIndicies);
+
+	// Build the LOD chain - every level indexes into the same vertices
+	// (position, then UV and normal must match for verts to weld)
+	std::vector<SimplifyResult> levels;
+	BuildLODChain(&vertexes[0].Position.x, numVerticies, sizeof(Vertex), 5,
+		indices, numberOfIndicies, MESH_LOD_LEVELS, levels);
+	boundingRadius = MeshBoundingRadius(&vertexes[0].Position.x, numVerticies, sizeof(Vertex));
+	bounds = ComputeMeshBounds(&vertexes[0].Position.x, numVerticies, sizeof(Vertex));
 
 	// Create the VERTEX BUFFER description -----------------------------------
 	D3D11_BUFFER_DESC vbd;
@@ -216,22 +276,27 @@ void Mesh::CreateBuffers(Vertex * vertexes, int numVerticies, unsigned int * ind
 	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
 	device->CreateBuffer(&vbd, &initialVertexData, &vertexBuffer);
 
-	// Create the INDEX BUFFER description ------------------------------------
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(int) * numIndices;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-
-	// Create the proper struct to hold the initial index data, and put the data into the buffer
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = indices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+	// Create an INDEX BUFFER per LOD ---------------------------------------
+	for (size_t i = 0; i < levels.size() && !levels[i].indices.empty(); i++)
+	{
+		D3D11_BUFFER_DESC ibd;
+		ibd.Usage = D3D11_USAGE_IMMUTABLE;
+		ibd.ByteWidth = sizeof(int) * (UINT)levels[i].indices.size();
+		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		ibd.CPUAccessFlags = 0;
+		ibd.MiscFlags = 0;
+		ibd.StructureByteStride = 0;
+
+		D3D11_SUBRESOURCE_DATA initialIndexData;
+		initialIndexData.pSysMem = &levels[i].indices[0];
+
+		ID3D11Buffer* indexBuffer = 0;
+		device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
+
+		lodIndexBuffers.push_back(indexBuffer);
+		lodIndexCounts.push_back((int)levels[i].indices.size());
+		lodErrors.push_back(levels[i].error);
+	}
 }
 
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
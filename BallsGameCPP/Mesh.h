@@ -1,10 +1,22 @@
 #pragma once
 
 #include "Vertex.h"
+#include "MeshSimplifier.h"
+#include "FrustumCuller.h"
 #include <d3d11.h>
 #include <DirectXMath.h>
 #include <vector>
 #include <fstream>
+#include <utility>
+
+// LOD levels generated per mesh (including the full detail one)
+const int MESH_LOD_LEVELS = 4;
+
+// How far (in pixels) a LOD may stray from the full mesh before
+// a more detailed one is used.  Shadow maps are filtered and only
+// show silhouettes, so casters can go coarser
+const float LOD_MAX_ERROR_PIXELS = 1.0f;
+const float LOD_SHADOW_MAX_ERROR_PIXELS = 2.0f;
 
 class Mesh
 {
@@ -18,13 +30,33 @@ public:
 	ID3D11Buffer* GetIndexBuffer();
 	int GetIndexCount();
 
+	// Every LOD shares the vertex buffer and has its own index buffer
+	int GetLODCount();
+	ID3D11Buffer* GetIndexBuffer(int lod);
+	int GetIndexCount(int lod);
+	float GetBoundingRadius();
+
+	// Box and sphere for culling, worked out at load
+	const MeshBounds& GetBounds();
+
+	// Coarsest LOD that stays within maxErrorPixels when the
+	// bounding radius covers projectedRadius pixels on screen
+	int SelectLOD(float projectedRadius, float maxErrorPixels);
+
+	// Takes the other mesh's buffers (used for hot reloading) -
+	// the other mesh gets this one's old buffers to release
+	void SwapBuffers(Mesh* other);
+
 private:
 
 	//Buffers
 	ID3D11Buffer* vertexBuffer;
-	ID3D11Buffer* indexBuffer;
+	std::vector<ID3D11Buffer*> lodIndexBuffers;
+	std::vector<int> lodIndexCounts;
+	std::vector<float> lodErrors;
 
-	int numIndices;
+	float boundingRadius;
+	MeshBounds bounds;
 
 	void CreateBuffers(Vertex* vertArray, int numVerts, unsigned int* indexArray, int numIndices, ID3D11Device* device);
 	void CalculateTangents(Vertex * verts, int numVerts, unsigned int * indices, int numIndices);
@@ -0,0 +1,497 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Symmetric 4x4 error quadric, upper triangle only:
+//   a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+// 'weight' is the triangle area summed into it, so the error
+// can be turned back into an average distance
+// --------------------------------------------------------
+struct Quadric
+{
+	double a[10];
+	double weight;
+};
+
+static void QuadricZero(Quadric& q)
+{
+	memset(&q, 0, sizeof(Quadric));
+}
+
+static void QuadricAdd(Quadric& q, const Quadric& other)
+{
+	for (int i = 0; i < 10; i++)
+		q.a[i] += other.a[i];
+	q.weight += other.weight;
+}
+
+// Adds the plane (nx, ny, nz, d), weighted by area
+static void QuadricAddPlane(Quadric& q, double nx, double ny, double nz, double d, double area)
+{
+	q.a[0] += area * nx * nx; q.a[1] += area * nx * ny; q.a[2] += area * nx * nz; q.a[3] += area * nx * d;
+	q.a[4] += area * ny * ny; q.a[5] += area * ny * nz; q.a[6] += area * ny * d;
+	q.a[7] += area * nz * nz; q.a[8] += area * nz * d;
+	q.a[9] += area * d * d;
+	q.weight += area;
+}
+
+// Sum of squared distances (times area) from p to every plane in q
+static double QuadricError(const Quadric& q, const double* p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	double e =
+		q.a[0] * x * x + 2 * q.a[1] * x * y + 2 * q.a[2] * x * z + 2 * q.a[3] * x +
+		q.a[4] * y * y + 2 * q.a[5] * y * z + 2 * q.a[6] * y +
+		q.a[7] * z * z + 2 * q.a[8] * z +
+		q.a[9];
+	return e < 0 ? 0 : e;
+}
+
+static void Cross(const double* a, const double* b, double* out)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Unnormalized triangle normal (length is twice the area)
+static void TriangleNormal(const double* p0, const double* p1, const double* p2, double* n)
+{
+	double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	Cross(e1, e2, n);
+}
+
+// A triangle during simplification: welded vertex ids for the
+// topology, original vertex ids for the output
+struct SimplifyTriangle
+{
+	unsigned int welded[3];
+	unsigned int original[3];
+	bool alive;
+};
+
+// Sorted welded ids, for finding repeated triangles
+struct TriangleKey
+{
+	unsigned int welded[3];
+	unsigned int triangle;
+
+	bool operator<(const TriangleKey& other) const
+	{
+		if (welded[0] != other.welded[0]) return welded[0] < other.welded[0];
+		if (welded[1] != other.welded[1]) return welded[1] < other.welded[1];
+		if (welded[2] != other.welded[2]) return welded[2] < other.welded[2];
+		return triangle < other.triangle;
+	}
+};
+
+struct CollapseEdge
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+
+	bool operator<(const CollapseEdge& other) const { return cost < other.cost; }
+};
+
+struct PositionKey
+{
+	float p[3];
+	bool operator==(const PositionKey& other) const { return memcmp(p, other.p, sizeof(p)) == 0; }
+};
+
+struct PositionHash
+{
+	size_t operator()(const PositionKey& key) const
+	{
+		uint32_t bits[3];
+		memcpy(bits, key.p, sizeof(bits));
+		return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+	}
+};
+
+static const float* VertexAt(const float* vertices, size_t vertexStride, size_t index)
+{
+	return (const float*)((const char*)vertices + index * vertexStride);
+}
+
+// Exporters write a normal per face corner, so smooth normals
+// rarely match exactly - anything this close is the same vert
+static bool AttributesMatch(const float* a, const float* b, size_t count)
+{
+	const float ATTRIBUTE_EPSILON = 1e-3f;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (fabsf(a[i] - b[i]) > ATTRIBUTE_EPSILON)
+			return false;
+	}
+	return true;
+}
+
+void SimplifyMesh(
+	const float* vertices, size_t vertexCount, size_t vertexStride, size_t attributeFloats,
+	const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount,
+	SimplifyResult& result)
+{
+	result.indices.clear();
+	result.error = 0;
+
+	// Weld by exact position, and lock any position whose verts disagree on attributes
+	std::unordered_map<PositionKey, unsigned int, PositionHash> weldMap;
+	std::vector<unsigned int> weldedOf(vertexCount);
+	std::vector<unsigned int> firstOriginal;
+	std::vector<bool> locked;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* v = VertexAt(vertices, vertexStride, i);
+		PositionKey key = { { v[0], v[1], v[2] } };
+
+		std::pair<std::unordered_map<PositionKey, unsigned int, PositionHash>::iterator, bool> inserted =
+			weldMap.insert(std::make_pair(key, (unsigned int)firstOriginal.size()));
+		unsigned int w = inserted.first->second;
+		weldedOf[i] = w;
+
+		if (inserted.second)
+		{
+			firstOriginal.push_back((unsigned int)i);
+			locked.push_back(false);
+		}
+		else if (!AttributesMatch(v + 3, VertexAt(vertices, vertexStride, firstOriginal[w]) + 3, attributeFloats))
+		{
+			locked[w] = true;
+		}
+	}
+
+	size_t weldedCount = firstOriginal.size();
+	std::vector<double> positions(weldedCount * 3);
+	for (size_t w = 0; w < weldedCount; w++)
+	{
+		const float* v = VertexAt(vertices, vertexStride, firstOriginal[w]);
+		positions[w * 3 + 0] = v[0];
+		positions[w * 3 + 1] = v[1];
+		positions[w * 3 + 2] = v[2];
+	}
+
+	// Triangles, skipping any that collapsed to a line when welded
+	std::vector<SimplifyTriangle> triangles;
+	triangles.reserve(indexCount / 3);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		SimplifyTriangle t;
+		for (int c = 0; c < 3; c++)
+		{
+			t.original[c] = indices[i + c];
+			t.welded[c] = weldedOf[indices[i + c]];
+		}
+		t.alive = t.welded[0] != t.welded[1] && t.welded[1] != t.welded[2] && t.welded[0] != t.welded[2];
+		if (t.alive)
+			triangles.push_back(t);
+	}
+
+	// Drop repeated triangles (same three positions) - some exported
+	// models contain every face twice, which would also make every
+	// edge look non-manifold and lock the whole mesh
+	{
+		std::vector<TriangleKey> keys(triangles.size());
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			unsigned int* w = keys[t].welded;
+			memcpy(w, triangles[t].welded, sizeof(keys[t].welded));
+			std::sort(w, w + 3);
+			keys[t].triangle = (unsigned int)t;
+		}
+		std::sort(keys.begin(), keys.end());
+		for (size_t k = 1; k < keys.size(); k++)
+		{
+			if (memcmp(keys[k].welded, keys[k - 1].welded, sizeof(keys[k].welded)) == 0)
+				triangles[keys[k].triangle].alive = false;
+		}
+
+		size_t kept = 0;
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			if (triangles[t].alive)
+				triangles[kept++] = triangles[t];
+		}
+		triangles.resize(kept);
+	}
+
+	// Lock open borders and non-manifold edges (anything not shared by exactly two triangles)
+	{
+		std::unordered_map<unsigned long long, int> edgeUse;
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int a = triangles[t].welded[c];
+				unsigned int b = triangles[t].welded[(c + 1) % 3];
+				unsigned long long key = a < b ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+				edgeUse[key]++;
+			}
+		}
+		for (std::unordered_map<unsigned long long, int>::iterator it = edgeUse.begin(); it != edgeUse.end(); it++)
+		{
+			if (it->second != 2)
+			{
+				locked[(unsigned int)(it->first >> 32)] = true;
+				locked[(unsigned int)(it->first & 0xFFFFFFFF)] = true;
+			}
+		}
+	}
+
+	// Every vertex starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(weldedCount);
+	for (size_t w = 0; w < weldedCount; w++)
+		QuadricZero(quadrics[w]);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		const double* p0 = &positions[triangles[t].welded[0] * 3];
+		const double* p1 = &positions[triangles[t].welded[1] * 3];
+		const double* p2 = &positions[triangles[t].welded[2] * 3];
+
+		double n[3];
+		TriangleNormal(p0, p1, p2, n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0)
+			continue;
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+		Quadric q;
+		QuadricZero(q);
+		QuadricAddPlane(q, n[0], n[1], n[2], d, length * 0.5);
+		for (int c = 0; c < 3; c++)
+			QuadricAdd(quadrics[triangles[t].welded[c]], q);
+	}
+
+	size_t liveTriangles = triangles.size();
+	size_t targetTriangles = targetIndexCount / 3;
+
+	// Each pass collapses a set of edges that don't touch each other,
+	// cheapest first, then rebuilds adjacency and goes again
+	std::vector<std::vector<unsigned int> > vertexTriangles(weldedCount);
+	std::vector<CollapseEdge> edges;
+	std::vector<unsigned char> touched(weldedCount);
+	std::vector<unsigned int> neighbours;
+	while (liveTriangles > targetTriangles)
+	{
+		for (size_t w = 0; w < weldedCount; w++)
+			vertexTriangles[w].clear();
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			if (!triangles[t].alive)
+				continue;
+			for (int c = 0; c < 3; c++)
+				vertexTriangles[triangles[t].welded[c]].push_back((unsigned int)t);
+		}
+
+		// Cheapest direction for every edge (each edge is seen from both triangles, that's fine)
+		edges.clear();
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			if (!triangles[t].alive)
+				continue;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int a = triangles[t].welded[c];
+				unsigned int b = triangles[t].welded[(c + 1) % 3];
+				if (a > b || (locked[a] && locked[b]))
+					continue;
+
+				Quadric q = quadrics[a];
+				QuadricAdd(q, quadrics[b]);
+
+				CollapseEdge edge;
+				double costAB = locked[a] ? -1 : QuadricError(q, &positions[b * 3]);
+				double costBA = locked[b] ? -1 : QuadricError(q, &positions[a * 3]);
+				if (costBA < 0 || (costAB >= 0 && costAB <= costBA))
+				{
+					edge.from = a; edge.to = b; edge.cost = costAB;
+				}
+				else
+				{
+					edge.from = b; edge.to = a; edge.cost = costBA;
+				}
+				edges.push_back(edge);
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		memset(&touched[0], 0, touched.size());
+		size_t collapsed = 0;
+		for (size_t e = 0; e < edges.size() && liveTriangles > targetTriangles; e++)
+		{
+			unsigned int u = edges[e].from;
+			unsigned int v = edges[e].to;
+			if (touched[u] || touched[v])
+				continue;
+
+			const std::vector<unsigned int>& around = vertexTriangles[u];
+
+			// Link condition: u and v may only share the two vertices
+			// opposite their edge, or the collapse pinches the surface
+			neighbours.clear();
+			for (size_t i = 0; i < around.size(); i++)
+				for (int c = 0; c < 3; c++)
+					neighbours.push_back(triangles[around[i]].welded[c]);
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+			int shared = 0;
+			for (size_t i = 0; i < vertexTriangles[v].size(); i++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					unsigned int n = triangles[vertexTriangles[v][i]].welded[c];
+					if (n != u && n != v && std::binary_search(neighbours.begin(), neighbours.end(), n))
+					{
+						shared++;
+					}
+				}
+			}
+			// Each shared neighbour is counted once per triangle around v that has it - two each
+			if (shared > 4)
+				continue;
+
+			// No triangle around u may flip or collapse to nothing, and v's
+			// original vert comes from a triangle on the edge
+			bool valid = true;
+			unsigned int vOriginal = firstOriginal[v];
+			for (size_t i = 0; i < around.size() && valid; i++)
+			{
+				const SimplifyTriangle& t = triangles[around[i]];
+				int cu = t.welded[0] == u ? 0 : (t.welded[1] == u ? 1 : 2);
+				int cv = t.welded[0] == v ? 0 : (t.welded[1] == v ? 1 : (t.welded[2] == v ? 2 : -1));
+				if (cv >= 0)
+				{
+					vOriginal = t.original[cv];
+					continue;
+				}
+
+				const double* p[3] = { &positions[t.welded[0] * 3], &positions[t.welded[1] * 3], &positions[t.welded[2] * 3] };
+				double before[3], after[3];
+				TriangleNormal(p[0], p[1], p[2], before);
+				p[cu] = &positions[v * 3];
+				TriangleNormal(p[0], p[1], p[2], after);
+
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				double lengthBefore = sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+				double lengthAfter = sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+				if (dot <= 0.2 * lengthBefore * lengthAfter)
+					valid = false;
+			}
+			if (!valid)
+				continue;
+
+			// Collapse u onto v
+			for (size_t i = 0; i < around.size(); i++)
+			{
+				SimplifyTriangle& t = triangles[around[i]];
+				for (int c = 0; c < 3; c++)
+					touched[t.welded[c]] = 1;
+
+				if (t.welded[0] == v || t.welded[1] == v || t.welded[2] == v)
+				{
+					t.alive = false;
+					liveTriangles--;
+					continue;
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					if (t.welded[c] == u)
+					{
+						t.welded[c] = v;
+						t.original[c] = vOriginal;
+					}
+				}
+			}
+
+			double weight = quadrics[u].weight + quadrics[v].weight;
+			float error = weight > 0 ? (float)sqrt(edges[e].cost / weight) : 0;
+			result.error = std::max(result.error, error);
+
+			QuadricAdd(quadrics[v], quadrics[u]);
+			collapsed++;
+		}
+
+		if (collapsed == 0)
+			break;
+	}
+
+	result.indices.reserve(liveTriangles * 3);
+	for (size_t t = 0; t < triangles.size(); t++)
+	{
+		if (!triangles[t].alive)
+			continue;
+		result.indices.push_back(triangles[t].original[0]);
+		result.indices.push_back(triangles[t].original[1]);
+		result.indices.push_back(triangles[t].original[2]);
+	}
+}
+
+void BuildLODChain(
+	const float* vertices, size_t vertexCount, size_t vertexStride, size_t attributeFloats,
+	const unsigned int* indices, size_t indexCount,
+	size_t maxLevels,
+	std::vector<SimplifyResult>& levels)
+{
+	levels.clear();
+	if (maxLevels == 0)
+		return;
+
+	// Level 0 is the input with nothing collapsed, just repeated
+	// and degenerate triangles removed
+	SimplifyResult full;
+	SimplifyMesh(vertices, vertexCount, vertexStride, attributeFloats, indices, indexCount, indexCount, full);
+	levels.push_back(full);
+
+	while (levels.size() < maxLevels)
+	{
+		// Each level simplifies the one before it, so errors add up
+		const SimplifyResult& previous = levels.back();
+		size_t target = (previous.indices.size() / 6) * 3;
+
+		SimplifyResult next;
+		SimplifyMesh(vertices, vertexCount, vertexStride, attributeFloats,
+			previous.indices.empty() ? 0 : &previous.indices[0], previous.indices.size(),
+			target, next);
+
+		if (next.indices.empty() || next.indices.size() * 4 > previous.indices.size() * 3)
+			break;
+
+		next.error += previous.error;
+		levels.push_back(next);
+	}
+}
+
+float MeshBoundingRadius(const float* vertices, size_t vertexCount, size_t vertexStride)
+{
+	float radiusSquared = 0;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* v = VertexAt(vertices, vertexStride, i);
+		radiusSquared = std::max(radiusSquared, v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+	return sqrtf(radiusSquared);
+}
+
+int SelectLOD(const float* levelErrors, int levelCount, float radius, float projectedRadius, float maxErrorPixels)
+{
+	if (radius <= 0)
+		return 0;
+
+	float pixelsPerUnit = projectedRadius / radius;
+	for (int i = levelCount - 1; i > 0; i--)
+	{
+		if (levelErrors[i] * pixelsPerUnit <= maxErrorPixels)
+			return i;
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// --------------------------------------------------------
+// Quadric error metric edge-collapse simplification
+// (Garland & Heckbert), used to build mesh LOD chains.
+//
+// Collapses always move a vertex onto one of its neighbours,
+// so a simplified mesh is just a new index list into the
+// ORIGINAL vertices - every LOD shares the full-detail vertex
+// buffer and only needs its own index buffer.
+//
+// OBJ meshes come in unindexed (three unique verts per
+// triangle), so vertices are welded by position first.  A
+// position shared by verts with different attributes (UV
+// seams, hard normal edges) or lying on an open border is
+// locked in place, which keeps textures from tearing.
+//
+// Vertices come in as a float pointer and a stride rather than
+// as the game's Vertex, so Tools/MeshLOD.cpp can feed it what it
+// loads itself.
+// --------------------------------------------------------
+
+struct SimplifyResult
+{
+	std::vector<unsigned int> indices;	// Into the original vertices
+	float error;						// Largest collapse error, in mesh units (roughly a distance)
+};
+
+// vertices        - Vertex data; each vertex starts with a float3 position
+// vertexCount     - Number of vertices
+// vertexStride    - Size of one vertex in bytes
+// attributeFloats - How many floats right after the position must match
+//                   for two verts to count as the same (UV + normal = 5,
+//                   compared with a small tolerance)
+// indices         - Triangle list
+// targetIndexCount- Stop once the triangle list is this small (or nothing
+//                   more can be collapsed)
+void SimplifyMesh(
+	const float* vertices, size_t vertexCount, size_t vertexStride, size_t attributeFloats,
+	const unsigned int* indices, size_t indexCount,
+	size_t targetIndexCount,
+	SimplifyResult& result);
+
+// --------------------------------------------------------
+// Builds a LOD chain by repeatedly halving the triangle count.
+// Level 0 is the input minus repeated and degenerate triangles.  A level is only kept if it drops at
+// least a quarter of the previous level's triangles, so meshes
+// that can't simplify (a cube) end up with just level 0.
+// --------------------------------------------------------
+void BuildLODChain(
+	const float* vertices, size_t vertexCount, size_t vertexStride, size_t attributeFloats,
+	const unsigned int* indices, size_t indexCount,
+	size_t maxLevels,
+	std::vector<SimplifyResult>& levels);
+
+// Distance from the origin to the farthest vertex
+float MeshBoundingRadius(const float* vertices, size_t vertexCount, size_t vertexStride);
+
+// --------------------------------------------------------
+// Picks the coarsest level whose error, projected to the
+// screen, stays under maxErrorPixels.
+//
+// levelErrors     - SimplifyResult::error for each level
+// radius          - Bounding radius of the mesh in model units
+// projectedRadius - That radius as it appears on screen, in pixels
+// --------------------------------------------------------
+int SelectLOD(const float* levelErrors, int levelCount, float radius, float projectedRadius, float maxErrorPixels);
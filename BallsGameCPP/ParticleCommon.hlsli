@@ -0,0 +1,61 @@
+// --------------------------------------------------------
+// Shared by the particle compute shaders and the vertex
+// shader that draws their output.  Kept in step with
+// ParticleSim.cpp, the CPU reference.
+// --------------------------------------------------------
+
+// As ParticleState; 32 bytes
+struct Particle
+{
+	float3 position;
+	float life;
+	float3 velocity;
+	uint id;
+};
+
+// As ParticleEmit
+struct Emit
+{
+	float3 position;
+	float speed;
+	uint count;
+	uint first;
+	uint firstId;
+	uint seed;
+};
+
+// PCG, as ParticleHash
+uint ParticleHash(uint value)
+{
+	uint state = value * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+	return (word >> 22) ^ word;
+}
+
+float ParticleRandom(uint seed, uint index, uint channel)
+{
+	return (ParticleHash(seed ^ ParticleHash(index * 4 + channel)) >> 8) * (1.0f / 16777216.0f);
+}
+
+Particle SpawnParticle(Emit emit, uint index, float lifetime)
+{
+	float z = ParticleRandom(emit.seed, index, 0) * 2 - 1;
+	float phi = ParticleRandom(emit.seed, index, 1) * 6.2831853f;
+	float speed = emit.speed * (0.5f + 0.5f * ParticleRandom(emit.seed, index, 2));
+	float r = sqrt(max(0.0f, 1 - z * z));
+
+	Particle p;
+	p.position = emit.position;
+	p.life = lifetime * (0.5f + 0.5f * ParticleRandom(emit.seed, index, 3));
+	p.velocity = float3(r * cos(phi), r * sin(phi), z) * speed;
+	p.id = emit.firstId + index;
+	return p;
+}
+
+bool StepParticle(inout Particle p, float dt, float drag)
+{
+	p.velocity *= saturate(1 - drag * dt);
+	p.position += p.velocity * dt;
+	p.life -= dt;
+	return p.life > 0;
+}
@@ -0,0 +1,110 @@
+#include "ParticleRenderer.h"
+#include "Profiler.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+ParticleRenderer::ParticleRenderer(ID3D11Device* device, ID3D11DeviceContext* context)
+	: device(device), context(context)
+{
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+	drawCalls = 0;
+
+	// A unit quad around the particle, as a triangle strip
+	XMFLOAT2 corners[4] =
+	{
+		XMFLOAT2(-0.5f, +0.5f),
+		XMFLOAT2(+0.5f, +0.5f),
+		XMFLOAT2(-0.5f, -0.5f),
+		XMFLOAT2(+0.5f, -0.5f),
+	};
+
+	D3D11_BUFFER_DESC cbd = {};
+	cbd.Usage = D3D11_USAGE_IMMUTABLE;
+	cbd.ByteWidth = sizeof(corners);
+	cbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA initialCornerData = {};
+	initialCornerData.pSysMem = corners;
+	cornerBuffer = 0;
+	device->CreateBuffer(&cbd, &initialCornerData, &cornerBuffer);
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+	if (cornerBuffer) cornerBuffer->Release();
+	if (instanceBuffer) instanceBuffer->Release();
+}
+
+// Doubles until count fits, so the buffer settles at the
+// biggest explosion seen
+bool ParticleRenderer::Reserve(size_t count)
+{
+	if (count <= instanceCapacity)
+		return true;
+
+	size_t capacity = instanceCapacity ? instanceCapacity : 256;
+	while (capacity < count)
+		capacity *= 2;
+
+	if (instanceBuffer) instanceBuffer->Release();
+	instanceBuffer = 0;
+	instanceCapacity = 0;
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_DYNAMIC;
+	ibd.ByteWidth = (UINT)(sizeof(ParticleInstance) * capacity);
+	ibd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&ibd, 0, &instanceBuffer)))
+		return false;
+
+	instanceCapacity = capacity;
+	return true;
+}
+
+void ParticleRenderer::Draw(const ParticleInstance* particles, size_t count,
+	SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader,
+	ID3D11ShaderResourceView* texture, ID3D11SamplerState* sampler,
+	ID3D11BlendState* blendState, ID3D11DepthStencilState* depthState,
+	const XMFLOAT4X4& view, const XMFLOAT4X4& projection)
+{
+	PROFILE_SCOPE("ParticleRenderer::Draw");
+	drawCalls = 0;
+	if (count == 0 || !cornerBuffer || !Reserve(count))
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, particles, sizeof(ParticleInstance) * count);
+	context->Unmap(instanceBuffer, 0);
+
+	ID3D11Buffer* buffers[2] = { cornerBuffer, instanceBuffer };
+	UINT strides[2] = { sizeof(XMFLOAT2), sizeof(ParticleInstance) };
+	UINT offsets[2] = { 0, 0 };
+	context->IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	vertexShader->SetMatrix4x4("view", view);
+	vertexShader->SetMatrix4x4("projection", projection);
+	vertexShader->CopyAllBufferData();
+	vertexShader->SetShader();
+
+	pixelShader->SetShaderResourceView("Particle", texture);
+	pixelShader->SetSamplerState("Sampler", sampler);
+	pixelShader->SetShader();
+
+	float blend[4] = { 1, 1, 1, 1 };
+	context->OMSetBlendState(blendState, blend, 0xffffffff);
+	context->OMSetDepthStencilState(depthState, 0);
+
+	context->DrawInstanced(4, (UINT)count, 0, 0);
+	drawCalls = 1;
+
+	// Back to what everything else expects
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->OMSetBlendState(0, blend, 0xffffffff);
+	context->OMSetDepthStencilState(0, 0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <vector>
+
+#include "SimpleShader.h"
+
+// One particle as the vertex shader reads it; the layout has to
+// match the _PER_INSTANCE inputs of VertexShaderParticle.hlsl
+struct ParticleInstance
+{
+	float x, y, z;
+	float size;			// Width and height in world units
+	float fade;			// 1 when born, 0 when gone
+};
+
+// --------------------------------------------------------
+// Draws every live particle, from every emitter, as a camera
+// facing quad in one DrawInstanced.
+//
+// Particles used to be pooled GameEntities drawn through the
+// lit material path, each with its own world matrix,
+// PrepareMaterial and DrawIndexed.  Here each is five floats
+// in a dynamic instance buffer; a four vertex corner buffer
+// is the per-vertex stream, and the vertex shader turns each
+// instance into a quad facing the camera (SimpleShader puts
+// _PER_INSTANCE inputs in slot 1).
+//
+// Blending and depth states are the caller's - the game's
+// additive blend and its no-depth-write particle state.
+// --------------------------------------------------------
+class ParticleRenderer
+{
+public:
+	ParticleRenderer(ID3D11Device* device, ID3D11DeviceContext* context);
+	~ParticleRenderer();
+
+	// Shaders are passed in each time since the hot reloader
+	// may have swapped them
+	void Draw(const ParticleInstance* particles, size_t count,
+		SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader,
+		ID3D11ShaderResourceView* texture, ID3D11SamplerState* sampler,
+		ID3D11BlendState* blendState, ID3D11DepthStencilState* depthState,
+		const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection);
+
+	// Draw calls the last Draw made; one, unless nothing was alive
+	int GetDrawCalls() const { return drawCalls; }
+
+private:
+	bool Reserve(size_t count);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	ID3D11Buffer* cornerBuffer;
+	ID3D11Buffer* instanceBuffer;
+	size_t instanceCapacity;
+	int drawCalls;
+};
@@ -0,0 +1,142 @@
+#include "ParticleSim.h"
+
+#include <algorithm>
+#include <cmath>
+
+// A float in [0, 1) from one of a particle's random channels
+static float ParticleRandom(uint32_t seed, uint32_t index, uint32_t channel)
+{
+	return (ParticleHash(seed ^ ParticleHash(index * 4 + channel)) >> 8) * (1.0f / 16777216.0f);
+}
+
+ParticleState SpawnParticle(const ParticleEmit& emit, uint32_t index, const ParticleSimConfig& config)
+{
+	// A direction uniform over the sphere, and a speed and life
+	// between half and all of the most
+	float z = ParticleRandom(emit.seed, index, 0) * 2 - 1;
+	float phi = ParticleRandom(emit.seed, index, 1) * 6.2831853f;
+	float speed = emit.speed * (0.5f + 0.5f * ParticleRandom(emit.seed, index, 2));
+	float r = sqrtf(std::max(0.0f, 1 - z * z));
+
+	ParticleState p;
+	p.x = emit.x;
+	p.y = emit.y;
+	p.z = emit.z;
+	p.life = config.lifetime * (0.5f + 0.5f * ParticleRandom(emit.seed, index, 3));
+	p.vx = r * cosf(phi) * speed;
+	p.vy = r * sinf(phi) * speed;
+	p.vz = z * speed;
+	p.id = emit.firstId + index;
+	return p;
+}
+
+bool StepParticle(ParticleState& p, float dt, const ParticleSimConfig& config)
+{
+	float keep = std::min(std::max(1 - config.drag * dt, 0.0f), 1.0f);
+	p.vx *= keep;
+	p.vy *= keep;
+	p.vz *= keep;
+	p.x += p.vx * dt;
+	p.y += p.vy * dt;
+	p.z += p.vz * dt;
+	p.life -= dt;
+	return p.life > 0;
+}
+
+ParticleEmitQueue::ParticleEmitQueue()
+{
+	newCount = 0;
+	nextId = 0;
+}
+
+bool ParticleEmitQueue::Add(float x, float y, float z, uint32_t count, float speed)
+{
+	if (emits.size() >= PARTICLE_MAX_EMITS)
+		return false;
+
+	ParticleEmit emit;
+	emit.x = x;
+	emit.y = y;
+	emit.z = z;
+	emit.speed = speed;
+	emit.count = count;
+	emit.first = newCount;
+	emit.firstId = nextId;
+	emit.seed = ParticleHash(nextId);
+	emits.push_back(emit);
+
+	newCount += count;
+	nextId += count;
+	return true;
+}
+
+void ParticleEmitQueue::Clear()
+{
+	emits.clear();
+	newCount = 0;
+}
+
+ParticleSim::ParticleSim(const ParticleSimConfig& config) : config(config)
+{
+}
+
+void ParticleSim::Step(float dt, const std::vector<ParticleEmit>& emits)
+{
+	// Consume, move, append the survivors
+	next.clear();
+	for (size_t i = 0; i < particles.size(); i++)
+	{
+		ParticleState p = particles[i];
+		if (StepParticle(p, dt, config))
+			next.push_back(p);
+	}
+	particles.swap(next);
+
+	// New particles past the capacity are dropped, last first,
+	// as the emit shader drops them
+	uint32_t room = config.capacity > particles.size() ? config.capacity - (uint32_t)particles.size() : 0;
+	for (size_t e = 0; e < emits.size(); e++)
+	{
+		const ParticleEmit& emit = emits[e];
+		for (uint32_t i = 0; i < emit.count && emit.first + i < room; i++)
+			particles.push_back(SpawnParticle(emit, i, config));
+	}
+}
+
+static bool ById(const ParticleState& a, const ParticleState& b)
+{
+	return a.id < b.id;
+}
+
+ParticleParityResult CompareParticles(std::vector<ParticleState>& a, std::vector<ParticleState>& b)
+{
+	std::sort(a.begin(), a.end(), ById);
+	std::sort(b.begin(), b.end(), ById);
+
+	ParticleParityResult result = {};
+	result.countA = a.size();
+	result.countB = b.size();
+
+	size_t i = 0, j = 0;
+	while (i < a.size() && j < b.size())
+	{
+		if (a[i].id < b[j].id) { result.unmatched++; i++; continue; }
+		if (b[j].id < a[i].id) { result.unmatched++; j++; continue; }
+
+		const ParticleState& p = a[i++];
+		const ParticleState& q = b[j++];
+		float position = std::max(std::fabs(p.x - q.x), std::max(std::fabs(p.y - q.y), std::fabs(p.z - q.z)));
+		float velocity = std::max(std::fabs(p.vx - q.vx), std::max(std::fabs(p.vy - q.vy), std::fabs(p.vz - q.vz)));
+		result.maxPositionError = std::max(result.maxPositionError, position);
+		result.maxVelocityError = std::max(result.maxVelocityError, velocity);
+		result.maxLifeError = std::max(result.maxLifeError, std::fabs(p.life - q.life));
+	}
+	result.unmatched += (a.size() - i) + (b.size() - j);
+	return result;
+}
+
+bool ParticlesMatch(const ParticleParityResult& result, float tolerance)
+{
+	return result.unmatched == 0 && result.countA == result.countB &&
+		result.maxPositionError <= tolerance && result.maxVelocityError <= tolerance && result.maxLifeError <= tolerance;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Explosion particles as a GPU compute shader runs them, with
+// the same rules on the CPU for reference.
+//
+// Every step the live particles are consumed, moved, aged and
+// appended to a second list if they're still alive, then this
+// step's bursts append their new particles after them, up to
+// the capacity.  GpuParticleSystem does this with append and
+// consume buffers and ComputeShaderParticle*.hlsl; ParticleSim
+// here does it with vectors.  Nothing is random except through
+// ParticleHash of a burst's seed and a particle's index, so the
+// two agree on every particle up to float rounding, though the
+// GPU's appends come out in any order - CompareParticles
+// matches them up by id.
+//
+// These particles are only for show.  The match's own Emitters
+// stay as they are, deterministic and in its snapshots; the
+// game turns each new one into a burst here.
+// --------------------------------------------------------
+
+// As the shaders' Particle struct; 32 bytes
+struct ParticleState
+{
+	float x, y, z;
+	float life;			// Seconds left
+	float vx, vy, vz;
+	uint32_t id;
+};
+
+// One step's worth of new particles from one place; as the
+// shaders' Emit struct
+struct ParticleEmit
+{
+	float x, y, z;
+	float speed;		// Average, in units a second
+	uint32_t count;
+	uint32_t first;		// Of this step's new particles, where this burst's start
+	uint32_t firstId;	// id of the first, the rest follow on
+	uint32_t seed;
+};
+
+// Bursts in one step; the size of the GPU's emit buffer
+const int PARTICLE_MAX_EMITS = 64;
+
+struct ParticleSimConfig
+{
+	float lifetime;			// Longest a particle lives, in seconds
+	float drag;				// Fraction of speed lost a second
+	uint32_t capacity;		// Most particles alive at once
+
+	ParticleSimConfig() : lifetime(0.5f), drag(2.0f), capacity(1 << 16) {}
+};
+
+// The shaders' hash (PCG), for everything random
+inline uint32_t ParticleHash(uint32_t value)
+{
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+	return (word >> 22) ^ word;
+}
+
+// Makes particle index of emit
+ParticleState SpawnParticle(const ParticleEmit& emit, uint32_t index, const ParticleSimConfig& config);
+
+// Moves and ages p by dt; false once it's dead
+bool StepParticle(ParticleState& p, float dt, const ParticleSimConfig& config);
+
+// Hands out ids and seeds for bursts, so the CPU and GPU paths
+// can be given exactly the same ones
+class ParticleEmitQueue
+{
+public:
+	ParticleEmitQueue();
+
+	// False if this step already has PARTICLE_MAX_EMITS bursts
+	bool Add(float x, float y, float z, uint32_t count, float speed);
+
+	const std::vector<ParticleEmit>& GetEmits() const { return emits; }
+	uint32_t GetNewCount() const { return newCount; }
+
+	// Empties the queue for the next step; ids keep counting
+	void Clear();
+
+private:
+	std::vector<ParticleEmit> emits;
+	uint32_t newCount;
+	uint32_t nextId;
+};
+
+// The CPU path
+class ParticleSim
+{
+public:
+	explicit ParticleSim(const ParticleSimConfig& config);
+
+	// Moves everything alive by dt, then adds emits' particles
+	void Step(float dt, const std::vector<ParticleEmit>& emits);
+
+	const std::vector<ParticleState>& GetParticles() const { return particles; }
+	const ParticleSimConfig& GetConfig() const { return config; }
+	void Clear() { particles.clear(); }
+
+private:
+	ParticleSimConfig config;
+	std::vector<ParticleState> particles;
+	std::vector<ParticleState> next;
+};
+
+struct ParticleParityResult
+{
+	size_t countA;
+	size_t countB;
+	size_t unmatched;		// Ids in one list and not the other
+	float maxPositionError;
+	float maxVelocityError;
+	float maxLifeError;
+};
+
+// Matches a and b up by id and says how far apart they are.
+// Sorts both in place.
+ParticleParityResult CompareParticles(std::vector<ParticleState>& a, std::vector<ParticleState>& b);
+
+// True if the lists hold the same ids and nothing is further
+// apart than tolerance
+bool ParticlesMatch(const ParticleParityResult& result, float tolerance);
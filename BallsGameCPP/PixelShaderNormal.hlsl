@@ -89,7 +89,10 @@ float4 main(VertexToPixel input) : SV_TARGET
 	//input.tangent = normalize(input.tangent);
 
 	////Getting new normal
-	float3 normalFromMap = NormalMap.Sample(basicSampler, input.uv).rgb * 2 - 1;
+	// Only X and Y are read so BC5 (two channel) normal maps work too - Z is rebuilt
+	float3 normalFromMap;
+	normalFromMap.xy = NormalMap.Sample(basicSampler, input.uv).rg * 2 - 1;
+	normalFromMap.z = sqrt(saturate(1 - dot(normalFromMap.xy, normalFromMap.xy)));
 
 	// Calculate my TBN matrix to get the normal into world space
 	float3 N = input.normal;
@@ -0,0 +1,16 @@
+
+Texture2D Particle		: register(t0);
+SamplerState Sampler	: register(s0);
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float fade			: FADE;
+};
+
+// Blended additively, so fading is just getting darker
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	return Particle.Sample(Sampler, input.uv) * input.fade;
+}
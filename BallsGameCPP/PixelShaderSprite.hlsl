@@ -0,0 +1,16 @@
+
+Texture2D Sprite		: register(t0);
+SamplerState Sampler	: register(s0);
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float4 color		: COLOR;
+	float2 uv			: TEXCOORD;
+};
+
+// Premultiplied, like SpriteBatch
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	return Sprite.Sample(Sampler, input.uv) * input.color;
+}
@@ -0,0 +1,179 @@
+#include "Profiler.h"
+#include "ErrorMessage.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Rings are only added, never removed, so a thread's events stay
+// exportable after it exits
+static std::mutex registryLock;
+static std::vector<ProfileRing*> rings;
+
+// Now() and real time at the first registration, to work out the
+// tick rate from at export
+static uint64_t calibrationTicks;
+static std::chrono::steady_clock::time_point calibrationTime;
+
+// Shortest time to measure the tick rate over
+const double MIN_CALIBRATION_SECONDS = 0.02;
+
+// Call with registryLock held
+static ProfileRing* NewRing(const char* name)
+{
+	if (rings.empty())
+	{
+		calibrationTicks = Profiler::Now();
+		calibrationTime = std::chrono::steady_clock::now();
+	}
+	ProfileRing* ring = new ProfileRing();
+	ring->written.store(0);
+	ring->threadId = (uint32_t)rings.size() + 1;
+	ring->threadName = name;
+	ring->paused = 0;
+	rings.push_back(ring);
+	return ring;
+}
+
+void Profiler::RegisterThread(const char* name)
+{
+	ProfileRing*& ring = CurrentRing();
+	std::lock_guard<std::mutex> lock(registryLock);
+	if (!ring)
+		ring = NewRing(name);
+	ring->threadName = name;
+}
+
+ProfileRing* Profiler::AddTrack(const char* name)
+{
+	std::lock_guard<std::mutex> lock(registryLock);
+	return NewRing(name);
+}
+
+double Profiler::GetTicksPerSecond()
+{
+#if PROFILER_USE_TSC
+	std::chrono::steady_clock::time_point start;
+	uint64_t startTicks;
+	{
+		std::lock_guard<std::mutex> lock(registryLock);
+		if (rings.empty())
+			return 0;
+		start = calibrationTime;
+		startTicks = calibrationTicks;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	uint64_t ticks = Now() - startTicks;
+	return elapsed.count() > 0 ? ticks / elapsed.count() : 0;
+#else
+	return 1e9;
+#endif
+}
+
+uint64_t Profiler::GetEventCount()
+{
+	std::lock_guard<std::mutex> lock(registryLock);
+	uint64_t count = 0;
+	for (ProfileRing* ring : rings)
+		count += ring->written.load(std::memory_order_acquire);
+	return count;
+}
+
+// Copies out what a ring holds while its thread may still be
+// writing to it.  Anything the writer could have lapped during
+// the copy is dropped, and so is the slot it may be part way
+// through overwriting, so what's left is whole.
+static void CopyRing(ProfileRing& ring, std::vector<ProfileEvent>& events)
+{
+	uint64_t end = ring.written.load(std::memory_order_acquire);
+	uint64_t begin = end > PROFILE_RING_SIZE ? end - PROFILE_RING_SIZE : 0;
+
+	events.clear();
+	for (uint64_t i = begin; i < end; i++)
+		events.push_back(ring.events[i & (PROFILE_RING_SIZE - 1)]);
+
+	uint64_t after = ring.written.load(std::memory_order_acquire);
+	uint64_t safeBegin = after >= PROFILE_RING_SIZE ? after + 1 - PROFILE_RING_SIZE : 0;
+	if (safeBegin > begin)
+		events.erase(events.begin(), events.begin() + (size_t)std::min<uint64_t>(safeBegin - begin, events.size()));
+}
+
+static void WriteJsonString(FILE* f, const char* text)
+{
+	fputc('"', f);
+	for (; *text; text++)
+	{
+		if (*text == '"' || *text == '\\')
+			fputc('\\', f);
+		if ((unsigned char)*text >= 0x20)
+			fputc(*text, f);
+	}
+	fputc('"', f);
+}
+
+// Microseconds per tick of Now(), waiting a moment if the
+// profiler only just started to measure it over long enough
+static double GetTickMicroseconds()
+{
+#if PROFILER_USE_TSC
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - calibrationTime;
+	if (elapsed.count() < MIN_CALIBRATION_SECONDS)
+		std::this_thread::sleep_for(std::chrono::duration<double>(MIN_CALIBRATION_SECONDS - elapsed.count()));
+#endif
+	double ticksPerSecond = Profiler::GetTicksPerSecond();
+	return ticksPerSecond > 0 ? 1e6 / ticksPerSecond : 0;
+}
+
+bool Profiler::ExportChromeTrace(const char* fileName, std::string* error)
+{
+	std::vector<ProfileRing*> snapshot;
+	{
+		std::lock_guard<std::mutex> lock(registryLock);
+		snapshot = rings;
+	}
+	if (snapshot.empty())
+		return Fail(error, "No threads are being profiled");
+
+	std::vector<std::vector<ProfileEvent> > events(snapshot.size());
+	uint64_t origin = UINT64_MAX;
+	for (size_t i = 0; i < snapshot.size(); i++)
+	{
+		CopyRing(*snapshot[i], events[i]);
+		for (const ProfileEvent& event : events[i])
+			origin = std::min(origin, event.start);
+	}
+	double tickMicroseconds = GetTickMicroseconds();
+
+	FILE* f = fopen(fileName, "w");
+	if (!f)
+		return Fail(error, "Could not create file");
+
+	// Times in microseconds from the first event, as the viewer expects
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (size_t i = 0; i < snapshot.size(); i++)
+	{
+		fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			first ? "" : ",\n", snapshot[i]->threadId);
+		WriteJsonString(f, snapshot[i]->threadName.c_str());
+		fprintf(f, "}}");
+		first = false;
+
+		for (const ProfileEvent& event : events[i])
+		{
+			fprintf(f, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+				snapshot[i]->threadId, (event.start - origin) * tickMicroseconds, event.duration * tickMicroseconds);
+			WriteJsonString(f, event.name);
+			fputc('}', f);
+		}
+	}
+	fprintf(f, "\n]}\n");
+
+	bool written = !ferror(f);
+	fclose(f);
+	if (!written)
+		return Fail(error, "Could not write file");
+	return true;
+}
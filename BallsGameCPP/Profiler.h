@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PROFILER_USE_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_USE_TSC 1
+#else
+#define PROFILER_USE_TSC 0
+#endif
+
+// --------------------------------------------------------
+// CPU profiling scopes.
+//
+//   PROFILE_SCOPE("Game::Update");
+//
+// records when the enclosing block started and how long it ran
+// into a ring buffer belonging to the calling thread.  Each
+// ring has exactly one writer, so recording is two reads of the
+// CPU's timestamp counter and a store - no locks, no allocation,
+// no conversion to real time until the trace is exported.  Threads
+// that never called Profiler::RegisterThread (the tools, pool
+// workers) record nothing, and cost one thread-local read per
+// scope.  Profiler::ExportChromeTrace writes what the rings
+// hold as a chrome://tracing / Perfetto JSON file.
+//
+// Define DISABLE_PROFILER to compile every scope out.
+//
+// Only the scopes are in this header, so code that has them
+// (BallManager) still builds without Profiler.cpp as long as
+// it never registers a thread.
+// --------------------------------------------------------
+
+#ifndef DISABLE_PROFILER
+#define PROFILER_ENABLED 1
+#else
+#define PROFILER_ENABLED 0
+#endif
+
+// Events each thread keeps; older ones are overwritten
+const uint32_t PROFILE_RING_SIZE = 1 << 16;
+
+struct ProfileEvent
+{
+	const char* name;		// Must outlive the profiler - use literals
+	uint64_t start;			// In Profiler::Now() ticks
+	uint64_t duration;
+};
+
+struct ProfileRing
+{
+	ProfileEvent events[PROFILE_RING_SIZE];
+	std::atomic<uint64_t> written;		// Events ever recorded; the newest is written - 1
+	uint32_t threadId;
+	std::string threadName;
+	int paused;
+};
+
+namespace Profiler
+{
+	// Ticks on a clock shared by every thread: the timestamp
+	// counter where there is one (constant rate on anything
+	// recent), nanoseconds otherwise
+	inline uint64_t Now()
+	{
+#if PROFILER_USE_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// The calling thread's ring, or null if it isn't registered
+	inline ProfileRing*& CurrentRing()
+	{
+		static thread_local ProfileRing* ring = 0;
+		return ring;
+	}
+
+	inline void Record(ProfileRing* ring, const char* name, uint64_t start, uint64_t end)
+	{
+		uint64_t index = ring->written.load(std::memory_order_relaxed);
+		ProfileEvent& event = ring->events[index & (PROFILE_RING_SIZE - 1)];
+		event.name = name;
+		event.start = start;
+		event.duration = end - start;
+		ring->written.store(index + 1, std::memory_order_release);
+	}
+
+	// Starts recording the calling thread's scopes
+	void RegisterThread(const char* name);
+
+	// A ring for events that don't happen on a CPU thread, like
+	// the GPU's passes, recorded with Record().  Only one thread
+	// may record into it.
+	ProfileRing* AddTrack(const char* name);
+
+	// Now() ticks a second, measured against the system clock
+	// since the first thread or track was added - only rough for
+	// the first few milliseconds
+	double GetTicksPerSecond();
+
+	// Writes every thread's recorded events, oldest first, as
+	// Chrome trace JSON.  Safe while other threads keep recording.
+	bool ExportChromeTrace(const char* fileName, std::string* error = 0);
+
+	// Events recorded across all threads so far
+	uint64_t GetEventCount();
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+	{
+		ring = Profiler::CurrentRing();
+		if (ring && ring->paused)
+			ring = 0;
+		this->name = name;
+		start = ring ? Profiler::Now() : 0;
+	}
+
+	~ProfileScope()
+	{
+		if (ring)
+			Profiler::Record(ring, name, start, Profiler::Now());
+	}
+
+private:
+	ProfileRing* ring;
+	const char* name;
+	uint64_t start;
+};
+
+// Stops the calling thread recording until the end of the block,
+// for work too fine-grained to be worth a scope each time
+class ProfilePause
+{
+public:
+	ProfilePause()
+	{
+		ring = Profiler::CurrentRing();
+		if (ring)
+			ring->paused++;
+	}
+
+	~ProfilePause()
+	{
+		if (ring)
+			ring->paused--;
+	}
+
+private:
+	ProfileRing* ring;
+};
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_PAUSE() ProfilePause PROFILE_CONCAT(profilePause, __LINE__)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_PAUSE() ((void)0)
+
+#endif
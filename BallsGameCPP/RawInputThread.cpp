@@ -0,0 +1,160 @@
+#include "RawInputThread.h"
+#include "Match.h"
+#include "Profiler.h"
+#include "ThreadStart.h"
+
+#include <cstring>
+
+static const wchar_t* RAW_INPUT_WINDOW_CLASS = L"BallGameRawInput";
+
+// The match's keys, as Game::Update used to poll them
+static uint8_t ButtonForKey(USHORT key, bool extended)
+{
+	switch (key)
+	{
+	case 'W': return MATCH_P1_UP;
+	case 'S': return MATCH_P1_DOWN;
+	case VK_SPACE: return MATCH_P1_FIRE;
+	case VK_UP: return extended ? MATCH_P2_UP : 0;			// Not the number pad's
+	case VK_DOWN: return extended ? MATCH_P2_DOWN : 0;
+	case VK_CONTROL: return extended ? MATCH_P2_FIRE : 0;	// Right control only
+	default: return 0;
+	}
+}
+
+RawInputThread::RawInputThread(InputQueue& queue) : queue(queue), running(false)
+{
+	window = 0;
+	memset(keyDown, 0, sizeof(keyDown));
+}
+
+RawInputThread::~RawInputThread()
+{
+	Stop();
+}
+
+bool RawInputThread::Start(std::string* error)
+{
+	if (running)
+		return true;
+
+	// The window has to be made on the thread that pumps it
+	if (!StartThread(thread, &RawInputThread::Run, this, error))
+		return false;
+	running = true;
+	return true;
+}
+
+void RawInputThread::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	PostMessage(window, WM_CLOSE, 0, 0);
+	thread.join();
+	running = false;
+}
+
+LRESULT CALLBACK RawInputThread::WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	if (msg == WM_INPUT)
+	{
+		RawInputThread* self = (RawInputThread*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+		if (self)
+			self->OnRawInput((HRAWINPUT)lParam);
+	}
+	else if (msg == WM_CLOSE)
+	{
+		DestroyWindow(hwnd);
+		return 0;
+	}
+	else if (msg == WM_DESTROY)
+	{
+		PostQuitMessage(0);
+		return 0;
+	}
+	return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+void RawInputThread::Run(std::string* error, std::atomic<int>* started)
+{
+	Profiler::RegisterThread("Raw input");
+
+	// Key events are the whole job of this thread
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+	WNDCLASSW windowClass = {};
+	windowClass.lpfnWndProc = WindowProc;
+	windowClass.hInstance = GetModuleHandle(0);
+	windowClass.lpszClassName = RAW_INPUT_WINDOW_CLASS;
+	RegisterClassW(&windowClass);
+
+	window = CreateWindowExW(0, RAW_INPUT_WINDOW_CLASS, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, 0, windowClass.hInstance, 0);
+	if (!window)
+	{
+		*error = "could not create the raw input window";
+		started->store(-1);
+		return;
+	}
+	SetWindowLongPtr(window, GWLP_USERDATA, (LONG_PTR)this);
+
+	// Generic desktop page, keyboard usage
+	RAWINPUTDEVICE device = {};
+	device.usUsagePage = 0x01;
+	device.usUsage = 0x06;
+	device.dwFlags = RIDEV_INPUTSINK;
+	device.hwndTarget = window;
+	if (!RegisterRawInputDevices(&device, 1, sizeof(device)))
+	{
+		*error = "could not register for raw keyboard input";
+		DestroyWindow(window);
+		started->store(-1);
+		return;
+	}
+	started->store(1);
+
+	MSG msg;
+	while (GetMessage(&msg, 0, 0, 0) > 0)
+		DispatchMessage(&msg);
+
+	device.dwFlags = RIDEV_REMOVE;
+	device.hwndTarget = 0;
+	RegisterRawInputDevices(&device, 1, sizeof(device));
+}
+
+void RawInputThread::OnRawInput(HRAWINPUT input)
+{
+	// Stamped first, before anything else can delay it
+	int64_t now = InputNow();
+
+	RAWINPUT raw;
+	UINT size = sizeof(raw);
+	if (GetRawInputData(input, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1 || raw.header.dwType != RIM_TYPEKEYBOARD)
+		return;
+
+	const RAWKEYBOARD& keyboard = raw.data.keyboard;
+	if (keyboard.VKey >= 256)
+		return;
+
+	bool extended = (keyboard.Flags & RI_KEY_E0) != 0;
+	bool released = (keyboard.Flags & RI_KEY_BREAK) != 0;
+	uint8_t button = ButtonForKey(keyboard.VKey, extended);
+	if (!button)
+		return;
+
+	// Left and right control share a VKey; keep them apart
+	int slot = keyboard.VKey == VK_CONTROL && extended ? VK_RCONTROL : keyboard.VKey;
+	if (released)
+	{
+		keyDown[slot] = false;
+		return;
+	}
+	if (keyDown[slot])
+		return;		// Auto-repeat
+	keyDown[slot] = true;
+
+	InputEvent event;
+	event.timeNs = now;
+	event.buttons = button;
+	queue.Push(event);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "InputQueue.h"
+
+// --------------------------------------------------------
+// Reads the keyboard on its own thread with Raw Input and
+// pushes each match key's press into an InputQueue, stamped
+// the moment it arrives.
+//
+// The thread owns a message-only window registered as a raw
+// input sink, so it hears keys whether or not the game has
+// focus (as GetAsyncKeyState did) and never waits on a frame.
+// Only presses count - releases and auto-repeat are ignored.
+// --------------------------------------------------------
+class RawInputThread
+{
+public:
+	explicit RawInputThread(InputQueue& queue);
+	~RawInputThread();
+
+	// False, with why in error, if the window or the
+	// registration failed; the caller should poll instead
+	bool Start(std::string* error = 0);
+	void Stop();
+	bool IsRunning() const { return running; }
+
+private:
+	static LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	void Run(std::string* error, std::atomic<int>* started);
+	void OnRawInput(HRAWINPUT input);
+
+	InputQueue& queue;
+	std::thread thread;
+	std::atomic<bool> running;
+	HWND window;
+	bool keyDown[256];
+};
@@ -1,10 +1,12 @@
 #include "Renderer.h"
+#include "Profiler.h"
 
 
 
 Renderer::Renderer(ID3D11DeviceContext* deviceContext)
 {
 	context = deviceContext;
+	cullStats = CullStats();
 }
 
 
@@ -44,13 +46,68 @@ void Renderer::SetPaticleInfo(ID3D11DepthStencilState* particleDepthState, ID3D1
 	this->particleBlendState = bsAlphaBlend;
 }
 
+// --------------------------------------------------------
+// Picks a mesh LOD from how big the entity's bounding sphere
+// is on screen.  The matrices are stored transposed for HLSL,
+// so the view space depth is the third ROW of the view matrix.
+// --------------------------------------------------------
+int Renderer::SelectLOD(GameEntity* gameEntity, Mesh* mesh, XMFLOAT4X4& viewMatrix, XMFLOAT4X4& projectionMatrix, float viewportHeight)
+{
+	if (mesh->GetLODCount() <= 1)
+		return 0;
+
+	XMFLOAT3 position = gameEntity->getPosition();
+	XMFLOAT3 scale = gameEntity->getScale();
+	float maxScale = max(fabsf(scale.x), max(fabsf(scale.y), fabsf(scale.z)));
+	float radius = mesh->GetBoundingRadius() * maxScale;
+
+	float depth =
+		viewMatrix._31 * position.x +
+		viewMatrix._32 * position.y +
+		viewMatrix._33 * position.z +
+		viewMatrix._34;
+
+	// Anything reaching the near plane gets full detail
+	if (depth <= radius)
+		return 0;
+
+	// _22 is cot(fov / 2), so this is the radius in pixels
+	float projectedRadius = radius * projectionMatrix._22 / depth * viewportHeight * 0.5f;
+	return mesh->SelectLOD(projectedRadius, LOD_MAX_ERROR_PIXELS);
+}
+
 void Renderer::Draw(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 {
+	PROFILE_SCOPE("Renderer::Draw");
+	cullStats = CullStats();
 	if (gameEntityList.size() != 0)
 	{
+		//Update the World Matrices using the current position, rotation, and scale,
+		//then leave out everything the camera can't see
+		{
+			PROFILE_SCOPE("Frustum cull");
+			culler.Clear();
+			for (int i = 0; i < gameEntityList.size(); i++)
+			{
+				GameEntity* gameEntity = gameEntityList[i];
+				gameEntity->UpdateWorldMatrix();
+				XMFLOAT4X4 world = gameEntity->getWorldMatrix();
+				if (gameEntity->getMesh())
+					culler.Add(gameEntity->getMesh()->GetBounds(), &world._11);
+				else
+					culler.AddAlwaysVisible();
+			}
+			cullStats = culler.Cull(FrustumFromViewProjection(&viewMatrix._11, &projectionMatrix._11), visible);
+		}
+
 		UINT stride = sizeof(Vertex);
 		UINT offset = 0;
 
+		// LOD selection works in pixels
+		D3D11_VIEWPORT viewport;
+		UINT viewportCount = 1;
+		context->RSGetViewports(&viewportCount, &viewport);
+
 		ID3D11Buffer* vertexBuff;
 
 		// Reset to default states for next frame
@@ -61,10 +118,10 @@ void Renderer::Draw(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 
 		for(int i = 0; i < gameEntityList.size(); i++)
 		{
-			GameEntity* gameEntity = gameEntityList[i];
+			if (!visible[i])
+				continue;
 
-			//Update the World Matrix using the current position, rotation, and scale
-			gameEntity->UpdateWorldMatrix();
+			GameEntity* gameEntity = gameEntityList[i];
 			gameEntity->getMaterial()->PrepareMaterial(
 				gameEntity->getWorldMatrix(),
 				viewMatrix,
@@ -88,12 +145,14 @@ void Renderer::Draw(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 					context->OMSetDepthStencilState(particleDepthState, 0);			// No depth WRITING
 				}
 
+				int lod = SelectLOD(gameEntity, tempMesh, viewMatrix, projectionMatrix, viewport.Height);
+
 				vertexBuff = tempMesh->GetVertexBuffer();
 				context->IASetVertexBuffers(0, 1, &vertexBuff, &stride, &offset);
-				context->IASetIndexBuffer(tempMesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
+				context->IASetIndexBuffer(tempMesh->GetIndexBuffer(lod), DXGI_FORMAT_R32_UINT, 0);
 
 				context->DrawIndexed(
-					tempMesh->GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
+					tempMesh->GetIndexCount(lod),     // The number of indices to use (we could draw a subset if we wanted)
 					0,     // Offset to the first index we want to use
 					0);    // Offset to add to each index when looking up vertices
 			}
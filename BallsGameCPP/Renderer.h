@@ -3,6 +3,7 @@
 #include <vector>
 #include "GameEntity.h"
 #include "SimpleShader.h"
+#include "FrustumCuller.h"
 
 class Renderer
 {
@@ -17,10 +18,20 @@ public:
 	void SetPaticleInfo(ID3D11DepthStencilState * particleDepthState, ID3D11BlendState * bsAlphaBlend);
 	void Draw(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix);
 
+	// What the last Draw left out for being outside the view
+	const CullStats& GetCullStats() { return cullStats; }
+
 private:
 
+	int SelectLOD(GameEntity* gameEntity, Mesh* mesh, XMFLOAT4X4& viewMatrix, XMFLOAT4X4& projectionMatrix, float viewportHeight);
+
 	std::vector<GameEntity*> gameEntityList;
 
+	// Refilled every Draw, keeps its arrays
+	FrustumCuller culler;
+	std::vector<uint8_t> visible;
+	CullStats cullStats;
+
 	XMFLOAT4X4 worldMatrix;
 	XMFLOAT4X4 viewMatrix;
 	XMFLOAT4X4 projectionMatrix;
@@ -0,0 +1,200 @@
+#include "Replay.h"
+#include "ErrorMessage.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "MappedFile.h"
+
+static void WriteVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (p >= end)
+			return false;
+		uint8_t byte = *p++;
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Writer
+// --------------------------------------------------------
+ReplayWriter::ReplayWriter()
+{
+	Begin(0);
+}
+
+void ReplayWriter::Begin(uint64_t seed)
+{
+	this->seed = seed;
+	nextEventStep = 0;
+	events.clear();
+	hashes.clear();
+}
+
+void ReplayWriter::Record(MatchInput input, uint32_t stateHash)
+{
+	uint32_t step = (uint32_t)hashes.size();
+	if (input.buttons != 0)
+	{
+		WriteVarint(events, step - nextEventStep);
+		events.push_back(input.buttons);
+		nextEventStep = step + 1;
+	}
+	hashes.push_back(stateHash);
+}
+
+void ReplayWriter::Serialize(std::vector<uint8_t>& data) const
+{
+	ReplayHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = REPLAY_MAGIC;
+	header.version = REPLAY_VERSION;
+	header.seed = seed;
+	header.timestep = MATCH_TIMESTEP;
+	header.stepCount = (uint32_t)hashes.size();
+	header.eventBytes = (uint32_t)events.size();
+
+	size_t hashBytes = hashes.size() * sizeof(uint32_t);
+	data.resize(sizeof(header) + events.size() + hashBytes);
+	memcpy(&data[0], &header, sizeof(header));
+	if (!events.empty())
+		memcpy(&data[sizeof(header)], &events[0], events.size());
+	if (!hashes.empty())
+		memcpy(&data[sizeof(header) + events.size()], &hashes[0], hashBytes);
+}
+
+bool ReplayWriter::Save(const char* fileName, std::string* error) const
+{
+	std::vector<uint8_t> data;
+	Serialize(data);
+
+	FILE* f = fopen(fileName, "wb");
+	if (!f)
+		return Fail(error, "Could not create file");
+
+	bool written = fwrite(&data[0], 1, data.size(), f) == data.size();
+	fclose(f);
+	if (!written)
+		return Fail(error, "Could not write file");
+	return true;
+}
+
+// --------------------------------------------------------
+// Reader
+// --------------------------------------------------------
+ReplayReader::ReplayReader()
+{
+	seed = 0;
+}
+
+bool ReplayReader::Load(const char* fileName, std::string* error)
+{
+	MappedFile file;
+	if (!file.Open(fileName))
+		return Fail(error, "Could not open file");
+	return Parse(file.GetData(), file.GetSize(), error);
+}
+
+bool ReplayReader::Parse(const uint8_t* data, size_t size, std::string* error)
+{
+	events.clear();
+	hashes.clear();
+
+	ReplayHeader header;
+	if (size < sizeof(header))
+		return Fail(error, "File is too small to be a replay");
+	memcpy(&header, data, sizeof(header));
+
+	if (header.magic != REPLAY_MAGIC)
+		return Fail(error, "Not a replay");
+	if (header.version != REPLAY_VERSION)
+		return Fail(error, "Unsupported replay version");
+	if (header.timestep != MATCH_TIMESTEP)
+		return Fail(error, "Replay was recorded with a different timestep");
+	if ((uint64_t)sizeof(header) + header.eventBytes + (uint64_t)header.stepCount * sizeof(uint32_t) != size)
+		return Fail(error, "Replay size doesn't match its header");
+
+	// Decode events, making sure every one lands on a recorded step
+	const uint8_t* p = data + sizeof(header);
+	const uint8_t* end = p + header.eventBytes;
+	uint64_t nextStep = 0;
+	while (p < end)
+	{
+		uint32_t gap;
+		if (!ReadVarint(p, end, gap) || p >= end)
+			return Fail(error, "Truncated input event");
+
+		ReplayEvent event;
+		uint64_t step = nextStep + gap;
+		event.buttons = *p++;
+		if (step >= header.stepCount)
+			return Fail(error, "Input event past the last step");
+		if (event.buttons == 0 || (event.buttons & ~MATCH_BUTTON_MASK))
+			return Fail(error, "Bad input event buttons");
+
+		event.step = (uint32_t)step;
+		events.push_back(event);
+		nextStep = step + 1;
+	}
+
+	hashes.resize(header.stepCount);
+	if (header.stepCount > 0)
+		memcpy(&hashes[0], end, header.stepCount * sizeof(uint32_t));
+
+	seed = header.seed;
+	return true;
+}
+
+// --------------------------------------------------------
+// Playback
+// --------------------------------------------------------
+void PlayReplay(const ReplayReader& replay, ReplayResult& result)
+{
+	result.stepsPlayed = 0;
+	result.divergedStep = -1;
+	result.expectedHash = 0;
+	result.actualHash = 0;
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Match match(replay.GetSeed());
+	const std::vector<ReplayEvent>& events = replay.GetEvents();
+	size_t nextEvent = 0;
+	for (uint32_t step = 0; step < replay.GetStepCount(); step++)
+	{
+		MatchInput input;
+		if (nextEvent < events.size() && events[nextEvent].step == step)
+			input.buttons = events[nextEvent++].buttons;
+
+		match.Step(input);
+		result.stepsPlayed++;
+
+		uint32_t hash = match.Hash();
+		if (hash != replay.GetHash(step))
+		{
+			result.divergedStep = (int)step;
+			result.expectedHash = replay.GetHash(step);
+			result.actualHash = hash;
+			break;
+		}
+	}
+
+	result.winner = match.GetWinner();
+	result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Match.h"
+
+// --------------------------------------------------------
+// Match replays - the seed plus every step's input, along
+// with the state hash the recording machine saw after each
+// step.
+//
+// Layout (little endian):
+//   ReplayHeader
+//   eventBytes of input events, one per step that had any
+//     buttons down: a LEB128 count of empty steps since the
+//     previous event, then the button byte
+//   stepCount uint32 state hashes
+//
+// Most steps have no input, so a full match is a few bytes of
+// events; the hashes are what make it possible to say exactly
+// which step a re-simulation first went wrong on.
+// --------------------------------------------------------
+
+const uint32_t REPLAY_MAGIC = 0x4C505242; // "BRPL"
+const uint32_t REPLAY_VERSION = 1;
+
+struct ReplayHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t seed;
+	float timestep;
+	uint32_t stepCount;
+	uint32_t eventBytes;
+	uint32_t reserved;
+};
+
+struct ReplayEvent
+{
+	uint32_t step;
+	uint8_t buttons;
+};
+
+// --------------------------------------------------------
+// Builds a replay in memory while a match is played
+// --------------------------------------------------------
+class ReplayWriter
+{
+public:
+	ReplayWriter();
+
+	// Starts a new recording, dropping anything recorded so far
+	void Begin(uint64_t seed);
+
+	// Call once per Match::Step with that step's input and the
+	// hash of the state it produced
+	void Record(MatchInput input, uint32_t stateHash);
+
+	uint32_t GetStepCount() const { return (uint32_t)hashes.size(); }
+
+	void Serialize(std::vector<uint8_t>& data) const;
+	bool Save(const char* fileName, std::string* error = 0) const;
+
+private:
+	uint64_t seed;
+	uint32_t nextEventStep;
+	std::vector<uint8_t> events;
+	std::vector<uint32_t> hashes;
+};
+
+// --------------------------------------------------------
+// Validates and decodes a replay
+// --------------------------------------------------------
+class ReplayReader
+{
+public:
+	ReplayReader();
+
+	bool Load(const char* fileName, std::string* error = 0);
+	bool Parse(const uint8_t* data, size_t size, std::string* error = 0);
+
+	uint64_t GetSeed() const { return seed; }
+	uint32_t GetStepCount() const { return (uint32_t)hashes.size(); }
+	const std::vector<ReplayEvent>& GetEvents() const { return events; }
+	uint32_t GetHash(uint32_t step) const { return hashes[step]; }
+
+private:
+	uint64_t seed;
+	std::vector<ReplayEvent> events;
+	std::vector<uint32_t> hashes;
+};
+
+// --------------------------------------------------------
+// Re-simulates a replay as fast as possible, with no
+// rendering, checking the state hash after every step
+// --------------------------------------------------------
+struct ReplayResult
+{
+	uint32_t stepsPlayed;
+	int divergedStep;		// First step whose hash didn't match, -1 if none did
+	uint32_t expectedHash;	// At divergedStep
+	uint32_t actualHash;
+	int winner;				// Match::GetWinner() at the end
+	double seconds;			// Wall clock time spent simulating
+};
+
+void PlayReplay(const ReplayReader& replay, ReplayResult& result);
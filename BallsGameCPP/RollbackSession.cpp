@@ -0,0 +1,263 @@
+#include "RollbackSession.h"
+
+#include <chrono>
+#include <cstring>
+
+const uint32_t NET_MAGIC = 0x504E5242; // "BRNP"
+const uint32_t NO_FRAME = 0xFFFFFFFF;
+
+// Most input frames repeated in one packet.  Every packet resends
+// everything the remote hasn't acknowledged, so a lost packet
+// costs nothing as long as the next one arrives.
+const uint32_t MAX_PACKET_INPUTS = 64;
+
+// magic, seed, ack, first frame, check frame, check hash, input count
+const size_t PACKET_HEADER_SIZE = 4 + 8 + 4 + 4 + 4 + 4 + 1;
+
+static void Put32(uint8_t*& p, uint32_t value) { memcpy(p, &value, 4); p += 4; }
+static void Put64(uint8_t*& p, uint64_t value) { memcpy(p, &value, 8); p += 8; }
+static uint32_t Get32(const uint8_t*& p) { uint32_t value; memcpy(&value, p, 4); p += 4; return value; }
+static uint64_t Get64(const uint8_t*& p) { uint64_t value; memcpy(&value, p, 8); p += 8; return value; }
+
+RollbackSession::RollbackSession(int localPlayer, uint64_t seed, int inputDelay)
+	: match(seed), scratch(0), snapshots(ROLLBACK_MAX_FRAMES, 64 * 1024), conditioner(&socket, seed ^ localPlayer)
+{
+	this->localPlayer = localPlayer == 2 ? 2 : 1;
+	this->inputDelay = inputDelay < 0 ? 0 : (inputDelay > 8 ? 8 : inputDelay);
+	connected = false;
+
+	memset(localInputs, 0, sizeof(localInputs));
+	memset(remoteInputs, 0, sizeof(remoteInputs));
+	memset(usedRemoteInputs, 0, sizeof(usedRemoteInputs));
+
+	// The first inputDelay frames have no local input at all
+	localInputEnd = this->inputDelay;
+	remoteConfirmed = 0;
+	remoteAcked = 0;
+	rollbackFrom = NO_FRAME;
+
+	for (int i = 0; i < CHECK_HISTORY; i++)
+		checkFrames[i] = NO_FRAME;
+	nextCheckFrame = DESYNC_CHECK_INTERVAL;
+	lastCheckFrame = NO_FRAME;
+	lastCheckHash = 0;
+	comparedCheckFrame = 0;
+
+	memset(&stats, 0, sizeof(stats));
+	stats.desyncFrame = -1;
+}
+
+bool RollbackSession::Start(uint16_t localPort, const NetAddress& remote)
+{
+	this->remote = remote;
+	return socket.Open(localPort);
+}
+
+MatchInput RollbackSession::GetInput(uint32_t frame, uint8_t remoteButtons) const
+{
+	uint8_t local = localInputs[frame % INPUT_HISTORY];
+	uint8_t p1 = localPlayer == 1 ? local : remoteButtons;
+	uint8_t p2 = localPlayer == 1 ? remoteButtons : local;
+	return MatchInput((uint8_t)(p1 | (p2 << 3)));
+}
+
+int RollbackSession::GetConfirmedWinner()
+{
+	if (match.GetStepCount() > remoteConfirmed)
+		return 0;
+	return match.GetWinner();
+}
+
+bool RollbackSession::Update(uint8_t localButtons, double nowMs)
+{
+	Receive();
+	ResolveInputs();
+
+	// Don't get further ahead of the remote than we can roll back
+	uint32_t frame = match.GetStepCount();
+	bool advance = connected && frame + 1 < remoteConfirmed + ROLLBACK_MAX_FRAMES;
+
+	// A won match takes the step but has nothing to simulate (see
+	// the header)
+	if (advance && match.GetWinner() == 0)
+	{
+		localInputs[(frame + inputDelay) % INPUT_HISTORY] = localButtons & PLAYER_BUTTON_MASK;
+		localInputEnd = frame + inputDelay + 1;
+		SimulateFrame();
+	}
+	else if (connected && !advance)
+		stats.stalls++;
+
+	SendInputs(nowMs);
+	conditioner.Flush(nowMs);
+	return advance;
+}
+
+void RollbackSession::Poll(double nowMs)
+{
+	Receive();
+	ResolveInputs();
+	SendInputs(nowMs);
+	conditioner.Flush(nowMs);
+}
+
+// Fixes up anything simulated with a wrong guess, then hashes
+// whatever that leaves confirmed
+void RollbackSession::ResolveInputs()
+{
+	if (rollbackFrom < match.GetStepCount())
+		Rollback(rollbackFrom);
+	rollbackFrom = NO_FRAME;
+	CheckConfirmedState();
+}
+
+void RollbackSession::SimulateFrame()
+{
+	uint32_t frame = match.GetStepCount();
+	uint8_t remoteButtons = frame < remoteConfirmed ? remoteInputs[frame % INPUT_HISTORY] : 0;
+	usedRemoteInputs[frame % INPUT_HISTORY] = remoteButtons;
+
+	snapshots.Save(match);
+	match.Step(GetInput(frame, remoteButtons));
+	stats.framesSimulated++;
+}
+
+void RollbackSession::Rollback(uint32_t toFrame)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	uint32_t endFrame = match.GetStepCount();
+	if (!snapshots.Restore(match, toFrame))
+		return;
+
+	// Re-simulate up to where we were; a finished match stops early
+	while (match.GetStepCount() < endFrame && match.GetWinner() == 0)
+		SimulateFrame();
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	uint32_t depth = endFrame - toFrame;
+	stats.rollbacks++;
+	stats.framesResimulated += depth;
+	stats.resimulateMs += ms;
+	if (depth > stats.maxRollbackDepth)
+		stats.maxRollbackDepth = depth;
+	if (ms > stats.maxResimulateMs)
+		stats.maxResimulateMs = ms;
+}
+
+// Hashes saved frames once nothing can change them any more
+void RollbackSession::CheckConfirmedState()
+{
+	while (nextCheckFrame <= remoteConfirmed && nextCheckFrame < match.GetStepCount())
+	{
+		if (snapshots.Has(nextCheckFrame) && snapshots.Restore(scratch, nextCheckFrame))
+		{
+			int slot = (nextCheckFrame / DESYNC_CHECK_INTERVAL) % CHECK_HISTORY;
+			checkFrames[slot] = nextCheckFrame;
+			checkHashes[slot] = scratch.Hash();
+			lastCheckFrame = nextCheckFrame;
+			lastCheckHash = checkHashes[slot];
+		}
+		nextCheckFrame += DESYNC_CHECK_INTERVAL;
+	}
+}
+
+void RollbackSession::Receive()
+{
+	uint8_t buffer[512];
+	NetAddress from;
+	size_t size;
+	while ((size = socket.Receive(buffer, sizeof(buffer), from)) > 0)
+	{
+		if (!(from == remote))
+			continue;
+		stats.packetsReceived++;
+		stats.bytesReceived += size;
+		ReadPacket(buffer, size);
+	}
+}
+
+void RollbackSession::ReadPacket(const uint8_t* data, size_t size)
+{
+	if (size < PACKET_HEADER_SIZE)
+		return;
+
+	const uint8_t* p = data;
+	if (Get32(p) != NET_MAGIC)
+		return;
+	uint64_t seed = Get64(p);
+	uint32_t ack = Get32(p);
+	uint32_t firstFrame = Get32(p);
+	uint32_t remoteCheckFrame = Get32(p);
+	uint32_t remoteCheckHash = Get32(p);
+	uint32_t count = *p++;
+	if (PACKET_HEADER_SIZE + count != size)
+		return;
+
+	// Player 1 picks the seed; player 2 takes it from the first packet
+	if (!connected)
+	{
+		connected = true;
+		if (localPlayer == 2)
+		{
+			match.Reset(seed);
+			snapshots.Clear();
+		}
+	}
+
+	if (ack > remoteAcked && ack <= localInputEnd)
+		remoteAcked = ack;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t frame = firstFrame + i;
+		if (frame < remoteConfirmed)
+			continue;
+		if (frame > remoteConfirmed)
+			break;
+
+		uint8_t buttons = p[i] & PLAYER_BUTTON_MASK;
+		remoteInputs[frame % INPUT_HISTORY] = buttons;
+		if (frame < match.GetStepCount() && usedRemoteInputs[frame % INPUT_HISTORY] != buttons && frame < rollbackFrom)
+			rollbackFrom = frame;
+		remoteConfirmed++;
+	}
+
+	// Compare the remote's latest state hash against ours for that frame
+	if (remoteCheckFrame != NO_FRAME && remoteCheckFrame > comparedCheckFrame)
+	{
+		int slot = (remoteCheckFrame / DESYNC_CHECK_INTERVAL) % CHECK_HISTORY;
+		if (checkFrames[slot] == remoteCheckFrame)
+		{
+			comparedCheckFrame = remoteCheckFrame;
+			stats.desyncChecks++;
+			if (checkHashes[slot] != remoteCheckHash && stats.desyncFrame < 0)
+				stats.desyncFrame = (int)remoteCheckFrame;
+		}
+	}
+}
+
+void RollbackSession::SendInputs(double nowMs)
+{
+	uint32_t first = remoteAcked;
+	if (localInputEnd - first > MAX_PACKET_INPUTS)
+		first = localInputEnd - MAX_PACKET_INPUTS;
+	uint32_t count = localInputEnd - first;
+
+	uint8_t packet[PACKET_HEADER_SIZE + MAX_PACKET_INPUTS];
+	uint8_t* p = packet;
+	Put32(p, NET_MAGIC);
+	Put64(p, match.GetSeed());
+	Put32(p, remoteConfirmed);
+	Put32(p, first);
+	Put32(p, lastCheckFrame);
+	Put32(p, lastCheckHash);
+	*p++ = (uint8_t)count;
+	for (uint32_t frame = first; frame < localInputEnd; frame++)
+		*p++ = localInputs[frame % INPUT_HISTORY];
+
+	size_t size = p - packet;
+	conditioner.Send(remote, packet, size, nowMs);
+	stats.packetsSent++;
+	stats.bytesSent += size;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "Match.h"
+#include "SnapshotRing.h"
+#include "UdpSocket.h"
+
+// --------------------------------------------------------
+// Two-player rollback netcode.
+//
+// Each peer runs the whole Match itself and only sends its own
+// buttons.  A frame is simulated as soon as the local input for
+// it is known, with the remote player predicted to press
+// nothing (inputs are single-frame presses, so "nothing" is
+// almost always right).  When the real remote input turns up
+// and differs from the prediction, the match is restored from
+// the SnapshotRing to that frame and re-simulated up to the
+// present with the corrected inputs.
+//
+// Local input is held back inputDelay frames before it's used,
+// which hides that much latency without any rollback at all.
+// If the remote falls more than ROLLBACK_MAX_FRAMES behind, the
+// local side stalls until it catches up.
+//
+// Every DESYNC_CHECK_INTERVAL confirmed frames, both sides hash
+// their state and exchange the hashes, so a desync is reported
+// at the frame it became visible instead of as a mystery later.
+// --------------------------------------------------------
+
+// Furthest back a late input can rewind
+const int ROLLBACK_MAX_FRAMES = 16;
+
+// How often (in frames) confirmed state is hashed and compared
+const int DESYNC_CHECK_INTERVAL = 30;
+
+// Buttons for one player, before they're placed into a MatchInput
+enum PlayerButton
+{
+	PLAYER_UP = 1 << 0,
+	PLAYER_DOWN = 1 << 1,
+	PLAYER_FIRE = 1 << 2,
+	PLAYER_BUTTON_MASK = (1 << 3) - 1
+};
+
+struct RollbackStats
+{
+	uint32_t framesSimulated;	// Including re-simulated ones
+	uint32_t stalls;			// Updates that waited on the remote
+	uint32_t rollbacks;
+	uint32_t framesResimulated;
+	uint32_t maxRollbackDepth;
+	double resimulateMs;		// Total time spent re-simulating
+	double maxResimulateMs;		// Longest single rollback
+	uint32_t packetsSent;
+	uint32_t packetsReceived;
+	uint64_t bytesSent;			// UDP payload only
+	uint64_t bytesReceived;
+	uint32_t desyncChecks;
+	int desyncFrame;			// First frame whose hashes differed, -1 if none
+};
+
+class RollbackSession
+{
+public:
+	// localPlayer - 1 or 2; player 1's seed is the one both sides use
+	RollbackSession(int localPlayer, uint64_t seed, int inputDelay);
+
+	bool Start(uint16_t localPort, const NetAddress& remote);
+	void SetConditions(const LinkConditions& conditions) { conditioner.SetConditions(conditions); }
+
+	// --------------------------------------------------------
+	// Call once per fixed step.  Reads the network, rolls back
+	// if a late input needs it, then simulates the next frame.
+	//
+	// localButtons - PlayerButtons pressed since the last call
+	// nowMs        - Any steadily increasing clock
+	//
+	// Returns false if the frame couldn't be simulated yet (not
+	// connected, or too far ahead of the remote); the buttons
+	// weren't used and should be passed in again next time.
+	// Once the match has a winner nothing more is simulated, but
+	// this still returns true when it would otherwise have
+	// advanced: the buttons are dropped, as they'd have nothing
+	// to do, and the caller keeps stepping at its usual rate
+	// rather than saving up steps for a rollback that undoes the
+	// win.
+	// --------------------------------------------------------
+	bool Update(uint8_t localButtons, double nowMs);
+
+	// Keeps talking to the remote without simulating anything new,
+	// for while the match is over or paused
+	void Poll(double nowMs);
+
+	bool IsConnected() const { return connected; }
+	int GetLocalPlayer() const { return localPlayer; }
+	Match& GetMatch() { return match; }
+	uint32_t GetFrame() const { return match.GetStepCount(); }
+
+	// Every frame below this has both players' real input
+	uint32_t GetConfirmedFrame() const { return remoteConfirmed; }
+
+	// 0 while playing, otherwise the winner - but only once the
+	// winning frame is confirmed and can't be rolled back
+	int GetConfirmedWinner();
+
+	const RollbackStats& GetStats() const { return stats; }
+	uint32_t GetDroppedPackets() const { return conditioner.GetDroppedCount(); }
+
+private:
+	void Receive();
+	void ReadPacket(const uint8_t* data, size_t size);
+	void SendInputs(double nowMs);
+	void ResolveInputs();
+	void Rollback(uint32_t toFrame);
+	void SimulateFrame();
+	void CheckConfirmedState();
+	MatchInput GetInput(uint32_t frame, uint8_t remoteButtons) const;
+
+	int localPlayer;
+	int inputDelay;
+	bool connected;
+
+	Match match;
+	Match scratch;			// For hashing saved frames
+	SnapshotRing snapshots;
+
+	UdpSocket socket;
+	LinkConditioner conditioner;
+	NetAddress remote;
+
+	// Per-frame inputs, indexed by frame % INPUT_HISTORY
+	static const int INPUT_HISTORY = 256;
+	uint8_t localInputs[INPUT_HISTORY];
+	uint8_t remoteInputs[INPUT_HISTORY];
+	uint8_t usedRemoteInputs[INPUT_HISTORY];	// What each simulated frame assumed
+
+	uint32_t localInputEnd;		// Local input is known for every frame below this
+	uint32_t remoteConfirmed;	// Same for the remote's input
+	uint32_t remoteAcked;		// The remote has all our input below this
+	uint32_t rollbackFrom;		// Earliest frame that was mispredicted, or ~0
+
+	// Our recent desync checks, and the latest one to send
+	static const int CHECK_HISTORY = 8;
+	uint32_t checkFrames[CHECK_HISTORY];
+	uint32_t checkHashes[CHECK_HISTORY];
+	uint32_t nextCheckFrame;
+	uint32_t lastCheckFrame;
+	uint32_t lastCheckHash;
+	uint32_t comparedCheckFrame;	// Latest remote check we've compared
+
+	RollbackStats stats;
+};
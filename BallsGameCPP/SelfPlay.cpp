@@ -0,0 +1,300 @@
+#include "SelfPlay.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Steps between row changes - about as fast as someone tapping a
+// key, and never quite evenly
+const uint32_t BOT_MOVE_MIN_STEPS = 8;
+const uint32_t BOT_MOVE_RANGE_STEPS = 12;
+
+// Longest a bot waits before firing once it decides to
+const uint32_t BOT_FIRE_RANGE_STEPS = 10;
+
+// How long a wandering bot stays on a row, in steps
+const uint32_t BOT_WANDER_MIN_STEPS = 60;
+const uint32_t BOT_WANDER_RANGE_STEPS = 180;
+
+// Matches a pool job plays back to back; enough that handing out
+// jobs costs nothing next to playing them
+const uint32_t MATCHES_PER_JOB = 16;
+
+static const char* ROW_POLICY_NAMES[BOT_ROW_POLICY_COUNT] = { "stay", "random", "track", "lead" };
+static const char* FIRE_POLICY_NAMES[BOT_FIRE_POLICY_COUNT] = { "random", "asap", "lined-up", "volley" };
+
+const char* GetBotRowPolicyName(BotRowPolicy row)
+{
+	return row >= 0 && row < BOT_ROW_POLICY_COUNT ? ROW_POLICY_NAMES[row] : "?";
+}
+
+const char* GetBotFirePolicyName(BotFirePolicy fire)
+{
+	return fire >= 0 && fire < BOT_FIRE_POLICY_COUNT ? FIRE_POLICY_NAMES[fire] : "?";
+}
+
+bool ParseBotPolicy(const char* text, BotPolicy& policy)
+{
+	const char* slash = strchr(text, '/');
+	if (!slash)
+		return false;
+
+	size_t rowLength = slash - text;
+	int row = -1, fire = -1;
+	for (int i = 0; i < BOT_ROW_POLICY_COUNT; i++)
+		if (strlen(ROW_POLICY_NAMES[i]) == rowLength && strncmp(text, ROW_POLICY_NAMES[i], rowLength) == 0)
+			row = i;
+	for (int i = 0; i < BOT_FIRE_POLICY_COUNT; i++)
+		if (strcmp(slash + 1, FIRE_POLICY_NAMES[i]) == 0)
+			fire = i;
+	if (row < 0 || fire < 0)
+		return false;
+
+	policy.row = (BotRowPolicy)row;
+	policy.fire = (BotFirePolicy)fire;
+	return true;
+}
+
+MatchBot::MatchBot(int player, const BotPolicy& policy, uint64_t seed)
+	: player(player), policy(policy), random(seed)
+{
+	wanderRow = MATCH_ROWS / 2;
+	nextWanderStep = 0;
+	nextMoveStep = random.Next() % BOT_MOVE_RANGE_STEPS;
+	nextFireStep = 0;
+	volleying = false;
+}
+
+// Where the soccer ball's height puts it among the rows
+static int RowForHeight(int player, float y)
+{
+	float top = Match::GetRowPosition(player, 0).y;
+	float spacing = top - Match::GetRowPosition(player, 1).y;
+	int row = (int)floorf((top - y) / spacing + 0.5f);
+	return row < 0 ? 0 : (row >= MATCH_ROWS ? MATCH_ROWS - 1 : row);
+}
+
+int MatchBot::GetTargetRow(Match& match)
+{
+	if (policy.row == BOT_ROW_STAY)
+		return MATCH_ROWS / 2;
+
+	if (policy.row == BOT_ROW_RANDOM)
+	{
+		if (match.GetStepCount() >= nextWanderStep)
+		{
+			wanderRow = (int)(random.Next() % MATCH_ROWS);
+			nextWanderStep = match.GetStepCount() + BOT_WANDER_MIN_STEPS + random.Next() % BOT_WANDER_RANGE_STEPS;
+		}
+		return wanderRow;
+	}
+
+	// The soccer ball is added first and never removed
+	Ball& soccer = match.GetBallManager()->getBalls()[0];
+	myVector position = soccer.getPosition();
+	float y = position.y;
+
+	if (policy.row == BOT_ROW_LEAD)
+	{
+		// Carry it on for as long as a shot takes to cross to it,
+		// folding the path back off the top and bottom walls
+		float distance = fabsf(position.x - Match::GetRowPosition(player, 0).x);
+		y += soccer.getVelocity().y * distance / match.GetRules().ballSpeed;
+
+		float limit = FIELD_Y_BOUND - SOCCER_BALL_RADIUS;
+		float span = 2 * limit;
+		y = fmodf(y + limit, 2 * span);
+		if (y < 0)
+			y += 2 * span;
+		if (y > span)
+			y = 2 * span - y;
+		y -= limit;
+	}
+	return RowForHeight(player, y);
+}
+
+uint8_t MatchBot::Think(Match& match)
+{
+	uint32_t step = match.GetStepCount();
+	int selection = match.GetSelection(player);
+	int target = GetTargetRow(match);
+
+	uint8_t buttons = 0;
+	if (target != selection && step >= nextMoveStep)
+	{
+		buttons |= target < selection ? MATCH_P1_UP : MATCH_P1_DOWN;
+		selection += target < selection ? -1 : 1;
+		nextMoveStep = step + BOT_MOVE_MIN_STEPS + random.Next() % BOT_MOVE_RANGE_STEPS;
+	}
+
+	// The match moves before it fires, so this is the row a shot
+	// would leave from
+	bool fire = false;
+	switch (policy.fire)
+	{
+	case BOT_FIRE_RANDOM:
+		fire = random.Next() % 50 == 0;
+		break;
+	case BOT_FIRE_ASAP:
+		fire = true;
+		break;
+	case BOT_FIRE_LINED_UP:
+		fire = selection == target;
+		break;
+	case BOT_FIRE_VOLLEY:
+		{
+			int ballsLeft = match.GetBallsLeft(player);
+			if (ballsLeft >= match.GetRules().ballsPerPlayer)
+				volleying = true;
+			else if (ballsLeft == 0)
+				volleying = false;
+			fire = volleying;
+		}
+		break;
+	default:
+		break;
+	}
+	// Hesitate a little before each shot the policy wants, other
+	// than the random one's
+	if (fire && policy.fire != BOT_FIRE_RANDOM)
+	{
+		if (nextFireStep == 0)
+			nextFireStep = step + random.Next() % BOT_FIRE_RANGE_STEPS;
+		fire = step >= nextFireStep;
+	}
+	if (fire)
+	{
+		buttons |= MATCH_P1_FIRE;
+		nextFireStep = 0;
+	}
+	return buttons;
+}
+
+// --------------------------------------------------------
+// Batch runner
+// --------------------------------------------------------
+
+// SplitMix64, so neighbouring indices get unrelated seeds
+static uint64_t GetMatchSeed(uint64_t seed, uint32_t index)
+{
+	uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static void ClearResult(SelfPlayResult& result)
+{
+	result.matches = 0;
+	result.wins[0] = result.wins[1] = 0;
+	result.draws = 0;
+	result.sideWins[0] = result.sideWins[1] = 0;
+	result.goals[0] = result.goals[1] = 0;
+	result.steps = 0;
+	result.seconds = 0;
+	result.lengthHistogram.clear();
+}
+
+static void PlayMatch(const SelfPlayConfig& config, uint32_t index, Match& match, SelfPlayResult& result)
+{
+	uint64_t seed = GetMatchSeed(config.seed, index);
+	match.Reset(seed);
+
+	// Bot A is player 1 unless this match swaps them over
+	int a = config.alternateSides && (index & 1) ? 1 : 0;
+	MatchBot p1(1, config.bots[a], seed ^ 0x632BE59BD9B4E019ULL);
+	MatchBot p2(2, config.bots[1 - a], seed ^ 0x85157AF5ADE4A8E3ULL);
+
+	uint32_t steps = 0;
+	while (steps < config.maxSteps && match.GetWinner() == 0)
+	{
+		uint8_t buttons = p1.Think(match) | (p2.Think(match) << 3);
+		match.Step(MatchInput(buttons));
+		steps++;
+	}
+
+	result.matches++;
+	result.steps += steps;
+	result.goals[a] += match.GetScore(1);
+	result.goals[1 - a] += match.GetScore(2);
+
+	int winner = match.GetWinner();
+	if (winner == 0)
+	{
+		result.draws++;
+		return;
+	}
+	result.sideWins[winner - 1]++;
+	result.wins[winner == 1 ? a : 1 - a]++;
+
+	size_t bucket = (size_t)(steps * MATCH_TIMESTEP);
+	if (result.lengthHistogram.size() <= bucket)
+		result.lengthHistogram.resize(bucket + 1, 0);
+	result.lengthHistogram[bucket]++;
+}
+
+void RunSelfPlay(const SelfPlayConfig& config, JobPool& pool, SelfPlayResult& result)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// A match and a tally per worker, merged at the end
+	int workers = pool.GetThreadCount();
+	std::vector<Match*> matches(workers);
+	std::vector<SelfPlayResult> partials(workers);
+	for (int i = 0; i < workers; i++)
+	{
+		matches[i] = new Match(0, config.rules);
+		matches[i]->GetBallManager()->setExplosionsEnabled(false);
+		ClearResult(partials[i]);
+	}
+
+	int jobs = (int)((config.matches + MATCHES_PER_JOB - 1) / MATCHES_PER_JOB);
+	pool.Run(jobs, [&](int job, int worker)
+	{
+		uint32_t begin = (uint32_t)job * MATCHES_PER_JOB;
+		uint32_t end = begin + MATCHES_PER_JOB < config.matches ? begin + MATCHES_PER_JOB : config.matches;
+		for (uint32_t index = begin; index < end; index++)
+			PlayMatch(config, index, *matches[worker], partials[worker]);
+	});
+
+	ClearResult(result);
+	for (int i = 0; i < workers; i++)
+	{
+		const SelfPlayResult& partial = partials[i];
+		result.matches += partial.matches;
+		result.draws += partial.draws;
+		result.steps += partial.steps;
+		for (int side = 0; side < 2; side++)
+		{
+			result.wins[side] += partial.wins[side];
+			result.sideWins[side] += partial.sideWins[side];
+			result.goals[side] += partial.goals[side];
+		}
+		if (result.lengthHistogram.size() < partial.lengthHistogram.size())
+			result.lengthHistogram.resize(partial.lengthHistogram.size(), 0);
+		for (size_t bucket = 0; bucket < partial.lengthHistogram.size(); bucket++)
+			result.lengthHistogram[bucket] += partial.lengthHistogram[bucket];
+		delete matches[i];
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+float GetSelfPlayLengthPercentile(const SelfPlayResult& result, float fraction)
+{
+	uint64_t decided = 0;
+	for (uint32_t count : result.lengthHistogram)
+		decided += count;
+	if (decided == 0)
+		return 0;
+
+	uint64_t wanted = (uint64_t)ceil(fraction * decided);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < result.lengthHistogram.size(); bucket++)
+	{
+		seen += result.lengthHistogram[bucket];
+		if (seen >= wanted && seen > 0)
+			return (float)(bucket + 1);
+	}
+	return (float)result.lengthHistogram.size();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "JobPool.h"
+#include "Match.h"
+
+// --------------------------------------------------------
+// Scripted bots, and a batch runner that plays them against
+// each other by the million for tuning bots and rules.
+//
+// A bot is a row policy (which row to sit on) plus a fire
+// policy (when to shoot).  It reads the Match directly and
+// answers with one player's buttons, drawing any randomness
+// from its own generator, so a match between two bots is as
+// reproducible as any other.  Bots change rows no faster than
+// a person could and hesitate a little before shooting, with
+// the timing varied at random: the match draws nothing random
+// that affects play, so without it every match between the
+// same two bots would be the same match.
+// --------------------------------------------------------
+
+enum BotRowPolicy
+{
+	BOT_ROW_STAY,		// Never moves from the middle row
+	BOT_ROW_RANDOM,		// Wanders to a new row every second or so
+	BOT_ROW_TRACK,		// The row the soccer ball is level with
+	BOT_ROW_LEAD,		// Where the soccer ball will be when a shot gets there
+	BOT_ROW_POLICY_COUNT
+};
+
+enum BotFirePolicy
+{
+	BOT_FIRE_RANDOM,	// Now and then, like the server's filler bots
+	BOT_FIRE_ASAP,		// Whenever it can
+	BOT_FIRE_LINED_UP,	// Only from the row it wants to be on
+	BOT_FIRE_VOLLEY,	// Waits for a full magazine, then empties it
+	BOT_FIRE_POLICY_COUNT
+};
+
+struct BotPolicy
+{
+	BotRowPolicy row;
+	BotFirePolicy fire;
+};
+
+// "lead/lined-up" and back
+bool ParseBotPolicy(const char* text, BotPolicy& policy);
+const char* GetBotRowPolicyName(BotRowPolicy row);
+const char* GetBotFirePolicyName(BotFirePolicy fire);
+
+class MatchBot
+{
+public:
+	MatchBot(int player, const BotPolicy& policy, uint64_t seed);
+
+	// This step's buttons for our player, as player 1's
+	// MatchButtons (shift player 2's up by 3)
+	uint8_t Think(Match& match);
+
+private:
+	int GetTargetRow(Match& match);
+
+	int player;
+	BotPolicy policy;
+	SimRandom random;
+	int wanderRow;
+	uint32_t nextWanderStep;
+	uint32_t nextMoveStep;
+	uint32_t nextFireStep;		// 0 until a shot is wanted
+	bool volleying;
+};
+
+// --------------------------------------------------------
+// One batch of bot matches
+// --------------------------------------------------------
+struct SelfPlayConfig
+{
+	MatchRules rules;
+	BotPolicy bots[2];			// Bot A and bot B
+	uint64_t seed;				// Each match's seed comes from this and its index
+	uint32_t matches;
+	uint32_t maxSteps;			// Matches still going after this many steps are draws
+	bool alternateSides;		// Swap which side A plays every other match
+};
+
+struct SelfPlayResult
+{
+	uint32_t matches;
+	uint32_t wins[2];			// Bot A, bot B
+	uint32_t draws;
+	uint32_t sideWins[2];		// Player 1, player 2, whichever bot was there
+	uint64_t goals[2];			// Scored by bot A, bot B
+	uint64_t steps;				// Simulated, across every match
+	double seconds;				// Wall time for the batch
+
+	// Decided matches by length, one bucket per second of play
+	std::vector<uint32_t> lengthHistogram;
+};
+
+// Plays every match in the batch across the pool.  Results only
+// depend on the config, not on the thread count.
+void RunSelfPlay(const SelfPlayConfig& config, JobPool& pool, SelfPlayResult& result);
+
+// Seconds of play that the given fraction of decided matches
+// were over within
+float GetSelfPlayLengthPercentile(const SelfPlayResult& result, float fraction);
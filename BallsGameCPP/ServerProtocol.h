@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// --------------------------------------------------------
+// What clients send a MatchServer, as small UDP packets:
+//   WATCH  matchId ack      - stream me this match (resend every
+//                             few seconds or you're dropped)
+//   INPUT  matchId player   - buttons for player 1 or 2; also
+//          buttons ack        takes that slot from the bot
+// ack is the newest snapshot tick the client has decoded, or
+// SERVER_NO_ACK.  The server answers with snapshots (see
+// SnapshotCodec).
+// --------------------------------------------------------
+
+enum ServerPacketType
+{
+	SERVER_PACKET_WATCH = 0,
+	SERVER_PACKET_INPUT = 1
+};
+
+struct ServerRequest
+{
+	uint8_t type;
+	uint16_t matchId;
+	uint8_t player;
+	uint8_t buttons;	// Player 1's MatchButtons, for INPUT
+	uint32_t ackTick;
+};
+
+const uint32_t SERVER_REQUEST_MAGIC = 0x43535242;	// "BRSC"
+const uint32_t SERVER_NO_ACK = 0xFFFFFFFF;
+
+// magic, type, match, player, buttons, ack
+const size_t SERVER_REQUEST_SIZE = 4 + 1 + 2 + 1 + 1 + 4;
+
+inline void WriteServerRequest(const ServerRequest& request, uint8_t* packet)
+{
+	memcpy(packet, &SERVER_REQUEST_MAGIC, 4);
+	packet[4] = request.type;
+	memcpy(packet + 5, &request.matchId, 2);
+	packet[7] = request.player;
+	packet[8] = request.buttons;
+	memcpy(packet + 9, &request.ackTick, 4);
+}
+
+inline bool ReadServerRequest(const uint8_t* packet, size_t size, ServerRequest& request)
+{
+	uint32_t magic;
+	if (size != SERVER_REQUEST_SIZE)
+		return false;
+	memcpy(&magic, packet, 4);
+	if (magic != SERVER_REQUEST_MAGIC)
+		return false;
+
+	request.type = packet[4];
+	memcpy(&request.matchId, packet + 5, 2);
+	request.player = packet[7];
+	request.buttons = packet[8];
+	memcpy(&request.ackTick, packet + 9, 4);
+	return true;
+}
@@ -0,0 +1,531 @@
+#include "ShaderBundle.h"
+#include "ErrorMessage.h"
+
+#include <cctype>
+#include <cstring>
+
+#define FOURCC(a, b, c, d) \
+	((uint32_t)(uint8_t)(a) | ((uint32_t)(uint8_t)(b) << 8) | ((uint32_t)(uint8_t)(c) << 16) | ((uint32_t)(uint8_t)(d) << 24))
+
+static uint32_t ReadU32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+// Copies a string into a fixed size name field, failing if it doesn't fit
+static bool CopyName(char* dest, const char* src)
+{
+	size_t length = strlen(src);
+	if (length >= SHADER_BUNDLE_NAME_LENGTH)
+		return false;
+
+	memset(dest, 0, SHADER_BUNDLE_NAME_LENGTH);
+	memcpy(dest, src, length);
+	return true;
+}
+
+static bool NameIsTerminated(const char* name)
+{
+	return memchr(name, 0, SHADER_BUNDLE_NAME_LENGTH) != 0;
+}
+
+const char* ShaderStageName(uint32_t stage)
+{
+	switch (stage)
+	{
+	case SHADER_STAGE_PIXEL: return "pixel";
+	case SHADER_STAGE_VERTEX: return "vertex";
+	case SHADER_STAGE_GEOMETRY: return "geometry";
+	case SHADER_STAGE_HULL: return "hull";
+	case SHADER_STAGE_DOMAIN: return "domain";
+	case SHADER_STAGE_COMPUTE: return "compute";
+	default: return "unknown";
+	}
+}
+
+// --------------------------------------------------------
+// One chunk of a DXBC container, with a bounds checked
+// string reader since every name is an offset into the chunk
+// --------------------------------------------------------
+struct DXBCChunk
+{
+	const uint8_t* data;
+	uint32_t size;
+
+	bool Has(uint32_t offset, uint64_t bytes) const
+	{
+		return (uint64_t)offset + bytes <= size;
+	}
+
+	const char* String(uint32_t offset) const
+	{
+		if (offset >= size || !memchr(data + offset, 0, size - offset))
+			return 0;
+		return (const char*)(data + offset);
+	}
+};
+
+static bool FindChunk(const uint8_t* bytecode, size_t size, uint32_t fourCC, DXBCChunk& chunk)
+{
+	uint32_t chunkCount = ReadU32(bytecode + 28);
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		uint32_t offset = ReadU32(bytecode + 32 + i * 4);
+		if ((uint64_t)offset + 8 > size)
+			return false;
+
+		uint32_t chunkSize = ReadU32(bytecode + offset + 4);
+		if ((uint64_t)offset + 8 + chunkSize > size)
+			return false;
+
+		if (ReadU32(bytecode + offset) == fourCC)
+		{
+			chunk.data = bytecode + offset + 8;
+			chunk.size = chunkSize;
+			return true;
+		}
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Walks the program's instructions looking for dcl_thread_group.
+// Each instruction's length is in bits 24-30 of its opcode
+// token, except custom data blocks which store it in the next
+// token.  Declarations come first, so this stops early.
+// --------------------------------------------------------
+static bool ReadThreadGroupSize(const DXBCChunk& code, uint32_t size[3])
+{
+	const uint32_t OPCODE_CUSTOMDATA = 53;
+	const uint32_t OPCODE_DCL_THREAD_GROUP = 155;
+
+	if (!code.Has(0, 8))
+		return false;
+
+	uint32_t tokenCount = ReadU32(code.data + 4);
+	if (!code.Has(0, (uint64_t)tokenCount * 4))
+		return false;
+
+	uint32_t token = 2;
+	while (token < tokenCount)
+	{
+		uint32_t opcodeToken = ReadU32(code.data + token * 4);
+		uint32_t opcode = opcodeToken & 0x7FF;
+		uint32_t length = (opcodeToken >> 24) & 0x7F;
+
+		if (opcode == OPCODE_CUSTOMDATA)
+		{
+			if (token + 1 >= tokenCount)
+				return false;
+			length = ReadU32(code.data + (token + 1) * 4);
+		}
+		else if (opcode == OPCODE_DCL_THREAD_GROUP)
+		{
+			if (length != 4 || token + 4 > tokenCount)
+				return false;
+			size[0] = ReadU32(code.data + (token + 1) * 4);
+			size[1] = ReadU32(code.data + (token + 2) * 4);
+			size[2] = ReadU32(code.data + (token + 3) * 4);
+			return true;
+		}
+
+		if (length == 0)
+			return false;
+		token += length;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Reads the same reflection data D3DReflect gives SimpleShader
+// out of a compiled shader (.cso):
+//  - SHDR/SHEX for the shader stage
+//  - RDEF for constant buffers, variables and bound resources
+//  - ISGN for the input signature (vertex shaders)
+//
+// bytecode - The whole .cso file
+// out      - Receives the reflection and a copy of the bytecode
+// error    - Optional, receives a reason on failure
+// --------------------------------------------------------
+bool DXBCReflect(const uint8_t* bytecode, size_t size, ShaderReflectionData& out, std::string* error)
+{
+	out.buffers.clear();
+	out.variables.clear();
+	out.resources.clear();
+	out.inputs.clear();
+
+	// Container header: magic, checksum[16], 1, total size, chunk count, chunk offsets
+	if (size < 32 || ReadU32(bytecode) != FOURCC('D', 'X', 'B', 'C'))
+		return Fail(error, "Not a DXBC container");
+	if (ReadU32(bytecode + 24) != size)
+		return Fail(error, "DXBC size doesn't match the file size");
+	if ((uint64_t)32 + (uint64_t)ReadU32(bytecode + 28) * 4 > size)
+		return Fail(error, "DXBC chunk table is truncated");
+
+	// Stage comes from the program's version token
+	DXBCChunk code;
+	if (!FindChunk(bytecode, size, FOURCC('S', 'H', 'E', 'X'), code) &&
+		!FindChunk(bytecode, size, FOURCC('S', 'H', 'D', 'R'), code))
+		return Fail(error, "No shader program chunk");
+	if (!code.Has(0, 4))
+		return Fail(error, "Shader program chunk is empty");
+	out.stage = ReadU32(code.data) >> 16;
+	if (out.stage > SHADER_STAGE_COMPUTE)
+		return Fail(error, "Unknown shader stage");
+
+	// Compute shaders declare their thread group size in the instruction stream
+	out.threadGroupSize[0] = out.threadGroupSize[1] = out.threadGroupSize[2] = 0;
+	if (out.stage == SHADER_STAGE_COMPUTE && !ReadThreadGroupSize(code, out.threadGroupSize))
+		return Fail(error, "Compute shader without a thread group size");
+
+	DXBCChunk rdef;
+	if (!FindChunk(bytecode, size, FOURCC('R', 'D', 'E', 'F'), rdef))
+		return Fail(error, "No RDEF chunk (was the shader stripped of reflection?)");
+	if (!rdef.Has(0, 28))
+		return Fail(error, "RDEF chunk is truncated");
+
+	uint32_t bufferCount = ReadU32(rdef.data + 0);
+	uint32_t bufferOffset = ReadU32(rdef.data + 4);
+	uint32_t bindCount = ReadU32(rdef.data + 8);
+	uint32_t bindOffset = ReadU32(rdef.data + 12);
+	uint32_t target = ReadU32(rdef.data + 16);
+
+	// Shader model 5 added four fields to each variable
+	uint32_t majorVersion = (target >> 8) & 0xFF;
+	uint32_t variableStride = majorVersion >= 5 ? 40 : 24;
+
+	// Bound resources - 32 bytes each
+	if (!rdef.Has(bindOffset, (uint64_t)bindCount * 32))
+		return Fail(error, "RDEF resource table is truncated");
+	for (uint32_t i = 0; i < bindCount; i++)
+	{
+		const uint8_t* desc = rdef.data + bindOffset + i * 32;
+		const char* name = rdef.String(ReadU32(desc));
+		if (!name)
+			return Fail(error, "Bad resource name offset");
+
+		ShaderBundleResource resource;
+		if (!CopyName(resource.name, name))
+			return Fail(error, std::string("Resource name too long: ") + name);
+		resource.type = ReadU32(desc + 4);
+		resource.bindIndex = ReadU32(desc + 20);
+		out.resources.push_back(resource);
+	}
+
+	// Constant buffers - 24 bytes each
+	if (!rdef.Has(bufferOffset, (uint64_t)bufferCount * 24))
+		return Fail(error, "RDEF buffer table is truncated");
+	for (uint32_t b = 0; b < bufferCount; b++)
+	{
+		const uint8_t* desc = rdef.data + bufferOffset + b * 24;
+		const char* name = rdef.String(ReadU32(desc));
+		uint32_t variableCount = ReadU32(desc + 4);
+		uint32_t variableOffset = ReadU32(desc + 8);
+		if (!name)
+			return Fail(error, "Bad buffer name offset");
+
+		ShaderBundleBuffer buffer;
+		if (!CopyName(buffer.name, name))
+			return Fail(error, std::string("Buffer name too long: ") + name);
+		buffer.size = ReadU32(desc + 12);
+		buffer.firstVariable = (uint32_t)out.variables.size();
+		buffer.variableCount = variableCount;
+
+		// The bind slot is on the matching resource binding
+		buffer.bindIndex = 0;
+		for (size_t r = 0; r < out.resources.size(); r++)
+		{
+			if ((out.resources[r].type == SHADER_RESOURCE_CBUFFER || out.resources[r].type == SHADER_RESOURCE_TBUFFER) &&
+				strcmp(out.resources[r].name, name) == 0)
+			{
+				buffer.bindIndex = out.resources[r].bindIndex;
+				break;
+			}
+		}
+
+		if (!rdef.Has(variableOffset, (uint64_t)variableCount * variableStride))
+			return Fail(error, "RDEF variable table is truncated");
+		for (uint32_t v = 0; v < variableCount; v++)
+		{
+			const uint8_t* varDesc = rdef.data + variableOffset + v * variableStride;
+			const char* varName = rdef.String(ReadU32(varDesc));
+			if (!varName)
+				return Fail(error, "Bad variable name offset");
+
+			ShaderBundleVariable variable;
+			if (!CopyName(variable.name, varName))
+				return Fail(error, std::string("Variable name too long: ") + varName);
+			variable.byteOffset = ReadU32(varDesc + 4);
+			variable.size = ReadU32(varDesc + 8);
+			if ((uint64_t)variable.byteOffset + variable.size > buffer.size)
+				return Fail(error, std::string("Variable outside its buffer: ") + varName);
+			out.variables.push_back(variable);
+		}
+
+		out.buffers.push_back(buffer);
+	}
+
+	// Input signature - 8 byte header, then 24 bytes per element
+	DXBCChunk isgn;
+	if (FindChunk(bytecode, size, FOURCC('I', 'S', 'G', 'N'), isgn))
+	{
+		if (!isgn.Has(0, 8))
+			return Fail(error, "ISGN chunk is truncated");
+
+		uint32_t elementCount = ReadU32(isgn.data);
+		if (!isgn.Has(8, (uint64_t)elementCount * 24))
+			return Fail(error, "ISGN element table is truncated");
+
+		for (uint32_t i = 0; i < elementCount; i++)
+		{
+			const uint8_t* element = isgn.data + 8 + i * 24;
+			const char* semantic = isgn.String(ReadU32(element));
+			if (!semantic)
+				return Fail(error, "Bad semantic name offset");
+
+			ShaderBundleInput input;
+			if (!CopyName(input.semanticName, semantic))
+				return Fail(error, std::string("Semantic name too long: ") + semantic);
+			input.semanticIndex = ReadU32(element + 4);
+			input.componentType = ReadU32(element + 12);
+			input.mask = element[20];
+			out.inputs.push_back(input);
+		}
+	}
+
+	out.bytecode.assign(bytecode, bytecode + size);
+	return true;
+}
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// --------------------------------------------------------
+// Packs reflected shaders into a single bundle
+// --------------------------------------------------------
+bool ShaderBundleWrite(const std::vector<ShaderReflectionData>& shaders, std::vector<uint8_t>& out, std::string* error)
+{
+	std::vector<ShaderBundleShader> shaderTable;
+	std::vector<ShaderBundleBuffer> bufferTable;
+	std::vector<ShaderBundleVariable> variableTable;
+	std::vector<ShaderBundleResource> resourceTable;
+	std::vector<ShaderBundleInput> inputTable;
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		const ShaderReflectionData& source = shaders[i];
+
+		ShaderBundleShader shader;
+		if (!CopyName(shader.name, source.name.c_str()))
+			return Fail(error, "Shader name too long: " + source.name);
+		shader.stage = source.stage;
+		shader.bytecodeOffset = 0; // Filled in once the tables are sized
+		shader.bytecodeSize = (uint32_t)source.bytecode.size();
+		shader.firstBuffer = (uint32_t)bufferTable.size();
+		shader.bufferCount = (uint32_t)source.buffers.size();
+		shader.firstResource = (uint32_t)resourceTable.size();
+		shader.resourceCount = (uint32_t)source.resources.size();
+		shader.firstInput = (uint32_t)inputTable.size();
+		shader.inputCount = (uint32_t)source.inputs.size();
+		memcpy(shader.threadGroupSize, source.threadGroupSize, sizeof(shader.threadGroupSize));
+
+		// Variable ranges are local to each shader until now
+		uint32_t variableBase = (uint32_t)variableTable.size();
+		for (size_t b = 0; b < source.buffers.size(); b++)
+		{
+			ShaderBundleBuffer buffer = source.buffers[b];
+			buffer.firstVariable += variableBase;
+			bufferTable.push_back(buffer);
+		}
+		variableTable.insert(variableTable.end(), source.variables.begin(), source.variables.end());
+		resourceTable.insert(resourceTable.end(), source.resources.begin(), source.resources.end());
+		inputTable.insert(inputTable.end(), source.inputs.begin(), source.inputs.end());
+		shaderTable.push_back(shader);
+	}
+
+	ShaderBundleHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SHADER_BUNDLE_MAGIC;
+	header.version = SHADER_BUNDLE_VERSION;
+	header.shaderCount = (uint32_t)shaderTable.size();
+	header.bufferCount = (uint32_t)bufferTable.size();
+	header.variableCount = (uint32_t)variableTable.size();
+	header.resourceCount = (uint32_t)resourceTable.size();
+	header.inputCount = (uint32_t)inputTable.size();
+
+	uint32_t offset = sizeof(ShaderBundleHeader);
+	header.shaderOffset = offset;   offset += header.shaderCount * sizeof(ShaderBundleShader);
+	header.bufferOffset = offset;   offset += header.bufferCount * sizeof(ShaderBundleBuffer);
+	header.variableOffset = offset; offset += header.variableCount * sizeof(ShaderBundleVariable);
+	header.resourceOffset = offset; offset += header.resourceCount * sizeof(ShaderBundleResource);
+	header.inputOffset = offset;    offset += header.inputCount * sizeof(ShaderBundleInput);
+
+	for (size_t i = 0; i < shaderTable.size(); i++)
+	{
+		offset = AlignUp(offset, 16);
+		shaderTable[i].bytecodeOffset = offset;
+		offset += shaderTable[i].bytecodeSize;
+	}
+	header.fileSize = offset;
+
+	out.assign(header.fileSize, 0);
+	memcpy(&out[0], &header, sizeof(header));
+	if (!shaderTable.empty()) memcpy(&out[header.shaderOffset], &shaderTable[0], shaderTable.size() * sizeof(ShaderBundleShader));
+	if (!bufferTable.empty()) memcpy(&out[header.bufferOffset], &bufferTable[0], bufferTable.size() * sizeof(ShaderBundleBuffer));
+	if (!variableTable.empty()) memcpy(&out[header.variableOffset], &variableTable[0], variableTable.size() * sizeof(ShaderBundleVariable));
+	if (!resourceTable.empty()) memcpy(&out[header.resourceOffset], &resourceTable[0], resourceTable.size() * sizeof(ShaderBundleResource));
+	if (!inputTable.empty()) memcpy(&out[header.inputOffset], &inputTable[0], inputTable.size() * sizeof(ShaderBundleInput));
+	for (size_t i = 0; i < shaders.size(); i++)
+		memcpy(&out[shaderTable[i].bytecodeOffset], &shaders[i].bytecode[0], shaders[i].bytecode.size());
+
+	return true;
+}
+
+ShaderBundle::ShaderBundle()
+{
+	data = 0;
+	size = 0;
+	header = 0;
+	shaders = 0;
+	buffers = 0;
+	variables = 0;
+	resources = 0;
+	inputs = 0;
+}
+
+bool ShaderBundle::Open(const char* fileName, std::string* error)
+{
+	if (!file.Open(fileName))
+		return Fail(error, std::string("Could not open ") + fileName);
+
+	if (!Parse(file.GetData(), file.GetSize(), error))
+	{
+		file.Close();
+		return false;
+	}
+	return true;
+}
+
+// Checks a table lies inside the file and is aligned for direct access
+static bool TableFits(uint32_t offset, uint32_t count, size_t elementSize, size_t fileSize)
+{
+	return (offset % 4) == 0 && (uint64_t)offset + (uint64_t)count * elementSize <= fileSize;
+}
+
+// --------------------------------------------------------
+// Validates every offset, count and name in the bundle so
+// the getters can be used without further checks
+// --------------------------------------------------------
+bool ShaderBundle::Parse(const uint8_t* data, size_t size, std::string* error)
+{
+	header = 0;
+	this->data = data;
+	this->size = size;
+
+	if (!data || size < sizeof(ShaderBundleHeader) || ((uintptr_t)data % 4) != 0)
+		return Fail(error, "File too small for a bundle header");
+
+	const ShaderBundleHeader* h = (const ShaderBundleHeader*)data;
+	if (h->magic != SHADER_BUNDLE_MAGIC)
+		return Fail(error, "Not a shader bundle");
+	if (h->version != SHADER_BUNDLE_VERSION)
+		return Fail(error, "Unsupported bundle version");
+	if (h->fileSize != size)
+		return Fail(error, "Bundle size doesn't match the file size");
+
+	if (!TableFits(h->shaderOffset, h->shaderCount, sizeof(ShaderBundleShader), size) ||
+		!TableFits(h->bufferOffset, h->bufferCount, sizeof(ShaderBundleBuffer), size) ||
+		!TableFits(h->variableOffset, h->variableCount, sizeof(ShaderBundleVariable), size) ||
+		!TableFits(h->resourceOffset, h->resourceCount, sizeof(ShaderBundleResource), size) ||
+		!TableFits(h->inputOffset, h->inputCount, sizeof(ShaderBundleInput), size))
+		return Fail(error, "Bundle table outside the file");
+
+	shaders = (const ShaderBundleShader*)(data + h->shaderOffset);
+	buffers = (const ShaderBundleBuffer*)(data + h->bufferOffset);
+	variables = (const ShaderBundleVariable*)(data + h->variableOffset);
+	resources = (const ShaderBundleResource*)(data + h->resourceOffset);
+	inputs = (const ShaderBundleInput*)(data + h->inputOffset);
+
+	for (uint32_t i = 0; i < h->shaderCount; i++)
+	{
+		const ShaderBundleShader& s = shaders[i];
+		if (!NameIsTerminated(s.name))
+			return Fail(error, "Unterminated shader name");
+
+		std::string name = s.name;
+		if (s.stage > SHADER_STAGE_COMPUTE)
+			return Fail(error, name + ": unknown stage");
+		if ((uint64_t)s.bytecodeOffset + s.bytecodeSize > size || s.bytecodeSize < 32)
+			return Fail(error, name + ": bytecode outside the file");
+		if (ReadU32(data + s.bytecodeOffset) != FOURCC('D', 'X', 'B', 'C') || ReadU32(data + s.bytecodeOffset + 24) != s.bytecodeSize)
+			return Fail(error, name + ": bytecode isn't a DXBC container");
+		if ((uint64_t)s.firstBuffer + s.bufferCount > h->bufferCount ||
+			(uint64_t)s.firstResource + s.resourceCount > h->resourceCount ||
+			(uint64_t)s.firstInput + s.inputCount > h->inputCount)
+			return Fail(error, name + ": table range outside the bundle");
+	}
+
+	for (uint32_t i = 0; i < h->bufferCount; i++)
+	{
+		const ShaderBundleBuffer& b = buffers[i];
+		if (!NameIsTerminated(b.name))
+			return Fail(error, "Unterminated buffer name");
+		if ((uint64_t)b.firstVariable + b.variableCount > h->variableCount)
+			return Fail(error, std::string(b.name) + ": variable range outside the bundle");
+
+		for (uint32_t v = b.firstVariable; v < b.firstVariable + b.variableCount; v++)
+		{
+			if (!NameIsTerminated(variables[v].name))
+				return Fail(error, "Unterminated variable name");
+			if ((uint64_t)variables[v].byteOffset + variables[v].size > b.size)
+				return Fail(error, std::string(variables[v].name) + ": outside its buffer");
+		}
+	}
+
+	for (uint32_t i = 0; i < h->resourceCount; i++)
+	{
+		if (!NameIsTerminated(resources[i].name))
+			return Fail(error, "Unterminated resource name");
+		if (resources[i].type > SHADER_RESOURCE_UAV_RWSTRUCTURED_WITH_COUNTER)
+			return Fail(error, std::string(resources[i].name) + ": unknown resource type");
+	}
+
+	for (uint32_t i = 0; i < h->inputCount; i++)
+	{
+		if (!NameIsTerminated(inputs[i].semanticName))
+			return Fail(error, "Unterminated semantic name");
+		if (inputs[i].mask == 0 || inputs[i].mask > 15 || inputs[i].componentType > 3)
+			return Fail(error, std::string(inputs[i].semanticName) + ": bad input element");
+	}
+
+	header = h;
+	return true;
+}
+
+// --------------------------------------------------------
+// Finds a shader by name, ignoring case (the .cso names in
+// the project don't all match their .hlsl capitalization)
+// --------------------------------------------------------
+const ShaderBundleShader* ShaderBundle::FindShader(const char* name) const
+{
+	if (!header)
+		return 0;
+
+	for (uint32_t i = 0; i < header->shaderCount; i++)
+	{
+		const char* a = shaders[i].name;
+		const char* b = name;
+		while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+		{
+			a++;
+			b++;
+		}
+		if (*a == 0 && *b == 0)
+			return &shaders[i];
+	}
+	return 0;
+}
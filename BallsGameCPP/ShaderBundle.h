@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Precompiled shader bundle.
+//
+// One file holding the bytecode of every shader plus the
+// reflection data SimpleShader needs (constant buffer layouts,
+// variable offsets, texture/sampler bind slots and the vertex
+// input signature), so shaders can be created at startup without
+// reading eight .cso files and running D3DReflect on each.
+//
+// The bundle is built by Tools/ShaderBundler.cpp, which reads
+// the reflection straight out of the DXBC containers, so both
+// building and validating bundles work without the Windows SDK.
+//
+// File layout (all values little endian, tables 4 byte aligned):
+//   ShaderBundleHeader
+//   ShaderBundleShader[shaderCount]
+//   ShaderBundleBuffer[bufferCount]
+//   ShaderBundleVariable[variableCount]
+//   ShaderBundleResource[resourceCount]
+//   ShaderBundleInput[inputCount]
+//   bytecode blobs, 16 byte aligned
+// --------------------------------------------------------
+
+const uint32_t SHADER_BUNDLE_MAGIC = 0x4E424853; // "SHBN"
+const uint32_t SHADER_BUNDLE_VERSION = 1;
+const size_t SHADER_BUNDLE_NAME_LENGTH = 64;
+
+// Same numbering as D3D11_SHADER_VERSION_TYPE
+enum ShaderBundleStage
+{
+	SHADER_STAGE_PIXEL = 0,
+	SHADER_STAGE_VERTEX = 1,
+	SHADER_STAGE_GEOMETRY = 2,
+	SHADER_STAGE_HULL = 3,
+	SHADER_STAGE_DOMAIN = 4,
+	SHADER_STAGE_COMPUTE = 5
+};
+
+// Same numbering as D3D_SHADER_INPUT_TYPE
+enum ShaderBundleResourceType
+{
+	SHADER_RESOURCE_CBUFFER = 0,
+	SHADER_RESOURCE_TBUFFER = 1,
+	SHADER_RESOURCE_TEXTURE = 2,
+	SHADER_RESOURCE_SAMPLER = 3,
+	SHADER_RESOURCE_UAV_RWTYPED = 4,
+	SHADER_RESOURCE_STRUCTURED = 5,
+	SHADER_RESOURCE_UAV_RWSTRUCTURED = 6,
+	SHADER_RESOURCE_BYTEADDRESS = 7,
+	SHADER_RESOURCE_UAV_RWBYTEADDRESS = 8,
+	SHADER_RESOURCE_UAV_APPEND_STRUCTURED = 9,
+	SHADER_RESOURCE_UAV_CONSUME_STRUCTURED = 10,
+	SHADER_RESOURCE_UAV_RWSTRUCTURED_WITH_COUNTER = 11
+};
+
+#pragma pack(push, 4)
+struct ShaderBundleHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fileSize;
+
+	uint32_t shaderCount;
+	uint32_t bufferCount;
+	uint32_t variableCount;
+	uint32_t resourceCount;
+	uint32_t inputCount;
+
+	uint32_t shaderOffset;
+	uint32_t bufferOffset;
+	uint32_t variableOffset;
+	uint32_t resourceOffset;
+	uint32_t inputOffset;
+};
+
+// The first/count pairs index the bundle-wide tables
+struct ShaderBundleShader
+{
+	char name[SHADER_BUNDLE_NAME_LENGTH];	// File name without extension, like "PixelShader"
+	uint32_t stage;
+	uint32_t bytecodeOffset;
+	uint32_t bytecodeSize;
+	uint32_t firstBuffer;
+	uint32_t bufferCount;
+	uint32_t firstResource;
+	uint32_t resourceCount;
+	uint32_t firstInput;
+	uint32_t inputCount;
+	uint32_t threadGroupSize[3];	// Compute shaders only, zero otherwise
+};
+
+struct ShaderBundleBuffer
+{
+	char name[SHADER_BUNDLE_NAME_LENGTH];
+	uint32_t size;
+	uint32_t bindIndex;
+	uint32_t firstVariable;
+	uint32_t variableCount;
+};
+
+struct ShaderBundleVariable
+{
+	char name[SHADER_BUNDLE_NAME_LENGTH];
+	uint32_t byteOffset;
+	uint32_t size;
+};
+
+struct ShaderBundleResource
+{
+	char name[SHADER_BUNDLE_NAME_LENGTH];
+	uint32_t type;			// ShaderBundleResourceType
+	uint32_t bindIndex;
+};
+
+struct ShaderBundleInput
+{
+	char semanticName[SHADER_BUNDLE_NAME_LENGTH];
+	uint32_t semanticIndex;
+	uint32_t componentType;	// D3D_REGISTER_COMPONENT_TYPE
+	uint32_t mask;			// Used components, 1 to 15
+};
+#pragma pack(pop)
+
+// --------------------------------------------------------
+// Reflection for a single shader, as pulled from its DXBC
+// container.  Buffer variable ranges index 'variables'.
+// --------------------------------------------------------
+struct ShaderReflectionData
+{
+	std::string name;
+	uint32_t stage;
+	uint32_t threadGroupSize[3];
+	std::vector<uint8_t> bytecode;
+	std::vector<ShaderBundleBuffer> buffers;
+	std::vector<ShaderBundleVariable> variables;
+	std::vector<ShaderBundleResource> resources;
+	std::vector<ShaderBundleInput> inputs;
+};
+
+bool DXBCReflect(const uint8_t* bytecode, size_t size, ShaderReflectionData& out, std::string* error = 0);
+bool ShaderBundleWrite(const std::vector<ShaderReflectionData>& shaders, std::vector<uint8_t>& out, std::string* error = 0);
+
+const char* ShaderStageName(uint32_t stage);
+
+// --------------------------------------------------------
+// A validated, read-only view of a bundle.  Everything returned
+// points into the file data, nothing is copied.
+// --------------------------------------------------------
+class ShaderBundle
+{
+public:
+	ShaderBundle();
+
+	// Maps and validates a bundle file
+	bool Open(const char* fileName, std::string* error = 0);
+
+	// Validates a bundle already in memory (must outlive this object)
+	bool Parse(const uint8_t* data, size_t size, std::string* error = 0);
+
+	const ShaderBundleShader* FindShader(const char* name) const;
+
+	uint32_t GetShaderCount() const { return header ? header->shaderCount : 0; }
+	const ShaderBundleShader& GetShader(uint32_t index) const { return shaders[index]; }
+	const ShaderBundleBuffer& GetBuffer(uint32_t index) const { return buffers[index]; }
+	const ShaderBundleVariable& GetVariable(uint32_t index) const { return variables[index]; }
+	const ShaderBundleResource& GetResource(uint32_t index) const { return resources[index]; }
+	const ShaderBundleInput& GetInput(uint32_t index) const { return inputs[index]; }
+	const uint8_t* GetBytecode(const ShaderBundleShader& shader) const { return data + shader.bytecodeOffset; }
+	size_t GetSize() const { return size; }
+
+private:
+	MappedFile file;
+	const uint8_t* data;
+	size_t size;
+
+	const ShaderBundleHeader* header;
+	const ShaderBundleShader* shaders;
+	const ShaderBundleBuffer* buffers;
+	const ShaderBundleVariable* variables;
+	const ShaderBundleResource* resources;
+	const ShaderBundleInput* inputs;
+};
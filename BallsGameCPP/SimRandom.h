@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------
+// Seeded random numbers for the simulation (PCG32).
+//
+// rand() has hidden global state and differs between C
+// runtimes, so anything that affects the match draws from one
+// of these instead.  The whole generator is a single integer,
+// which makes it trivial to record, hash and restore.
+// --------------------------------------------------------
+class SimRandom
+{
+public:
+	explicit SimRandom(uint64_t seed = 0) { Seed(seed); }
+
+	void Seed(uint64_t seed)
+	{
+		state = 0;
+		Next();
+		state += seed;
+		Next();
+	}
+
+	uint32_t Next()
+	{
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rotation = (uint32_t)(old >> 59);
+		return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+	}
+
+	// [0, 1)
+	float NextFloat() { return (Next() >> 8) * (1.0f / 16777216.0f); }
+
+	// [-1, 1)
+	float NextSigned() { return NextFloat() * 2.0f - 1.0f; }
+
+	uint64_t GetState() const { return state; }
+	void SetState(uint64_t state) { this->state = state; }
+
+private:
+	uint64_t state;
+};
+
+// --------------------------------------------------------
+// FNV-1a, used to fingerprint simulation state so two runs
+// can be compared step by step
+// --------------------------------------------------------
+const uint32_t SIM_HASH_START = 2166136261u;
+
+inline uint32_t SimHash(uint32_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
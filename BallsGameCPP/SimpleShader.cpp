@@ -4,6 +4,61 @@
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
+// --------------------------------------------------------
+// Picks the DXGI format for a vertex shader input based on
+// which components it uses and their type
+// --------------------------------------------------------
+static DXGI_FORMAT GetInputFormat(unsigned int mask, unsigned int componentType)
+{
+	if (mask == 1)
+	{
+		if (componentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32_UINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32_SINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32_FLOAT;
+	}
+	else if (mask <= 3)
+	{
+		if (componentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32_UINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32_SINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32_FLOAT;
+	}
+	else if (mask <= 7)
+	{
+		if (componentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32B32_UINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32B32_SINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32B32_FLOAT;
+	}
+	else if (mask <= 15)
+	{
+		if (componentType == D3D_REGISTER_COMPONENT_UINT32) return DXGI_FORMAT_R32G32B32A32_UINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_SINT32) return DXGI_FORMAT_R32G32B32A32_SINT;
+		else if (componentType == D3D_REGISTER_COMPONENT_FLOAT32) return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	}
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+// --------------------------------------------------------
+// True if a semantic name ends in "_PER_INSTANCE"
+// --------------------------------------------------------
+static bool IsPerInstanceSemantic(const std::string& sem)
+{
+	std::string perInstanceStr = "_PER_INSTANCE";
+	int lenDiff = sem.size() - perInstanceStr.size();
+	return
+		lenDiff >= 0 &&
+		sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+}
+
+// --------------------------------------------------------
+// True for inputs the input assembler makes up itself, like
+// SV_VertexID and SV_InstanceID, which an input layout must
+// not list
+// --------------------------------------------------------
+static bool IsSystemValueSemantic(const char* sem)
+{
+	return (sem[0] == 'S' || sem[0] == 's') && (sem[1] == 'V' || sem[1] == 'v') && sem[2] == '_';
+}
+
 // --------------------------------------------------------
 // Constructor accepts DirectX device & context
 // --------------------------------------------------------
@@ -45,6 +100,7 @@ void ISimpleShader::CleanUp()
 	if (constantBuffers)
 	{
 		delete[] constantBuffers;
+		constantBuffers = 0;
 		constantBufferCount = 0;
 	}
 
@@ -54,6 +110,9 @@ void ISimpleShader::CleanUp()
 	for (unsigned int i = 0; i < samplerStates.size(); i++)
 		delete samplerStates[i];
 
+	shaderResourceViews.clear();
+	samplerStates.clear();
+
 	// Clean up tables
 	varTable.clear();
 	cbTable.clear();
@@ -208,6 +267,150 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	return true;
 }
 
+// --------------------------------------------------------
+// Loads the named shader from a precompiled bundle.  The
+// bundle already holds everything LoadShaderFile() gets from
+// reflection, so the tables are filled straight from it.
+//
+// bundle - A bundle that was opened successfully
+// name   - The shader's file name without extension, like "PixelShader"
+//
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadFromBundle(const ShaderBundle& bundle, const char* name)
+{
+	const ShaderBundleShader* entry = bundle.FindShader(name);
+	if (!entry)
+		return false;
+
+	// D3D wants the bytecode in a blob for the life of the shader
+	// (the vertex shader needs it again for the input layout)
+	ID3DBlob* blob = 0;
+	if (FAILED(D3DCreateBlob(entry->bytecodeSize, &blob)))
+		return false;
+	memcpy(blob->GetBufferPointer(), bundle.GetBytecode(*entry), entry->bytecodeSize);
+
+	if (shaderBlob)
+		shaderBlob->Release();
+	shaderBlob = blob;
+
+	// Create the shader - Calls the appropriate child class
+	shaderValid = CreateShaderFromBundle(shaderBlob, bundle, *entry);
+	if (!shaderValid)
+	{
+		return false;
+	}
+
+	// Textures and samplers
+	for (unsigned int r = 0; r < entry->resourceCount; r++)
+	{
+		const ShaderBundleResource& resource = bundle.GetResource(entry->firstResource + r);
+		switch (resource.type)
+		{
+		case SHADER_RESOURCE_TEXTURE:
+		{
+			SimpleSRV* srv = new SimpleSRV();
+			srv->BindIndex = resource.bindIndex;
+			srv->Index = shaderResourceViews.size();
+
+			textureTable.insert(std::pair<std::string, SimpleSRV*>(resource.name, srv));
+			shaderResourceViews.push_back(srv);
+		}
+			break;
+
+		case SHADER_RESOURCE_SAMPLER:
+		{
+			SimpleSampler* samp = new SimpleSampler();
+			samp->BindIndex = resource.bindIndex;
+			samp->Index = samplerStates.size();
+
+			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resource.name, samp));
+			samplerStates.push_back(samp);
+		}
+			break;
+		}
+	}
+
+	// Constant buffers and their variables
+	constantBufferCount = entry->bufferCount;
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ShaderBundleBuffer& buffer = bundle.GetBuffer(entry->firstBuffer + b);
+
+		constantBuffers[b].BindIndex = buffer.bindIndex;
+		constantBuffers[b].Name = buffer.name;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(buffer.name, &constantBuffers[b]));
+
+		D3D11_BUFFER_DESC newBuffDesc;
+		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
+		newBuffDesc.ByteWidth = buffer.size;
+		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		newBuffDesc.CPUAccessFlags = 0;
+		newBuffDesc.MiscFlags = 0;
+		newBuffDesc.StructureByteStride = 0;
+		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
+
+		constantBuffers[b].Size = buffer.size;
+		constantBuffers[b].LocalDataBuffer = new unsigned char[buffer.size];
+		ZeroMemory(constantBuffers[b].LocalDataBuffer, buffer.size);
+
+		for (unsigned int v = 0; v < buffer.variableCount; v++)
+		{
+			const ShaderBundleVariable& variable = bundle.GetVariable(buffer.firstVariable + v);
+
+			SimpleShaderVariable varStruct;
+			varStruct.ConstantBufferIndex = b;
+			varStruct.ByteOffset = variable.byteOffset;
+			varStruct.Size = variable.size;
+
+			varTable.insert(std::pair<std::string, SimpleShaderVariable>(variable.name, varStruct));
+			constantBuffers[b].Variables.push_back(varStruct);
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Creates the shader for LoadFromBundle().  Shader types that
+// need nothing beyond the bytecode just use CreateShader()
+// --------------------------------------------------------
+bool ISimpleShader::CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry)
+{
+	return CreateShader(shaderBlob);
+}
+
+// --------------------------------------------------------
+// Copies the local (CPU side) value of every variable that
+// also exists in another shader, matched by name and size.
+// Used when a shader is reloaded, so data that was only set
+// once (like lights) carries over to the new version even if
+// its constant buffer layout changed.
+//
+// other - The shader to copy values from
+//
+// Returns the number of variables copied
+// --------------------------------------------------------
+unsigned int ISimpleShader::CopyVariablesFrom(ISimpleShader* other)
+{
+	unsigned int copied = 0;
+	std::unordered_map<std::string, SimpleShaderVariable>::iterator it;
+	for (it = other->varTable.begin(); it != other->varTable.end(); it++)
+	{
+		SimpleShaderVariable* var = FindVariable(it->first, it->second.Size);
+		if (!var)
+			continue;
+
+		memcpy(
+			constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
+			other->constantBuffers[it->second.ConstantBufferIndex].LocalDataBuffer + it->second.ByteOffset,
+			var->Size);
+		copied++;
+	}
+	return copied;
+}
+
 // --------------------------------------------------------
 // Helper for looking up a variable by name and also
 // verifying that it is the requested size
@@ -675,13 +878,12 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
 		refl->GetInputParameterDesc(i, &paramDesc);
 
+		// Skip anything the input assembler generates
+		if (IsSystemValueSemantic(paramDesc.SemanticName))
+			continue;
+
 		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = sem.size() - perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+		bool isPerInstance = IsPerInstanceSemantic(paramDesc.SemanticName);
 
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc;
@@ -703,35 +905,20 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		}
 
 		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
+		elementDesc.Format = GetInputFormat(paramDesc.Mask, paramDesc.ComponentType);
 
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// A shader that only reads system values (SV_VertexID and
+	// the like) needs no layout at all
+	if (inputLayoutDesc.empty())
+	{
+		refl->Release();
+		return true;
+	}
+
 	// Try to create Input Layout
 	HRESULT hr = device->CreateInputLayout(
 		&inputLayoutDesc[0], 
@@ -745,6 +932,75 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 	return true;
 }
 
+// --------------------------------------------------------
+// Creates the DirectX vertex shader from a bundle entry,
+// building the input layout from the bundled input signature
+// instead of reflecting
+// --------------------------------------------------------
+bool SimpleVertexShader::CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry)
+{
+	if (entry.stage != SHADER_STAGE_VERTEX)
+		return false;
+
+	// Keep a custom input layout from the constructor, since
+	// CleanUp() would otherwise release it
+	ID3D11InputLayout* customLayout = inputLayout;
+	inputLayout = 0;
+	this->CleanUp();
+	inputLayout = customLayout;
+
+	HRESULT result = device->CreateVertexShader(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		0,
+		&shader);
+	if (result != S_OK)
+		return false;
+
+	if (inputLayout)
+		return true;
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
+	for (unsigned int i = 0; i < entry.inputCount; i++)
+	{
+		const ShaderBundleInput& input = bundle.GetInput(entry.firstInput + i);
+		if (IsSystemValueSemantic(input.semanticName))
+			continue;
+		bool isPerInstance = IsPerInstanceSemantic(input.semanticName);
+
+		D3D11_INPUT_ELEMENT_DESC elementDesc;
+		elementDesc.SemanticName = input.semanticName;	// Lives in the bundle, which outlives this call
+		elementDesc.SemanticIndex = input.semanticIndex;
+		elementDesc.Format = GetInputFormat(input.mask, input.componentType);
+		elementDesc.InputSlot = 0;
+		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		elementDesc.InstanceDataStepRate = 0;
+
+		if (isPerInstance)
+		{
+			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
+			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+			elementDesc.InstanceDataStepRate = 1;
+
+			perInstanceCompatible = true;
+		}
+
+		inputLayoutDesc.push_back(elementDesc);
+	}
+
+	if (inputLayoutDesc.empty())
+		return true;
+
+	device->CreateInputLayout(
+		&inputLayoutDesc[0],
+		inputLayoutDesc.size(),
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		&inputLayout);
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets the vertex shader, input layout and constant buffers
 // for future DirectX drawing
@@ -1541,6 +1797,48 @@ bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
 	return true;
 }
 
+// --------------------------------------------------------
+// Creates the DirectX compute shader from a bundle entry,
+// taking the UAV slots and thread group size from the bundle
+// --------------------------------------------------------
+bool SimpleComputeShader::CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry)
+{
+	if (entry.stage != SHADER_STAGE_COMPUTE)
+		return false;
+
+	this->CleanUp();
+
+	HRESULT result = device->CreateComputeShader(
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		0,
+		&shader);
+	if (result != S_OK)
+		return false;
+
+	threadsX = entry.threadGroupSize[0];
+	threadsY = entry.threadGroupSize[1];
+	threadsZ = entry.threadGroupSize[2];
+	threadsTotal = threadsX * threadsY * threadsZ;
+
+	for (unsigned int r = 0; r < entry.resourceCount; r++)
+	{
+		const ShaderBundleResource& resource = bundle.GetResource(entry.firstResource + r);
+		switch (resource.type)
+		{
+		case SHADER_RESOURCE_UAV_APPEND_STRUCTURED:
+		case SHADER_RESOURCE_UAV_CONSUME_STRUCTURED:
+		case SHADER_RESOURCE_UAV_RWBYTEADDRESS:
+		case SHADER_RESOURCE_UAV_RWSTRUCTURED:
+		case SHADER_RESOURCE_UAV_RWSTRUCTURED_WITH_COUNTER:
+		case SHADER_RESOURCE_UAV_RWTYPED:
+			uavTable.insert(std::pair<std::string, unsigned int>(resource.name, resource.bindIndex));
+		}
+	}
+
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets the Compute shader and constant buffers for
 // future DirectX drawing
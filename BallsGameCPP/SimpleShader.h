@@ -10,6 +10,8 @@
 #include <vector>
 #include <string>
 
+#include "ShaderBundle.h"
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -67,6 +69,10 @@ public:
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
 
+	// Same as above, but takes the bytecode and prebuilt reflection
+	// tables from a shader bundle, so no reflection happens at runtime
+	bool LoadFromBundle(const ShaderBundle& bundle, const char* name);
+
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
@@ -75,6 +81,7 @@ public:
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
+	unsigned int CopyVariablesFrom(ISimpleShader* other);
 
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
@@ -137,6 +144,10 @@ protected:
 	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
 
+	// Defaults to CreateShader() - overridden by shaders that
+	// would otherwise reflect for extra data (input layout, UAVs)
+	virtual bool CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry);
+
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
@@ -165,6 +176,7 @@ protected:
 	ID3D11InputLayout* inputLayout;
 	ID3D11VertexShader* shader;
 	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry);
 	void SetShaderAndCBs();
 	void CleanUp();
 };
@@ -295,6 +307,7 @@ protected:
 	unsigned int threadsTotal;
 
 	bool CreateShader(ID3DBlob* shaderBlob);
+	bool CreateShaderFromBundle(ID3DBlob* shaderBlob, const ShaderBundle& bundle, const ShaderBundleShader& entry);
 	void SetShaderAndCBs();
 	void CleanUp();
 };
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include "SnapshotCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "BitStream.h"
+
+// magic, match, tick, baseline age
+const size_t SNAPSHOT_HEADER_SIZE = 4 + 2 + 4 + 1;
+
+const int SCORE_BITS = 5;
+const int SELECTION_BITS = 3;
+
+const int32_t X_MAX = (1 << SNAPSHOT_X_BITS) - 1;
+const int32_t Y_MAX = (1 << SNAPSHOT_Y_BITS) - 1;
+const int32_t VELOCITY_MAX = (1 << SNAPSHOT_VELOCITY_BITS) - 1;
+const int32_t VELOCITY_ZERO = 1 << (SNAPSHOT_VELOCITY_BITS - 1);
+const float VELOCITY_OFFSET = VELOCITY_ZERO / SNAPSHOT_VELOCITY_SCALE;
+
+// The field sits in the middle of the range, leaving room for balls
+// that are past the edge on their way out
+const float X_OFFSET = (1 << (SNAPSHOT_X_BITS - 1)) / SNAPSHOT_POSITION_SCALE;
+const float Y_OFFSET = (1 << (SNAPSHOT_Y_BITS - 1)) / SNAPSHOT_POSITION_SCALE;
+
+// Position steps a velocity step covers in a second, and ticks in a second
+const int32_t POSITION_PER_VELOCITY = (int32_t)(SNAPSHOT_POSITION_SCALE / SNAPSHOT_VELOCITY_SCALE);
+const int32_t TICKS_PER_SECOND = (int32_t)(1.0f / MATCH_TIMESTEP + 0.5f);
+
+static int32_t Quantize(float value, float offset, float scale, int32_t max)
+{
+	int32_t q = (int32_t)floorf((value + offset) * scale + 0.5f);
+	return q < 0 ? 0 : (q > max ? max : q);
+}
+
+static uint8_t Clamp(int value, int bits)
+{
+	int max = (1 << bits) - 1;
+	return (uint8_t)(value < 0 ? 0 : (value > max ? max : value));
+}
+
+float SnapshotToX(int32_t x) { return x / SNAPSHOT_POSITION_SCALE - X_OFFSET; }
+float SnapshotToY(int32_t y) { return y / SNAPSHOT_POSITION_SCALE - Y_OFFSET; }
+float SnapshotToVelocity(int32_t v) { return (v - VELOCITY_ZERO) / SNAPSHOT_VELOCITY_SCALE; }
+
+void CaptureSnapshot(Match& match, uint32_t tick, Snapshot& snapshot)
+{
+	BallManager* manager = match.GetBallManager();
+	std::vector<Ball>& balls = manager->getBalls();
+	MatchScore& score = manager->getScore();
+
+	snapshot.tick = tick;
+	snapshot.p1Score = Clamp(score.p1Score, SCORE_BITS);
+	snapshot.p2Score = Clamp(score.p2Score, SCORE_BITS);
+	snapshot.p1Balls = Clamp(score.p1Balls, SCORE_BITS);
+	snapshot.p2Balls = Clamp(score.p2Balls, SCORE_BITS);
+	snapshot.p1Selection = Clamp(match.GetSelection(1), SELECTION_BITS);
+	snapshot.p2Selection = Clamp(match.GetSelection(2), SELECTION_BITS);
+
+	// BallManager keeps balls in id order already
+	snapshot.balls.resize(balls.size());
+	for (size_t i = 0; i < balls.size(); i++)
+	{
+		myVector position = balls[i].getPosition();
+		myVector velocity = balls[i].getVelocity();
+		SnapshotBall& ball = snapshot.balls[i];
+		ball.id = balls[i].getId();
+		ball.soccer = balls[i].getIsSoccerBall();
+		ball.x = Quantize(position.x, X_OFFSET, SNAPSHOT_POSITION_SCALE, X_MAX);
+		ball.y = Quantize(position.y, Y_OFFSET, SNAPSHOT_POSITION_SCALE, Y_MAX);
+		ball.vx = Quantize(velocity.x, VELOCITY_OFFSET, SNAPSHOT_VELOCITY_SCALE, VELOCITY_MAX);
+		ball.vy = Quantize(velocity.y, VELOCITY_OFFSET, SNAPSHOT_VELOCITY_SCALE, VELOCITY_MAX);
+	}
+}
+
+// --------------------------------------------------------
+// Where a baseline ball would be after age ticks if nothing hit
+// it.  Integer math, so both ends agree to the bit.
+// --------------------------------------------------------
+static void Predict(const SnapshotBall& ball, uint32_t age, int32_t& x, int32_t& y)
+{
+	x = ball.x + (ball.vx - VELOCITY_ZERO) * POSITION_PER_VELOCITY * (int32_t)age / TICKS_PER_SECOND;
+	y = ball.y + (ball.vy - VELOCITY_ZERO) * POSITION_PER_VELOCITY * (int32_t)age / TICKS_PER_SECOND;
+}
+
+// 4 bits at a time, each followed by a bit saying whether more follow
+static void WriteVar(BitWriter& writer, uint32_t value)
+{
+	do
+	{
+		writer.Write(value & 15, 4);
+		value >>= 4;
+		writer.WriteBool(value != 0);
+	} while (value != 0);
+}
+
+static uint32_t ReadVar(BitReader& reader)
+{
+	uint32_t value = 0;
+	for (int shift = 0; shift < 32; shift += 4)
+	{
+		value |= reader.Read(4) << shift;
+		if (!reader.ReadBool())
+			return value;
+	}
+	return value;
+}
+
+// --------------------------------------------------------
+// A signed difference in as few bits as it needs: one bit for
+// zero, otherwise a two bit size class and the zigzagged value
+// --------------------------------------------------------
+static const int DELTA_CLASS_BITS[4] = { 3, 6, 10, 16 };
+
+static void WriteDelta(BitWriter& writer, int32_t delta)
+{
+	if (delta == 0)
+	{
+		writer.WriteBool(false);
+		return;
+	}
+	writer.WriteBool(true);
+
+	uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+	uint32_t value = zigzag - 1;
+	int sizeClass = 0;
+	while (sizeClass < 3 && value >= (1u << DELTA_CLASS_BITS[sizeClass]))
+		sizeClass++;
+	writer.Write(sizeClass, 2);
+	writer.Write(value, DELTA_CLASS_BITS[sizeClass]);
+}
+
+static int32_t ReadDelta(BitReader& reader)
+{
+	if (!reader.ReadBool())
+		return 0;
+	int sizeClass = (int)reader.Read(2);
+	uint32_t zigzag = reader.Read(DELTA_CLASS_BITS[sizeClass]) + 1;
+	return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+}
+
+static void WriteFullBall(BitWriter& writer, const SnapshotBall& ball)
+{
+	writer.WriteBool(ball.soccer);
+	writer.Write(ball.x, SNAPSHOT_X_BITS);
+	writer.Write(ball.y, SNAPSHOT_Y_BITS);
+	writer.Write(ball.vx, SNAPSHOT_VELOCITY_BITS);
+	writer.Write(ball.vy, SNAPSHOT_VELOCITY_BITS);
+}
+
+void EncodeSnapshot(uint16_t matchId, const Snapshot& snapshot, const Snapshot* baseline, std::vector<uint8_t>& packet)
+{
+	uint32_t age = 0;
+	if (baseline && baseline->tick < snapshot.tick && snapshot.tick - baseline->tick <= SNAPSHOT_MAX_BASELINE_AGE)
+		age = snapshot.tick - baseline->tick;
+	else
+		baseline = 0;
+
+	packet.resize(SNAPSHOT_HEADER_SIZE);
+	memcpy(&packet[0], &SNAPSHOT_MAGIC, 4);
+	memcpy(&packet[4], &matchId, 2);
+	memcpy(&packet[6], &snapshot.tick, 4);
+	packet[10] = (uint8_t)age;
+
+	BitWriter writer(packet);
+	writer.Write(snapshot.p1Score, SCORE_BITS);
+	writer.Write(snapshot.p2Score, SCORE_BITS);
+	writer.Write(snapshot.p1Balls, SCORE_BITS);
+	writer.Write(snapshot.p2Balls, SCORE_BITS);
+	writer.Write(snapshot.p1Selection, SELECTION_BITS);
+	writer.Write(snapshot.p2Selection, SELECTION_BITS);
+
+	// Walk both id-sorted lists together; whatever's left in the
+	// current one afterwards is new
+	const std::vector<SnapshotBall>& balls = snapshot.balls;
+	size_t newCount = balls.size();
+	if (baseline)
+	{
+		size_t c = 0;
+		for (const SnapshotBall& old : baseline->balls)
+		{
+			while (c < balls.size() && balls[c].id < old.id)
+				c++;
+			bool alive = c < balls.size() && balls[c].id == old.id;
+			writer.WriteBool(alive);
+			if (!alive)
+				continue;
+
+			const SnapshotBall& ball = balls[c++];
+			newCount--;
+			int32_t x, y;
+			Predict(old, age, x, y);
+			bool changed = ball.x != x || ball.y != y || ball.vx != old.vx || ball.vy != old.vy || ball.soccer != old.soccer;
+			writer.WriteBool(changed);
+			if (changed)
+			{
+				writer.WriteBool(ball.soccer);
+				WriteDelta(writer, ball.x - x);
+				WriteDelta(writer, ball.y - y);
+				WriteDelta(writer, ball.vx - old.vx);
+				WriteDelta(writer, ball.vy - old.vy);
+			}
+		}
+	}
+
+	WriteVar(writer, (uint32_t)newCount);
+	uint32_t previousId = 0;
+	size_t b = 0;
+	for (const SnapshotBall& ball : balls)
+	{
+		// Skip the ones already sent as changes to the baseline
+		if (baseline)
+		{
+			while (b < baseline->balls.size() && baseline->balls[b].id < ball.id)
+				b++;
+			if (b < baseline->balls.size() && baseline->balls[b].id == ball.id)
+				continue;
+		}
+		WriteVar(writer, ball.id - previousId);
+		previousId = ball.id;
+		WriteFullBall(writer, ball);
+	}
+	writer.Flush();
+}
+
+bool PeekSnapshot(const uint8_t* data, size_t size, uint16_t& matchId, uint32_t& tick, uint32_t& baselineTick)
+{
+	uint32_t magic;
+	if (size < SNAPSHOT_HEADER_SIZE)
+		return false;
+	memcpy(&magic, data, 4);
+	if (magic != SNAPSHOT_MAGIC)
+		return false;
+
+	memcpy(&matchId, data + 4, 2);
+	memcpy(&tick, data + 6, 4);
+	uint8_t age = data[10];
+	baselineTick = age == 0 ? tick : tick - age;
+	return age == 0 || age <= tick;
+}
+
+static bool LessId(const SnapshotBall& a, const SnapshotBall& b)
+{
+	return a.id < b.id;
+}
+
+bool DecodeSnapshot(const uint8_t* data, size_t size, const SnapshotHistory& history, Snapshot& snapshot)
+{
+	uint16_t matchId;
+	uint32_t tick, baselineTick;
+	if (!PeekSnapshot(data, size, matchId, tick, baselineTick))
+		return false;
+
+	const Snapshot* baseline = 0;
+	if (baselineTick != tick)
+	{
+		baseline = history.Find(baselineTick);
+		if (!baseline)
+			return false;
+	}
+	uint32_t age = tick - baselineTick;
+
+	BitReader reader(data + SNAPSHOT_HEADER_SIZE, size - SNAPSHOT_HEADER_SIZE);
+	snapshot.tick = tick;
+	snapshot.p1Score = (uint8_t)reader.Read(SCORE_BITS);
+	snapshot.p2Score = (uint8_t)reader.Read(SCORE_BITS);
+	snapshot.p1Balls = (uint8_t)reader.Read(SCORE_BITS);
+	snapshot.p2Balls = (uint8_t)reader.Read(SCORE_BITS);
+	snapshot.p1Selection = (uint8_t)reader.Read(SELECTION_BITS);
+	snapshot.p2Selection = (uint8_t)reader.Read(SELECTION_BITS);
+
+	snapshot.balls.clear();
+	if (baseline)
+	{
+		for (const SnapshotBall& old : baseline->balls)
+		{
+			if (!reader.ReadBool())
+				continue;
+
+			SnapshotBall ball = old;
+			Predict(old, age, ball.x, ball.y);
+			if (reader.ReadBool())
+			{
+				ball.soccer = reader.ReadBool();
+				ball.x += ReadDelta(reader);
+				ball.y += ReadDelta(reader);
+				ball.vx += ReadDelta(reader);
+				ball.vy += ReadDelta(reader);
+			}
+			if (ball.x < 0 || ball.x > X_MAX || ball.y < 0 || ball.y > Y_MAX ||
+				ball.vx < 0 || ball.vx > VELOCITY_MAX || ball.vy < 0 || ball.vy > VELOCITY_MAX)
+				return false;
+			snapshot.balls.push_back(ball);
+		}
+	}
+	size_t keptCount = snapshot.balls.size();
+
+	// Each new ball takes at least 49 bits, which bounds a bogus count
+	uint32_t newCount = ReadVar(reader);
+	if (reader.IsOverflowed() || newCount > reader.GetBitsLeft() / 49)
+		return false;
+
+	uint32_t id = 0;
+	for (uint32_t i = 0; i < newCount; i++)
+	{
+		SnapshotBall ball;
+		uint32_t gap = ReadVar(reader);
+		if (i > 0 && gap == 0)
+			return false;
+		id += gap;
+		ball.id = id;
+		ball.soccer = reader.ReadBool();
+		ball.x = (int32_t)reader.Read(SNAPSHOT_X_BITS);
+		ball.y = (int32_t)reader.Read(SNAPSHOT_Y_BITS);
+		ball.vx = (int32_t)reader.Read(SNAPSHOT_VELOCITY_BITS);
+		ball.vy = (int32_t)reader.Read(SNAPSHOT_VELOCITY_BITS);
+		snapshot.balls.push_back(ball);
+	}
+	if (reader.IsOverflowed())
+		return false;
+
+	// Kept and new balls are each in id order; keep the whole list that way
+	std::inplace_merge(snapshot.balls.begin(), snapshot.balls.begin() + keptCount, snapshot.balls.end(), LessId);
+	return true;
+}
+
+// --------------------------------------------------------
+// History
+// --------------------------------------------------------
+SnapshotHistory::SnapshotHistory(int count)
+	: snapshots(count < 1 ? 1 : count), used(count < 1 ? 1 : count, false)
+{
+	newestTick = 0;
+	any = false;
+}
+
+Snapshot& SnapshotHistory::Add(uint32_t tick)
+{
+	size_t slot = tick % snapshots.size();
+	used[slot] = true;
+	snapshots[slot].tick = tick;
+	if (!any || tick > newestTick)
+		newestTick = tick;
+	any = true;
+	return snapshots[slot];
+}
+
+const Snapshot* SnapshotHistory::Find(uint32_t tick) const
+{
+	size_t slot = tick % snapshots.size();
+	if (!used[slot] || snapshots[slot].tick != tick)
+		return 0;
+	return &snapshots[slot];
+}
+
+const Snapshot* SnapshotHistory::GetNewest() const
+{
+	return any ? Find(newestTick) : 0;
+}
+
+void SnapshotHistory::Clear()
+{
+	for (size_t i = 0; i < used.size(); i++)
+		used[i] = false;
+	any = false;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Match.h"
+
+// --------------------------------------------------------
+// Compact match snapshots for spectators.
+//
+// A Snapshot is what a spectator needs to draw a match: the
+// score, both players' rows, and every ball's position and
+// velocity quantized to fixed point.  Positions are in steps of
+// 1/1024 of a unit, and the bits for each axis are the fewest
+// that cover the field (FIELD_X_BOUND/FIELD_Y_BOUND either side
+// of the middle): 13 for x, 12 for y, with the spare range split
+// either side for balls overshooting the edge.  Velocities are
+// +-4 units/s in steps of 1/256, 11 bits each.
+//
+// Snapshots are encoded against a baseline the receiver is known
+// to have (the newest one it acknowledged):
+//   - one bit per baseline ball for whether it's still there
+//   - for those that are, one bit for whether it changed beyond
+//     what its baseline velocity predicts, then a small variable
+//     length delta per field if it did
+//   - balls the baseline doesn't have, in full
+// With no baseline every ball goes in full.  Both ends quantize
+// and predict with the same integer math, so the receiver
+// rebuilds exactly the snapshot the sender encoded.
+// --------------------------------------------------------
+
+const float SNAPSHOT_POSITION_SCALE = 1024.0f;	// Steps per unit
+const float SNAPSHOT_VELOCITY_SCALE = 256.0f;
+const int SNAPSHOT_X_BITS = 13;
+const int SNAPSHOT_Y_BITS = 12;
+const int SNAPSHOT_VELOCITY_BITS = 11;
+
+// Ticks a snapshot's baseline can be behind it
+const int SNAPSHOT_MAX_BASELINE_AGE = 255;
+
+const uint32_t SNAPSHOT_MAGIC = 0x53535242;	// "BRSS"
+
+struct SnapshotBall
+{
+	uint32_t id;
+	bool soccer;
+	int32_t x, y;		// Quantized, the field's centre is mid-range
+	int32_t vx, vy;		// Quantized, 0 is the most negative speed
+};
+
+struct Snapshot
+{
+	uint32_t tick;
+	uint8_t p1Score, p2Score;
+	uint8_t p1Balls, p2Balls;
+	uint8_t p1Selection, p2Selection;
+	std::vector<SnapshotBall> balls;	// Sorted by id
+};
+
+// Quantizes the match's current state into snapshot.  Reuses the
+// snapshot's ball storage, so capturing every tick doesn't allocate.
+void CaptureSnapshot(Match& match, uint32_t tick, Snapshot& snapshot);
+
+// Back to world units
+float SnapshotToX(int32_t x);
+float SnapshotToY(int32_t y);
+float SnapshotToVelocity(int32_t v);
+
+// --------------------------------------------------------
+// Writes snapshot as a packet, as a delta against baseline if
+// one is given (it must be older than snapshot, by no more than
+// SNAPSHOT_MAX_BASELINE_AGE ticks).
+// --------------------------------------------------------
+void EncodeSnapshot(uint16_t matchId, const Snapshot& snapshot, const Snapshot* baseline, std::vector<uint8_t>& packet);
+
+// --------------------------------------------------------
+// The last N snapshots, by tick, on either end of the connection
+// --------------------------------------------------------
+class SnapshotHistory
+{
+public:
+	explicit SnapshotHistory(int count);
+
+	// Slot to capture or decode the given tick into; replaces
+	// whatever was count ticks back
+	Snapshot& Add(uint32_t tick);
+
+	// The snapshot for tick if it's still held
+	const Snapshot* Find(uint32_t tick) const;
+
+	const Snapshot* GetNewest() const;
+	void Clear();
+
+private:
+	std::vector<Snapshot> snapshots;
+	std::vector<bool> used;
+	uint32_t newestTick;
+	bool any;
+};
+
+// Reads the match and ticks from a packet, without decoding it
+bool PeekSnapshot(const uint8_t* data, size_t size, uint16_t& matchId, uint32_t& tick, uint32_t& baselineTick);
+
+// --------------------------------------------------------
+// Rebuilds a snapshot from a packet.  The baseline it names has
+// to be in history; fails (leaving snapshot in an unspecified
+// state) if it isn't or the packet is malformed.
+// --------------------------------------------------------
+bool DecodeSnapshot(const uint8_t* data, size_t size, const SnapshotHistory& history, Snapshot& snapshot);
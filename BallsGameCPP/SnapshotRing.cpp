@@ -0,0 +1,46 @@
+#include "SnapshotRing.h"
+
+SnapshotRing::SnapshotRing(int frameCount, size_t bytesPerFrame)
+{
+	frames.resize(frameCount > 0 ? frameCount : 1);
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		frames[i].step = 0;
+		frames[i].used = false;
+		frames[i].state.reserve(bytesPerFrame);
+	}
+}
+
+void SnapshotRing::Save(Match& match)
+{
+	Frame& frame = frames[match.GetStepCount() % frames.size()];
+	frame.step = match.GetStepCount();
+	frame.used = true;
+	match.SaveState(frame.state);
+}
+
+bool SnapshotRing::Restore(Match& match, uint32_t step) const
+{
+	if (!Has(step))
+		return false;
+
+	const Frame& frame = frames[step % frames.size()];
+	return match.LoadState(&frame.state[0], frame.state.size());
+}
+
+bool SnapshotRing::Has(uint32_t step) const
+{
+	const Frame& frame = frames[step % frames.size()];
+	return frame.used && frame.step == step;
+}
+
+void SnapshotRing::Clear()
+{
+	for (size_t i = 0; i < frames.size(); i++)
+		frames[i].used = false;
+}
+
+size_t SnapshotRing::GetFrameSize(uint32_t step) const
+{
+	return Has(step) ? frames[step % frames.size()].state.size() : 0;
+}
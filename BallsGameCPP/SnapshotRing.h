@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Match.h"
+
+// --------------------------------------------------------
+// The last N steps of a match, kept so it can be rewound.
+//
+// A step's state lives in slot (step % N), so finding a saved
+// step is a single index and saving overwrites whatever was
+// N steps back.  Every slot is allocated up front; saving only
+// allocates if a match outgrows the reserved size, after which
+// that slot keeps the larger buffer.
+// --------------------------------------------------------
+class SnapshotRing
+{
+public:
+	// frameCount    - How many steps back can be restored
+	// bytesPerFrame - Capacity to reserve in each slot
+	SnapshotRing(int frameCount, size_t bytesPerFrame);
+
+	// Stores the match's current state under its current step
+	void Save(Match& match);
+
+	// Puts the match back to how it was at step, if that's still held
+	bool Restore(Match& match, uint32_t step) const;
+
+	bool Has(uint32_t step) const;
+	void Clear();
+
+	int GetFrameCount() const { return (int)frames.size(); }
+	size_t GetFrameSize(uint32_t step) const;
+
+private:
+	struct Frame
+	{
+		uint32_t step;
+		bool used;
+		std::vector<uint8_t> state;
+	};
+
+	std::vector<Frame> frames;
+};
@@ -0,0 +1,624 @@
+#include "SoftwareMixer.h"
+#include "ErrorMessage.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOFTWARE_MIXER_SSE 1
+#include <emmintrin.h>
+#else
+#define SOFTWARE_MIXER_SSE 0
+#endif
+
+// Source frames per bus frame that a block can take and still fit
+// in the two buffers, whatever the stream's rate
+const double MAX_STEP = (double)(STREAM_CHUNK_FRAMES - 2) / MIX_BLOCK_FRAMES - 1.0;
+
+// Most blocks MixerAudioSink mixes in one pass before it gives up
+// catching up and skips ahead
+const uint64_t MAX_BLOCKS_PER_UPDATE = 64;
+
+SoftwareMixer::SoftwareMixer(int voiceCount, int sampleRate)
+	: sampleRate(sampleRate), useSimd(SOFTWARE_MIXER_SSE != 0), feederRunning(false), feederStopping(false), framesStreamed(0)
+{
+	// Everything either thread writes is sized here, so neither
+	// allocates while it runs
+	for (int v = 0; v < voiceCount; v++)
+	{
+		Voice* voice = new Voice();
+		voice->playing = false;
+		voice->primed = false;
+		voice->pending = false;
+		voice->pendingStream = 0;
+		voice->pendingLoop = false;
+		voice->volume = 0;
+		voice->pan = 0;
+		voice->pitch = 0;
+		voice->gains[0] = voice->gains[1] = 0;
+		voice->step = 1;
+		voice->phase = 0;
+		voice->carry[0] = voice->carry[1] = 0;
+		voice->front = 0;
+		voice->frontPosition = 0;
+		voice->finishing = false;
+		voice->stream = 0;
+		voice->loop = false;
+		voice->restart = false;
+		for (int b = 0; b < 2; b++)
+		{
+			StreamBuffer& buffer = voice->buffers[b];
+			buffer.state.store(BUFFER_IDLE);
+			buffer.channels[0].resize(STREAM_CHUNK_FRAMES);
+			buffer.channels[1].resize(STREAM_CHUNK_FRAMES);
+			buffer.frames = 0;
+			buffer.end = false;
+		}
+		voice->chunk.resize(STREAM_CHUNK_FRAMES * 2);
+		voices.push_back(voice);
+	}
+
+	// The carry, what a block reads, and room for the last
+	// interpolation to read one past it
+	size_t sourceFrames = (size_t)(MAX_STEP * MIX_BLOCK_FRAMES) + 4;
+	source[0].resize(sourceFrames);
+	source[1].resize(sourceFrames);
+
+	ResetStats();
+}
+
+SoftwareMixer::~SoftwareMixer()
+{
+	StopFeeder();
+	for (size_t v = 0; v < voices.size(); v++)
+		delete voices[v];
+}
+
+void SoftwareMixer::StartFeeder()
+{
+	if (feeder.joinable())
+		return;
+
+	feederStopping = false;
+	feederRunning = true;
+	feeder = std::thread(&SoftwareMixer::FeederLoop, this);
+}
+
+void SoftwareMixer::StopFeeder()
+{
+	if (!feeder.joinable())
+		return;
+
+	feederStopping = true;
+	feeder.join();
+	feederRunning = false;
+}
+
+void SoftwareMixer::SetUseSimd(bool useSimd)
+{
+	this->useSimd = useSimd && SOFTWARE_MIXER_SSE;
+}
+
+void SoftwareMixer::ResetStats()
+{
+	stats.blocks = 0;
+	stats.voiceBlocks = 0;
+	stats.underruns = 0;
+	stats.framesStreamed = 0;
+	stats.mixTime.Reset();
+	framesStreamed = 0;
+}
+
+void SoftwareMixer::Play(int index, AudioStream* stream, float volume, float pan, float pitch, bool loop)
+{
+	// Silent from now; it starts once the feeder lets go of it
+	Voice& voice = *voices[index];
+	voice.playing = false;
+	voice.pending = true;
+	voice.pendingStream = stream;
+	voice.pendingLoop = loop;
+	voice.volume = volume;
+	voice.pan = std::max(-1.0f, std::min(1.0f, pan));
+	voice.pitch = std::max(-MIXER_MAX_PITCH, std::min(MIXER_MAX_PITCH, pitch));
+}
+
+void SoftwareMixer::SetVolume(int index, float volume)
+{
+	Voice& voice = *voices[index];
+	voice.volume = volume;
+	UpdateGains(voice);
+}
+
+void SoftwareMixer::Stop(int index)
+{
+	Voice& voice = *voices[index];
+	voice.playing = false;
+	voice.pending = false;
+}
+
+bool SoftwareMixer::IsPlaying(int index) const
+{
+	const Voice& voice = *voices[index];
+	return voice.playing || voice.pending;
+}
+
+// Equal power, so a sound keeps its loudness as it pans
+void SoftwareMixer::UpdateGains(Voice& voice)
+{
+	float angle = (voice.pan + 1.0f) * 0.78539816f;
+	voice.gains[0] = voice.volume * std::cos(angle);
+	voice.gains[1] = voice.volume * std::sin(angle);
+}
+
+// Reads the stream's next chunk into buffer as planar floats;
+// only whoever moved the buffer to FILLING calls this
+void SoftwareMixer::FillBuffer(Voice& voice, StreamBuffer& buffer)
+{
+	AudioStream* stream = voice.stream;
+	int channels = stream->GetFormat().channels;
+	if (voice.restart)
+	{
+		stream->Rewind();
+		voice.restart = false;
+	}
+
+	// Short only at the end, so loop back there; a stream that
+	// gives nothing even from the start ends regardless
+	size_t frames = 0;
+	bool end = false;
+	bool rewound = false;
+	while (frames < STREAM_CHUNK_FRAMES)
+	{
+		size_t read = stream->Read(&voice.chunk[frames * channels], STREAM_CHUNK_FRAMES - frames);
+		frames += read;
+		if (read > 0)
+			rewound = false;
+		if (frames == STREAM_CHUNK_FRAMES)
+			break;
+		if (!voice.loop || rewound)
+		{
+			end = true;
+			break;
+		}
+		stream->Rewind();
+		rewound = true;
+	}
+
+	const int16_t* in = voice.chunk.data();
+	float* out0 = buffer.channels[0].data();
+	float* out1 = buffer.channels[1].data();
+	const float scale = 1.0f / 32768.0f;
+	size_t i = 0;
+#if SOFTWARE_MIXER_SSE
+	// Eight samples at a time, widened by shifting them into the
+	// top of each 32 bit lane and back down with their sign
+	__m128 scaleVec = _mm_set1_ps(scale);
+	if (channels == 1)
+	{
+		for (; i + 8 <= frames; i += 8)
+		{
+			__m128i samples = _mm_loadu_si128((const __m128i*)(in + i));
+			__m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+			__m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+			_mm_storeu_ps(out0 + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scaleVec));
+			_mm_storeu_ps(out0 + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scaleVec));
+		}
+	}
+	else
+	{
+		// Each lane is a left and right pair
+		for (; i + 4 <= frames; i += 4)
+		{
+			__m128i pairs = _mm_loadu_si128((const __m128i*)(in + i * 2));
+			__m128i left = _mm_srai_epi32(_mm_slli_epi32(pairs, 16), 16);
+			__m128i right = _mm_srai_epi32(pairs, 16);
+			_mm_storeu_ps(out0 + i, _mm_mul_ps(_mm_cvtepi32_ps(left), scaleVec));
+			_mm_storeu_ps(out1 + i, _mm_mul_ps(_mm_cvtepi32_ps(right), scaleVec));
+		}
+	}
+#endif
+	for (; i < frames; i++)
+	{
+		out0[i] = in[i * channels] * scale;
+		if (channels == 2)
+			out1[i] = in[i * 2 + 1] * scale;
+	}
+
+	buffer.frames = frames;
+	buffer.end = end;
+	framesStreamed.fetch_add(frames, std::memory_order_relaxed);
+}
+
+// Fills buffer if it's waiting and nobody else got to it first
+bool SoftwareMixer::Feed(Voice& voice, StreamBuffer& buffer)
+{
+	int expected = BUFFER_EMPTY;
+	if (!buffer.state.compare_exchange_strong(expected, BUFFER_FILLING, std::memory_order_acquire))
+		return false;
+
+	FillBuffer(voice, buffer);
+	buffer.state.store(BUFFER_READY, std::memory_order_release);
+	return true;
+}
+
+// The mixer's own reads: what it's about to play, then the
+// buffer after it
+bool SoftwareMixer::FeedNext(Voice& voice)
+{
+	RequestNext(voice);
+	bool fed = Feed(voice, voice.buffers[voice.front]);
+	RequestNext(voice);
+	fed = Feed(voice, voice.buffers[voice.front ^ 1]) || fed;
+	return fed;
+}
+
+void SoftwareMixer::FeederLoop()
+{
+	Profiler::RegisterThread("Audio Feeder");
+
+	while (!feederStopping.load())
+	{
+		bool fed = false;
+		for (size_t v = 0; v < voices.size(); v++)
+		{
+			Voice* voice = voices[v];
+			for (int b = 0; b < 2; b++)
+			{
+				StreamBuffer& buffer = voice->buffers[b];
+				int expected = BUFFER_EMPTY;
+				if (buffer.state.load(std::memory_order_relaxed) != BUFFER_EMPTY ||
+					!buffer.state.compare_exchange_strong(expected, BUFFER_FILLING, std::memory_order_acquire))
+					continue;
+
+				// Holding it, the stream is safe to look at.  Ones
+				// the mixer reads itself go straight back.
+				if (voice->stream->CanReadInline())
+				{
+					buffer.state.store(BUFFER_EMPTY, std::memory_order_release);
+					continue;
+				}
+
+				PROFILE_SCOPE("SoftwareMixer::Feed");
+				FillBuffer(*voice, buffer);
+				buffer.state.store(BUFFER_READY, std::memory_order_release);
+				fed = true;
+			}
+		}
+
+		if (!fed)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Takes both buffers back from the feeder so the voice's stream
+// can change.  Fails while one is mid-read.
+bool SoftwareMixer::TryIdle(Voice& voice)
+{
+	for (int b = 0; b < 2; b++)
+	{
+		StreamBuffer& buffer = voice.buffers[b];
+		int state = buffer.state.load(std::memory_order_acquire);
+		if (state == BUFFER_FILLING)
+			return false;
+		if (state == BUFFER_EMPTY && !buffer.state.compare_exchange_strong(state, BUFFER_IDLE, std::memory_order_acquire))
+			return false;
+		if (state == BUFFER_READY)
+			buffer.state.store(BUFFER_IDLE, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+void SoftwareMixer::Begin(Voice& voice)
+{
+	voice.stream = voice.pendingStream;
+	voice.loop = voice.pendingLoop;
+	voice.restart = true;
+	voice.pending = false;
+
+	const AudioFormat& format = voice.stream->GetFormat();
+	voice.step = std::min(MAX_STEP, (double)format.sampleRate / sampleRate * std::pow(2.0, (double)voice.pitch));
+
+	// Silence before the first frame, and the first bus frame on it
+	voice.phase = 1.0;
+	voice.carry[0] = voice.carry[1] = 0;
+	voice.front = 0;
+	voice.frontPosition = 0;
+	voice.finishing = false;
+	voice.primed = false;
+	voice.playing = true;
+	UpdateGains(voice);
+
+	voice.buffers[0].state.store(BUFFER_EMPTY, std::memory_order_release);
+}
+
+// Asks for the buffer after the one playing, or the one playing
+// if it's been used up, unless the stream's end is already in
+void SoftwareMixer::RequestNext(Voice& voice)
+{
+	if (voice.finishing)
+		return;
+
+	StreamBuffer& front = voice.buffers[voice.front];
+	StreamBuffer& back = voice.buffers[voice.front ^ 1];
+	int frontState = front.state.load(std::memory_order_acquire);
+	int backState = back.state.load(std::memory_order_acquire);
+	if (frontState == BUFFER_READY && front.end)
+		voice.finishing = true;
+	else if (frontState == BUFFER_IDLE && backState == BUFFER_IDLE)
+		front.state.store(BUFFER_EMPTY, std::memory_order_release);
+	else if (frontState == BUFFER_READY && backState == BUFFER_IDLE)
+		back.state.store(BUFFER_EMPTY, std::memory_order_release);
+}
+
+// Frames ready to play, and whether the stream ends after them
+size_t SoftwareMixer::GetAvailable(Voice& voice, bool& end)
+{
+	end = false;
+	StreamBuffer& front = voice.buffers[voice.front];
+	if (front.state.load(std::memory_order_acquire) != BUFFER_READY)
+		return 0;
+
+	size_t available = front.frames - voice.frontPosition;
+	if (front.end)
+	{
+		end = voice.finishing = true;
+		return available;
+	}
+
+	StreamBuffer& back = voice.buffers[voice.front ^ 1];
+	if (back.state.load(std::memory_order_acquire) == BUFFER_READY)
+	{
+		available += back.frames;
+		if (back.end)
+			end = voice.finishing = true;
+	}
+	return available;
+}
+
+// Copies the next count frames without consuming them; only as
+// many as GetAvailable said there are
+void SoftwareMixer::CopyFrames(Voice& voice, size_t count, float* out0, float* out1)
+{
+	int channels = voice.stream->GetFormat().channels;
+	size_t position = voice.frontPosition;
+	for (int b = 0; b < 2 && count > 0; b++)
+	{
+		const StreamBuffer& buffer = voice.buffers[(voice.front + b) & 1];
+		size_t run = std::min(count, buffer.frames - position);
+		memcpy(out0, &buffer.channels[0][position], run * sizeof(float));
+		if (channels == 2)
+			memcpy(out1, &buffer.channels[1][position], run * sizeof(float));
+		out0 += run;
+		out1 += run;
+		count -= run;
+		position = 0;
+	}
+}
+
+// Consumes frames, handing used up buffers back to be refilled
+void SoftwareMixer::Advance(Voice& voice, size_t frames)
+{
+	voice.frontPosition += frames;
+	for (int b = 0; b < 2; b++)
+	{
+		StreamBuffer& front = voice.buffers[voice.front];
+		if (front.state.load(std::memory_order_acquire) != BUFFER_READY || front.end || voice.frontPosition < front.frames)
+			break;
+		voice.frontPosition -= front.frames;
+		front.state.store(BUFFER_IDLE, std::memory_order_release);
+		voice.front ^= 1;
+	}
+}
+
+// Bus frame j is at phase + j * step in source, where source[0]
+// is the carry.  Linear between the frames either side, added into
+// the bus with each channel's gain.  The SSE version does the same
+// float operations in the same order, so the two agree exactly.
+static void ResampleScalar(const float* source0, const float* source1, float phase, float step, const float* gains,
+	float* left, float* right, size_t frames)
+{
+	for (size_t j = 0; j < frames; j++)
+	{
+		float position = phase + (float)j * step;
+		int index = (int)position;
+		float fraction = position - (float)index;
+		float a0 = source0[index];
+		float a1 = source1[index];
+		left[j] += (a0 + (source0[index + 1] - a0) * fraction) * gains[0];
+		right[j] += (a1 + (source1[index + 1] - a1) * fraction) * gains[1];
+	}
+}
+
+#if SOFTWARE_MIXER_SSE
+// frames is a multiple of four
+static void ResampleSse(const float* source0, const float* source1, float phase, float step, const float* gains,
+	float* left, float* right, size_t frames)
+{
+	__m128 phaseVec = _mm_set1_ps(phase);
+	__m128 stepVec = _mm_set1_ps(step);
+	__m128 gain0 = _mm_set1_ps(gains[0]);
+	__m128 gain1 = _mm_set1_ps(gains[1]);
+	__m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+
+	for (size_t j = 0; j < frames; j += 4)
+	{
+		__m128 position = _mm_add_ps(phaseVec, _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)j), lanes), stepVec));
+		__m128i index = _mm_cvttps_epi32(position);
+		__m128 fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+
+		// No gather before AVX2; the indices come out one by one
+		int i[4];
+		_mm_storeu_si128((__m128i*)i, index);
+		__m128 a0 = _mm_set_ps(source0[i[3]], source0[i[2]], source0[i[1]], source0[i[0]]);
+		__m128 b0 = _mm_set_ps(source0[i[3] + 1], source0[i[2] + 1], source0[i[1] + 1], source0[i[0] + 1]);
+		__m128 a1 = _mm_set_ps(source1[i[3]], source1[i[2]], source1[i[1]], source1[i[0]]);
+		__m128 b1 = _mm_set_ps(source1[i[3] + 1], source1[i[2] + 1], source1[i[1] + 1], source1[i[0] + 1]);
+
+		__m128 s0 = _mm_add_ps(a0, _mm_mul_ps(_mm_sub_ps(b0, a0), fraction));
+		__m128 s1 = _mm_add_ps(a1, _mm_mul_ps(_mm_sub_ps(b1, a1), fraction));
+		_mm_storeu_ps(left + j, _mm_add_ps(_mm_loadu_ps(left + j), _mm_mul_ps(s0, gain0)));
+		_mm_storeu_ps(right + j, _mm_add_ps(_mm_loadu_ps(right + j), _mm_mul_ps(s1, gain1)));
+	}
+}
+#endif
+
+// Mixes one voice's block into the bus; false if it sat it out
+bool SoftwareMixer::MixVoice(Voice& voice, float* left, float* right)
+{
+	if (!feederRunning.load(std::memory_order_relaxed) || voice.stream->CanReadInline())
+		FeedNext(voice);
+	else
+		RequestNext(voice);
+
+	// What this block moves past, and what its last frame reads
+	size_t consumed = (size_t)(voice.phase + MIX_BLOCK_FRAMES * voice.step);
+	size_t needed = std::max(consumed, (size_t)(voice.phase + (MIX_BLOCK_FRAMES - 1) * voice.step) + 1);
+
+	bool end;
+	size_t available = GetAvailable(voice, end);
+	if (available < needed && !end)
+	{
+		// Not started yet is latency; after that it's the feeder
+		// falling behind
+		if (voice.primed)
+			stats.underruns++;
+		return false;
+	}
+	voice.primed = true;
+
+	int channels = voice.stream->GetFormat().channels;
+	float* source0 = source[0].data();
+	float* source1 = channels == 2 ? source[1].data() : source0;
+	size_t copied = std::min(available, needed);
+	source0[0] = voice.carry[0];
+	source1[0] = voice.carry[1];
+	CopyFrames(voice, copied, source0 + 1, source1 + 1);
+
+	// Past the end is silence; one more past what's needed covers
+	// a position that rounds up onto the next frame
+	for (size_t i = copied + 1; i <= needed + 1; i++)
+		source0[i] = source1[i] = 0;
+	if (copied == needed)
+	{
+		source0[needed + 1] = source0[needed];
+		source1[needed + 1] = source1[needed];
+	}
+
+#if SOFTWARE_MIXER_SSE
+	if (useSimd)
+		ResampleSse(source0, source1, (float)voice.phase, (float)voice.step, voice.gains, left, right, MIX_BLOCK_FRAMES);
+	else
+#endif
+		ResampleScalar(source0, source1, (float)voice.phase, (float)voice.step, voice.gains, left, right, MIX_BLOCK_FRAMES);
+
+	if (end && available <= consumed)
+	{
+		Advance(voice, available);
+		voice.playing = false;
+		return true;
+	}
+
+	voice.carry[0] = source0[consumed];
+	voice.carry[1] = source1[consumed];
+	voice.phase += MIX_BLOCK_FRAMES * voice.step - consumed;
+	Advance(voice, consumed);
+	return true;
+}
+
+void SoftwareMixer::MixBlock(float* left, float* right)
+{
+	PROFILE_SCOPE("SoftwareMixer::MixBlock");
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	memset(left, 0, MIX_BLOCK_FRAMES * sizeof(float));
+	memset(right, 0, MIX_BLOCK_FRAMES * sizeof(float));
+
+	uint64_t mixed = 0;
+	for (size_t v = 0; v < voices.size(); v++)
+	{
+		Voice* voice = voices[v];
+		if (voice->pending && TryIdle(*voice))
+			Begin(*voice);
+		if (!voice->playing)
+		{
+			// Stopped voices hand their buffers back as they can
+			if (!voice->pending)
+				TryIdle(*voice);
+			continue;
+		}
+		if (MixVoice(*voice, left, right))
+			mixed++;
+	}
+
+	stats.blocks++;
+	stats.voiceBlocks += mixed;
+	stats.framesStreamed = framesStreamed.load(std::memory_order_relaxed);
+	stats.mixTime.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+}
+
+MixerAudioSink::MixerAudioSink(MixerOutput* output) : output(output), mixer(VOICE_COUNT), blocksMixed(0)
+{
+	left.resize(MIX_BLOCK_FRAMES);
+	right.resize(MIX_BLOCK_FRAMES);
+}
+
+MixerAudioSink::~MixerAudioSink()
+{
+	Close();
+	delete output;
+}
+
+bool MixerAudioSink::Open(std::string* error)
+{
+	std::string outputError;
+	if (!output->Open(mixer.GetSampleRate(), &outputError))
+		return Fail(error, "could not open the mixer's output: " + outputError);
+
+	for (int kind = 0; kind < SOUND_KIND_COUNT; kind++)
+		SynthesizeSound((SoundKind)kind, sounds[kind]);
+	startTime = std::chrono::steady_clock::now();
+	blocksMixed = 0;
+	return true;
+}
+
+void MixerAudioSink::Close()
+{
+	output->Close();
+}
+
+void MixerAudioSink::Start(int voice, const VoiceStart& start)
+{
+	AudioFormat format;
+	format.sampleRate = SOUND_SAMPLE_RATE;
+	format.channels = 1;
+	cursors[voice].Reset(sounds[start.kind].data(), sounds[start.kind].size(), format);
+	mixer.Play(voice, &cursors[voice], start.volume, start.pan, start.pitch);
+}
+
+void MixerAudioSink::SetVolume(int voice, float volume)
+{
+	mixer.SetVolume(voice, volume);
+}
+
+void MixerAudioSink::Stop(int voice)
+{
+	mixer.Stop(voice);
+}
+
+// Mixes up to a block ahead of the clock
+void MixerAudioSink::Update()
+{
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	uint64_t due = (uint64_t)(elapsed * mixer.GetSampleRate() / MIX_BLOCK_FRAMES) + 1;
+	if (due > blocksMixed + MAX_BLOCKS_PER_UPDATE)
+		blocksMixed = due - MAX_BLOCKS_PER_UPDATE;
+
+	while (blocksMixed < due)
+	{
+		mixer.MixBlock(left.data(), right.data());
+		output->Write(left.data(), right.data(), MIX_BLOCK_FRAMES);
+		blocksMixed++;
+	}
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioStream.h"
+#include "FrameStats.h"
+#include "SoundPlayer.h"
+
+// --------------------------------------------------------
+// Mixes any number of streamed voices into one float stereo
+// bus, a block at a time, in software.
+//
+// Each voice reads its stream a chunk at a time into two
+// buffers: the mixer plays from one while the feeder thread
+// fills the other, so nothing is ever loaded whole and the
+// mixer never waits on a disk.  A buffer's state is an atomic
+// that only one side may move on from, which is all the two
+// threads share.  Streams that never touch a disk (memory) are
+// read by the mixer itself; with no feeder running, every
+// stream is, which is what an offline render wants.
+//
+// Each block, a voice's source frames are gathered from its
+// buffers into one run of floats, then resampled to the bus
+// rate (with the voice's pitch) by linear interpolation and
+// added into the bus with its pan gains - four output frames
+// at a time with SSE, or one at a time for comparison.  A voice
+// whose next chunk isn't in yet sits the block out and counts
+// an underrun rather than stalling the mix.
+//
+// The mixer never opens a device: the bus goes to whatever
+// MixerOutput it's handed - a WAV file for -sound-to, or
+// nothing - which is how Tools/MixerBench.cpp runs and times
+// all of it.
+// --------------------------------------------------------
+
+const int MIXER_SAMPLE_RATE = 44100;
+
+// Bus frames mixed at once - 5.8 ms at 44.1 kHz
+const size_t MIX_BLOCK_FRAMES = 256;
+
+// Frames read from a stream at once, into each of a voice's buffers
+const size_t STREAM_CHUNK_FRAMES = 4096;
+
+// Furthest a voice may be pitched either way, in octaves
+const float MIXER_MAX_PITCH = 1.0f;
+
+struct MixerStats
+{
+	uint64_t blocks;
+	uint64_t voiceBlocks;		// Voices mixed, summed over blocks
+	uint64_t underruns;			// Voice blocks skipped waiting on the feeder
+	uint64_t framesStreamed;	// Read from streams, by either thread
+	TimeHistogram mixTime;		// Per block, mixing only
+};
+
+class SoftwareMixer
+{
+public:
+	explicit SoftwareMixer(int voiceCount, int sampleRate = MIXER_SAMPLE_RATE);
+	~SoftwareMixer();
+
+	// A thread that fills buffers for streams that can't be
+	// read inline.  Without it the mixer reads them itself.
+	void StartFeeder();
+	void StopFeeder();
+
+	// Starts stream on a voice from its first frame.  The stream
+	// isn't owned and has to outlive the mixer; the feeder may
+	// still be finishing a read from it after the voice stops.  A
+	// voice whose buffer the feeder is filling starts at the next
+	// block rather than wait for it.
+	void Play(int voice, AudioStream* stream, float volume, float pan, float pitch, bool loop = false);
+	void SetVolume(int voice, float volume);
+	void Stop(int voice);
+	bool IsPlaying(int voice) const;
+
+	// Mixes the next block into left and right, MIX_BLOCK_FRAMES each
+	void MixBlock(float* left, float* right);
+
+	// Resampling with SSE, on where the CPU has it, or scalar
+	void SetUseSimd(bool useSimd);
+	bool GetUseSimd() const { return useSimd; }
+
+	int GetSampleRate() const { return sampleRate; }
+	int GetVoiceCount() const { return (int)voices.size(); }
+	const MixerStats& GetStats() const { return stats; }
+	void ResetStats();
+
+private:
+	enum BufferState
+	{
+		BUFFER_IDLE,		// Nothing to do with it
+		BUFFER_EMPTY,		// Wants the stream's next chunk
+		BUFFER_FILLING,		// Whoever got it there is reading
+		BUFFER_READY		// Full, for the mixer
+	};
+
+	struct StreamBuffer
+	{
+		std::atomic<int> state;
+		std::vector<float> channels[2];
+		size_t frames;
+		bool end;				// The stream ran out in this one
+	};
+
+	struct Voice
+	{
+		// Mixer only
+		bool playing;
+		bool primed;			// Has had a buffer ready since it started
+		bool pending;			// Play is waiting for the feeder to let go
+		AudioStream* pendingStream;
+		bool pendingLoop;
+		float volume;
+		float pan;
+		float pitch;
+		float gains[2];			// Left, right
+		double step;			// Source frames per bus frame
+		double phase;			// Source frames past carry, for the next bus frame
+		float carry[2];			// Last source frame consumed
+		int front;				// Buffer being played
+		size_t frontPosition;
+		bool finishing;			// Stream's end is in the buffers
+
+		// Shared with the feeder while a buffer isn't idle
+		AudioStream* stream;
+		bool loop;
+		bool restart;			// Rewind before the next read
+		StreamBuffer buffers[2];
+		std::vector<int16_t> chunk;		// Feeder's scratch for this voice
+	};
+
+	void FillBuffer(Voice& voice, StreamBuffer& buffer);
+	bool Feed(Voice& voice, StreamBuffer& buffer);
+	bool FeedNext(Voice& voice);
+	void FeederLoop();
+	bool TryIdle(Voice& voice);
+	void Begin(Voice& voice);
+	void UpdateGains(Voice& voice);
+	void RequestNext(Voice& voice);
+	size_t GetAvailable(Voice& voice, bool& end);
+	void CopyFrames(Voice& voice, size_t count, float* out0, float* out1);
+	void Advance(Voice& voice, size_t frames);
+	bool MixVoice(Voice& voice, float* left, float* right);
+
+	int sampleRate;
+	std::vector<Voice*> voices;
+	bool useSimd;
+	std::thread feeder;
+	std::atomic<bool> feederRunning;
+	std::atomic<bool> feederStopping;
+
+	// A voice's gathered source frames, per block
+	std::vector<float> source[2];
+	std::atomic<uint64_t> framesStreamed;
+
+	MixerStats stats;
+};
+
+// --------------------------------------------------------
+// Plays SoundPlayer's voices through a SoftwareMixer into a
+// MixerOutput, mixing whatever blocks the clock says are due
+// each time the audio thread comes round
+// --------------------------------------------------------
+class MixerAudioSink : public AudioSink
+{
+public:
+	// Takes ownership of the output
+	explicit MixerAudioSink(MixerOutput* output);
+	~MixerAudioSink();
+
+	bool Open(std::string* error);
+	void Close();
+	void Start(int voice, const VoiceStart& start);
+	void SetVolume(int voice, float volume);
+	void Stop(int voice);
+	void Update();
+
+	const MixerStats& GetStats() const { return mixer.GetStats(); }
+
+private:
+	MixerOutput* output;
+	SoftwareMixer mixer;
+	std::vector<int16_t> sounds[SOUND_KIND_COUNT];
+	MemoryStream cursors[VOICE_COUNT];
+	std::vector<float> left;
+	std::vector<float> right;
+	std::chrono::steady_clock::time_point startTime;
+	uint64_t blocksMixed;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------
+// Something in the match that makes a noise, as BallManager
+// reports it.  Only ever written to a log the game hands the
+// match; nothing in the simulation reads them back, so they
+// can't affect how a match plays out.
+// --------------------------------------------------------
+enum SoundKind
+{
+	SOUND_COLLISION,	// Two balls hit each other
+	SOUND_WALL,			// A ball bounced off the top or bottom
+	SOUND_GOAL,			// The soccer ball went in
+	SOUND_KIND_COUNT
+};
+
+struct SoundEvent
+{
+	uint8_t kind;		// SoundKind
+	float x;			// Where on the field, for panning
+	float y;
+	float strength;		// 0 to 1, from how hard the hit was
+};
@@ -0,0 +1,316 @@
+#include "SoundPlayer.h"
+#include "Ball.h"
+#include "Profiler.h"
+#include "ThreadStart.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Per SoundKind: how long it plays, how many voices it may
+// have at once, and how much it matters against the others
+static const float SOUND_SECONDS[SOUND_KIND_COUNT] = { 0.15f, 0.1f, 1.0f };
+static const int SOUND_VOICE_CAP[SOUND_KIND_COUNT] = { 10, 4, 2 };
+static const float SOUND_WEIGHT[SOUND_KIND_COUNT] = { 1.0f, 0.5f, 4.0f };
+
+// Same kind, this close in time and place, and it's one sound
+const double MERGE_SECONDS = 0.03;
+const float MERGE_DISTANCE = 0.5f;
+
+// Anything quieter isn't worth a voice
+const float MIN_SOUND_STRENGTH = 0.02f;
+
+// How often the audio thread looks at the queue
+const int AUDIO_PASS_MS = 5;
+
+VoicePool::VoicePool()
+{
+	memset(voices, 0, sizeof(voices));
+	memset(&stats, 0, sizeof(stats));
+}
+
+// Two hits at once sound louder than one, but not twice as loud
+static float Combine(float a, float b)
+{
+	return std::min(1.0f, std::sqrt(a * a + b * b));
+}
+
+static bool Near(float x1, float y1, float x2, float y2)
+{
+	return (x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) < MERGE_DISTANCE * MERGE_DISTANCE;
+}
+
+static bool Louder(const SoundEvent& a, const SoundEvent& b)
+{
+	return a.strength * SOUND_WEIGHT[a.kind] > b.strength * SOUND_WEIGHT[b.kind];
+}
+
+void VoicePool::Play(const SoundEvent* sounds, size_t count, double now, AudioSink& sink)
+{
+	PROFILE_SCOPE("VoicePool::Play");
+	stats.sounds += count;
+
+	// Fold this pass's sounds together first
+	batch.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		const SoundEvent& sound = sounds[i];
+		if (sound.kind >= SOUND_KIND_COUNT || sound.strength < MIN_SOUND_STRENGTH)
+		{
+			stats.dropped++;
+			continue;
+		}
+
+		bool merged = false;
+		for (size_t j = 0; j < batch.size() && !merged; j++)
+		{
+			SoundEvent& other = batch[j];
+			if (other.kind != sound.kind || !Near(other.x, other.y, sound.x, sound.y))
+				continue;
+			float total = other.strength + sound.strength;
+			other.x = (other.x * other.strength + sound.x * sound.strength) / total;
+			other.y = (other.y * other.strength + sound.y * sound.strength) / total;
+			other.strength = Combine(other.strength, sound.strength);
+			merged = true;
+		}
+		if (merged)
+			stats.merged++;
+		else
+			batch.push_back(sound);
+	}
+
+	// Then into anything of the same kind that only just started
+	size_t kept = 0;
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		const SoundEvent& sound = batch[i];
+		bool merged = false;
+		for (int v = 0; v < VOICE_COUNT && !merged; v++)
+		{
+			Voice& voice = voices[v];
+			if (voice.end <= now || voice.kind != sound.kind || now - voice.start > MERGE_SECONDS || !Near(voice.x, voice.y, sound.x, sound.y))
+				continue;
+			voice.volume = Combine(voice.volume, sound.strength);
+			sink.SetVolume(v, voice.volume);
+			merged = true;
+		}
+		if (merged)
+			stats.merged++;
+		else
+			batch[kept++] = sound;
+	}
+	batch.resize(kept);
+
+	// Loudest first, so whatever's dropped is what mattered least
+	std::sort(batch.begin(), batch.end(), Louder);
+	for (size_t i = 0; i < batch.size(); i++)
+	{
+		const SoundEvent& sound = batch[i];
+		bool kindFull = GetPlayingCount(now, (SoundKind)sound.kind) >= SOUND_VOICE_CAP[sound.kind];
+
+		int freeVoice = -1;
+		for (int v = 0; v < VOICE_COUNT && freeVoice < 0 && !kindFull; v++)
+		{
+			if (voices[v].end <= now)
+				freeVoice = v;
+		}
+		if (freeVoice >= 0)
+		{
+			StartVoice(freeVoice, sound, now, sink);
+			stats.played++;
+			continue;
+		}
+
+		// A full kind can only take from itself
+		int victim = FindVictim(now, kindFull ? sound.kind : -1);
+		if (victim >= 0 && sound.strength * SOUND_WEIGHT[sound.kind] > GetPriority(voices[victim], now))
+		{
+			sink.Stop(victim);
+			StartVoice(victim, sound, now, sink);
+			stats.stolen++;
+		}
+		else
+			stats.dropped++;
+	}
+
+	stats.maxPlaying = std::max(stats.maxPlaying, (uint32_t)GetPlayingCount(now));
+}
+
+int VoicePool::GetPlayingCount(double now) const
+{
+	int playing = 0;
+	for (int v = 0; v < VOICE_COUNT; v++)
+	{
+		if (voices[v].end > now)
+			playing++;
+	}
+	return playing;
+}
+
+int VoicePool::GetPlayingCount(double now, SoundKind kind) const
+{
+	int playing = 0;
+	for (int v = 0; v < VOICE_COUNT; v++)
+	{
+		if (voices[v].end > now && voices[v].kind == kind)
+			playing++;
+	}
+	return playing;
+}
+
+// Fades as it plays out, so a loud sound near its end can go
+// before a quiet one that's just begun
+float VoicePool::GetPriority(const Voice& voice, double now) const
+{
+	float left = (float)((voice.end - now) / SOUND_SECONDS[voice.kind]);
+	return voice.volume * SOUND_WEIGHT[voice.kind] * left;
+}
+
+// The playing voice that matters least, of the given kind or
+// any kind if it's -1
+int VoicePool::FindVictim(double now, int kind) const
+{
+	int victim = -1;
+	float lowest = 0;
+	for (int v = 0; v < VOICE_COUNT; v++)
+	{
+		const Voice& voice = voices[v];
+		if (voice.end <= now || (kind >= 0 && voice.kind != kind))
+			continue;
+		float priority = GetPriority(voice, now);
+		if (victim < 0 || priority < lowest)
+		{
+			victim = v;
+			lowest = priority;
+		}
+	}
+	return victim;
+}
+
+void VoicePool::StartVoice(int index, const SoundEvent& sound, double now, AudioSink& sink)
+{
+	Voice& voice = voices[index];
+	voice.start = now;
+	voice.end = now + SOUND_SECONDS[sound.kind];
+	voice.volume = sound.strength;
+	voice.x = sound.x;
+	voice.y = sound.y;
+	voice.kind = sound.kind;
+
+	// Harder hits ring a little higher; goals always sound the same
+	VoiceStart start;
+	start.kind = sound.kind;
+	start.volume = sound.strength;
+	start.pitch = sound.kind == SOUND_GOAL ? 0.0f : (sound.strength - 0.5f) * 0.4f;
+	start.pan = std::max(-1.0f, std::min(1.0f, sound.x / FIELD_X_BOUND));
+	sink.Start(index, start);
+}
+
+// One decaying tone, or two one after the other, with a burst
+// of hiss at the front
+static void Synthesize(float seconds, float frequency, float secondFrequency, float decay, float noise, std::vector<int16_t>& samples)
+{
+	samples.resize((size_t)(seconds * SOUND_SAMPLE_RATE));
+	uint32_t random = 1;
+	float phase = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		float t = (float)i / SOUND_SAMPLE_RATE;
+		float noteTime = t;
+		float hz = frequency;
+		if (secondFrequency > 0 && t >= seconds * 0.25f)
+		{
+			noteTime = t - seconds * 0.25f;
+			hz = secondFrequency;
+		}
+		phase += 6.2831853f * hz / SOUND_SAMPLE_RATE;
+
+		random = random * 1664525u + 1013904223u;
+		float hiss = ((random >> 8) * (1.0f / 8388608.0f) - 1.0f) * noise * std::exp(-t * 200.0f);
+		float envelope = std::exp(-noteTime * decay) * (1.0f - t / seconds);
+		float sample = std::sin(phase) * envelope + hiss;
+		samples[i] = (int16_t)(std::max(-1.0f, std::min(1.0f, sample)) * 30000.0f);
+	}
+}
+
+void SynthesizeSound(SoundKind kind, std::vector<int16_t>& samples)
+{
+	switch (kind)
+	{
+	case SOUND_COLLISION: Synthesize(SOUND_SECONDS[kind], 1400.0f, 0, 40.0f, 0.4f, samples); break;
+	case SOUND_WALL: Synthesize(SOUND_SECONDS[kind], 420.0f, 0, 50.0f, 0.2f, samples); break;
+	case SOUND_GOAL: Synthesize(SOUND_SECONDS[kind], 660.0f, 990.0f, 3.0f, 0, samples); break;
+	default: samples.clear(); break;
+	}
+}
+
+SoundPlayer::SoundPlayer(AudioSink* sink) : sink(sink), stopping(false)
+{
+	memset(&statsCopy, 0, sizeof(statsCopy));
+}
+
+SoundPlayer::~SoundPlayer()
+{
+	Stop();
+	delete sink;
+}
+
+bool SoundPlayer::Start(std::string* error)
+{
+	if (thread.joinable())
+		return true;
+
+	// The sink has to be opened on the thread that uses it
+	stopping = false;
+	return StartThread(thread, &SoundPlayer::Run, this, error);
+}
+
+void SoundPlayer::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	stopping = true;
+	thread.join();
+}
+
+VoiceStats SoundPlayer::GetStats()
+{
+	std::lock_guard<std::mutex> hold(statsLock);
+	return statsCopy;
+}
+
+void SoundPlayer::Run(std::string* error, std::atomic<int>* started)
+{
+	Profiler::RegisterThread("Audio");
+
+	if (!sink->Open(error))
+	{
+		started->store(-1);
+		return;
+	}
+	started->store(1);
+
+	std::vector<SoundEvent> sounds;
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	while (!stopping.load())
+	{
+		sounds.clear();
+		SoundEvent sound;
+		while (queue.Pop(sound))
+			sounds.push_back(sound);
+
+		double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		pool.Play(sounds.data(), sounds.size(), now, *sink);
+		sink->Update();
+		{
+			std::lock_guard<std::mutex> hold(statsLock);
+			statsCopy = pool.GetStats();
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(AUDIO_PASS_MS));
+	}
+
+	sink->Close();
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SoundEvent.h"
+#include "SpscQueue.h"
+
+// --------------------------------------------------------
+// Match sounds, from the step that made them to the speakers.
+//
+// The main thread pushes each step's SoundEvents into a
+// SoundQueue and carries on; an audio thread pops them every
+// few milliseconds, has the VoicePool decide what's worth
+// hearing, and tells an AudioSink to play it.  The simulation
+// never waits on audio - a full queue drops the sound.
+//
+// The pool has a fixed number of voices, with a cap per kind
+// so a pile-up of collisions can't drown out a goal.  Sounds
+// of the same kind close together in place and time become
+// one louder voice rather than many; when every voice is busy,
+// a new sound takes over the one that matters least (the
+// quietest and most nearly finished), or is dropped if it
+// matters less than all of them.
+//
+// The only way out is an AudioSink - XAudioSink in the game -
+// so with a NullAudioSink in its place Tools/SoundBench.cpp
+// runs the pool and the audio thread whole.
+// --------------------------------------------------------
+
+const int VOICE_COUNT = 16;
+
+// Rate the sounds are synthesized at
+const int SOUND_SAMPLE_RATE = 22050;
+
+// Most sounds the queue holds between two audio thread passes
+const size_t SOUND_QUEUE_CAPACITY = 1024;
+
+// How the pool asks for a sound
+struct VoiceStart
+{
+	uint8_t kind;		// SoundKind
+	float volume;		// 0 to 1
+	float pitch;		// Octaves, -1 to 1
+	float pan;			// -1 left to 1 right
+};
+
+// A click for a hit, a thud for a bounce and a two-note chime
+// for a goal, as mono 16 bit samples at SOUND_SAMPLE_RATE, so
+// there are no sound files to ship
+void SynthesizeSound(SoundKind kind, std::vector<int16_t>& samples);
+
+// --------------------------------------------------------
+// What actually makes the noise.  Only ever called from the
+// audio thread, Open included.
+// --------------------------------------------------------
+class AudioSink
+{
+public:
+	virtual ~AudioSink() {}
+
+	// False, with why in error, if there's no audio to be had
+	virtual bool Open(std::string* error) = 0;
+	virtual void Close() {}
+
+	// Starts a sound on a voice, cutting off whatever it played
+	virtual void Start(int voice, const VoiceStart& start) = 0;
+	virtual void SetVolume(int voice, float volume) = 0;
+	virtual void Stop(int voice) = 0;
+
+	// Once a pass, after the pool's done
+	virtual void Update() {}
+};
+
+// Counts what it's asked to do and plays nothing
+class NullAudioSink : public AudioSink
+{
+public:
+	NullAudioSink() : starts(0), stops(0), volumeChanges(0) {}
+
+	bool Open(std::string*) { return true; }
+	void Start(int, const VoiceStart&) { starts++; }
+	void SetVolume(int, float) { volumeChanges++; }
+	void Stop(int) { stops++; }
+
+	uint64_t starts;
+	uint64_t stops;
+	uint64_t volumeChanges;
+};
+
+// The main thread pushes, the audio thread pops
+typedef SpscQueue<SoundEvent, SOUND_QUEUE_CAPACITY> SoundQueue;
+
+struct VoiceStats
+{
+	uint64_t sounds;		// Events the pool was given
+	uint64_t played;		// Started on a free voice
+	uint64_t merged;		// Folded into another sound of the same kind
+	uint64_t stolen;		// Started on a voice taken from another sound
+	uint64_t dropped;		// Mattered less than everything playing
+	uint32_t maxPlaying;	// Most voices busy at once
+};
+
+class VoicePool
+{
+public:
+	VoicePool();
+
+	// Everything heard since the last call, at now seconds on
+	// any clock that only goes forward
+	void Play(const SoundEvent* sounds, size_t count, double now, AudioSink& sink);
+
+	int GetPlayingCount(double now) const;
+	int GetPlayingCount(double now, SoundKind kind) const;
+	const VoiceStats& GetStats() const { return stats; }
+
+private:
+	struct Voice
+	{
+		double start;
+		double end;			// Free from here on
+		float volume;
+		float x;
+		float y;
+		uint8_t kind;
+	};
+
+	// What a voice is worth keeping at now
+	float GetPriority(const Voice& voice, double now) const;
+	int FindVictim(double now, int kind) const;
+	void StartVoice(int index, const SoundEvent& sound, double now, AudioSink& sink);
+
+	Voice voices[VOICE_COUNT];
+	std::vector<SoundEvent> batch;		// This pass's sounds after merging
+	VoiceStats stats;
+};
+
+// --------------------------------------------------------
+// The audio thread: owns the sink and the pool
+// --------------------------------------------------------
+class SoundPlayer
+{
+public:
+	// Takes ownership of the sink
+	explicit SoundPlayer(AudioSink* sink);
+	~SoundPlayer();
+
+	// False, with why in error, if the sink wouldn't open; the
+	// game then just stays quiet
+	bool Start(std::string* error = 0);
+	void Stop();
+	bool IsRunning() const { return thread.joinable(); }
+
+	// Main thread only, never blocks
+	bool Push(const SoundEvent& sound) { return queue.Push(sound); }
+
+	// As of the audio thread's last pass
+	VoiceStats GetStats();
+	uint32_t GetQueueDropped() const { return queue.GetDropped(); }
+
+private:
+	void Run(std::string* error, std::atomic<int>* started);
+
+	AudioSink* sink;
+	SoundQueue queue;
+	VoicePool pool;
+	std::thread thread;
+	std::atomic<bool> stopping;
+	std::mutex statsLock;		// Only ever held for a copy
+	VoiceStats statsCopy;
+};
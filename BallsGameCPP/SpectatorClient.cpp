@@ -0,0 +1,223 @@
+#include "SpectatorClient.h"
+
+#include <cmath>
+#include <cstring>
+
+// How often to remind the server we're here when nothing is arriving
+const double WATCH_RESEND_MS = 1000.0;
+
+// Playback further than this from where it should be jumps instead
+// of catching up gradually
+const double RESYNC_TICKS = 30.0;
+
+// Share of the playback error corrected each view
+const double CATCH_UP_RATE = 0.05;
+
+// Longest a ball is carried on past the newest snapshot
+const double MAX_EXTRAPOLATE_TICKS = 12.0;
+
+// A ball moving further than this between two snapshots was placed,
+// not moved (the soccer ball going back to the middle after a goal)
+const float TELEPORT_DISTANCE = 0.5f;
+
+SpectatorClient::SpectatorClient()
+	: history(SPECTATOR_SNAPSHOT_HISTORY)
+{
+	matchId = 0;
+	haveSnapshot = false;
+	newestTick = 0;
+	lastSendMs = -WATCH_RESEND_MS;
+	playing = false;
+	playbackTick = 0;
+	lastViewMs = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+bool SpectatorClient::Connect(const NetAddress& server, uint16_t matchId)
+{
+	this->server = server;
+	this->matchId = matchId;
+	history.Clear();
+	haveSnapshot = false;
+	playing = false;
+	return socket.Open(0);
+}
+
+void SpectatorClient::SendWatch(double nowMs)
+{
+	ServerRequest request;
+	request.type = SERVER_PACKET_WATCH;
+	request.matchId = matchId;
+	request.player = 0;
+	request.buttons = 0;
+	request.ackTick = haveSnapshot ? newestTick : SERVER_NO_ACK;
+
+	uint8_t packet[SERVER_REQUEST_SIZE];
+	WriteServerRequest(request, packet);
+	socket.Send(server, packet, sizeof(packet));
+	lastSendMs = nowMs;
+}
+
+void SpectatorClient::Update(double nowMs)
+{
+	uint8_t buffer[65536];
+	NetAddress from;
+	size_t size;
+	bool decoded = false;
+	while ((size = socket.Receive(buffer, sizeof(buffer), from)) > 0)
+	{
+		uint16_t packetMatch;
+		uint32_t tick, baselineTick;
+		if (!(from == server) || !PeekSnapshot(buffer, size, packetMatch, tick, baselineTick) || packetMatch != matchId)
+			continue;
+		stats.snapshotsReceived++;
+		stats.bytesReceived += size;
+
+		// Late arrivals are still worth keeping as baselines and
+		// for interpolating, as long as they're new to us and too
+		// recent to push out something newer
+		if (history.Find(tick) || (haveSnapshot && tick + SPECTATOR_SNAPSHOT_HISTORY <= newestTick))
+			continue;
+		if (!DecodeSnapshot(buffer, size, history, scratch))
+		{
+			stats.decodeFailures++;
+			continue;
+		}
+		history.Add(tick) = scratch;
+		if (!haveSnapshot || tick > newestTick)
+			newestTick = tick;
+		haveSnapshot = true;
+		decoded = true;
+	}
+
+	// Acking every batch keeps the server's baselines recent
+	if (decoded || nowMs - lastSendMs >= WATCH_RESEND_MS)
+		SendWatch(nowMs);
+}
+
+const Snapshot* SpectatorClient::FindAtOrBefore(uint32_t tick) const
+{
+	for (int back = 0; back < SPECTATOR_SNAPSHOT_HISTORY && back <= (int)tick; back++)
+	{
+		const Snapshot* snapshot = history.Find(tick - back);
+		if (snapshot)
+			return snapshot;
+	}
+	return 0;
+}
+
+const Snapshot* SpectatorClient::FindAfter(uint32_t tick) const
+{
+	for (uint32_t next = tick + 1; next <= newestTick; next++)
+	{
+		const Snapshot* snapshot = history.Find(next);
+		if (snapshot)
+			return snapshot;
+	}
+	return 0;
+}
+
+bool SpectatorClient::GetView(double nowMs, SpectatorView& view)
+{
+	if (!haveSnapshot)
+		return false;
+
+	// Advance playback by real time, then steer it towards sitting
+	// the delay behind the newest snapshot
+	double target = (double)newestTick - INTERPOLATION_DELAY_TICKS;
+	if (!playing)
+	{
+		playing = true;
+		playbackTick = target;
+	}
+	else
+	{
+		playbackTick += (nowMs - lastViewMs) / (MATCH_TIMESTEP * 1000.0);
+		double error = target - playbackTick;
+		if (fabs(error) > RESYNC_TICKS)
+		{
+			playbackTick = target;
+			stats.resyncs++;
+		}
+		else
+			playbackTick += error * CATCH_UP_RATE;
+	}
+	lastViewMs = nowMs;
+	if (playbackTick < 0)
+		playbackTick = 0;
+
+	const Snapshot* from = FindAtOrBefore((uint32_t)playbackTick);
+	if (!from)
+		from = history.GetNewest();
+	const Snapshot* to = FindAfter(from->tick);
+
+	double t = 0;
+	if (to)
+	{
+		t = (playbackTick - from->tick) / (double)(to->tick - from->tick);
+		t = t < 0 ? 0 : (t > 1 ? 1 : t);
+		stats.interpolatedViews++;
+	}
+	else
+		stats.extrapolatedViews++;
+
+	view.tick = playbackTick;
+	const Snapshot& scores = to && t >= 0.5 ? *to : *from;
+	view.p1Score = scores.p1Score;
+	view.p2Score = scores.p2Score;
+	view.p1Balls = scores.p1Balls;
+	view.p2Balls = scores.p2Balls;
+	view.p1Selection = scores.p1Selection;
+	view.p2Selection = scores.p2Selection;
+
+	// Balls in both snapshots blend; balls only in the older one show
+	// until the newer one is reached, and new ones wait to appear.
+	// Both lists are in id order.
+	view.balls.clear();
+	size_t n = 0;
+	for (const SnapshotBall& a : from->balls)
+	{
+		SpectatorBall ball;
+		ball.id = a.id;
+		ball.soccer = a.soccer;
+		ball.x = SnapshotToX(a.x);
+		ball.y = SnapshotToY(a.y);
+
+		if (to)
+		{
+			while (n < to->balls.size() && to->balls[n].id < a.id)
+				n++;
+			if (n < to->balls.size() && to->balls[n].id == a.id)
+			{
+				float x = SnapshotToX(to->balls[n].x);
+				float y = SnapshotToY(to->balls[n].y);
+				if (fabsf(x - ball.x) + fabsf(y - ball.y) > TELEPORT_DISTANCE)
+				{
+					if (t >= 0.5)
+					{
+						ball.x = x;
+						ball.y = y;
+					}
+				}
+				else
+				{
+					ball.x += (x - ball.x) * (float)t;
+					ball.y += (y - ball.y) * (float)t;
+				}
+			}
+			else if (t >= 1)
+				continue;
+		}
+		else
+		{
+			double ahead = playbackTick - from->tick;
+			if (ahead > MAX_EXTRAPOLATE_TICKS)
+				ahead = MAX_EXTRAPOLATE_TICKS;
+			float seconds = (float)(ahead * MATCH_TIMESTEP);
+			ball.x += SnapshotToVelocity(a.vx) * seconds;
+			ball.y += SnapshotToVelocity(a.vy) * seconds;
+		}
+		view.balls.push_back(ball);
+	}
+	return true;
+}
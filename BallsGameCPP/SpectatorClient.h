@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "ServerProtocol.h"
+#include "SnapshotCodec.h"
+#include "UdpSocket.h"
+
+// --------------------------------------------------------
+// Watches one match on a MatchServer.
+//
+// Snapshots arrive every server tick, with jitter and gaps.
+// Rather than showing each one as it lands, the view plays back
+// a steady INTERPOLATION_DELAY_TICKS behind the newest snapshot
+// and blends the two snapshots either side of that point, so
+// balls move smoothly and a lost packet or two goes unnoticed.
+// If it runs out of snapshots it carries balls on along their
+// last velocity for a short while before freezing.
+//
+// Every decoded snapshot is acked straight back, which is what
+// lets the server send the next one as a delta.
+// --------------------------------------------------------
+
+// How far behind the newest snapshot the view plays, in ticks
+const int INTERPOLATION_DELAY_TICKS = 6;
+
+// Snapshots kept for interpolating and as baselines
+const int SPECTATOR_SNAPSHOT_HISTORY = 64;
+
+struct SpectatorBall
+{
+	uint32_t id;
+	bool soccer;
+	float x, y;
+};
+
+struct SpectatorView
+{
+	double tick;	// Fractional - where between snapshots this is
+	int p1Score, p2Score;
+	int p1Balls, p2Balls;
+	int p1Selection, p2Selection;
+	std::vector<SpectatorBall> balls;
+};
+
+struct SpectatorStats
+{
+	uint32_t snapshotsReceived;
+	uint64_t bytesReceived;
+	uint32_t decodeFailures;		// Malformed, or the baseline was gone
+	uint32_t interpolatedViews;
+	uint32_t extrapolatedViews;		// Ran past the newest snapshot
+	uint32_t resyncs;				// Playback was too far off and jumped
+};
+
+class SpectatorClient
+{
+public:
+	SpectatorClient();
+
+	bool Connect(const NetAddress& server, uint16_t matchId);
+
+	// Reads snapshots and sends acks; call at least once a frame
+	void Update(double nowMs);
+
+	// The match as it should look at nowMs; false until the first
+	// snapshot has arrived
+	bool GetView(double nowMs, SpectatorView& view);
+
+	uint32_t GetNewestTick() const { return newestTick; }
+	const SpectatorStats& GetStats() const { return stats; }
+
+private:
+	void SendWatch(double nowMs);
+	const Snapshot* FindAtOrBefore(uint32_t tick) const;
+	const Snapshot* FindAfter(uint32_t tick) const;
+
+	UdpSocket socket;
+	NetAddress server;
+	uint16_t matchId;
+
+	SnapshotHistory history;
+	Snapshot scratch;
+	bool haveSnapshot;
+	uint32_t newestTick;
+	double lastSendMs;
+
+	// Playback clock, in ticks
+	bool playing;
+	double playbackTick;
+	double lastViewMs;
+
+	SpectatorStats stats;
+};
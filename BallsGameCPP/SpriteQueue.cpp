@@ -0,0 +1,372 @@
+#include "SpriteQueue.h"
+#include "JobPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SPRITE_QUEUE_SSE 1
+#include <emmintrin.h>
+#else
+#define SPRITE_QUEUE_SSE 0
+#endif
+
+typedef std::chrono::steady_clock SpriteClock;
+
+static double MsSince(SpriteClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(SpriteClock::now() - start).count();
+}
+
+// Float bits that sort as unsigned integers in the same order
+// as the floats: flip everything for negatives, just the sign
+// bit otherwise
+static uint32_t SortableDepth(float depth)
+{
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+SpriteQueue::SpriteQueue()
+{
+	mode = SPRITE_SORT_DEFERRED;
+	count = 0;
+	capacity = 0;
+	memset(&times, 0, sizeof(times));
+}
+
+void SpriteQueue::Begin(SpriteSortMode mode)
+{
+	this->mode = mode;
+	count = 0;
+	batches.clear();
+}
+
+void SpriteQueue::Grow()
+{
+	capacity = capacity ? capacity * 2 : 256;
+
+	std::vector<float>* floats[] = { &x, &y, &width, &height, &originX, &originY, &sine, &cosine, &u0, &v0, &u1, &v1, &depth };
+	for (std::vector<float>* field : floats)
+		field->resize(capacity);
+	color.resize(capacity);
+	texture.resize(capacity);
+
+	keys.resize(capacity);
+	keysBack.resize(capacity);
+	order.resize(capacity);
+	orderBack.resize(capacity);
+}
+
+void SpriteQueue::Add(uint16_t texture, float x, float y, float width, float height,
+	float u0, float v0, float u1, float v1, uint32_t color,
+	float rotation, float originX, float originY, float depth)
+{
+	if (count == capacity)
+		Grow();
+
+	size_t i = count++;
+	this->x[i] = x;
+	this->y[i] = y;
+	this->width[i] = width;
+	this->height[i] = height;
+	this->originX[i] = originX;
+	this->originY[i] = originY;
+	this->sine[i] = rotation != 0 ? sinf(rotation) : 0;
+	this->cosine[i] = rotation != 0 ? cosf(rotation) : 1;
+	this->u0[i] = u0;
+	this->v0[i] = v0;
+	this->u1[i] = u1;
+	this->v1[i] = v1;
+	this->color[i] = color;
+	this->texture[i] = texture;
+	this->depth[i] = depth;
+}
+
+void SpriteQueue::BuildKeys()
+{
+	for (size_t i = 0; i < count; i++)
+		order[i] = (uint32_t)i;
+
+	switch (mode)
+	{
+	case SPRITE_SORT_TEXTURE:
+		for (size_t i = 0; i < count; i++)
+			keys[i] = texture[i];
+		break;
+
+	// Depth first, then texture, so sprites at the same depth
+	// still share batches where they can
+	case SPRITE_SORT_FRONT_TO_BACK:
+		for (size_t i = 0; i < count; i++)
+			keys[i] = (uint64_t)SortableDepth(depth[i]) << 16 | texture[i];
+		break;
+
+	case SPRITE_SORT_BACK_TO_FRONT:
+		for (size_t i = 0; i < count; i++)
+			keys[i] = (uint64_t)~SortableDepth(depth[i]) << 16 | texture[i];
+		break;
+
+	default:
+		break;
+	}
+}
+
+void SpriteQueue::Sort(JobPool* pool)
+{
+	SpriteClock::time_point start = SpriteClock::now();
+
+	BuildKeys();
+	times.sortPasses = mode == SPRITE_SORT_DEFERRED ? 0 : RadixSort(pool);
+	FindBatches();
+
+	times.sortMs = MsSince(start);
+}
+
+// Least significant byte first.  One read counts every byte of
+// every key; those counts don't change as the sprites move, so
+// they say up front which bytes are all the same (and need no
+// pass) and, on one thread, where each pass's buckets start.
+int SpriteQueue::RadixSort(JobPool* pool)
+{
+	if (count < 2)
+		return 0;
+
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = keys[i];
+		for (int b = 0; b < 8; b++)
+			histograms[b][(key >> (b * 8)) & 0xFF]++;
+	}
+
+	bool parallel = pool && pool->GetThreadCount() > 1 && count >= SPRITE_PARALLEL_SORT_MIN;
+	int passes = 0;
+	for (int b = 0; b < 8; b++)
+	{
+		if (histograms[b][(keys[0] >> (b * 8)) & 0xFF] == count)
+			continue;
+
+		if (parallel)
+			ScatterPassParallel(b * 8, pool);
+		else
+			ScatterPass(b * 8, histograms[b]);
+
+		keys.swap(keysBack);
+		order.swap(orderBack);
+		passes++;
+	}
+	return passes;
+}
+
+void SpriteQueue::ScatterPass(int shift, const uint32_t* histogram)
+{
+	uint32_t offsets[256];
+	uint32_t total = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		offsets[i] = total;
+		total += histogram[i];
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t to = offsets[(keys[i] >> shift) & 0xFF]++;
+		keysBack[to] = keys[i];
+		orderBack[to] = order[i];
+	}
+}
+
+// Each worker counts its own slice of the keys, the counts are
+// turned into where every slice's share of every bucket starts,
+// and each worker scatters its slice there.  Slices are in key
+// order within a bucket, so this is as stable as one thread.
+void SpriteQueue::ScatterPassParallel(int shift, JobPool* pool)
+{
+	int chunks = pool->GetThreadCount();
+	if (chunkCounts.size() < (size_t)chunks * 256)
+		chunkCounts.resize((size_t)chunks * 256);
+	uint32_t* counts = &chunkCounts[0];
+	size_t total = count;
+
+	pool->Run(chunks, [&](int chunk, int)
+	{
+		uint32_t* mine = counts + chunk * 256;
+		memset(mine, 0, 256 * sizeof(uint32_t));
+		size_t end = total * (chunk + 1) / chunks;
+		for (size_t i = total * chunk / chunks; i < end; i++)
+			mine[(keys[i] >> shift) & 0xFF]++;
+	});
+
+	uint32_t offset = 0;
+	for (int bucket = 0; bucket < 256; bucket++)
+	{
+		for (int chunk = 0; chunk < chunks; chunk++)
+		{
+			uint32_t here = counts[chunk * 256 + bucket];
+			counts[chunk * 256 + bucket] = offset;
+			offset += here;
+		}
+	}
+
+	pool->Run(chunks, [&](int chunk, int)
+	{
+		uint32_t* offsets = counts + chunk * 256;
+		size_t end = total * (chunk + 1) / chunks;
+		for (size_t i = total * chunk / chunks; i < end; i++)
+		{
+			uint32_t to = offsets[(keys[i] >> shift) & 0xFF]++;
+			keysBack[to] = keys[i];
+			orderBack[to] = order[i];
+		}
+	});
+}
+
+void SpriteQueue::FindBatches()
+{
+	batches.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		uint16_t id = texture[order[i]];
+		if (batches.empty() || batches.back().texture != id)
+		{
+			SpriteBatchRun run = { id, (uint32_t)i, 0 };
+			batches.push_back(run);
+		}
+		batches.back().count++;
+	}
+}
+
+// Corners in the order SpriteBatch uses: top left, top right,
+// bottom left, bottom right
+static const float CORNER_X[SPRITE_VERTICES] = { 0, 1, 0, 1 };
+static const float CORNER_Y[SPRITE_VERTICES] = { 0, 0, 1, 1 };
+
+void SpriteQueue::GenerateVerticesScalar(SpriteVertex* out, float viewportWidth, float viewportHeight) const
+{
+	SpriteClock::time_point start = SpriteClock::now();
+	float scaleX = 2 / viewportWidth;
+	float scaleY = 2 / viewportHeight;
+
+	for (size_t n = 0; n < count; n++)
+	{
+		uint32_t i = order[n];
+		for (int k = 0; k < SPRITE_VERTICES; k++)
+		{
+			float localX = CORNER_X[k] * width[i] - originX[i];
+			float localY = CORNER_Y[k] * height[i] - originY[i];
+			float px = x[i] + (localX * cosine[i] - localY * sine[i]);
+			float py = y[i] + (localX * sine[i] + localY * cosine[i]);
+
+			SpriteVertex& vertex = out[n * SPRITE_VERTICES + k];
+			vertex.x = px * scaleX - 1;
+			vertex.y = 1 - py * scaleY;
+			vertex.z = depth[i];
+			vertex.color = color[i];
+			vertex.u = k & 1 ? u1[i] : u0[i];
+			vertex.v = k & 2 ? v1[i] : v0[i];
+		}
+	}
+	times.verticesMs = MsSince(start);
+}
+
+#if SPRITE_QUEUE_SSE
+static inline __m128 Gather(const std::vector<float>& field, const uint32_t* index)
+{
+	return _mm_setr_ps(field[index[0]], field[index[1]], field[index[2]], field[index[3]]);
+}
+#endif
+
+void SpriteQueue::GenerateVertices(SpriteVertex* out, float viewportWidth, float viewportHeight) const
+{
+#if SPRITE_QUEUE_SSE
+	SpriteClock::time_point start = SpriteClock::now();
+	const __m128 scaleX = _mm_set1_ps(2 / viewportWidth);
+	const __m128 scaleY = _mm_set1_ps(2 / viewportHeight);
+	const __m128 one = _mm_set1_ps(1);
+
+	// Four sprites a lane each; every field is gathered through
+	// the sorted order once, and each corner is four vertices'
+	// worth of arithmetic, transposed into place on the way out
+	size_t n = 0;
+	for (; n + 4 <= count; n += 4)
+	{
+		const uint32_t* index = &order[n];
+		__m128 px = Gather(x, index), py = Gather(y, index);
+		__m128 w = Gather(width, index), h = Gather(height, index);
+		__m128 ox = Gather(originX, index), oy = Gather(originY, index);
+		__m128 s = Gather(sine, index), c = Gather(cosine, index);
+		__m128 left = Gather(u0, index), top = Gather(v0, index);
+		__m128 right = Gather(u1, index), bottom = Gather(v1, index);
+		__m128 z = Gather(depth, index);
+		__m128 rgba = _mm_castsi128_ps(_mm_setr_epi32((int)color[index[0]], (int)color[index[1]], (int)color[index[2]], (int)color[index[3]]));
+
+		SpriteVertex* first = out + n * SPRITE_VERTICES;
+		for (int k = 0; k < SPRITE_VERTICES; k++)
+		{
+			__m128 localX = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(CORNER_X[k]), w), ox);
+			__m128 localY = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(CORNER_Y[k]), h), oy);
+			__m128 cornerX = _mm_add_ps(px, _mm_sub_ps(_mm_mul_ps(localX, c), _mm_mul_ps(localY, s)));
+			__m128 cornerY = _mm_add_ps(py, _mm_add_ps(_mm_mul_ps(localX, s), _mm_mul_ps(localY, c)));
+
+			__m128 row0 = _mm_sub_ps(_mm_mul_ps(cornerX, scaleX), one);
+			__m128 row1 = _mm_sub_ps(one, _mm_mul_ps(cornerY, scaleY));
+			__m128 row2 = z;
+			__m128 row3 = rgba;
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+			__m128 u = k & 1 ? right : left;
+			__m128 v = k & 2 ? bottom : top;
+			__m128 uv01 = _mm_unpacklo_ps(u, v);
+			__m128 uv23 = _mm_unpackhi_ps(u, v);
+
+			SpriteVertex* vertex = first + k;
+			_mm_storeu_ps(&vertex[0].x, row0);
+			_mm_storel_pi((__m64*)&vertex[0].u, uv01);
+			_mm_storeu_ps(&vertex[SPRITE_VERTICES].x, row1);
+			_mm_storeh_pi((__m64*)&vertex[SPRITE_VERTICES].u, uv01);
+			_mm_storeu_ps(&vertex[SPRITE_VERTICES * 2].x, row2);
+			_mm_storel_pi((__m64*)&vertex[SPRITE_VERTICES * 2].u, uv23);
+			_mm_storeu_ps(&vertex[SPRITE_VERTICES * 3].x, row3);
+			_mm_storeh_pi((__m64*)&vertex[SPRITE_VERTICES * 3].u, uv23);
+		}
+	}
+
+	// The last few one at a time, with the same arithmetic
+	float sx = 2 / viewportWidth;
+	float sy = 2 / viewportHeight;
+	for (; n < count; n++)
+	{
+		uint32_t i = order[n];
+		for (int k = 0; k < SPRITE_VERTICES; k++)
+		{
+			float localX = CORNER_X[k] * width[i] - originX[i];
+			float localY = CORNER_Y[k] * height[i] - originY[i];
+			float cornerX = x[i] + (localX * cosine[i] - localY * sine[i]);
+			float cornerY = y[i] + (localX * sine[i] + localY * cosine[i]);
+
+			SpriteVertex& vertex = out[n * SPRITE_VERTICES + k];
+			vertex.x = cornerX * sx - 1;
+			vertex.y = 1 - cornerY * sy;
+			vertex.z = depth[i];
+			vertex.color = color[i];
+			vertex.u = k & 1 ? u1[i] : u0[i];
+			vertex.v = k & 2 ? v1[i] : v0[i];
+		}
+	}
+	times.verticesMs = MsSince(start);
+#else
+	GenerateVerticesScalar(out, viewportWidth, viewportHeight);
+#endif
+}
+
+void SpriteQueue::GenerateIndices(uint32_t* out, size_t spriteCount)
+{
+	static const uint32_t CORNERS[SPRITE_INDICES] = { 0, 1, 2, 1, 3, 2 };
+	for (size_t s = 0; s < spriteCount; s++)
+		for (int i = 0; i < SPRITE_INDICES; i++)
+			out[s * SPRITE_INDICES + i] = (uint32_t)(s * SPRITE_VERTICES) + CORNERS[i];
+}
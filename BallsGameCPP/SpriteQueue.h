@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+// --------------------------------------------------------
+// A sprite queue kept as arrays, sorted by radix.
+//
+// SpriteBatch keeps each queued sprite as an 80 byte struct,
+// sorts pointers to them with std::sort (following a pointer
+// for every comparison) and builds one sprite's vertices at a
+// time, flushing every 2048 sprites.  That's fine for a few
+// hundred sprites and falls over long before 100k.
+//
+// Here each field of a sprite lives in its own array, and the
+// sort only touches two of them: a 64 bit key and the sprite's
+// index.  Keys are laid out so the sort mode is just a radix
+// sort on them (texture id in Texture mode, depth then texture
+// in the depth modes), which is stable, so equal keys stay in
+// the order they were added just as Deferred would draw them.
+// Bytes every key shares are skipped, so a queue with a few
+// textures sorts in one pass.  Given a JobPool and a big
+// enough queue, each pass's counting and scattering is split
+// across its workers.
+//
+// GenerateVertices then walks the sorted order four sprites at
+// a time with SSE, and Batches lists each run of one texture,
+// however long.  Textures are only 16 bit ids here - the
+// SpriteRenderer that hands them out owns the views, buffers
+// and shaders - so Tools/SpriteQueueBench.cpp sorts and builds
+// vertices with no device.
+// --------------------------------------------------------
+
+enum SpriteSortMode
+{
+	SPRITE_SORT_DEFERRED,		// In the order they were added
+	SPRITE_SORT_TEXTURE,
+	SPRITE_SORT_BACK_TO_FRONT,
+	SPRITE_SORT_FRONT_TO_BACK
+};
+
+// Queues smaller than this sort on the calling thread even
+// with a pool; splitting costs more than it saves
+const size_t SPRITE_PARALLEL_SORT_MIN = 16384;
+
+// One corner of a sprite, already in clip space.  The colour
+// is RGBA8 with red in the low byte, unpacked by the shader.
+struct SpriteVertex
+{
+	float x, y, z;
+	uint32_t color;
+	float u, v;
+};
+
+const int SPRITE_VERTICES = 4;
+const int SPRITE_INDICES = 6;
+
+// A run of sorted sprites that share a texture
+struct SpriteBatchRun
+{
+	uint16_t texture;
+	uint32_t first;			// Index into the sorted sprites
+	uint32_t count;
+};
+
+struct SpriteQueueTimes
+{
+	double sortMs;
+	double verticesMs;
+	int sortPasses;
+};
+
+class SpriteQueue
+{
+public:
+	SpriteQueue();
+
+	// Empties the queue, keeping what it's allocated
+	void Begin(SpriteSortMode mode);
+
+	// x, y        - Where the sprite's origin goes, in pixels
+	// width/height - Size on screen, in pixels
+	// u0..v1      - Texture coordinates of its top left and bottom right
+	// color       - RGBA8, red in the low byte
+	// rotation    - Radians, about the origin
+	// originX/Y   - The origin, in pixels from the sprite's top left
+	// depth       - 0 to 1, for sorting and the depth buffer
+	void Add(uint16_t texture, float x, float y, float width, float height,
+		float u0, float v0, float u1, float v1, uint32_t color,
+		float rotation = 0, float originX = 0, float originY = 0, float depth = 0);
+
+	// Sorts by the mode given to Begin.  pool may be null.
+	void Sort(JobPool* pool = 0);
+
+	// Four vertices per sorted sprite into out, which must hold
+	// GetCount() * SPRITE_VERTICES.  Positions are mapped from
+	// pixels on a viewport of the given size to clip space.
+	void GenerateVertices(SpriteVertex* out, float viewportWidth, float viewportHeight) const;
+
+	// Same again one sprite at a time, without SSE; for checking
+	void GenerateVerticesScalar(SpriteVertex* out, float viewportWidth, float viewportHeight) const;
+
+	// Runs of one texture in sorted order; valid after Sort
+	const std::vector<SpriteBatchRun>& GetBatches() const { return batches; }
+
+	size_t GetCount() const { return count; }
+	SpriteSortMode GetSortMode() const { return mode; }
+
+	// Index of the i'th sprite in sorted order, as it was added
+	uint32_t GetSorted(size_t i) const { return order[i]; }
+
+	// How long the last Sort and GenerateVertices took
+	const SpriteQueueTimes& GetTimes() const { return times; }
+
+	// Fills in the six indices of every sprite up to spriteCount,
+	// for a static index buffer
+	static void GenerateIndices(uint32_t* out, size_t spriteCount);
+
+private:
+	void Grow();
+	void BuildKeys();
+	int RadixSort(JobPool* pool);
+	void ScatterPass(int shift, const uint32_t* histogram);
+	void ScatterPassParallel(int shift, JobPool* pool);
+	void FindBatches();
+
+	SpriteSortMode mode;
+	size_t count;
+	size_t capacity;
+
+	// One entry per sprite, in the order they were added
+	std::vector<float> x, y, width, height;
+	std::vector<float> originX, originY, sine, cosine;
+	std::vector<float> u0, v0, u1, v1;
+	std::vector<float> depth;
+	std::vector<uint32_t> color;
+	std::vector<uint16_t> texture;
+
+	// The sort's working set: keys and sprite indices, plus a
+	// second pair to scatter into
+	std::vector<uint64_t> keys, keysBack;
+	std::vector<uint32_t> order, orderBack;
+
+	// Per-chunk counts for the parallel passes
+	std::vector<uint32_t> chunkCounts;
+
+	std::vector<SpriteBatchRun> batches;
+	mutable SpriteQueueTimes times;
+};
@@ -0,0 +1,153 @@
+#include "SpriteRenderer.h"
+#include "Profiler.h"
+
+SpriteRenderer::SpriteRenderer(ID3D11Device* device, ID3D11DeviceContext* context)
+	: device(device), context(context)
+{
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	bufferSprites = 0;
+
+	// Premultiplied alpha, as SpriteBatch and SpriteFont expect
+	D3D11_BLEND_DESC blend = {};
+	blend.RenderTarget[0].BlendEnable = true;
+	blend.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+	blend.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+	blend.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+	blend.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+	blend.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+	blend.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+	blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	blendState = 0;
+	device->CreateBlendState(&blend, &blendState);
+
+	D3D11_DEPTH_STENCIL_DESC depth = {};
+	depth.DepthEnable = false;
+	depth.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+	depth.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+	depthState = 0;
+	device->CreateDepthStencilState(&depth, &depthState);
+
+	D3D11_RASTERIZER_DESC rasterizer = {};
+	rasterizer.FillMode = D3D11_FILL_SOLID;
+	rasterizer.CullMode = D3D11_CULL_NONE;
+	rasterizer.DepthClipEnable = true;
+	rasterizerState = 0;
+	device->CreateRasterizerState(&rasterizer, &rasterizerState);
+
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	sampler = 0;
+	device->CreateSamplerState(&samplerDesc, &sampler);
+}
+
+SpriteRenderer::~SpriteRenderer()
+{
+	if (vertexBuffer) vertexBuffer->Release();
+	if (indexBuffer) indexBuffer->Release();
+	if (blendState) blendState->Release();
+	if (depthState) depthState->Release();
+	if (rasterizerState) rasterizerState->Release();
+	if (sampler) sampler->Release();
+	for (auto texture : textures)
+		texture->Release();
+}
+
+uint16_t SpriteRenderer::AddTexture(ID3D11ShaderResourceView* texture)
+{
+	for (size_t i = 0; i < textures.size(); i++)
+		if (textures[i] == texture)
+			return (uint16_t)i;
+
+	texture->AddRef();
+	textures.push_back(texture);
+	return (uint16_t)(textures.size() - 1);
+}
+
+// Grows both buffers to hold at least sprites, doubling so a
+// queue that creeps up doesn't recreate them every frame
+bool SpriteRenderer::Reserve(size_t sprites)
+{
+	if (sprites <= bufferSprites)
+		return true;
+
+	size_t size = bufferSprites ? bufferSprites : 1024;
+	while (size < sprites)
+		size *= 2;
+
+	if (vertexBuffer) vertexBuffer->Release();
+	if (indexBuffer) indexBuffer->Release();
+	vertexBuffer = 0;
+	indexBuffer = 0;
+	bufferSprites = 0;
+
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_DYNAMIC;
+	vbd.ByteWidth = (UINT)(sizeof(SpriteVertex) * SPRITE_VERTICES * size);
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(device->CreateBuffer(&vbd, 0, &vertexBuffer)))
+		return false;
+
+	std::vector<uint32_t> indices(size * SPRITE_INDICES);
+	SpriteQueue::GenerateIndices(&indices[0], size);
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_IMMUTABLE;
+	ibd.ByteWidth = (UINT)(sizeof(uint32_t) * indices.size());
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA initialIndexData = {};
+	initialIndexData.pSysMem = &indices[0];
+	if (FAILED(device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer)))
+		return false;
+
+	bufferSprites = size;
+	return true;
+}
+
+void SpriteRenderer::Draw(SpriteQueue& queue, SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader,
+	float viewportWidth, float viewportHeight, JobPool* pool)
+{
+	PROFILE_SCOPE("SpriteRenderer::Draw");
+	if (queue.GetCount() == 0)
+		return;
+
+	queue.Sort(pool);
+	if (!Reserve(queue.GetCount()))
+		return;
+
+	// Straight into the buffer, no copy on the way
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	queue.GenerateVertices((SpriteVertex*)mapped.pData, viewportWidth, viewportHeight);
+	context->Unmap(vertexBuffer, 0);
+
+	UINT stride = sizeof(SpriteVertex);
+	UINT offset = 0;
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	context->OMSetBlendState(blendState, 0, 0xFFFFFFFF);
+	context->OMSetDepthStencilState(depthState, 0);
+	context->RSSetState(rasterizerState);
+
+	vertexShader->SetShader();
+	pixelShader->SetSamplerState("Sampler", sampler);
+	pixelShader->SetShader();
+
+	for (const SpriteBatchRun& run : queue.GetBatches())
+	{
+		if (run.texture >= textures.size())
+			continue;
+		pixelShader->SetShaderResourceView("Sprite", textures[run.texture]);
+		context->DrawIndexed(run.count * SPRITE_INDICES, run.first * SPRITE_INDICES, 0);
+	}
+
+	// Leave blending as the rest of the frame expects it
+	context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+}
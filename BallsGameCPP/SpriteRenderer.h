@@ -0,0 +1,57 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+
+#include "SimpleShader.h"
+#include "SpriteQueue.h"
+
+class JobPool;
+
+// --------------------------------------------------------
+// Draws a SpriteQueue: sorts it, writes its vertices straight
+// into a dynamic vertex buffer and draws each run of one
+// texture with a single DrawIndexed.
+//
+// Unlike SpriteBatch there's no 2048 sprite limit per batch;
+// the buffers grow to fit the biggest queue seen (indices are
+// 32 bit and never change, so only the vertices are written
+// each frame).  Textures are registered once for a small id,
+// which is what the queue sorts on.
+//
+// States match SpriteBatch's defaults: premultiplied alpha,
+// no depth test, no culling, linear clamped sampling.
+// --------------------------------------------------------
+class SpriteRenderer
+{
+public:
+	SpriteRenderer(ID3D11Device* device, ID3D11DeviceContext* context);
+	~SpriteRenderer();
+
+	// The id to queue sprites with texture under; the same
+	// texture always gets the same id
+	uint16_t AddTexture(ID3D11ShaderResourceView* texture);
+
+	// Shaders are passed in each time since the hot reloader
+	// may have swapped them.  pool is for sorting big queues,
+	// and may be null.
+	void Draw(SpriteQueue& queue, SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader,
+		float viewportWidth, float viewportHeight, JobPool* pool = 0);
+
+private:
+	bool Reserve(size_t sprites);
+
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+	size_t bufferSprites;
+
+	ID3D11BlendState* blendState;
+	ID3D11DepthStencilState* depthState;
+	ID3D11RasterizerState* rasterizerState;
+	ID3D11SamplerState* sampler;
+
+	std::vector<ID3D11ShaderResourceView*> textures;
+};
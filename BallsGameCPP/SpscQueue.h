@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// --------------------------------------------------------
+// A single producer, single consumer ring of N items, for
+// handing things from one thread to another without either
+// ever waiting: one thread pushes, one thread pops, and each
+// side only writes its own index, with the indices on separate
+// cache lines.  A full queue drops the item and counts it
+// rather than blocking the producer.
+//
+// InputQueue carries key presses to the main thread on it and
+// SoundQueue carries match sounds to the audio thread.
+// --------------------------------------------------------
+template <typename T, size_t N>
+class SpscQueue
+{
+public:
+	SpscQueue() : written(0), read(0), dropped(0) {}
+
+	// Producer only.  False, and counted, if it's full.
+	//
+	// The item is written before written is published, and read
+	// only after it's seen, so the release/acquire pair is all
+	// the two threads need.
+	bool Push(const T& item)
+	{
+		size_t w = written.load(std::memory_order_relaxed);
+		if (w - read.load(std::memory_order_acquire) >= N)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		items[w % N] = item;
+		written.store(w + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only.  False if it's empty.
+	bool Pop(T& item)
+	{
+		size_t r = read.load(std::memory_order_relaxed);
+		if (r == written.load(std::memory_order_acquire))
+			return false;
+
+		item = items[r % N];
+		read.store(r + 1, std::memory_order_release);
+		return true;
+	}
+
+	uint32_t GetDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	T items[N];
+
+	// Pushes and pops ever made; each side owns one, on its own
+	// cache line (padded rather than aligned, as queues live in
+	// heap objects)
+	char itemsPad[64];
+	std::atomic<size_t> written;
+	char writtenPad[64];
+	std::atomic<size_t> read;
+	std::atomic<uint32_t> dropped;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "ErrorMessage.h"
+
+// --------------------------------------------------------
+// Starts a thread that has to set itself up before it's any
+// use - a window or an audio device made on the thread that
+// will pump it - and waits to hear how that went.
+//
+// The thread runs (owner->*run)(error, started), and stores 1
+// in started once it's ready or -1, with why in error, if it
+// can't be.  A thread that fails is joined, and false returned
+// with its reason.
+// --------------------------------------------------------
+template <typename Owner>
+bool StartThread(std::thread& thread, void (Owner::*run)(std::string*, std::atomic<int>*), Owner* owner, std::string* error)
+{
+	std::atomic<int> started(0);
+	std::string startError;
+	thread = std::thread(run, owner, &startError, &started);
+	while (started.load() == 0)
+		std::this_thread::yield();
+
+	if (started.load() < 0)
+	{
+		thread.join();
+		return Fail(error, startError);
+	}
+	return true;
+}
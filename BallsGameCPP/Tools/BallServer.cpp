@@ -0,0 +1,158 @@
+// --------------------------------------------------------
+// BallServer - dedicated headless match server
+//
+// Hosts any number of matches in one process (see MatchServer)
+// and ticks them all at a fixed rate, spread across every core.
+// No window, no device, nothing from Windows - just the
+// simulation, a thread pool and a UDP socket.
+//
+// Every few seconds, and again at exit, it prints how long
+// ticks took (percentiles of the wall time per tick), how many
+// ticks ran late, and how many matches one core could keep up
+// with at this tick rate, measured two ways:
+//   cpu  - tick period / average CPU time of one match tick
+//   wall - matches * tick period / (threads * average tick)
+// cpu is the ceiling; wall includes the pool's overhead and
+// whatever else the machine was doing.
+//
+// --flat-out ticks back to back instead of at the tick rate,
+// to find the most the machine can do.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread BallServer.cpp ../MatchServer.cpp ../JobPool.cpp ../Match.cpp ../SnapshotCodec.cpp ../UdpSocket.cpp -o ballserver
+//
+// Usage:
+//   ballserver [--matches N] [--threads N] [--port P] [--rate Hz]
+//              [--seconds N] [--seed N] [--flat-out]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "../MatchServer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const double REPORT_SECONDS = 5.0;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Value below which the given fraction of samples fall
+static float Percentile(std::vector<float>& samples, float fraction)
+{
+	if (samples.empty())
+		return 0;
+	size_t index = (size_t)(fraction * (samples.size() - 1) + 0.5f);
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+static void Report(MatchServer& server, double periodMs, double seconds)
+{
+	MatchServerStats& stats = server.GetStats();
+	if (stats.ticks == 0)
+		return;
+
+	double totalTickMs = 0;
+	for (float ms : stats.tickMs)
+		totalTickMs += ms;
+	double averageTickMs = totalTickMs / stats.ticks;
+	double matchTickMs = stats.matchCpuMs / ((double)stats.ticks * server.GetMatchCount());
+
+	float p50 = Percentile(stats.tickMs, 0.50f);
+	float p95 = Percentile(stats.tickMs, 0.95f);
+	float p99 = Percentile(stats.tickMs, 0.99f);
+	float max = *std::max_element(stats.tickMs.begin(), stats.tickMs.end());
+
+	printf("%u ticks in %.1f s: tick p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms (budget %.2f ms), %u late\n",
+		stats.ticks, seconds, p50, p95, p99, max, periodMs, stats.lateTicks);
+	printf("  %d matches on %d threads: %.1f us per match tick, %.0f matches/core (cpu), %.0f matches/core (wall)\n",
+		server.GetMatchCount(), server.GetThreadCount(), matchTickMs * 1000.0,
+		periodMs / matchTickMs, server.GetMatchCount() * periodMs / (server.GetThreadCount() * averageTickMs));
+	printf("  %u matches finished, %.1f KB/s sent to %d watchers (%u full snapshots), %llu jobs stolen\n",
+		stats.matchesFinished, stats.bytesSent / 1024.0 / seconds, server.GetWatcherCount(), stats.fullSnapshots,
+		(unsigned long long)server.GetStolenJobs());
+	fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+	int matchCount = 200, threads = 0;
+	unsigned int port = 0;
+	double rate = 1.0 / MATCH_TIMESTEP;
+	double seconds = 10;
+	uint64_t seed = 1;
+	bool flatOut = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--flat-out") == 0) flatOut = true;
+		else if (i + 1 >= argc) break;
+		else if (strcmp(argv[i], "--matches") == 0) matchCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--port") == 0) port = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--rate") == 0) rate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--seconds") == 0) seconds = atof(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], 0, 10);
+	}
+
+	if (matchCount < 1 || matchCount > 65535 || rate <= 0 || port > 65535)
+	{
+		printf("Usage: ballserver [--matches N] [--threads N] [--port P] [--rate Hz]\n");
+		printf("                  [--seconds N] [--seed N] [--flat-out]\n");
+		return 1;
+	}
+
+	MatchServer server(matchCount, threads, seed);
+	if (port != 0 && !server.Open((uint16_t)port))
+	{
+		printf("Couldn't open UDP port %u\n", port);
+		return 1;
+	}
+
+	double periodMs = 1000.0 / rate;
+	printf("Hosting %d matches on %d threads at %.0f Hz%s%s\n", matchCount, server.GetThreadCount(), rate,
+		flatOut ? " (flat out)" : "", port != 0 ? "" : ", not listening");
+
+	Clock::time_point start = Clock::now();
+	double nextTickMs = 0, reportStartMs = 0;
+	while (true)
+	{
+		double nowMs = MillisecondsSince(start);
+		if (nowMs >= seconds * 1000.0)
+			break;
+
+		if (!flatOut)
+		{
+			if (nowMs < nextTickMs)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)((nextTickMs - nowMs) * 1000.0)));
+				continue;
+			}
+
+			// Fell a long way behind - don't try to catch it all up
+			nextTickMs += periodMs;
+			if (nowMs - nextTickMs > periodMs * 10)
+				nextTickMs = nowMs;
+		}
+
+		server.Tick(nowMs, periodMs);
+
+		if (nowMs - reportStartMs >= REPORT_SECONDS * 1000.0)
+		{
+			Report(server, periodMs, (nowMs - reportStartMs) / 1000.0);
+			server.ResetStats();
+			reportStartMs = nowMs;
+		}
+	}
+
+	Report(server, periodMs, (MillisecondsSince(start) - reportStartMs) / 1000.0);
+	return 0;
+}
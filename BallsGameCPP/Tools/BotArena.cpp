@@ -0,0 +1,138 @@
+// --------------------------------------------------------
+// BotArena - the lookahead bot against a scripted one
+//
+// Plays LookaheadBot as player 2 against a MatchBot for a
+// number of matches (the way the game's single-player mode
+// does) and reports who won, how long deciding took, and the
+// search's throughput: rollouts and simulated steps a second,
+// and so how many rollouts fit in a 60Hz frame.
+//
+// It also times forking a match (Match::Fork, what every
+// rollout starts with) against a save and restore through a
+// state buffer, on the field as it was at the end of a match.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread BotArena.cpp ../LookaheadBot.cpp ../SelfPlay.cpp ../JobPool.cpp ../Match.cpp -o botarena
+//
+// Usage:
+//   botarena [--opponent row/fire] [--matches N] [--threads N] [--seed N]
+//            [--horizon seconds] [--rollouts N] [--decision-steps N]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../LookaheadBot.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// Longest a match may go before it's called a draw
+const uint32_t MAX_STEPS = (uint32_t)(300 / MATCH_TIMESTEP);
+
+const double FRAME_MS = 1000.0 / 60.0;
+
+static double MicrosecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Fork against SaveState/LoadState on the same match
+static void TimeForks(Match& match)
+{
+	const int repeats = 20000;
+	Match scratch(0);
+	scratch.GetBallManager()->setExplosionsEnabled(false);
+
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < repeats; i++)
+		scratch.Fork(match);
+	double forkUs = MicrosecondsSince(start) / repeats;
+
+	std::vector<uint8_t> state;
+	start = Clock::now();
+	for (int i = 0; i < repeats; i++)
+	{
+		match.SaveState(state);
+		scratch.LoadState(&state[0], state.size());
+	}
+	double copyUs = MicrosecondsSince(start) / repeats;
+
+	printf("Forking a match of %zu balls, %zu explosions: %.3f us (save and load %.3f us)\n",
+		match.GetBallManager()->getBalls().size(), match.GetBallManager()->getExplosions().size(), forkUs, copyUs);
+}
+
+int main(int argc, char** argv)
+{
+	BotPolicy opponent;
+	opponent.row = BOT_ROW_LEAD;
+	opponent.fire = BOT_FIRE_LINED_UP;
+	LookaheadConfig config;
+	int matchCount = 20, threads = 0;
+	uint64_t seed = 1;
+	bool valid = true;
+
+	for (int i = 1; i < argc && valid; i++)
+	{
+		if (i + 1 >= argc) valid = false;
+		else if (strcmp(argv[i], "--opponent") == 0) valid = ParseBotPolicy(argv[++i], opponent);
+		else if (strcmp(argv[i], "--matches") == 0) matchCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "--horizon") == 0) config.horizonSeconds = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--rollouts") == 0) config.rolloutsPerAction = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--decision-steps") == 0) config.decisionSteps = (uint32_t)atoi(argv[++i]);
+		else valid = false;
+	}
+
+	if (!valid || matchCount < 1 || config.horizonSeconds <= 0 || config.rolloutsPerAction < 1 || config.decisionSteps < 1)
+	{
+		printf("Usage: botarena [--opponent row/fire] [--matches N] [--threads N] [--seed N]\n");
+		printf("                [--horizon seconds] [--rollouts N] [--decision-steps N]\n");
+		return 1;
+	}
+
+	JobPool pool(threads);
+	LookaheadBot bot(2, config, pool, seed);
+	Match match(0);
+	int wins = 0, losses = 0;
+	uint64_t steps = 0;
+
+	Clock::time_point start = Clock::now();
+	for (int m = 0; m < matchCount; m++)
+	{
+		uint64_t matchSeed = seed * 1000003 + m;
+		match.Reset(matchSeed);
+		MatchBot scripted(1, opponent, matchSeed ^ 0x632BE59BD9B4E019ULL);
+
+		while (match.GetStepCount() < MAX_STEPS && match.GetWinner() == 0)
+		{
+			uint8_t p1 = scripted.Think(match);
+			uint8_t p2 = bot.Think(match);
+			match.Step(MatchInput((uint8_t)(p1 | (p2 << 3))));
+		}
+		steps += match.GetStepCount();
+
+		int winner = match.GetWinner();
+		wins += winner == 2;
+		losses += winner == 1;
+		printf("Match %d: %d - %d in %.1f s\n", m + 1, match.GetScore(2), match.GetScore(1), match.GetStepCount() * MATCH_TIMESTEP);
+		fflush(stdout);
+	}
+	double seconds = MicrosecondsSince(start) / 1e6;
+
+	const LookaheadStats& stats = bot.GetStats();
+	double rolloutsPerSecond = stats.rollouts / (stats.searchMs / 1000.0);
+	printf("\nLookahead vs %s/%s: won %d, lost %d, drew %d of %d (%.1fx real time)\n",
+		GetBotRowPolicyName(opponent.row), GetBotFirePolicyName(opponent.fire),
+		wins, losses, matchCount - wins - losses, matchCount, steps * MATCH_TIMESTEP / seconds);
+	printf("%u decisions on %d threads: %.3f ms average, %.3f ms worst, %.0f rollouts each\n",
+		stats.decisions, pool.GetThreadCount(), stats.searchMs / stats.decisions, stats.maxSearchMs,
+		(double)stats.rollouts / stats.decisions);
+	printf("%.0f rollouts/s, %.2fM simulated steps/s, %.0f rollouts per 60Hz frame\n",
+		rolloutsPerSecond, stats.rolloutSteps / (stats.searchMs / 1000.0) / 1e6, rolloutsPerSecond * FRAME_MS / 1000.0);
+
+	TimeForks(match);
+	return 0;
+}
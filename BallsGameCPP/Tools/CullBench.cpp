@@ -0,0 +1,292 @@
+// --------------------------------------------------------
+// CullBench - FrustumCuller against brute force, and timed
+//
+// Scatters entities around a field - point clouds of a few
+// shapes (balls, flat boxes, long walls), scaled and turned -
+// and culls them against a perspective camera and four
+// orthographic lights, the views the game has.  For every
+// entity it checks against the vertices themselves:
+//  - anything with a vertex inside the view was kept
+//  - anything culled has every vertex behind one plane
+// and that the SSE results match the scalar ones.  Then it
+// times both across all five views.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 CullBench.cpp ../FrustumCuller.cpp -o cullbench
+//
+// Usage:
+//   cullbench [entities]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../FrustumCuller.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static uint32_t randomState = 1;
+static float Random(float lo, float hi)
+{
+	randomState = randomState * 1664525u + 1013904223u;
+	return lo + (hi - lo) * ((randomState >> 8) * (1.0f / 16777216.0f));
+}
+
+// Matrices here are all as the shaders get them: transposed, so
+// m[row * 4 + column] multiplies a column vector
+struct Matrix
+{
+	float m[16];
+};
+
+static Matrix Multiply(const Matrix& a, const Matrix& b)
+{
+	Matrix result;
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			result.m[r * 4 + c] = a.m[r * 4 + 0] * b.m[0 * 4 + c] + a.m[r * 4 + 1] * b.m[1 * 4 + c] +
+				a.m[r * 4 + 2] * b.m[2 * 4 + c] + a.m[r * 4 + 3] * b.m[3 * 4 + c];
+	return result;
+}
+
+static void Normalize(float* v)
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	v[0] /= length; v[1] /= length; v[2] /= length;
+}
+
+static void Cross(const float* a, const float* b, float* out)
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// As XMMatrixLookAtLH
+static Matrix LookAt(float ex, float ey, float ez, float ax, float ay, float az)
+{
+	float eye[3] = { ex, ey, ez };
+	float z[3] = { ax - ex, ay - ey, az - ez };
+	float up[3] = { 0, 1, 0 };
+	Normalize(z);
+	if (fabsf(z[1]) > 0.99f) { up[1] = 0; up[2] = 1; }
+	float x[3], y[3];
+	Cross(up, z, x);
+	Normalize(x);
+	Cross(z, x, y);
+
+	Matrix v = {};
+	const float* axes[3] = { x, y, z };
+	for (int r = 0; r < 3; r++)
+	{
+		v.m[r * 4 + 0] = axes[r][0];
+		v.m[r * 4 + 1] = axes[r][1];
+		v.m[r * 4 + 2] = axes[r][2];
+		v.m[r * 4 + 3] = -(axes[r][0] * eye[0] + axes[r][1] * eye[1] + axes[r][2] * eye[2]);
+	}
+	v.m[15] = 1;
+	return v;
+}
+
+// As XMMatrixPerspectiveFovLH
+static Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+{
+	float yScale = 1 / tanf(fov * 0.5f);
+	Matrix p = {};
+	p.m[0] = yScale / aspect;
+	p.m[5] = yScale;
+	p.m[10] = farZ / (farZ - nearZ);
+	p.m[11] = -nearZ * farZ / (farZ - nearZ);
+	p.m[14] = 1;
+	return p;
+}
+
+// As XMMatrixOrthographicLH
+static Matrix Orthographic(float width, float height, float nearZ, float farZ)
+{
+	Matrix p = {};
+	p.m[0] = 2 / width;
+	p.m[5] = 2 / height;
+	p.m[10] = 1 / (farZ - nearZ);
+	p.m[11] = -nearZ / (farZ - nearZ);
+	p.m[15] = 1;
+	return p;
+}
+
+// Scale, then turn about z and x, then move
+static Matrix World(float sx, float sy, float sz, float turnZ, float turnX, float tx, float ty, float tz)
+{
+	float cz = cosf(turnZ), szn = sinf(turnZ);
+	float cx = cosf(turnX), sxn = sinf(turnX);
+	// Rx * Rz
+	float r[3][3] =
+	{
+		{ cz, -szn, 0 },
+		{ cx * szn, cx * cz, -sxn },
+		{ sxn * szn, sxn * cz, cx },
+	};
+	float s[3] = { sx, sy, sz };
+	float t[3] = { tx, ty, tz };
+
+	Matrix w = {};
+	for (int row = 0; row < 3; row++)
+	{
+		for (int c = 0; c < 3; c++)
+			w.m[row * 4 + c] = r[row][c] * s[c];
+		w.m[row * 4 + 3] = t[row];
+	}
+	w.m[15] = 1;
+	return w;
+}
+
+struct Shape
+{
+	std::vector<float> points;	// float3s
+	MeshBounds bounds;
+};
+
+// A cloud of points in a box of the given size, off centre by
+// offset so the bounds can't assume the origin
+static Shape MakeShape(float x, float y, float z, float offset, bool round)
+{
+	Shape shape;
+	for (int i = 0; i < 64; i++)
+	{
+		float p[3] = { Random(-1, 1), Random(-1, 1), Random(-1, 1) };
+		if (round)
+			Normalize(p);
+		shape.points.push_back(p[0] * x + offset);
+		shape.points.push_back(p[1] * y);
+		shape.points.push_back(p[2] * z);
+	}
+	shape.bounds = ComputeMeshBounds(&shape.points[0], shape.points.size() / 3, sizeof(float) * 3);
+	return shape;
+}
+
+static void Transform(const Matrix& m, const float* p, float* out)
+{
+	for (int r = 0; r < 4; r++)
+		out[r] = m.m[r * 4 + 0] * p[0] + m.m[r * 4 + 1] * p[1] + m.m[r * 4 + 2] * p[2] + m.m[r * 4 + 3];
+}
+
+int main(int argc, char** argv)
+{
+	int entityCount = argc > 1 ? atoi(argv[1]) : 10000;
+	bool ok = true;
+
+	Shape shapes[3] =
+	{
+		MakeShape(0.5f, 0.5f, 0.5f, 0, true),		// Ball
+		MakeShape(1, 1, 0.05f, 0.3f, false),		// Flat box
+		MakeShape(4, 0.1f, 0.5f, 0, false),		// Wall
+	};
+
+	std::vector<Matrix> worlds(entityCount);
+	std::vector<int> kinds(entityCount);
+	for (int i = 0; i < entityCount; i++)
+	{
+		float scale = Random(0.2f, 2);
+		worlds[i] = World(scale, scale * Random(0.5f, 1.5f), scale, Random(0, 6.28f), Random(0, 6.28f),
+			Random(-40, 40), Random(-25, 25), Random(-10, 60));
+		kinds[i] = i % 3;
+	}
+
+	// The camera, then four lights looking at the field from
+	// above at different angles
+	Matrix views[5], projections[5];
+	views[0] = LookAt(0, 0, -5, 0, 0, 10);
+	projections[0] = Perspective(0.25f * 3.14159f, 16.0f / 9, 0.1f, 100);
+	for (int l = 0; l < 4; l++)
+	{
+		float angle = l * 1.57f + 0.4f;
+		views[l + 1] = LookAt(cosf(angle) * 20, 20, sinf(angle) * 20 + 10, 0, 0, 10);
+		projections[l + 1] = Orthographic(30, 30, 0.1f, 80);
+	}
+
+	FrustumCuller culler;
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < entityCount; i++)
+		culler.Add(shapes[kinds[i]].bounds, worlds[i].m);
+	double addMs = MillisecondsSince(start);
+
+	std::vector<uint8_t> simd, scalar;
+	for (int v = 0; v < 5; v++)
+	{
+		Frustum frustum = FrustumFromViewProjection(views[v].m, projections[v].m);
+		CullStats stats = culler.Cull(frustum, simd);
+		culler.CullScalar(frustum, scalar);
+		Matrix viewProjection = Multiply(projections[v], views[v]);
+
+		int mismatches = 0, wronglyCulled = 0, unprovenCulls = 0;
+		for (int i = 0; i < entityCount; i++)
+		{
+			mismatches += simd[i] != scalar[i];
+
+			const std::vector<float>& points = shapes[kinds[i]].points;
+			bool anyInside = false;
+			bool allBehind[6] = { true, true, true, true, true, true };
+			for (size_t p = 0; p < points.size(); p += 3)
+			{
+				float world[4], clip[4];
+				Transform(worlds[i], &points[p], world);
+				Transform(viewProjection, world, clip);
+				float w = clip[3];
+				anyInside = anyInside || (fabsf(clip[0]) <= w && fabsf(clip[1]) <= w && clip[2] >= 0 && clip[2] <= w);
+
+				// Slightly inside still counts as behind, for rounding
+				for (int plane = 0; plane < 6; plane++)
+				{
+					const float* f = frustum.planes[plane];
+					if (f[0] * world[0] + f[1] * world[1] + f[2] * world[2] + f[3] > 1e-4f)
+						allBehind[plane] = false;
+				}
+			}
+
+			if (anyInside && !simd[i])
+				wronglyCulled++;
+			if (!simd[i])
+			{
+				bool proven = false;
+				for (int plane = 0; plane < 6; plane++)
+					proven = proven || allBehind[plane];
+				unprovenCulls += !proven;
+			}
+		}
+
+		bool viewOk = mismatches == 0 && wronglyCulled == 0 && unprovenCulls == 0;
+		printf("%-7s %s - %u visible, %u culled; %d SSE/scalar mismatches, %d visible culled, %d culls not behind a plane\n",
+			v == 0 ? "camera" : "light", viewOk ? "ok" : "FAILED", stats.visible, stats.culled, mismatches, wronglyCulled, unprovenCulls);
+		ok = ok && viewOk;
+	}
+
+	// Every view, as a frame does it
+	const int repeats = 200;
+	Frustum frustums[5];
+	for (int v = 0; v < 5; v++)
+		frustums[v] = FrustumFromViewProjection(views[v].m, projections[v].m);
+
+	start = Clock::now();
+	uint32_t visibleSum = 0;
+	for (int r = 0; r < repeats; r++)
+		for (int v = 0; v < 5; v++)
+			visibleSum += culler.CullScalar(frustums[v], scalar).visible;
+	double scalarMs = MillisecondsSince(start) / repeats;
+
+	start = Clock::now();
+	for (int r = 0; r < repeats; r++)
+		for (int v = 0; v < 5; v++)
+			visibleSum -= culler.Cull(frustums[v], simd).visible;
+	double simdMs = MillisecondsSince(start) / repeats;
+
+	printf("%d entities: bounds %.3f ms, five views scalar %.3f ms, SSE %.3f ms (%.1fx)%s\n",
+		entityCount, addMs, scalarMs, simdMs, scalarMs / simdMs, visibleSum == 0 ? "" : " - COUNTS DIFFER");
+	return ok && visibleSum == 0 ? 0 : 1;
+}
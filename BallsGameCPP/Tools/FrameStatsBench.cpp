@@ -0,0 +1,110 @@
+// --------------------------------------------------------
+// FrameStatsBench - what FrameStats costs and how close it is
+//
+// Feeds a minute of made-up 60Hz frames - a little jitter, and
+// every few seconds a burst of slow frames like the ones when
+// explosions spawn - through FrameStats, then compares its
+// percentiles with the exact ones from sorting every frame, and
+// times AddFrame (three histogram records) against the frame it
+// describes.  The CSV log it writes is the same as the game's
+// frametimes.csv.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 FrameStatsBench.cpp ../FrameStats.cpp -o framestatsbench
+//
+// Usage:
+//   framestatsbench [log.csv]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "../FrameStats.h"
+#include "../SimRandom.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+const int FRAMES = 60 * 60;
+const int REPEATS = 1000;
+
+static double ExactPercentile(std::vector<double> values, double fraction)
+{
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t)(fraction * values.size() + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > values.size()) rank = values.size();
+	return values[rank - 1];
+}
+
+int main(int argc, char** argv)
+{
+	const char* logName = argc > 1 ? argv[1] : "frametimes.csv";
+
+	// Frame, update, draw in seconds
+	SimRandom random(1);
+	std::vector<double> frames(FRAMES), updates(FRAMES), draws(FRAMES);
+	for (int i = 0; i < FRAMES; i++)
+	{
+		bool hitch = i % 300 < 4;
+		updates[i] = 0.0009 + 0.0002 * random.NextFloat() + (hitch ? 0.012 + 0.01 * random.NextFloat() : 0);
+		draws[i] = 0.0021 + 0.0004 * random.NextFloat();
+		frames[i] = std::max(1.0 / 60 + 0.0005 * random.NextSigned(), updates[i] + draws[i]);
+	}
+
+	FrameStats stats;
+	std::string error;
+	if (!stats.OpenLog(logName, &error))
+	{
+		printf("%s: %s\n", logName, error.c_str());
+		return 1;
+	}
+	for (int i = 0; i < FRAMES; i++)
+		stats.AddFrame(frames[i], updates[i], draws[i]);
+	FrameStatsWindow session = stats.GetSession();
+	stats.CloseLog();
+
+	const std::vector<double>* channels[FRAME_STATS_CHANNELS] = { &frames, &updates, &draws };
+	const double fractions[3] = { 0.50, 0.95, 0.99 };
+	double worstError = 0;
+	printf("%u frames, %u windows; FrameStats against sorting every frame (ms):\n", session.frames, stats.GetWindowCount());
+	for (int c = 0; c < FRAME_STATS_CHANNELS; c++)
+	{
+		const float* reported[3] = { session.p50Ms, session.p95Ms, session.p99Ms };
+		printf("  %-6s", FrameStats::GetChannelName(c));
+		for (int p = 0; p < 3; p++)
+		{
+			double exact = ExactPercentile(*channels[c], fractions[p]) * 1000;
+			double error = std::fabs(reported[p][c] - exact) / exact;
+			worstError = std::max(worstError, error);
+			printf("  p%02d %7.3f/%7.3f", (int)(fractions[p] * 100 + 0.5), reported[p][c], exact);
+		}
+		double exactMax = *std::max_element(channels[c]->begin(), channels[c]->end()) * 1000;
+		printf("  max %7.3f/%7.3f\n", session.maxMs[c], exactMax);
+	}
+	printf("Worst percentile error %.2f%% (buckets are %.1f%% wide)\n", worstError * 100, 100.0 / TIME_HISTOGRAM_SUB_BUCKETS);
+
+	// Windows long enough that none close, so this is just the records
+	FrameStats timed;
+	timed.SetWindowSeconds(1e30);
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < REPEATS; r++)
+		for (int i = 0; i < FRAMES; i++)
+			timed.AddFrame(frames[i], updates[i], draws[i]);
+	double addNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((double)REPEATS * FRAMES);
+
+	// And closing a window: three percentiles a channel, and merging
+	FrameStats closing;
+	closing.SetWindowSeconds(0);
+	start = Clock::now();
+	for (int r = 0; r < REPEATS; r++)
+		closing.AddFrame(frames[r], updates[r], draws[r]);
+	double closeUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / REPEATS;
+
+	printf("AddFrame: %.1f ns (%.5f%% of a 60Hz frame); closing a window: %.1f us once a second\n",
+		addNs, 100.0 * addNs / (1e9 / 60), closeUs);
+	printf("Wrote %s\n", logName);
+	return 0;
+}
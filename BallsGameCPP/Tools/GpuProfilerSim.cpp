@@ -0,0 +1,190 @@
+// --------------------------------------------------------
+// GpuProfilerSim - GpuProfiler against a pretend GPU
+//
+// Draws frames of the game's passes (four shadow maps, the main
+// pass, skybox and HUD) through a GpuProfiler whose timestamps
+// come from FakeGpuTimestamps: a clock that each pass advances by
+// a known cost, which answers a set number of frames after the
+// frame was drawn and can report some frames as disjoint.
+//
+// It then checks the profiler got back what went in - every
+// pass's average, the frame time, how late frames came back, and
+// that when the GPU lags further behind than the ring holds the
+// frames in between are dropped rather than waited on.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 GpuProfilerSim.cpp ../GpuProfiler.cpp ../Profiler.cpp -o gpuprofilersim
+//
+// Usage:
+//   gpuprofilersim [--frames N] [--latency N] [--disjoint-every N] [--trace file.json]
+// --------------------------------------------------------
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../GpuProfiler.h"
+
+// A 10MHz clock, a common rate for real GPUs' timestamps
+const uint64_t FAKE_FREQUENCY = 10000000;
+
+class FakeGpuTimestamps : public IGpuTimestamps
+{
+public:
+	FakeGpuTimestamps(int latency, int disjointEvery) : latency(latency), disjointEvery(disjointEvery)
+	{
+		now = 0;
+		presents = 0;
+		for (int f = 0; f < GPU_PROFILER_FRAMES; f++)
+			endedAt[f] = 0;
+	}
+
+	// The GPU gets through frames whether or not they're timed
+	void Present() { presents++; }
+
+	// Time the pretend GPU spends on the work issued next
+	void Advance(double ms) { now += (uint64_t)(ms * FAKE_FREQUENCY / 1000.0 + 0.5); }
+
+	void BeginFrame(int frame) { endedAt[frame] = 0; }
+	void Timestamp(int frame, int index) { ticks[frame][index] = now; }
+	void EndFrame(int frame) { endedAt[frame] = presents + 1; }
+
+	GpuTimestampStatus Read(int frame, int count, uint64_t* out, uint64_t& frequency)
+	{
+		if (endedAt[frame] == 0 || presents < endedAt[frame] + latency)
+			return GPU_TIMESTAMPS_PENDING;
+		memcpy(out, ticks[frame], count * sizeof(uint64_t));
+		frequency = FAKE_FREQUENCY;
+		if (disjointEvery > 0 && endedAt[frame] % disjointEvery == 0)
+			return GPU_TIMESTAMPS_DISJOINT;
+		return GPU_TIMESTAMPS_READY;
+	}
+
+private:
+	int latency;
+	int disjointEvery;
+	uint64_t now;
+	uint32_t presents;
+	uint32_t endedAt[GPU_PROFILER_FRAMES];	// Which present each slot's frame went out with
+	uint64_t ticks[GPU_PROFILER_FRAMES][GPU_PROFILER_MAX_TIMESTAMPS];
+};
+
+struct SimPass
+{
+	const char* name;
+	double ms;
+};
+
+// Roughly what the game's passes cost on a laptop GPU
+static const SimPass passes[] = {
+	{ "Shadow map 1", 0.21 },
+	{ "Shadow map 2", 0.19 },
+	{ "Shadow map 3", 0.20 },
+	{ "Shadow map 4", 0.22 },
+	{ "Main pass", 1.35 },
+	{ "Skybox", 0.08 },
+	{ "Sprite HUD", 0.05 },
+};
+const int PASS_COUNT = sizeof(passes) / sizeof(passes[0]);
+
+// Unaccounted GPU time between passes
+const double GAP_MS = 0.01;
+
+static bool Check(bool ok, const char* what)
+{
+	printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	int frameCount = 1000, latency = 2, disjointEvery = 0;
+	const char* traceName = 0;
+	bool valid = true;
+
+	for (int i = 1; i < argc && valid; i++)
+	{
+		if (i + 1 >= argc) valid = false;
+		else if (strcmp(argv[i], "--frames") == 0) frameCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--latency") == 0) latency = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--disjoint-every") == 0) disjointEvery = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--trace") == 0) traceName = argv[++i];
+		else valid = false;
+	}
+
+	if (!valid || frameCount < 1 || latency < 0)
+	{
+		printf("Usage: gpuprofilersim [--frames N] [--latency N] [--disjoint-every N] [--trace file.json]\n");
+		return 1;
+	}
+
+	Profiler::RegisterThread("Main");
+	FakeGpuTimestamps* gpu = new FakeGpuTimestamps(latency, disjointEvery);
+	GpuProfiler profiler(gpu);
+
+	// A pass nested in the main pass checks depths are kept apart
+	double frameMs = 0;
+	for (int f = 0; f < frameCount; f++)
+	{
+		PROFILE_SCOPE("Frame");
+		profiler.BeginFrame();
+		frameMs = 0;
+		for (int p = 0; p < PASS_COUNT; p++)
+		{
+			GPU_SCOPE(&profiler, passes[p].name);
+			gpu->Advance(passes[p].ms);
+			frameMs += passes[p].ms;
+			if (strcmp(passes[p].name, "Main pass") == 0)
+			{
+				GPU_SCOPE(&profiler, "Transparent");
+				gpu->Advance(0.0);
+			}
+		}
+		gpu->Advance(GAP_MS);
+		frameMs += GAP_MS;
+		profiler.EndFrame();
+		gpu->Present();
+	}
+	const GpuProfilerStats& stats = profiler.GetStats();
+	printf("%u frames begun, %u timed, %u dropped (ring full), %u disjoint, answered %u frames late\n",
+		stats.framesBegun, stats.framesTimed, stats.framesDropped, stats.framesDisjoint, stats.lastLatency);
+	printf("%-20s %8s %8s %8s %7s\n", "Pass", "last ms", "avg ms", "max ms", "frames");
+	for (const GpuPassTime& pass : profiler.GetPassTimes())
+		printf("%*s%-*s %8.3f %8.3f %8.3f %7u\n", pass.depth * 2, "", 20 - pass.depth * 2, pass.name,
+			pass.lastMs, pass.averageMs, pass.maxMs, pass.frames);
+	printf("%-20s %8.3f %8.3f\n\n", "Frame", stats.lastFrameMs, stats.averageFrameMs);
+
+	// A ring of N frames can have N - 1 waiting while the next is
+	// drawn, so a GPU further behind than that loses frames
+	bool fits = latency < GPU_PROFILER_FRAMES;
+	bool ok = true;
+	ok &= Check(fits ? stats.framesDropped == 0 : stats.framesDropped > 0,
+		fits ? "no frames dropped while the GPU keeps up" : "frames dropped, not waited for, when the GPU falls behind");
+	// The last few frames drawn are still out on the GPU
+	uint32_t accounted = stats.framesTimed + stats.framesDropped + stats.framesDisjoint;
+	ok &= Check(accounted <= stats.framesBegun && accounted + GPU_PROFILER_FRAMES >= stats.framesBegun,
+		"every frame timed, dropped, disjoint or still out");
+	ok &= Check(stats.framesTimed == 0 || stats.lastLatency == (uint32_t)latency + 1, "frames come back when the GPU answers");
+	ok &= Check(stats.framesTimed == 0 || std::fabs(stats.averageFrameMs - frameMs) < 0.001, "frame time adds up");
+
+	bool passesMatch = (int)profiler.GetPassTimes().size() == PASS_COUNT + 1;
+	for (const GpuPassTime& pass : profiler.GetPassTimes())
+		for (int p = 0; p < PASS_COUNT; p++)
+			if (strcmp(pass.name, passes[p].name) == 0)
+				passesMatch &= pass.depth == 0 && std::fabs(pass.averageMs - passes[p].ms) < 0.001;
+	ok &= Check(passesMatch, "each pass's average matches what it cost");
+
+	if (traceName)
+	{
+		std::string error;
+		if (!Profiler::ExportChromeTrace(traceName, &error))
+		{
+			printf("%s: %s\n", traceName, error.c_str());
+			return 1;
+		}
+		printf("Wrote %s\n", traceName);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// --------------------------------------------------------
+// HudTextBench - the HUD's score text, the old way and the new
+//
+// The old way is what Game::Draw used to do every frame: build
+// "Score: N\nBalls: N" with to_string, widen it into a wstring,
+// then lay it out twice - once for MeasureString, once for
+// DrawString - with a binary search through the font for every
+// character, as SpriteFont does.  The new way formats into a
+// stack buffer, hands it to a HudTextRun that only lays out
+// when the text changed, and walks the placed glyphs.
+//
+// Both run over a made-up font and a match's worth of score
+// changes.  It checks the glyphs land where SpriteFont would put
+// them, counts heap allocations per frame (by replacing operator
+// new), and times the two.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 HudTextBench.cpp ../HudText.cpp -o hudtextbench
+//
+// Usage:
+//   hudtextbench
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cwctype>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../HudText.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+const int FRAMES = 200000;
+
+// Everything that reaches the heap while counting is on
+static size_t allocations;
+static bool counting;
+
+void* operator new(size_t size)
+{
+	if (counting)
+		allocations++;
+	void* memory = malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+// Printable ASCII, each a little different, like a real font
+static std::vector<HudGlyph> MakeFont(float& lineSpacing)
+{
+	std::vector<HudGlyph> glyphs;
+	for (uint32_t c = 32; c < 127; c++)
+	{
+		int width = c == ' ' ? 0 : 8 + (int)(c * 7 % 9);
+		int left = (int)(c - 32) * 20;
+		HudGlyph glyph = { c, left, 0, left + width, 24 - (int)(c % 3), c == 'j' ? -1.0f : 0.5f, (float)(c % 4), c == ' ' ? 7.0f : 1.0f };
+		glyphs.push_back(glyph);
+	}
+	lineSpacing = 26;
+	return glyphs;
+}
+
+// SpriteFont's ForEachGlyph with its per-character binary search
+template<typename Action>
+static void ForEachGlyph(const std::vector<HudGlyph>& glyphs, float lineSpacing, const wchar_t* text, Action action)
+{
+	float x = 0, y = 0;
+	for (; *text; text++)
+	{
+		wchar_t character = *text;
+		if (character == '\r')
+			continue;
+		if (character == '\n')
+		{
+			x = 0;
+			y += lineSpacing;
+			continue;
+		}
+
+		std::vector<HudGlyph>::const_iterator glyph = std::lower_bound(glyphs.begin(), glyphs.end(), (uint32_t)character,
+			[](const HudGlyph& glyph, uint32_t character) { return glyph.character < character; });
+		x += glyph->xOffset;
+		if (x < 0)
+			x = 0;
+		float advance = glyph->right - glyph->left + glyph->xAdvance;
+		if (!iswspace(character) || glyph->right - glyph->left > 1 || glyph->bottom - glyph->top > 1)
+			action(&*glyph, x, y);
+		x += advance;
+	}
+}
+
+// Stands in for SpriteBatch::Draw, so nothing is optimized away
+static volatile float sink;
+
+static void DrawOld(const std::vector<HudGlyph>& glyphs, float lineSpacing, int score, int balls, std::vector<float>* positions)
+{
+	std::string text = "Score: " + std::to_string(score) + "\nBalls: " + std::to_string(balls);
+	std::wstring wide(text.length(), L' ');
+	std::copy(text.begin(), text.end(), wide.begin());
+
+	float width = 0, height = 0;
+	ForEachGlyph(glyphs, lineSpacing, wide.c_str(), [&](const HudGlyph* glyph, float x, float y)
+	{
+		width = std::max(width, x + (glyph->right - glyph->left));
+		height = std::max(height, y + std::max((glyph->bottom - glyph->top) + glyph->yOffset, lineSpacing));
+	});
+	ForEachGlyph(glyphs, lineSpacing, wide.c_str(), [&](const HudGlyph* glyph, float x, float y)
+	{
+		sink = x - width / 2 + y + glyph->yOffset - height / 2;
+		if (positions)
+		{
+			positions->push_back(x - width / 2);
+			positions->push_back(y + glyph->yOffset - height / 2);
+		}
+	});
+}
+
+static void DrawNew(const HudGlyphTable& table, HudTextRun& run, int score, int balls, std::vector<float>* positions)
+{
+	char text[64];
+	HudStringBuilder(text, sizeof(text)).Append("Score: ").Append(score).Append("\nBalls: ").Append(balls);
+	run.Set(table, text);
+
+	const HudPlacedGlyph* placed = run.GetGlyphs();
+	for (size_t i = 0; i < run.GetGlyphCount(); i++)
+	{
+		sink = placed[i].x - run.GetWidth() / 2 + placed[i].y - run.GetHeight() / 2;
+		if (positions)
+		{
+			positions->push_back(placed[i].x - run.GetWidth() / 2);
+			positions->push_back(placed[i].y - run.GetHeight() / 2);
+		}
+	}
+}
+
+// A goal every ten seconds and a shot every half second, at 60Hz
+static void Score(int frame, int& score, int& balls)
+{
+	score = frame / 600 % 4;
+	balls = 8 - frame / 30 % 9;
+}
+
+int main()
+{
+	float lineSpacing;
+	std::vector<HudGlyph> glyphs = MakeFont(lineSpacing);
+	HudGlyphTable table;
+	table.Set(&glyphs[0], glyphs.size(), lineSpacing, '?');
+	HudTextRun run;
+
+	// Same glyphs, same places
+	bool same = true;
+	for (int frame = 0; frame < 6000 && same; frame += 7)
+	{
+		int score, balls;
+		Score(frame, score, balls);
+		std::vector<float> oldPositions, newPositions;
+		DrawOld(glyphs, lineSpacing, score, balls, &oldPositions);
+		DrawNew(table, run, score, balls, &newPositions);
+		same = oldPositions.size() == newPositions.size();
+		for (size_t i = 0; same && i < oldPositions.size(); i++)
+			same = std::fabs(oldPositions[i] - newPositions[i]) < 1e-4f;
+	}
+	printf("Layout matches SpriteFont's: %s\n", same ? "yes" : "NO");
+
+	int score, balls;
+	double seconds[2];
+	size_t allocated[2];
+	uint32_t layoutsBefore = run.GetLayoutCount();
+	for (int way = 0; way < 2; way++)
+	{
+		allocations = 0;
+		counting = true;
+		Clock::time_point start = Clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			Score(frame, score, balls);
+			if (way == 0)
+				DrawOld(glyphs, lineSpacing, score, balls, 0);
+			else
+				DrawNew(table, run, score, balls, 0);
+		}
+		seconds[way] = std::chrono::duration<double>(Clock::now() - start).count();
+		counting = false;
+		allocated[way] = allocations;
+	}
+
+	for (int way = 0; way < 2; way++)
+		printf("%s: %6.1f ns a frame, %.2f heap allocations a frame\n", way == 0 ? "to_string + DrawString" : "HudTextRun            ",
+			seconds[way] * 1e9 / FRAMES, (double)allocated[way] / FRAMES);
+	printf("HudTextRun laid out %u times in %d frames\n", run.GetLayoutCount() - layoutsBefore, FRAMES);
+	return same && allocated[1] == 0 ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// --------------------------------------------------------
+// InputLatencySim - where presses land in the match, polled
+// once a frame versus stamped on an input thread
+//
+// An input thread pushes presses into an InputQueue at random
+// moments while the main thread runs frames the way
+// Game::Update does: drain the queue, then step the match at
+// MATCH_TIMESTEP over the frame's time, each step taking the
+// presses made before its slice of time ended.  The old way is
+// worked out alongside - every press since the last frame goes
+// to the frame's first step.
+//
+// It checks the queue hands over every press exactly once and
+// in order.  Then, at a few frame rates, it reports how far
+// after a press the slice of time its step covers ends, both
+// ways.  That's signed: below zero, a press was applied to a
+// step whose time had already passed when it happened, which
+// polling does to more of them the lower the frame rate.  The
+// frame loop sleeps, so the run takes a few seconds.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread InputLatencySim.cpp ../InputQueue.cpp -o inputlatencysim
+//
+// Usage:
+//   inputlatencysim [seconds per frame rate]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../InputQueue.h"
+
+// As Match.h, without pulling in the match
+const float MATCH_TIMESTEP = 1.0f / 120.0f;
+
+struct RunResult
+{
+	bool ok;
+	uint32_t presses;
+	uint32_t dropped;
+	// Press to the end of its step's slice of time, in ns; the
+	// same measure both ways, negative when the slice ended first
+	std::vector<int64_t> stamped;
+	std::vector<int64_t> polled;
+};
+
+// Sorts values as it goes
+static double PercentileMs(std::vector<int64_t>& values, double fraction)
+{
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	return values[(size_t)(fraction * (values.size() - 1) + 0.5)] / 1e6;
+}
+
+static double EarlyPercent(const std::vector<int64_t>& values)
+{
+	size_t early = 0;
+	for (size_t i = 0; i < values.size(); i++)
+		early += values[i] < 0;
+	return values.empty() ? 0 : 100.0 * early / values.size();
+}
+
+static void Run(float frameMs, float seconds, RunResult& result)
+{
+	InputQueue queue;
+	std::atomic<bool> done(false);
+	std::atomic<uint32_t> pushed(0);
+
+	// Presses every 2 to 40 ms, each numbered in its buttons so
+	// order and loss can be checked
+	std::thread input([&]()
+	{
+		uint32_t random = 7;
+		while (!done.load())
+		{
+			random = random * 1664525u + 1013904223u;
+			std::this_thread::sleep_for(std::chrono::microseconds(2000 + (random >> 8) % 38000));
+			InputEvent event;
+			event.timeNs = InputNow();
+			event.buttons = (uint8_t)pushed.load();
+			if (queue.Push(event))
+				pushed++;
+		}
+	});
+
+	InputSchedule schedule;
+	std::vector<InputEvent> taken;
+	uint8_t expected = 0;
+	size_t unpolled = 0;
+	float accumulator = 0;
+	int64_t lastFrame = InputNow();
+	int64_t end = lastFrame + (int64_t)(seconds * 1e9);
+	result.ok = true;
+
+	while (InputNow() < end)
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds((int)(frameMs * 1000)));
+
+		int64_t frameNs = InputNow();
+		accumulator += (frameNs - lastFrame) / 1e9f;
+		lastFrame = frameNs;
+
+		// The old way: everything pressed since the last frame
+		// goes on this frame's first step
+		size_t held = schedule.GetHeldCount();
+		schedule.Drain(queue);
+		unpolled += schedule.GetHeldCount() - held;
+		if (accumulator >= MATCH_TIMESTEP)
+		{
+			int64_t firstStepEndNs = frameNs - (int64_t)((accumulator - MATCH_TIMESTEP) * 1e9);
+			taken.clear();
+			InputSchedule copy = schedule;
+			copy.Take(INT64_MAX, &taken);
+			for (size_t i = taken.size() - unpolled; i < taken.size(); i++)
+				result.polled.push_back(firstStepEndNs - taken[i].timeNs);
+			unpolled = 0;
+		}
+
+		while (accumulator >= MATCH_TIMESTEP)
+		{
+			int64_t stepEndNs = frameNs - (int64_t)((accumulator - MATCH_TIMESTEP) * 1e9);
+			taken.clear();
+			schedule.Take(stepEndNs, &taken);
+			for (size_t i = 0; i < taken.size(); i++)
+			{
+				if (taken[i].buttons != expected++)
+					result.ok = false;
+				result.stamped.push_back(stepEndNs - taken[i].timeNs);
+			}
+			accumulator -= MATCH_TIMESTEP;
+		}
+	}
+
+	done = true;
+	input.join();
+
+	// Whatever's left over still has to come out in order
+	schedule.Drain(queue);
+	taken.clear();
+	schedule.Take(INT64_MAX, &taken);
+	for (size_t i = 0; i < taken.size(); i++)
+	{
+		if (taken[i].buttons != expected++)
+			result.ok = false;
+	}
+
+	result.presses = pushed.load();
+	result.dropped = queue.GetDropped();
+	if ((uint8_t)result.presses != expected)
+		result.ok = false;
+}
+
+int main(int argc, char** argv)
+{
+	float seconds = argc > 1 ? (float)atof(argv[1]) : 1.5f;
+	const float frameRates[3] = { 144, 60, 20 };
+	bool ok = true;
+
+	for (int f = 0; f < 3; f++)
+	{
+		RunResult* result = new RunResult();
+		Run(1000.0f / frameRates[f], seconds, *result);
+		printf("%3.0f fps: %s - %u presses, %u dropped\n", frameRates[f],
+			result->ok ? "ok" : "OUT OF ORDER", result->presses, result->dropped);
+		printf("  stamped: press to its step's end min %6.2f ms, p50 %6.2f ms, max %6.2f ms, %4.1f%% before the press\n",
+			PercentileMs(result->stamped, 0), PercentileMs(result->stamped, 0.5),
+			PercentileMs(result->stamped, 1), EarlyPercent(result->stamped));
+		printf("  polled:  press to its step's end min %6.2f ms, p50 %6.2f ms, max %6.2f ms, %4.1f%% before the press\n",
+			PercentileMs(result->polled, 0), PercentileMs(result->polled, 0.5),
+			PercentileMs(result->polled, 1), EarlyPercent(result->polled));
+		ok = ok && result->ok;
+		delete result;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+// --------------------------------------------------------
+// MeshLOD - builds and reports the LOD chain for OBJ models
+//
+// Loads an OBJ the same way Mesh does (unindexed, three verts
+// per face, UVs flipped), runs the same BuildLODChain the game
+// runs at load time and prints each level's triangle count and
+// error, which level a ball picks at a few distances, and how
+// fast the simplifier chews through triangles.
+//
+// LOD0 is the model with duplicate faces dropped and nothing
+// collapsed, so what that alone saves is reported on its own and
+// the other levels and the per-ball figures are against LOD0.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 MeshLOD.cpp ../MeshSimplifier.cpp -o meshlod
+//
+// Usage:
+//   meshlod [--write] model.obj [model2.obj ...]
+//     --write  Also saves each level as model_lodN.obj for inspection
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../MeshSimplifier.h"
+
+// Position, UV and normal - the part of Vertex that exists when
+// the game builds its LODs (tangents come later)
+struct ObjVertex
+{
+	float position[3];
+	float uv[2];
+	float normal[3];
+};
+
+// Settings the game uses (see Renderer and Game::RenderShadowMap)
+const int LOD_LEVELS = 4;
+const float SCREEN_HEIGHT = 720.0f;
+const float FIELD_OF_VIEW = 0.25f * 3.1415926535f;
+const float MAIN_PIXEL_ERROR = 1.0f;
+const float SHADOW_MAP_SIZE = 1024.0f;
+const float SHADOW_ORTHO_SIZE = 10.0f;
+const float SHADOW_PIXEL_ERROR = 2.0f;
+const float BALL_RADIUS = 0.125f;
+
+static bool LoadObj(const char* file, std::vector<ObjVertex>& verts)
+{
+	FILE* f = fopen(file, "r");
+	if (!f)
+		return false;
+
+	std::vector<float> positions, uvs, normals;
+	char line[256];
+	while (fgets(line, sizeof(line), f))
+	{
+		float x, y, z;
+		if (line[0] == 'v' && line[1] == 'n' && sscanf(line, "vn %f %f %f", &x, &y, &z) == 3)
+		{
+			normals.push_back(x); normals.push_back(y); normals.push_back(z);
+		}
+		else if (line[0] == 'v' && line[1] == 't' && sscanf(line, "vt %f %f", &x, &y) == 2)
+		{
+			uvs.push_back(x); uvs.push_back(y);
+		}
+		else if (line[0] == 'v' && sscanf(line, "v %f %f %f", &x, &y, &z) == 3)
+		{
+			positions.push_back(x); positions.push_back(y); positions.push_back(z);
+		}
+		else if (line[0] == 'f')
+		{
+			unsigned int i[12];
+			int read = sscanf(line, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u",
+				&i[0], &i[1], &i[2], &i[3], &i[4], &i[5], &i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+			if (read != 9 && read != 12)
+				continue;
+
+			ObjVertex v[4];
+			for (int c = 0; c < read / 3; c++)
+			{
+				if (i[c * 3] * 3 > positions.size() || i[c * 3 + 1] * 2 > uvs.size() || i[c * 3 + 2] * 3 > normals.size())
+				{
+					fclose(f);
+					return false;
+				}
+				memcpy(v[c].position, &positions[(i[c * 3] - 1) * 3], sizeof(v[c].position));
+				memcpy(v[c].uv, &uvs[(i[c * 3 + 1] - 1) * 2], sizeof(v[c].uv));
+				memcpy(v[c].normal, &normals[(i[c * 3 + 2] - 1) * 3], sizeof(v[c].normal));
+				v[c].uv[1] = 1.0f - v[c].uv[1];
+			}
+
+			verts.push_back(v[0]); verts.push_back(v[1]); verts.push_back(v[2]);
+			if (read == 12)
+			{
+				verts.push_back(v[0]); verts.push_back(v[2]); verts.push_back(v[3]);
+			}
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+static void WriteObj(const std::string& file, const std::vector<ObjVertex>& verts, const std::vector<unsigned int>& indices)
+{
+	FILE* f = fopen(file.c_str(), "w");
+	if (!f)
+		return;
+	for (size_t i = 0; i < verts.size(); i++)
+		fprintf(f, "v %f %f %f\n", verts[i].position[0], verts[i].position[1], verts[i].position[2]);
+	for (size_t i = 0; i < verts.size(); i++)
+		fprintf(f, "vt %f %f\n", verts[i].uv[0], 1.0f - verts[i].uv[1]);
+	for (size_t i = 0; i < verts.size(); i++)
+		fprintf(f, "vn %f %f %f\n", verts[i].normal[0], verts[i].normal[1], verts[i].normal[2]);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int a = indices[i] + 1, b = indices[i + 1] + 1, c = indices[i + 2] + 1;
+		fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+	}
+	fclose(f);
+}
+
+int main(int argc, char** argv)
+{
+	bool write = false;
+	int files = 0;
+
+	for (int a = 1; a < argc; a++)
+	{
+		if (strcmp(argv[a], "--write") == 0)
+		{
+			write = true;
+			continue;
+		}
+
+		files++;
+		std::vector<ObjVertex> verts;
+		if (!LoadObj(argv[a], verts) || verts.empty())
+		{
+			printf("%s: could not load\n", argv[a]);
+			continue;
+		}
+
+		std::vector<unsigned int> indices(verts.size());
+		for (size_t i = 0; i < indices.size(); i++)
+			indices[i] = (unsigned int)i;
+
+		const float* data = verts[0].position;
+		size_t stride = sizeof(ObjVertex);
+		float radius = MeshBoundingRadius(data, verts.size(), stride);
+
+		// Time enough repeats to get a stable number
+		std::vector<SimplifyResult> levels;
+		int runs = 0;
+		double seconds = 0;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		do
+		{
+			BuildLODChain(data, verts.size(), stride, 5, &indices[0], indices.size(), LOD_LEVELS, levels);
+			runs++;
+			seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		} while (seconds < 0.5);
+
+		// Level 0 reads the whole model, every later level reads the one before it
+		size_t inputTriangles = indices.size() / 3;
+		for (size_t l = 0; l + 1 < levels.size(); l++)
+			inputTriangles += levels[l].indices.size() / 3;
+
+		size_t lod0Triangles = levels[0].indices.size() / 3;
+		printf("%s: %zu triangles, radius %.3f\n", argv[a], indices.size() / 3, radius);
+		printf("  duplicate faces dropped: %zu -> %zu triangles (%.1f%%)\n",
+			indices.size() / 3, lod0Triangles, 100.0 * lod0Triangles * 3 / indices.size());
+		std::vector<float> errors;
+		for (size_t l = 0; l < levels.size(); l++)
+		{
+			errors.push_back(levels[l].error);
+			printf("  LOD%zu: %6zu triangles (%5.1f%% of LOD0), error %.5f (%.3f%% of radius)\n",
+				l, levels[l].indices.size() / 3, 100.0 * levels[l].indices.size() / levels[0].indices.size(),
+				levels[l].error, 100.0 * levels[l].error / radius);
+
+			if (write)
+			{
+				std::string name(argv[a]);
+				size_t dot = name.find_last_of('.');
+				char suffix[32];
+				sprintf(suffix, "_lod%zu.obj", l);
+				WriteObj(name.substr(0, dot) + suffix, verts, levels[l].indices);
+			}
+		}
+		printf("  chain built in %.3f ms, %.2f M input triangles/s\n",
+			seconds * 1000.0 / runs, inputTriangles * runs / seconds / 1e6);
+
+		// What a ball of this mesh picks in the game, in the main view and a shadow map
+		float focal = 1.0f / tanf(FIELD_OF_VIEW * 0.5f);
+		float scale = BALL_RADIUS / radius;
+		float shadowRadius = BALL_RADIUS * SHADOW_MAP_SIZE / SHADOW_ORTHO_SIZE;
+		int shadowLod = SelectLOD(&errors[0], (int)errors.size(), radius, shadowRadius, SHADOW_PIXEL_ERROR);
+		printf("  ball (radius %.3f) in a %.0fpx shadow map: %.1fpx, LOD%d\n", BALL_RADIUS, SHADOW_MAP_SIZE, shadowRadius, shadowLod);
+
+		float distances[] = { 2.0f, 4.0f, 6.0f, 10.0f, 20.0f };
+		for (int d = 0; d < 5; d++)
+		{
+			float projected = radius * scale * focal / distances[d] * SCREEN_HEIGHT * 0.5f;
+			int lod = SelectLOD(&errors[0], (int)errors.size(), radius, projected, MAIN_PIXEL_ERROR);
+
+			// One main pass plus four shadow passes per ball, against
+			// LOD0 everywhere
+			size_t full = lod0Triangles * 5;
+			size_t reduced = levels[lod].indices.size() / 3 + levels[shadowLod].indices.size() / 3 * 4;
+			printf("  ball at %4.1f units: %5.1fpx, LOD%d, %zu -> %zu triangles per ball per frame\n",
+				distances[d], projected, lod, full, reduced);
+		}
+	}
+
+	if (files == 0)
+	{
+		printf("Usage: meshlod [--write] model.obj [model2.obj ...]\n");
+		return 1;
+	}
+	return 0;
+}
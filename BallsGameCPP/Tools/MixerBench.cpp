@@ -0,0 +1,417 @@
+// --------------------------------------------------------
+// MixerBench - the software mixer and its streams, on made-up
+// sound
+//
+// Writes a stereo 48 kHz and a mono 22.05 kHz test signal as
+// 16 bit .wav files, and again as MS-ADPCM, then checks:
+//   - the PCM files read back exactly, and a voice at the bus's
+//     own rate, panned hard left, mixes to exactly its samples
+//   - the ADPCM files decode to within a sensible noise floor
+//   - SSE and scalar resampling mix exactly the same bus from 64
+//     voices at odd pitches
+//
+// Then times MixBlock with 16, 64 and 256 voices against the
+// block's 5.8 ms: first from memory, SSE and scalar, then with
+// every voice streaming its own file (PCM and ADPCM) through the
+// feeder thread, paced at twice real time, counting underruns.
+// The 16 voice streamed mix is left in mixerbench.wav.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread MixerBench.cpp ../SoftwareMixer.cpp ../AudioStream.cpp ../SoundPlayer.cpp ../FrameStats.cpp ../Profiler.cpp -o mixerbench
+//
+// Usage:
+//   mixerbench [seconds streamed]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../SoftwareMixer.h"
+#include "../SimRandom.h"
+
+const double BLOCK_BUDGET_MS = 1000.0 * MIX_BLOCK_FRAMES / MIXER_SAMPLE_RATE;
+const int ADPCM_FRAMES_PER_BLOCK = 1012;
+
+struct TestSound
+{
+	std::string name;
+	AudioFormat format;
+	std::vector<int16_t> samples;
+	size_t frames;
+};
+
+// A wobbling tone with a chord on the right, or just the tone
+static void MakeSignal(TestSound& sound, const char* name, int sampleRate, int channels, size_t frames)
+{
+	sound.name = name;
+	sound.format.sampleRate = sampleRate;
+	sound.format.channels = channels;
+	sound.frames = frames;
+	sound.samples.resize(frames * channels);
+
+	SimRandom random(7);
+	for (size_t i = 0; i < frames; i++)
+	{
+		double t = (double)i / sampleRate;
+		double tone = std::sin(2 * 3.14159265 * (440 + 30 * std::sin(t * 5)) * t) * 0.5 + random.NextSigned() * 0.02;
+		sound.samples[i * channels] = (int16_t)(tone * 32767);
+		if (channels == 2)
+		{
+			double chord = (std::sin(2 * 3.14159265 * 330 * t) + std::sin(2 * 3.14159265 * 415 * t)) * 0.3 * std::exp(-std::fmod(t, 0.5) * 4);
+			sound.samples[i * 2 + 1] = (int16_t)(chord * 32767);
+		}
+	}
+}
+
+static void PutU16(std::vector<uint8_t>& out, uint16_t value) { out.push_back((uint8_t)value); out.push_back((uint8_t)(value >> 8)); }
+static void PutU32(std::vector<uint8_t>& out, uint32_t value) { PutU16(out, (uint16_t)value); PutU16(out, (uint16_t)(value >> 16)); }
+
+static bool SaveAdpcmFile(const char* fileName, const TestSound& sound)
+{
+	int channels = sound.format.channels;
+	AdpcmFormat format;
+	format.channels = channels;
+	format.blockAlign = 7 * channels + (ADPCM_FRAMES_PER_BLOCK - 2) * channels / 2;
+	format.samplesPerBlock = ADPCM_FRAMES_PER_BLOCK;
+	SetDefaultAdpcmCoefficients(format);
+
+	std::vector<uint8_t> data;
+	for (size_t start = 0; start + ADPCM_FRAMES_PER_BLOCK <= sound.frames; start += ADPCM_FRAMES_PER_BLOCK)
+	{
+		data.resize(data.size() + format.blockAlign);
+		EncodeAdpcmBlock(&sound.samples[start * channels], format, &data[data.size() - format.blockAlign]);
+	}
+
+	std::vector<uint8_t> file;
+	file.insert(file.end(), (const uint8_t*)"RIFF", (const uint8_t*)"RIFF" + 4);
+	PutU32(file, (uint32_t)(4 + 8 + 50 + 8 + data.size()));
+	file.insert(file.end(), (const uint8_t*)"WAVEfmt ", (const uint8_t*)"WAVEfmt " + 8);
+	PutU32(file, 50);
+	PutU16(file, WAVE_FORMAT_ADPCM_TAG);
+	PutU16(file, (uint16_t)channels);
+	PutU32(file, (uint32_t)sound.format.sampleRate);
+	PutU32(file, (uint32_t)(sound.format.sampleRate * format.blockAlign / ADPCM_FRAMES_PER_BLOCK));
+	PutU16(file, (uint16_t)format.blockAlign);
+	PutU16(file, 4);
+	PutU16(file, 32);
+	PutU16(file, (uint16_t)format.samplesPerBlock);
+	PutU16(file, (uint16_t)format.coefficientCount);
+	for (int i = 0; i < format.coefficientCount; i++)
+	{
+		PutU16(file, (uint16_t)format.coefficients[i][0]);
+		PutU16(file, (uint16_t)format.coefficients[i][1]);
+	}
+	file.insert(file.end(), (const uint8_t*)"data", (const uint8_t*)"data" + 4);
+	PutU32(file, (uint32_t)data.size());
+	file.insert(file.end(), data.begin(), data.end());
+
+	FILE* out = fopen(fileName, "wb");
+	if (!out)
+		return false;
+	bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+	fclose(out);
+	return ok;
+}
+
+static size_t ReadAll(AudioStream& stream, std::vector<int16_t>& samples)
+{
+	int channels = stream.GetFormat().channels;
+	samples.clear();
+	std::vector<int16_t> chunk(1000 * channels);
+	size_t frames = 0;
+	size_t read;
+	while ((read = stream.Read(chunk.data(), 1000)) > 0)
+	{
+		samples.insert(samples.end(), chunk.begin(), chunk.begin() + read * channels);
+		frames += read;
+	}
+	return frames;
+}
+
+static bool CheckPcm(const TestSound& sound, const std::string& fileName)
+{
+	WavFileStream stream;
+	std::string error;
+	std::vector<int16_t> samples;
+	if (!stream.Open(fileName.c_str(), &error))
+	{
+		printf("%s: %s\n", sound.name.c_str(), error.c_str());
+		return false;
+	}
+	bool ok = ReadAll(stream, samples) == sound.frames && samples == sound.samples;
+
+	// Rewound, it reads the same again
+	stream.Rewind();
+	std::vector<int16_t> again;
+	ok = ok && ReadAll(stream, again) == sound.frames && again == samples;
+	printf("PCM %s: %s\n", sound.name.c_str(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+static bool CheckAdpcm(const TestSound& sound, const std::string& fileName)
+{
+	WavFileStream stream;
+	std::string error;
+	std::vector<int16_t> samples;
+	if (!stream.Open(fileName.c_str(), &error) || !stream.IsAdpcm())
+	{
+		printf("%s: %s\n", sound.name.c_str(), error.c_str());
+		return false;
+	}
+	size_t frames = ReadAll(stream, samples);
+
+	double signal = 0;
+	double noise = 0;
+	for (size_t i = 0; i < std::min(samples.size(), sound.samples.size()); i++)
+	{
+		double difference = (double)samples[i] - sound.samples[i];
+		signal += (double)sound.samples[i] * sound.samples[i];
+		noise += difference * difference;
+	}
+	double snr = 10 * std::log10(signal / std::max(noise, 1.0));
+	bool ok = frames == sound.frames && snr > 20;
+	printf("ADPCM %s: %s - %.1f dB signal to noise, %llu bytes for %llu frames\n", sound.name.c_str(), ok ? "ok" : "FAILED",
+		snr, (unsigned long long)stream.GetBytesRead(), (unsigned long long)frames);
+	return ok;
+}
+
+// A mono voice at the bus rate, pitch 0, panned hard left, has
+// to come out of a .wav exactly as it went in
+static bool CheckPassThrough()
+{
+	TestSound sound;
+	MakeSignal(sound, "pass", MIXER_SAMPLE_RATE, 1, MIXER_SAMPLE_RATE);
+	MemoryStream stream;
+	stream.Reset(sound.samples.data(), sound.frames, sound.format);
+
+	SoftwareMixer mixer(1);
+	WavFileOutput output("mixerbench_pass.wav");
+	std::string error;
+	if (!output.Open(MIXER_SAMPLE_RATE, &error))
+	{
+		printf("Pass through: %s\n", error.c_str());
+		return false;
+	}
+	std::vector<float> left(MIX_BLOCK_FRAMES);
+	std::vector<float> right(MIX_BLOCK_FRAMES);
+	mixer.Play(0, &stream, 1.0f, -1.0f, 0.0f);
+	while (mixer.IsPlaying(0))
+	{
+		mixer.MixBlock(left.data(), right.data());
+		output.Write(left.data(), right.data(), MIX_BLOCK_FRAMES);
+	}
+	output.Close();
+
+	WavFileStream mixed;
+	std::vector<int16_t> samples;
+	bool ok = mixed.Open("mixerbench_pass.wav") && ReadAll(mixed, samples) >= sound.frames;
+	for (size_t i = 0; ok && i < samples.size() / 2; i++)
+	{
+		int16_t expected = i < sound.frames ? sound.samples[i] : 0;
+		ok = samples[i * 2] == expected && samples[i * 2 + 1] == 0;
+	}
+	remove("mixerbench_pass.wav");
+	printf("Pass through: %s\n", ok ? "ok" : "FAILED");
+	return ok;
+}
+
+// Voices at random pitches, pans and volumes, some looping
+static void StartVoices(SoftwareMixer& mixer, std::vector<AudioStream*>& streams, uint64_t seed)
+{
+	SimRandom random(seed);
+	for (int v = 0; v < mixer.GetVoiceCount(); v++)
+	{
+		mixer.Play(v, streams[v % streams.size()], 0.1f + random.NextFloat() * 0.1f, random.NextSigned(),
+			random.NextSigned() * MIXER_MAX_PITCH, v % 3 != 0);
+	}
+}
+
+static bool CheckSimdParity(const TestSound* sounds, int soundCount)
+{
+	SoftwareMixer scalar(64);
+	SoftwareMixer simd(64);
+	scalar.SetUseSimd(false);
+	simd.SetUseSimd(true);
+	if (!simd.GetUseSimd())
+	{
+		printf("SIMD parity: skipped, no SSE\n");
+		return true;
+	}
+
+	std::vector<MemoryStream> cursors(128);
+	std::vector<AudioStream*> scalarStreams;
+	std::vector<AudioStream*> simdStreams;
+	for (size_t i = 0; i < cursors.size(); i++)
+	{
+		const TestSound& sound = sounds[i % soundCount];
+		cursors[i].Reset(sound.samples.data(), sound.frames, sound.format);
+		(i < 64 ? scalarStreams : simdStreams).push_back(&cursors[i]);
+	}
+	StartVoices(scalar, scalarStreams, 11);
+	StartVoices(simd, simdStreams, 11);
+
+	std::vector<float> bus[4];
+	for (int b = 0; b < 4; b++)
+		bus[b].resize(MIX_BLOCK_FRAMES);
+	bool ok = true;
+	int blocks = 0;
+	for (; blocks < 2000 && ok; blocks++)
+	{
+		scalar.MixBlock(bus[0].data(), bus[1].data());
+		simd.MixBlock(bus[2].data(), bus[3].data());
+		ok = memcmp(bus[0].data(), bus[2].data(), MIX_BLOCK_FRAMES * sizeof(float)) == 0 &&
+			memcmp(bus[1].data(), bus[3].data(), MIX_BLOCK_FRAMES * sizeof(float)) == 0;
+	}
+	printf("SIMD parity: %s - %d blocks of 64 voices\n", ok ? "ok" : "FAILED", blocks);
+	return ok;
+}
+
+static void Report(const char* label, int voices, const MixerStats& stats)
+{
+	const TimeHistogram& time = stats.mixTime;
+	double p99 = time.GetPercentile(0.99) / 1e6;
+	printf("  %-16s %3d voices: p50 %.3f ms, p99 %.3f ms, max %.3f ms (%.1f%% of the block at p99), %llu underruns, %.1f voices a block\n",
+		label, voices, time.GetPercentile(0.5) / 1e6, p99, time.GetMax() / 1e6, 100.0 * p99 / BLOCK_BUDGET_MS,
+		(unsigned long long)stats.underruns, stats.blocks > 0 ? (double)stats.voiceBlocks / stats.blocks : 0.0);
+}
+
+static void TimeMemory(const TestSound* sounds, int soundCount, int voices, bool useSimd)
+{
+	SoftwareMixer mixer(voices);
+	mixer.SetUseSimd(useSimd);
+	std::vector<MemoryStream> cursors(voices);
+	std::vector<AudioStream*> streams;
+	for (int v = 0; v < voices; v++)
+	{
+		const TestSound& sound = sounds[v % soundCount];
+		cursors[v].Reset(sound.samples.data(), sound.frames, sound.format);
+		streams.push_back(&cursors[v]);
+	}
+	StartVoices(mixer, streams, 5);
+
+	std::vector<float> left(MIX_BLOCK_FRAMES);
+	std::vector<float> right(MIX_BLOCK_FRAMES);
+	for (int b = 0; b < 2000; b++)
+		mixer.MixBlock(left.data(), right.data());
+	Report(useSimd && mixer.GetUseSimd() ? "memory, SSE" : "memory, scalar", voices, mixer.GetStats());
+}
+
+// Every voice its own open file, fed by the feeder thread, with
+// blocks going no faster than twice real time
+static void TimeStreamed(const std::vector<std::string>& files, int voices, double seconds, const char* label, MixerOutput* output)
+{
+	std::vector<WavFileStream*> streams;
+	std::vector<AudioStream*> playing;
+	for (int v = 0; v < voices; v++)
+	{
+		WavFileStream* stream = new WavFileStream();
+		std::string error;
+		if (!stream->Open(files[v % files.size()].c_str(), &error))
+		{
+			printf("%s\n", error.c_str());
+			delete stream;
+			break;
+		}
+		streams.push_back(stream);
+		playing.push_back(stream);
+	}
+	if ((int)playing.size() != voices)
+	{
+		for (size_t i = 0; i < streams.size(); i++)
+			delete streams[i];
+		return;
+	}
+
+	SoftwareMixer mixer(voices);
+	mixer.StartFeeder();
+	StartVoices(mixer, playing, 9);
+
+	std::vector<float> left(MIX_BLOCK_FRAMES);
+	std::vector<float> right(MIX_BLOCK_FRAMES);
+	int blocks = (int)(seconds * MIXER_SAMPLE_RATE / MIX_BLOCK_FRAMES);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t bytesRead = 0;
+	for (int b = 0; b < blocks; b++)
+	{
+		std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)(b * BLOCK_BUDGET_MS * 500)));
+		mixer.MixBlock(left.data(), right.data());
+		if (output)
+			output->Write(left.data(), right.data(), MIX_BLOCK_FRAMES);
+	}
+	mixer.StopFeeder();
+	for (size_t i = 0; i < streams.size(); i++)
+		bytesRead += streams[i]->GetBytesRead();
+
+	Report(label, voices, mixer.GetStats());
+	printf("  %-16s %3d voices: %.1f MB read, %llu frames streamed\n", "", voices, bytesRead / 1e6,
+		(unsigned long long)mixer.GetStats().framesStreamed);
+
+	for (size_t i = 0; i < streams.size(); i++)
+		delete streams[i];
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+
+	TestSound sounds[2];
+	MakeSignal(sounds[0], "stereo 48k", 48000, 2, ADPCM_FRAMES_PER_BLOCK * 190);
+	MakeSignal(sounds[1], "mono 22k", 22050, 1, ADPCM_FRAMES_PER_BLOCK * 87);
+
+	std::vector<std::string> pcmFiles;
+	std::vector<std::string> adpcmFiles;
+	bool ok = true;
+	for (int i = 0; i < 2; i++)
+	{
+		std::string pcm = i == 0 ? "mixerbench_stereo.wav" : "mixerbench_mono.wav";
+		std::string adpcm = i == 0 ? "mixerbench_stereo_adpcm.wav" : "mixerbench_mono_adpcm.wav";
+		std::string error;
+		if (!SaveWavFile(pcm.c_str(), sounds[i].samples.data(), sounds[i].frames, sounds[i].format, &error) ||
+			!SaveAdpcmFile(adpcm.c_str(), sounds[i]))
+		{
+			printf("Could not write the test files: %s\n", error.c_str());
+			return 1;
+		}
+		pcmFiles.push_back(pcm);
+		adpcmFiles.push_back(adpcm);
+
+		ok = CheckPcm(sounds[i], pcm) && ok;
+		ok = CheckAdpcm(sounds[i], adpcm) && ok;
+	}
+	ok = CheckPassThrough() && ok;
+	ok = CheckSimdParity(sounds, 2) && ok;
+
+	printf("Mix time per %d frame block (%.2f ms of sound):\n", (int)MIX_BLOCK_FRAMES, BLOCK_BUDGET_MS);
+	const int voiceCounts[3] = { 16, 64, 256 };
+	for (int i = 0; i < 3; i++)
+	{
+		TimeMemory(sounds, 2, voiceCounts[i], true);
+		TimeMemory(sounds, 2, voiceCounts[i], false);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		WavFileOutput* output = i == 0 ? new WavFileOutput("mixerbench.wav") : 0;
+		if (output && !output->Open(MIXER_SAMPLE_RATE, 0))
+		{
+			delete output;
+			output = 0;
+		}
+		TimeStreamed(pcmFiles, voiceCounts[i], seconds, "streamed PCM", output);
+		delete output;
+		TimeStreamed(adpcmFiles, voiceCounts[i], seconds, "streamed ADPCM", 0);
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		remove(pcmFiles[i].c_str());
+		remove(adpcmFiles[i].c_str());
+	}
+	return ok ? 0 : 1;
+}
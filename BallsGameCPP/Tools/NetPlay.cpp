@@ -0,0 +1,157 @@
+// --------------------------------------------------------
+// NetPlay - a headless rollback peer for testing netcode
+//
+// Runs one side of a networked match with a random
+// button-masher in place of the player, stepping at the real
+// 120Hz so prediction and rollback behave like they do in the
+// game.  Start two of these pointed at each other (one as
+// player 1, one as player 2) and add latency, jitter and loss
+// to see what rollback costs under a bad connection.
+//
+// When the match ends (or --frames is reached) each side waits
+// for the other's input to catch up and then prints the final
+// state hash; the two should be identical, and the desync
+// checks along the way should have found nothing.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 NetPlay.cpp ../Match.cpp ../SnapshotRing.cpp ../RollbackSession.cpp ../UdpSocket.cpp -o netplay
+//
+// Usage:
+//   netplay --player 1 --port 7001 --peer localhost:7002 [--seed N]
+//           [--delay frames] [--latency ms] [--jitter ms] [--loss percent] [--frames N]
+//   netplay --player 2 --port 7002 --peer localhost:7001 ...
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "../RollbackSession.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// How long to keep answering the other side once we're done,
+// so it gets our last inputs even if some packets are lost
+const double LINGER_MS = 1000.0;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int player = 0, delay = 2;
+	unsigned int port = 0;
+	uint64_t seed = 1;
+	uint32_t maxFrames = 120 * 60;
+	NetAddress peer;
+	bool havePeer = false;
+	LinkConditions conditions;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (strcmp(argv[i], "--player") == 0) player = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--port") == 0) port = (unsigned int)atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--peer") == 0) havePeer = NetAddress::Parse(argv[i + 1], peer);
+		else if (strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[i + 1], 0, 10);
+		else if (strcmp(argv[i], "--delay") == 0) delay = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "--latency") == 0) conditions.latencyMs = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--jitter") == 0) conditions.jitterMs = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--loss") == 0) conditions.lossPercent = (float)atof(argv[i + 1]);
+		else if (strcmp(argv[i], "--frames") == 0) maxFrames = (uint32_t)strtoul(argv[i + 1], 0, 10);
+	}
+
+	if ((player != 1 && player != 2) || port == 0 || port > 65535 || !havePeer)
+	{
+		printf("Usage: netplay --player 1|2 --port P --peer host:port [--seed N] [--delay frames]\n");
+		printf("               [--latency ms] [--jitter ms] [--loss percent] [--frames N]\n");
+		return 1;
+	}
+
+	RollbackSession session(player, seed, delay);
+	session.SetConditions(conditions);
+	if (!session.Start((uint16_t)port, peer))
+	{
+		printf("Couldn't open UDP port %u\n", port);
+		return 1;
+	}
+
+	// Each side mashes differently, and never touches the match's generator
+	SimRandom bot(seed * 2 + player);
+	uint8_t buttons = 0;
+
+	Clock::time_point start = Clock::now();
+	double stepMs = MATCH_TIMESTEP * 1000.0;
+	double nextStepMs = 0;
+	double doneMs = -1;
+
+	while (true)
+	{
+		double nowMs = MillisecondsSince(start);
+		if (nowMs < nextStepMs)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds((long long)((nextStepMs - nowMs) * 1000.0)));
+			continue;
+		}
+		nextStepMs += stepMs;
+
+		bool finished = session.GetFrame() >= maxFrames || session.GetMatch().GetWinner() != 0;
+		if (!finished)
+		{
+			// Held buttons build up until the session takes them
+			uint32_t roll = bot.Next();
+			if (roll % 40 == 0) buttons |= PLAYER_UP;
+			if (roll % 40 == 1) buttons |= PLAYER_DOWN;
+			if ((roll >> 8) % 50 == 0) buttons |= PLAYER_FIRE;
+			if (session.Update(buttons, nowMs))
+				buttons = 0;
+		}
+		else
+			session.Poll(nowMs);
+
+		if (!session.IsConnected() && nowMs > 10000.0)
+		{
+			printf("No packets from the peer after 10 s\n");
+			return 1;
+		}
+
+		// Done once everything we simulated is confirmed, plus a grace period
+		if (finished && session.GetConfirmedFrame() >= session.GetFrame())
+		{
+			if (doneMs < 0)
+				doneMs = nowMs;
+			else if (nowMs - doneMs > LINGER_MS)
+				break;
+		}
+	}
+
+	double seconds = MillisecondsSince(start) / 1000.0;
+	const RollbackStats& stats = session.GetStats();
+	Match& match = session.GetMatch();
+	uint32_t frames = session.GetFrame();
+
+	printf("player %d: %u frames, winner %d, score %d-%d, final hash %08x\n",
+		player, frames, match.GetWinner(), match.GetScore(1), match.GetScore(2), match.Hash());
+	printf("  link        %.0f ms +0..%.0f ms, %.1f%% loss, input delay %d\n",
+		conditions.latencyMs, conditions.jitterMs, conditions.lossPercent, delay);
+	printf("  simulated   %u frames (%u re-simulated), %u stalls\n",
+		stats.framesSimulated, stats.framesResimulated, stats.stalls);
+	printf("  rollbacks   %u, avg depth %.1f, max depth %u\n", stats.rollbacks,
+		stats.rollbacks ? (double)stats.framesResimulated / stats.rollbacks : 0.0, stats.maxRollbackDepth);
+	printf("  re-sim time %.3f ms total, %.3f ms worst\n", stats.resimulateMs, stats.maxResimulateMs);
+	printf("  sent        %u packets, %llu bytes (%.0f bytes/s), %u dropped by the conditioner\n",
+		stats.packetsSent, (unsigned long long)stats.bytesSent, stats.bytesSent / seconds, session.GetDroppedPackets());
+	printf("  received    %u packets, %llu bytes (%.0f bytes/s)\n",
+		stats.packetsReceived, (unsigned long long)stats.bytesReceived, stats.bytesReceived / seconds);
+
+	if (stats.desyncFrame >= 0)
+	{
+		printf("  DESYNC at frame %d\n", stats.desyncFrame);
+		return 1;
+	}
+	printf("  %u desync checks, all matched\n", stats.desyncChecks);
+	return 0;
+}
@@ -0,0 +1,175 @@
+// --------------------------------------------------------
+// ParticleParity - ParticleSim against the GPU's way of
+// running the same rules
+//
+// The GPU's way, minus the D3D: the simulate shader's threads
+// consume and append in no particular order, and the emit
+// shader's threads find their burst by scanning the emit list
+// and drop whatever lands past the capacity.  Here that's done
+// over a shuffled order with the shaders' own lookups, so the
+// result comes out in a different order from ParticleSim's
+// every step - CompareParticles has to match them up by id.
+//
+// It runs a match's worth of explosions at 1x and at 100x the
+// particles (the second runs into the capacity), checks the
+// two agree every step, and times the CPU path, which is what
+// the GPU path takes off the frame.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 ParticleParity.cpp ../ParticleSim.cpp -o particleparity
+//
+// Usage:
+//   particleparity [seconds]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../ParticleSim.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// What the shaders do, one thread at a time in a shuffled order
+class ShaderEmulation
+{
+public:
+	explicit ShaderEmulation(const ParticleSimConfig& config) : config(config), shuffle(1) {}
+
+	void Step(float dt, const std::vector<ParticleEmit>& emits)
+	{
+		// ComputeShaderParticleSim: one thread per live particle
+		next.clear();
+		Shuffle(particles);
+		for (size_t i = 0; i < particles.size(); i++)
+		{
+			ParticleState p = particles[i];
+			if (StepParticle(p, dt, config))
+				next.push_back(p);
+		}
+
+		// ComputeShaderParticleEmit: one thread per new particle
+		uint32_t live = (uint32_t)next.size();
+		uint32_t newCount = emits.empty() ? 0 : emits.back().first + emits.back().count;
+		std::vector<uint32_t> threads(newCount);
+		for (uint32_t i = 0; i < newCount; i++)
+			threads[i] = i;
+		Shuffle(threads);
+		for (size_t t = 0; t < threads.size(); t++)
+		{
+			uint32_t id = threads[t];
+			if (live + id >= config.capacity)
+				continue;
+
+			size_t e = 0;
+			while (e + 1 < emits.size() && emits[e + 1].first <= id)
+				e++;
+			next.push_back(SpawnParticle(emits[e], id - emits[e].first, config));
+		}
+
+		particles.swap(next);
+	}
+
+	const std::vector<ParticleState>& GetParticles() const { return particles; }
+
+private:
+	template <typename T>
+	void Shuffle(std::vector<T>& items)
+	{
+		for (size_t i = items.size(); i > 1; i--)
+		{
+			shuffle = shuffle * 6364136223846793005ull + 1442695040888963407ull;
+			std::swap(items[i - 1], items[(shuffle >> 33) % i]);
+		}
+	}
+
+	ParticleSimConfig config;
+	std::vector<ParticleState> particles;
+	std::vector<ParticleState> next;
+	uint64_t shuffle;
+};
+
+struct RunResult
+{
+	bool ok;
+	size_t mostAlive;
+	size_t bursts;
+	double cpuMs;
+	int steps;
+};
+
+// A burst every few frames at random places on the field,
+// at 60 frames a second
+static RunResult Run(float seconds, uint32_t perExplosion)
+{
+	ParticleSimConfig config;
+	ParticleSim cpu(config);
+	ShaderEmulation gpu(config);
+	ParticleEmitQueue queue;
+
+	RunResult result = {};
+	result.ok = true;
+	const float dt = 1.0f / 60;
+	result.steps = (int)(seconds * 60);
+	uint32_t random = 12345;
+
+	for (int step = 0; step < result.steps; step++)
+	{
+		queue.Clear();
+		random = ParticleHash(random);
+		int bursts = random % 4 == 0 ? 1 + (random >> 8) % 3 : 0;
+		for (int b = 0; b < bursts; b++)
+		{
+			random = ParticleHash(random);
+			float x = (random & 0xffff) / 65536.0f * 8 - 4;
+			float y = (random >> 16) / 65536.0f * 4 - 2;
+			if (queue.Add(x, y, 0.65f, perExplosion, 1.2f))
+				result.bursts++;
+		}
+
+		Clock::time_point start = Clock::now();
+		cpu.Step(dt, queue.GetEmits());
+		result.cpuMs += MillisecondsSince(start);
+
+		gpu.Step(dt, queue.GetEmits());
+
+		std::vector<ParticleState> a = cpu.GetParticles();
+		std::vector<ParticleState> b = gpu.GetParticles();
+		result.mostAlive = std::max(result.mostAlive, a.size());
+		ParticleParityResult parity = CompareParticles(a, b);
+		if (!ParticlesMatch(parity, 0))
+		{
+			if (result.ok)
+				printf("  step %d: %u CPU, %u emulated, %u unmatched, worst %g position %g velocity %g life\n",
+					step, (unsigned)parity.countA, (unsigned)parity.countB, (unsigned)parity.unmatched,
+					parity.maxPositionError, parity.maxVelocityError, parity.maxLifeError);
+			result.ok = false;
+		}
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	float seconds = argc > 1 ? (float)atof(argv[1]) : 30;
+	bool ok = true;
+
+	const uint32_t densities[2] = { 1000, 100000 };
+	for (int d = 0; d < 2; d++)
+	{
+		RunResult run = Run(seconds, densities[d]);
+		printf("%6u a burst: %s - %u bursts, %u alive at most (capacity %u), CPU %.3f ms a step\n",
+			densities[d], run.ok ? "ok" : "MISMATCH", (unsigned)run.bursts, (unsigned)run.mostAlive,
+			ParticleSimConfig().capacity, run.cpuMs / run.steps);
+		ok = ok && run.ok;
+	}
+
+	return ok ? 0 : 1;
+}
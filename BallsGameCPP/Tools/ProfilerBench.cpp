@@ -0,0 +1,141 @@
+// --------------------------------------------------------
+// ProfilerBench - what the profiling scopes cost
+//
+// Times an empty PROFILE_SCOPE on a registered thread (records),
+// an unregistered one (the tools, pool workers) and a paused one,
+// then steps matches of 10 and 100 balls with and without the
+// thread registered - BallManager::Update has five scopes, so
+// that's the most scope-dense code in the game - and finally
+// writes what it recorded as a Chrome trace.
+//
+// Build it a second time with -DDISABLE_PROFILER to check the
+// scopes compile out: every "scope" time should then match the
+// bare loop.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread ProfilerBench.cpp ../Profiler.cpp ../Match.cpp -o profilerbench
+//
+// Usage:
+//   profilerbench [trace.json]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "../Match.h"
+#include "../Profiler.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+const int SCOPE_REPEATS = 10000000;
+const int STEPS = 20000;
+
+static double NanosecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Keeps the loops from being optimized away
+static volatile uint32_t sink;
+
+static double TimeScopes()
+{
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < SCOPE_REPEATS; i++)
+	{
+		PROFILE_SCOPE("Empty");
+		sink = sink + 1;
+	}
+	return NanosecondsSince(start) / SCOPE_REPEATS;
+}
+
+static double TimeBareLoop()
+{
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < SCOPE_REPEATS; i++)
+		sink = sink + 1;
+	return NanosecondsSince(start) / SCOPE_REPEATS;
+}
+
+// Fills the field with balls drifting about, then times stepping it
+static double TimeSteps(int ballCount)
+{
+	Match match(1);
+	SimRandom random(ballCount);
+	BallManager* balls = match.GetBallManager();
+	balls->setExplosionsEnabled(false);
+	for (int i = 1; i < ballCount; i++)
+		balls->addBall(myVector(random.NextSigned() * 2.4f, random.NextSigned() * 1.3f, -0.65f),
+			myVector(random.NextSigned(), random.NextSigned(), 0), 1.0f, BALL_RADIUS, false);
+
+	std::vector<uint8_t> start;
+	match.SaveState(start);
+
+	// Best of a few, since the difference being measured is small
+	double best = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		match.LoadState(&start[0], start.size());
+		Clock::time_point begin = Clock::now();
+		for (int i = 0; i < STEPS; i++)
+			match.Step(MatchInput());
+		double ns = NanosecondsSince(begin) / STEPS;
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	const char* traceName = argc > 1 ? argv[1] : "profile.json";
+	printf("Profiler %s\n", PROFILER_ENABLED ? "enabled" : "compiled out (DISABLE_PROFILER)");
+
+	double bare = TimeBareLoop();
+	double unregistered = TimeScopes();
+	double unregisteredSteps[2] = { TimeSteps(10), TimeSteps(100) };
+
+	Profiler::RegisterThread("Bench");
+	double registered = TimeScopes();
+	double paused;
+	{
+		PROFILE_PAUSE();
+		paused = TimeScopes();
+	}
+	double registeredSteps[2] = { TimeSteps(10), TimeSteps(100) };
+
+	printf("Empty scope: %.1f ns recording, %.1f ns unregistered, %.1f ns paused (bare loop %.1f ns)\n",
+		registered - bare, unregistered - bare, paused - bare, bare);
+	for (int i = 0; i < 2; i++)
+		printf("Match step, %3d balls: %8.1f ns recording, %8.1f ns unregistered (%+.2f%%)\n",
+			i == 0 ? 10 : 100, registeredSteps[i], unregisteredSteps[i],
+			100.0 * (registeredSteps[i] - unregisteredSteps[i]) / unregisteredSteps[i]);
+
+	// A frame with one or two steps and a dozen draw scopes has ~25
+	printf("A 60Hz frame with 25 scopes spends %.4f%% of its time recording them\n",
+		100.0 * 25 * (registered - bare) / (1e9 / 60));
+
+	// A second thread too, to show up as its own track
+	std::thread other([]()
+	{
+		Profiler::RegisterThread("Worker");
+		for (int i = 0; i < 100; i++)
+		{
+			PROFILE_SCOPE("Worker job");
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	});
+	other.join();
+
+	Clock::time_point start = Clock::now();
+	std::string error;
+	if (!Profiler::ExportChromeTrace(traceName, &error))
+	{
+		printf("%s: %s\n", traceName, error.c_str());
+		return 1;
+	}
+	printf("Wrote %s in %.1f ms (%llu scopes recorded, the last %u per thread kept)\n", traceName,
+		NanosecondsSince(start) / 1e6, (unsigned long long)Profiler::GetEventCount(), PROFILE_RING_SIZE);
+	return 0;
+}
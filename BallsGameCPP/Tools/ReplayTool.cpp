@@ -0,0 +1,130 @@
+// --------------------------------------------------------
+// ReplayTool - re-simulates match replays headlessly
+//
+// Plays each replay through the same Match/BallManager code
+// the game runs, as fast as the CPU allows and with no
+// rendering, and compares the state hash after every step
+// against the one recorded.  The first step that differs is
+// reported, which is where to start looking when a replay
+// stops reproducing (an uninitialized value, a stray rand(),
+// a compiler or platform doing float math differently...).
+//
+// --record makes a replay without the game by letting two
+// random button-mashers play each other, which is handy for
+// checking that Linux and Windows builds agree.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 ReplayTool.cpp ../Match.cpp ../Replay.cpp ../MappedFile.cpp -o replaytool
+//
+// Usage:
+//   replaytool match.replay [match2.replay ...]
+//   replaytool --record out.replay [--seed N] [--steps N]
+// --------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "../Replay.h"
+
+static int Record(const char* fileName, uint64_t seed, uint32_t maxSteps)
+{
+	Match match(seed);
+	ReplayWriter writer;
+	writer.Begin(seed);
+
+	// The bots get their own generator so they never touch the match's
+	SimRandom bots(seed ^ 0x9E3779B97F4A7C15ULL);
+	for (uint32_t step = 0; step < maxSteps && match.GetWinner() == 0; step++)
+	{
+		MatchInput input;
+		uint32_t roll = bots.Next();
+		if (roll % 40 == 0) input.buttons |= MATCH_P1_UP;
+		if (roll % 40 == 1) input.buttons |= MATCH_P1_DOWN;
+		if ((roll >> 8) % 50 == 0) input.buttons |= MATCH_P1_FIRE;
+		if ((roll >> 16) % 40 == 0) input.buttons |= MATCH_P2_UP;
+		if ((roll >> 16) % 40 == 1) input.buttons |= MATCH_P2_DOWN;
+		if ((roll >> 24) % 50 == 0) input.buttons |= MATCH_P2_FIRE;
+
+		match.Step(input);
+		writer.Record(input, match.Hash());
+	}
+
+	std::string error;
+	if (!writer.Save(fileName, &error))
+	{
+		printf("%s: %s\n", fileName, error.c_str());
+		return 1;
+	}
+
+	std::vector<uint8_t> data;
+	writer.Serialize(data);
+	printf("%s: seed %llu, %u steps (%.1f s of play), winner %d, score %d-%d, %zu bytes\n",
+		fileName, (unsigned long long)seed, writer.GetStepCount(), writer.GetStepCount() * MATCH_TIMESTEP,
+		match.GetWinner(), match.GetScore(1), match.GetScore(2), data.size());
+	return 0;
+}
+
+static int Play(const char* fileName)
+{
+	std::string error;
+	ReplayReader replay;
+	if (!replay.Load(fileName, &error))
+	{
+		printf("%s: INVALID - %s\n", fileName, error.c_str());
+		return 1;
+	}
+
+	ReplayResult result;
+	PlayReplay(replay, result);
+
+	double stepsPerSecond = result.seconds > 0 ? result.stepsPlayed / result.seconds : 0;
+	printf("%s: seed %llu, %u steps, %zu input events\n",
+		fileName, (unsigned long long)replay.GetSeed(), replay.GetStepCount(), replay.GetEvents().size());
+	printf("  played in %.2f ms: %.0f steps/s, %.0fx real time\n",
+		result.seconds * 1000.0, stepsPerSecond, stepsPerSecond * MATCH_TIMESTEP);
+
+	if (result.divergedStep >= 0)
+	{
+		printf("  DIVERGED at step %d (%.3f s): expected hash %08x, got %08x\n",
+			result.divergedStep, result.divergedStep * MATCH_TIMESTEP, result.expectedHash, result.actualHash);
+		return 1;
+	}
+	printf("  all %u step hashes match, winner %d\n", result.stepsPlayed, result.winner);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* recordFile = 0;
+	uint64_t seed = 1;
+	uint32_t steps = 120 * 60 * 10;
+	int files = 0, failures = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordFile = argv[++i];
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+			steps = (uint32_t)strtoul(argv[++i], 0, 10);
+		else
+		{
+			files++;
+			failures += Play(argv[i]);
+		}
+	}
+
+	if (recordFile)
+		return Record(recordFile, seed, steps);
+
+	if (files == 0)
+	{
+		printf("Usage: replaytool match.replay [match2.replay ...]\n");
+		printf("       replaytool --record out.replay [--seed N] [--steps N]\n");
+		return 1;
+	}
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+// --------------------------------------------------------
+// SelfPlay - plays scripted bots against each other in bulk
+//
+// Runs batches of headless matches (see SelfPlay.h) across every
+// core and reports who won, how long matches lasted and how many
+// matches a second the machine gets through.  The rules can be
+// changed from the command line, so the effect of a different
+// fire period, shot speed, speed cap, magazine or winning score
+// can be measured over a few million matches instead of felt
+// out by hand.
+//
+// Bots are given as row/fire:
+//   row  - stay, random, track, lead
+//   fire - random, asap, lined-up, volley
+// Bot A and bot B swap sides every other match unless
+// --fixed-sides is given; with the same bot on both sides,
+// --fixed-sides shows whether either side has an edge.
+//
+// --tournament plays every pair of the bots listed after it (or
+// of every bot, if none are) and ranks them by win rate.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread SelfPlay.cpp ../SelfPlay.cpp ../JobPool.cpp ../Match.cpp -o selfplay
+//
+// Usage:
+//   selfplay [--a row/fire] [--b row/fire] [--matches N] [--threads N]
+//            [--seed N] [--max-seconds N] [--fixed-sides] [--histogram]
+//            [--fire-period s] [--ball-speed v] [--max-speed v]
+//            [--magazine N] [--win-score N]
+//   selfplay --tournament [row/fire ...] [same options]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../SelfPlay.h"
+
+static void PrintPolicy(const BotPolicy& policy, char* text, size_t size)
+{
+	snprintf(text, size, "%s/%s", GetBotRowPolicyName(policy.row), GetBotFirePolicyName(policy.fire));
+}
+
+static void Report(const SelfPlayConfig& config, const SelfPlayResult& result, int threads, bool histogram)
+{
+	char a[32], b[32];
+	PrintPolicy(config.bots[0], a, sizeof(a));
+	PrintPolicy(config.bots[1], b, sizeof(b));
+
+	double matches = result.matches ? result.matches : 1;
+	uint32_t decided = result.matches - result.draws;
+	printf("%s vs %s: %u matches in %.2f s on %d threads, %.0f matches/s (%.2fM steps/s)\n",
+		a, b, result.matches, result.seconds, threads, result.matches / result.seconds, result.steps / result.seconds / 1e6);
+	printf("  A wins %.1f%%, B wins %.1f%%, draws %.1f%% (player 1's side won %.1f%% of decided)\n",
+		100.0 * result.wins[0] / matches, 100.0 * result.wins[1] / matches, 100.0 * result.draws / matches,
+		decided ? 100.0 * result.sideWins[0] / decided : 0.0);
+	printf("  goals per match %.2f - %.2f, length mean %.1f s, p10 %.0f s, p50 %.0f s, p90 %.0f s, p99 %.0f s\n",
+		result.goals[0] / matches, result.goals[1] / matches, result.steps * MATCH_TIMESTEP / matches,
+		GetSelfPlayLengthPercentile(result, 0.10f), GetSelfPlayLengthPercentile(result, 0.50f),
+		GetSelfPlayLengthPercentile(result, 0.90f), GetSelfPlayLengthPercentile(result, 0.99f));
+
+	if (histogram && decided > 0)
+	{
+		// Ten-second bars scaled to the biggest
+		std::vector<uint32_t> bars((result.lengthHistogram.size() + 9) / 10, 0);
+		for (size_t i = 0; i < result.lengthHistogram.size(); i++)
+			bars[i / 10] += result.lengthHistogram[i];
+		uint32_t most = *std::max_element(bars.begin(), bars.end());
+		for (size_t i = 0; i < bars.size(); i++)
+		{
+			int width = (int)(50.0 * bars[i] / most + 0.5);
+			printf("  %4zu-%4zu s %6.2f%% %.*s\n", i * 10, i * 10 + 9, 100.0 * bars[i] / decided, width,
+				"##################################################");
+		}
+	}
+	fflush(stdout);
+}
+
+struct Standing
+{
+	BotPolicy policy;
+	uint64_t wins, played;
+};
+
+static void RunTournament(SelfPlayConfig config, std::vector<BotPolicy> bots, JobPool& pool)
+{
+	if (bots.empty())
+	{
+		for (int row = 0; row < BOT_ROW_POLICY_COUNT; row++)
+			for (int fire = 0; fire < BOT_FIRE_POLICY_COUNT; fire++)
+			{
+				BotPolicy policy = { (BotRowPolicy)row, (BotFirePolicy)fire };
+				bots.push_back(policy);
+			}
+	}
+
+	std::vector<Standing> standings(bots.size());
+	for (size_t i = 0; i < bots.size(); i++)
+	{
+		standings[i].policy = bots[i];
+		standings[i].wins = standings[i].played = 0;
+	}
+
+	uint64_t totalMatches = 0;
+	double totalSeconds = 0;
+	for (size_t i = 0; i < bots.size(); i++)
+		for (size_t j = i + 1; j < bots.size(); j++)
+		{
+			config.bots[0] = bots[i];
+			config.bots[1] = bots[j];
+			SelfPlayResult result;
+			RunSelfPlay(config, pool, result);
+			Report(config, result, pool.GetThreadCount(), false);
+
+			standings[i].wins += result.wins[0];
+			standings[j].wins += result.wins[1];
+			standings[i].played += result.matches;
+			standings[j].played += result.matches;
+			totalMatches += result.matches;
+			totalSeconds += result.seconds;
+		}
+
+	std::sort(standings.begin(), standings.end(), [](const Standing& x, const Standing& y)
+	{
+		return x.wins * y.played > y.wins * x.played;
+	});
+
+	printf("\nStandings after %llu matches (%.0f matches/s):\n", (unsigned long long)totalMatches, totalMatches / totalSeconds);
+	for (const Standing& standing : standings)
+	{
+		char name[32];
+		PrintPolicy(standing.policy, name, sizeof(name));
+		printf("  %-18s won %5.1f%%\n", name, standing.played ? 100.0 * standing.wins / standing.played : 0.0);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	SelfPlayConfig config;
+	config.bots[0].row = BOT_ROW_LEAD;
+	config.bots[0].fire = BOT_FIRE_LINED_UP;
+	config.bots[1].row = BOT_ROW_RANDOM;
+	config.bots[1].fire = BOT_FIRE_RANDOM;
+	config.seed = 1;
+	config.matches = 10000;
+	config.maxSteps = (uint32_t)(300 / MATCH_TIMESTEP);
+	config.alternateSides = true;
+
+	int threads = 0;
+	bool tournament = false, histogram = false, valid = true;
+	std::vector<BotPolicy> tournamentBots;
+
+	for (int i = 1; i < argc && valid; i++)
+	{
+		BotPolicy policy;
+		if (strcmp(argv[i], "--tournament") == 0) tournament = true;
+		else if (strcmp(argv[i], "--fixed-sides") == 0) config.alternateSides = false;
+		else if (strcmp(argv[i], "--histogram") == 0) histogram = true;
+		else if (tournament && ParseBotPolicy(argv[i], policy)) tournamentBots.push_back(policy);
+		else if (i + 1 >= argc) valid = false;
+		else if (strcmp(argv[i], "--a") == 0) valid = ParseBotPolicy(argv[++i], config.bots[0]);
+		else if (strcmp(argv[i], "--b") == 0) valid = ParseBotPolicy(argv[++i], config.bots[1]);
+		else if (strcmp(argv[i], "--matches") == 0) config.matches = (uint32_t)strtoul(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0) config.seed = strtoull(argv[++i], 0, 10);
+		else if (strcmp(argv[i], "--max-seconds") == 0) config.maxSteps = (uint32_t)(atof(argv[++i]) / MATCH_TIMESTEP);
+		else if (strcmp(argv[i], "--fire-period") == 0) config.rules.firePeriod = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--ball-speed") == 0) config.rules.ballSpeed = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--max-speed") == 0) config.rules.maxSpeed = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "--magazine") == 0) config.rules.ballsPerPlayer = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--win-score") == 0) config.rules.winningScore = atoi(argv[++i]);
+		else valid = false;
+	}
+
+	// Scores go over the wire in a few bits, so keep them small
+	if (!valid || config.matches == 0 || config.maxSteps == 0 || config.rules.ballSpeed <= 0 ||
+		config.rules.maxSpeed <= 0 || config.rules.ballsPerPlayer < 0 || config.rules.winningScore < 1 || config.rules.winningScore > 31)
+	{
+		printf("Usage: selfplay [--a row/fire] [--b row/fire] [--matches N] [--threads N]\n");
+		printf("                [--seed N] [--max-seconds N] [--fixed-sides] [--histogram]\n");
+		printf("                [--fire-period s] [--ball-speed v] [--max-speed v]\n");
+		printf("                [--magazine N] [--win-score N]\n");
+		printf("       selfplay --tournament [row/fire ...] [same options]\n");
+		printf("  row: stay random track lead   fire: random asap lined-up volley\n");
+		return 1;
+	}
+
+	JobPool pool(threads);
+	printf("Rules: fire period %.2f s, ball speed %.2f, max speed %.2f, %d balls, first to %d\n",
+		config.rules.firePeriod, config.rules.ballSpeed, config.rules.maxSpeed,
+		config.rules.ballsPerPlayer, config.rules.winningScore);
+
+	if (tournament)
+		RunTournament(config, tournamentBots, pool);
+	else
+	{
+		SelfPlayResult result;
+		RunSelfPlay(config, pool, result);
+		Report(config, result, pool.GetThreadCount(), histogram);
+	}
+	return 0;
+}
@@ -0,0 +1,199 @@
+// --------------------------------------------------------
+// ShaderBundler - packs compiled shaders into one bundle
+//
+// Reads each .cso, pulls its reflection (constant buffers,
+// variables, bind slots, input signature) out of the DXBC
+// container and writes everything to a single file that
+// SimpleShader::LoadFromBundle() can use without D3DReflect.
+//
+// After writing, the bundle is mapped and validated with the
+// same ShaderBundle class the game uses, and the time spent
+// reflecting the .cso files is compared against parsing the
+// bundle.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 ShaderBundler.cpp ../ShaderBundle.cpp ../MappedFile.cpp -o shaderbundle
+//
+// Usage:
+//   shaderbundle -o Shaders.bundle VertexShader.cso PixelShader.cso ...
+//   shaderbundle --dump Shaders.bundle
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../ShaderBundle.h"
+#include "../MappedFile.h"
+
+static const char* ResourceTypeName(uint32_t type)
+{
+	switch (type)
+	{
+	case SHADER_RESOURCE_CBUFFER: return "cbuffer";
+	case SHADER_RESOURCE_TBUFFER: return "tbuffer";
+	case SHADER_RESOURCE_TEXTURE: return "texture";
+	case SHADER_RESOURCE_SAMPLER: return "sampler";
+	case SHADER_RESOURCE_UAV_RWTYPED: return "rwtyped";
+	case SHADER_RESOURCE_STRUCTURED: return "structured";
+	case SHADER_RESOURCE_UAV_RWSTRUCTURED: return "rwstructured";
+	case SHADER_RESOURCE_BYTEADDRESS: return "byteaddress";
+	case SHADER_RESOURCE_UAV_RWBYTEADDRESS: return "rwbyteaddress";
+	case SHADER_RESOURCE_UAV_APPEND_STRUCTURED: return "append";
+	case SHADER_RESOURCE_UAV_CONSUME_STRUCTURED: return "consume";
+	case SHADER_RESOURCE_UAV_RWSTRUCTURED_WITH_COUNTER: return "rwstructured_counter";
+	default: return "unknown";
+	}
+}
+
+// Shader name is the file name without directory or extension
+static std::string ShaderName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	return (dot == std::string::npos) ? name : name.substr(0, dot);
+}
+
+static double MicrosecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void Dump(const ShaderBundle& bundle)
+{
+	for (uint32_t s = 0; s < bundle.GetShaderCount(); s++)
+	{
+		const ShaderBundleShader& shader = bundle.GetShader(s);
+		printf("  %s (%s, %u bytes)", shader.name, ShaderStageName(shader.stage), shader.bytecodeSize);
+		if (shader.stage == SHADER_STAGE_COMPUTE)
+			printf(" threads %ux%ux%u", shader.threadGroupSize[0], shader.threadGroupSize[1], shader.threadGroupSize[2]);
+		printf("\n");
+
+		for (uint32_t b = 0; b < shader.bufferCount; b++)
+		{
+			const ShaderBundleBuffer& buffer = bundle.GetBuffer(shader.firstBuffer + b);
+			printf("    cbuffer %s : b%u, %u bytes\n", buffer.name, buffer.bindIndex, buffer.size);
+			for (uint32_t v = 0; v < buffer.variableCount; v++)
+			{
+				const ShaderBundleVariable& variable = bundle.GetVariable(buffer.firstVariable + v);
+				printf("      %-24s offset %4u size %4u\n", variable.name, variable.byteOffset, variable.size);
+			}
+		}
+
+		for (uint32_t r = 0; r < shader.resourceCount; r++)
+		{
+			const ShaderBundleResource& resource = bundle.GetResource(shader.firstResource + r);
+			if (resource.type == SHADER_RESOURCE_CBUFFER)
+				continue;
+			printf("    %s %s : slot %u\n", ResourceTypeName(resource.type), resource.name, resource.bindIndex);
+		}
+
+		for (uint32_t i = 0; i < shader.inputCount; i++)
+		{
+			const ShaderBundleInput& input = bundle.GetInput(shader.firstInput + i);
+			printf("    input %s%u mask 0x%x type %u\n", input.semanticName, input.semanticIndex, input.mask, input.componentType);
+		}
+	}
+}
+
+static int DumpBundle(const char* file)
+{
+	std::string error;
+	ShaderBundle bundle;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (!bundle.Open(file, &error))
+	{
+		printf("%s: INVALID - %s\n", file, error.c_str());
+		return 1;
+	}
+	double us = MicrosecondsSince(start);
+
+	printf("%s: %u shaders, %zu bytes, map + validate %.1f us\n", file, bundle.GetShaderCount(), bundle.GetSize(), us);
+	Dump(bundle);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	const char* output = 0;
+	std::vector<std::string> inputs;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+			return DumpBundle(argv[i + 1]);
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			output = argv[++i];
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	if (!output || inputs.empty())
+	{
+		printf("Usage: shaderbundle -o out.bundle shader.cso [shader2.cso ...]\n");
+		printf("       shaderbundle --dump file.bundle\n");
+		return 1;
+	}
+
+	// Reflect every shader, timing just the parse (the file is already mapped)
+	std::vector<ShaderReflectionData> shaders;
+	double reflectUs = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		MappedFile mapped;
+		if (!mapped.Open(inputs[i].c_str()))
+		{
+			printf("%s: could not map file\n", inputs[i].c_str());
+			return 1;
+		}
+
+		std::string error;
+		ShaderReflectionData shader;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		if (!DXBCReflect(mapped.GetData(), mapped.GetSize(), shader, &error))
+		{
+			printf("%s: INVALID - %s\n", inputs[i].c_str(), error.c_str());
+			return 1;
+		}
+		reflectUs += MicrosecondsSince(start);
+
+		shader.name = ShaderName(inputs[i]);
+		shaders.push_back(shader);
+	}
+
+	std::string error;
+	std::vector<uint8_t> bundleData;
+	if (!ShaderBundleWrite(shaders, bundleData, &error))
+	{
+		printf("%s: %s\n", output, error.c_str());
+		return 1;
+	}
+
+	FILE* f = fopen(output, "wb");
+	if (!f || fwrite(&bundleData[0], 1, bundleData.size(), f) != bundleData.size())
+	{
+		printf("%s: could not write file\n", output);
+		if (f) fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	// Read it back through the same path the game takes
+	ShaderBundle bundle;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	if (!bundle.Open(output, &error))
+	{
+		printf("%s: written bundle is INVALID - %s\n", output, error.c_str());
+		return 1;
+	}
+	double bundleUs = MicrosecondsSince(start);
+
+	printf("%s: %zu shaders, %zu bytes\n", output, shaders.size(), bundleData.size());
+	Dump(bundle);
+	printf("Reflecting %zu .cso files: %.1f us, mapping + validating the bundle: %.1f us\n",
+		shaders.size(), reflectUs, bundleUs);
+	return 0;
+}
@@ -0,0 +1,145 @@
+// --------------------------------------------------------
+// SnapshotBench - times saving and restoring match state
+//
+// Fills the field with N small balls moving in random
+// directions, steps the match while saving every step into a
+// SnapshotRing, then restores each saved step over and over.
+// Prints the state size and save/restore cost next to the cost
+// of a step, which is the budget rollback has to fit in.
+//
+// Also checks that a restore really is complete: rewinding a
+// few steps and re-simulating them has to land on the same
+// state hash as the first time through.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 SnapshotBench.cpp ../Match.cpp ../SnapshotRing.cpp -o snapshotbench
+//
+// Usage:
+//   snapshotbench [ballCount ...]     (default 10 100 1000)
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../Match.h"
+#include "../SnapshotRing.h"
+
+const int RING_FRAMES = 16;
+const int STEPS = 240;
+const int RESTORE_PASSES = 50;
+const int REWIND_STEPS = 8;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MicrosecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Lays out extra balls on a grid, clear of the soccer ball
+static void FillField(Match& match, int ballCount)
+{
+	SimRandom random(ballCount);
+	BallManager* manager = match.GetBallManager();
+	for (int row = 0; row < 28 && (int)manager->getBalls().size() <= ballCount; row++)
+	{
+		for (int column = 0; column < 50 && (int)manager->getBalls().size() <= ballCount; column++)
+		{
+			float x = -2.45f + column * 0.1f;
+			float y = -1.35f + row * 0.1f;
+			if (x * x + (y - 0.1f) * (y - 0.1f) < 0.35f * 0.35f)
+				continue;
+
+			float angle = random.NextFloat() * 6.2831853f;
+			manager->addBall(myVector(x, y, -0.65f), myVector(cosf(angle), sinf(angle), 0) * 0.5f, 1, 0.04f, false);
+		}
+	}
+}
+
+static void Run(int ballCount)
+{
+	Match match(1);
+	FillField(match, ballCount);
+	int startBalls = (int)match.GetBallManager()->getBalls().size() - 1;
+
+	SnapshotRing ring(RING_FRAMES, match.GetStateSize() * 2);
+	std::vector<uint32_t> hashes;
+	double stepUs = 0, saveUs = 0;
+	size_t maxBytes = 0, maxExplosions = 0;
+
+	ring.Save(match);
+	hashes.push_back(match.Hash());
+	for (int i = 0; i < STEPS; i++)
+	{
+		Clock::time_point start = Clock::now();
+		match.Step(MatchInput());
+		stepUs += MicrosecondsSince(start);
+
+		start = Clock::now();
+		ring.Save(match);
+		saveUs += MicrosecondsSince(start);
+
+		hashes.push_back(match.Hash());
+		if (ring.GetFrameSize(match.GetStepCount()) > maxBytes)
+			maxBytes = ring.GetFrameSize(match.GetStepCount());
+		if (match.GetBallManager()->getExplosions().size() > maxExplosions)
+			maxExplosions = match.GetBallManager()->getExplosions().size();
+	}
+	uint32_t lastStep = match.GetStepCount();
+	int endBalls = (int)match.GetBallManager()->getBalls().size() - 1;
+
+	// Restore every step still in the ring, many times over
+	Match scratch(0);
+	double restoreUs = 0;
+	int restores = 0;
+	for (int pass = 0; pass < RESTORE_PASSES; pass++)
+	{
+		for (uint32_t step = lastStep - RING_FRAMES + 1; step <= lastStep; step++)
+		{
+			Clock::time_point start = Clock::now();
+			bool restored = ring.Restore(scratch, step);
+			restoreUs += MicrosecondsSince(start);
+			restores++;
+			if (!restored || scratch.Hash() != hashes[step])
+			{
+				printf("%d balls: restore of step %u FAILED\n", ballCount, step);
+				return;
+			}
+		}
+	}
+
+	// Rewind and re-simulate; has to come out the same
+	ring.Restore(match, lastStep - REWIND_STEPS);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < REWIND_STEPS; i++)
+		match.Step(MatchInput());
+	double resimUs = MicrosecondsSince(start);
+	bool matches = match.Hash() == hashes[lastStep];
+
+	printf("%d balls (%d after %d steps), up to %zu explosions:\n", startBalls, endBalls, STEPS, maxExplosions);
+	printf("  snapshot  %8zu bytes max (%zu per ball, %zu per explosion)\n", maxBytes, sizeof(Ball), sizeof(Emitter));
+	printf("  step      %8.2f us\n", stepUs / STEPS);
+	printf("  save      %8.2f us (%.1f%% of a step)\n", saveUs / STEPS, 100.0 * saveUs / stepUs);
+	printf("  restore   %8.2f us\n", restoreUs / restores);
+	printf("  rewind %d steps and re-simulate: %.1f us, %s\n", REWIND_STEPS, resimUs,
+		matches ? "same state" : "DIFFERENT STATE");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; i++)
+			Run(atoi(argv[i]));
+	}
+	else
+	{
+		Run(10);
+		Run(100);
+		Run(1000);
+	}
+	return 0;
+}
@@ -0,0 +1,223 @@
+// --------------------------------------------------------
+// SnapshotCodecBench - spectator snapshot size and accuracy
+//
+// Fills the field with N small balls, steps the match and
+// sends a snapshot every tick through a pretend connection:
+// packets take --lag ticks to arrive, --loss percent of them
+// never do, and the server only learns what the client has
+// when the client's ack comes back (another --lag ticks).
+// Every snapshot the client decodes is checked against the one
+// the server captured, bit for bit.
+//
+// Prints the average bytes per tick against naive snapshots
+// (every ball as an id and four floats, the whole state every
+// tick), the largest packet, how far the quantized positions
+// are from the real ones, and the cost of encoding and decoding.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 SnapshotCodecBench.cpp ../SnapshotCodec.cpp ../Match.cpp -o snapshotcodecbench
+//
+// Usage:
+//   snapshotcodecbench [--lag ticks] [--loss percent] [ballCount ...]
+//     (default lag 6, loss 0, balls 10 100 1000)
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "../SnapshotCodec.h"
+
+const int STEPS = 600;
+const int HISTORY = 64;
+
+// Header (tick, score, rows) then id + x, y, vx, vy as floats per ball
+const size_t NAIVE_HEADER_BYTES = 4 + 4 * 4 + 2 * 4;
+const size_t NAIVE_BALL_BYTES = 4 + 4 * 4;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MicrosecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Lays out extra balls on a grid, clear of the soccer ball
+static void FillField(Match& match, int ballCount)
+{
+	SimRandom random(ballCount);
+	BallManager* manager = match.GetBallManager();
+	for (int row = 0; row < 28 && (int)manager->getBalls().size() <= ballCount; row++)
+	{
+		for (int column = 0; column < 50 && (int)manager->getBalls().size() <= ballCount; column++)
+		{
+			float x = -2.45f + column * 0.1f;
+			float y = -1.35f + row * 0.1f;
+			if (x * x + (y - 0.1f) * (y - 0.1f) < 0.35f * 0.35f)
+				continue;
+
+			float angle = random.NextFloat() * 6.2831853f;
+			manager->addBall(myVector(x, y, -0.65f), myVector(cosf(angle), sinf(angle), 0) * 0.5f, 1, 0.04f, false);
+		}
+	}
+}
+
+static bool SameSnapshot(const Snapshot& a, const Snapshot& b)
+{
+	if (a.tick != b.tick || a.p1Score != b.p1Score || a.p2Score != b.p2Score || a.p1Balls != b.p1Balls ||
+		a.p2Balls != b.p2Balls || a.p1Selection != b.p1Selection || a.p2Selection != b.p2Selection ||
+		a.balls.size() != b.balls.size())
+		return false;
+	for (size_t i = 0; i < a.balls.size(); i++)
+	{
+		const SnapshotBall& x = a.balls[i];
+		const SnapshotBall& y = b.balls[i];
+		if (x.id != y.id || x.soccer != y.soccer || x.x != y.x || x.y != y.y || x.vx != y.vx || x.vy != y.vy)
+			return false;
+	}
+	return true;
+}
+
+struct InFlight
+{
+	uint32_t arriveTick;
+	uint32_t tick;				// Of the snapshot, or of the ack
+	std::vector<uint8_t> packet;
+};
+
+static void Run(int ballCount, int lag, float lossPercent)
+{
+	Match match(1);
+	FillField(match, ballCount);
+	int startBalls = (int)match.GetBallManager()->getBalls().size() - 1;
+
+	SnapshotHistory serverHistory(HISTORY), clientHistory(HISTORY);
+	std::deque<InFlight> toClient, toServer;
+	SimRandom loss(ballCount * 7 + 1);
+	bool acked = false;
+	uint32_t ackedTick = 0;
+
+	uint64_t bytes = 0, naiveBytes = 0;
+	size_t largest = 0;
+	int sent = 0, received = 0, decodeFailures = 0, mismatches = 0, fullSnapshots = 0;
+	double encodeUs = 0, decodeUs = 0, maxError = 0;
+	std::vector<uint8_t> packet;
+	Snapshot decoded;
+
+	for (uint32_t tick = 1; tick <= STEPS; tick++)
+	{
+		match.Step(MatchInput());
+
+		// Server: capture and encode against the newest acked snapshot
+		Snapshot& current = serverHistory.Add(tick);
+		CaptureSnapshot(match, tick, current);
+		const Snapshot* baseline = acked ? serverHistory.Find(ackedTick) : 0;
+		if (!baseline)
+			fullSnapshots++;
+
+		Clock::time_point start = Clock::now();
+		EncodeSnapshot(0, current, baseline, packet);
+		encodeUs += MicrosecondsSince(start);
+
+		sent++;
+		bytes += packet.size();
+		naiveBytes += NAIVE_HEADER_BYTES + NAIVE_BALL_BYTES * current.balls.size();
+		if (packet.size() > largest)
+			largest = packet.size();
+
+		// How far quantizing moved each ball
+		std::vector<Ball>& balls = match.GetBallManager()->getBalls();
+		for (size_t i = 0; i < balls.size(); i++)
+		{
+			double dx = fabs(SnapshotToX(current.balls[i].x) - balls[i].getPosition().x);
+			double dy = fabs(SnapshotToY(current.balls[i].y) - balls[i].getPosition().y);
+			if (dx > maxError) maxError = dx;
+			if (dy > maxError) maxError = dy;
+		}
+
+		if (loss.NextFloat() * 100.0f >= lossPercent)
+		{
+			InFlight flight;
+			flight.arriveTick = tick + lag;
+			flight.tick = tick;
+			flight.packet = packet;
+			toClient.push_back(flight);
+		}
+
+		// Client: decode whatever arrived and ack it
+		while (!toClient.empty() && toClient.front().arriveTick <= tick)
+		{
+			InFlight& flight = toClient.front();
+			received++;
+			start = Clock::now();
+			bool ok = DecodeSnapshot(&flight.packet[0], flight.packet.size(), clientHistory, decoded);
+			decodeUs += MicrosecondsSince(start);
+			if (!ok)
+				decodeFailures++;
+			else
+			{
+				if (!SameSnapshot(decoded, *serverHistory.Find(flight.tick)))
+					mismatches++;
+				clientHistory.Add(decoded.tick) = decoded;
+
+				if (loss.NextFloat() * 100.0f >= lossPercent)
+				{
+					InFlight ack;
+					ack.arriveTick = tick + lag;
+					ack.tick = decoded.tick;
+					toServer.push_back(ack);
+				}
+			}
+			toClient.pop_front();
+		}
+
+		// Server: take in acks
+		while (!toServer.empty() && toServer.front().arriveTick <= tick)
+		{
+			if (!acked || toServer.front().tick > ackedTick)
+				ackedTick = toServer.front().tick;
+			acked = true;
+			toServer.pop_front();
+		}
+	}
+
+	int endBalls = (int)match.GetBallManager()->getBalls().size() - 1;
+	printf("%d balls (%d after %d ticks), lag %d ticks, %.0f%% loss:\n", startBalls, endBalls, STEPS, lag, lossPercent);
+	printf("  delta     %8.1f bytes/tick, largest %zu (%d full snapshots)\n", (double)bytes / sent, largest, fullSnapshots);
+	printf("  naive     %8.1f bytes/tick (%.1fx larger)\n", (double)naiveBytes / sent, (double)naiveBytes / bytes);
+	printf("  accuracy  %8.5f units worst position error\n", maxError);
+	printf("  encode    %8.2f us, decode %.2f us\n", encodeUs / sent, received ? decodeUs / received : 0.0);
+	printf("  %d of %d received, %d failed to decode, %d decoded differently%s\n", received, sent, decodeFailures, mismatches,
+		decodeFailures == 0 && mismatches == 0 ? "" : " - BROKEN");
+}
+
+int main(int argc, char** argv)
+{
+	int lag = 6;
+	float lossPercent = 0;
+	std::vector<int> counts;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--lag") == 0 && i + 1 < argc)
+			lag = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc)
+			lossPercent = (float)atof(argv[++i]);
+		else
+			counts.push_back(atoi(argv[i]));
+	}
+	if (counts.empty())
+	{
+		counts.push_back(10);
+		counts.push_back(100);
+		counts.push_back(1000);
+	}
+
+	for (int count : counts)
+		Run(count, lag < 0 ? 0 : lag, lossPercent);
+	return 0;
+}
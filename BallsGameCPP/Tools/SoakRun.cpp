@@ -0,0 +1,171 @@
+// --------------------------------------------------------
+// SoakRun - the game's match loop driven by InputSources, with
+// nobody at the controls and no window
+//
+// Runs frames on a made-up clock the way Game::Update does -
+// BeginFrame, then a step at MATCH_TIMESTEP for each slice of
+// the frame's time, each taking its buttons from the source -
+// with frame times wandering between 2 and 50 ms.  Bots play
+// match after match (BotInputSource), each recorded as the game
+// records it; every recording is then played back through a
+// ReplayInputSource under different frame times, and has to
+// hit every recorded state and end with the same winner.
+//
+// Reports matches, steps and how fast the loop gets through
+// them.  Nothing sleeps, so the figures are the simulation's
+// and the sources' cost alone.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 SoakRun.cpp ../InputSource.cpp ../InputQueue.cpp ../SelfPlay.cpp ../JobPool.cpp ../Match.cpp ../Replay.cpp ../MappedFile.cpp -pthread -o soakrun
+//
+// Usage:
+//   soakrun [matches] [row/fire row/fire] [--seed N]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../InputSource.h"
+
+// Matches still going after this long are given up on, as SelfPlay does
+const uint32_t MAX_MATCH_STEPS = (uint32_t)(300 / MATCH_TIMESTEP);
+
+// As Game's
+const int MAX_STEPS_PER_FRAME = 30;
+
+struct RunStats
+{
+	uint32_t frames;
+	uint64_t steps;
+	uint64_t presses;
+};
+
+// One match from start to winner, as Game::Update plays it
+static int PlayMatch(Match& match, InputSource& input, uint64_t frameSeed, ReplayWriter* writer, RunStats& stats)
+{
+	uint64_t seed;
+	if (!input.GetSeed(seed))
+		seed = frameSeed;
+	match.Reset(seed);
+	if (writer)
+		writer->Begin(seed);
+	input.Clear();
+
+	SimRandom frameTimes(frameSeed);
+	std::vector<InputEvent> presses;
+	int64_t frameNs = 0;
+	float accumulator = 0;
+
+	while (match.GetWinner() == 0 && match.GetStepCount() < MAX_MATCH_STEPS && !input.IsFinished())
+	{
+		float deltaTime = 0.002f + frameTimes.NextFloat() * 0.048f;
+		frameNs += (int64_t)(deltaTime * 1e9);
+		accumulator += deltaTime;
+		stats.frames++;
+
+		input.BeginFrame(frameNs);
+		int steps = 0;
+		while (accumulator >= MATCH_TIMESTEP && match.GetWinner() == 0)
+		{
+			int64_t stepEndNs = frameNs - (int64_t)((accumulator - MATCH_TIMESTEP) * 1e9);
+			presses.clear();
+			MatchInput stepInput;
+			stepInput.buttons = input.TakeStep(match, stepEndNs, &presses);
+			match.Step(stepInput);
+			if (writer)
+				writer->Record(stepInput, match.Hash());
+			input.EndStep(match);
+
+			stats.steps++;
+			stats.presses += presses.size();
+			accumulator -= MATCH_TIMESTEP;
+			if (++steps == MAX_STEPS_PER_FRAME)
+			{
+				accumulator = 0;
+				break;
+			}
+		}
+	}
+	return match.GetWinner();
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t matches = 200;
+	BotPolicy policies[2];
+	ParseBotPolicy("lead/lined-up", policies[0]);
+	ParseBotPolicy("track/volley", policies[1]);
+	uint64_t seed = 1;
+
+	int policy = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], 0, 10);
+		else if (strchr(argv[i], '/') && policy < 2)
+		{
+			if (!ParseBotPolicy(argv[i], policies[policy++]))
+			{
+				fprintf(stderr, "Unknown bot %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else
+			matches = (uint32_t)atoi(argv[i]);
+	}
+
+	Match match(0);
+	BotInputSource bots(&policies[0], &policies[1], seed);
+	ReplayWriter writer;
+	std::vector<uint8_t> recording;
+	RunStats played = {};
+	RunStats replayed = {};
+	double playSeconds = 0;
+	double replaySeconds = 0;
+	uint32_t wins[3] = {};
+	uint32_t diverged = 0;
+
+	for (uint32_t i = 0; i < matches; i++)
+	{
+		uint64_t matchSeed = seed * 0x9E3779B97F4A7C15ULL + i;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		int winner = PlayMatch(match, bots, matchSeed, &writer, played);
+		playSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		wins[winner]++;
+
+		// Back through the game loop, framed differently
+		std::string error;
+		ReplayInputSource replay;
+		recording.clear();
+		writer.Serialize(recording);
+		if (!replay.Parse(recording.data(), recording.size(), &error))
+		{
+			fprintf(stderr, "Match %u: recording doesn't parse: %s\n", i, error.c_str());
+			return 1;
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+		int replayWinner = PlayMatch(match, replay, ~matchSeed, 0, replayed);
+		replaySeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (replay.GetDivergedStep() >= 0 || replayWinner != winner || replay.GetStepsPlayed() != writer.GetStepCount())
+		{
+			printf("Match %u: %s, winner %d then %d\n", i, replay.GetSummary().c_str(), winner, replayWinner);
+			diverged++;
+		}
+	}
+
+	printf("%s\n", bots.GetSummary().c_str());
+	printf("Played:   %u matches (p1 %u, p2 %u, unfinished %u), %llu steps in %u frames, %llu presses, %.0f steps/s\n",
+		matches, wins[1], wins[2], wins[0], (unsigned long long)played.steps, played.frames,
+		(unsigned long long)played.presses, played.steps / (playSeconds > 0 ? playSeconds : 1e-9));
+	printf("Replayed: %llu steps in %u frames, %.0f steps/s, %u of %u matches diverged\n",
+		(unsigned long long)replayed.steps, replayed.frames,
+		replayed.steps / (replaySeconds > 0 ? replaySeconds : 1e-9), diverged, matches);
+	return diverged == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// --------------------------------------------------------
+// SoundBench - the voice pool and sound player against a
+// null audio sink
+//
+// First the pool alone, on a made-up clock: a few seconds of
+// 5 ms audio passes with up to 600 collisions arriving in one
+// pass now and then, bounces, and a goal every couple of
+// seconds.  After every pass it checks no more voices play than
+// there are, no kind goes over its cap, a goal always gets a
+// voice, and every sound is accounted for exactly once (played,
+// merged, stolen or dropped).  Reports how long a pass takes.
+//
+// Then the whole path: bot matches log their sounds step by
+// step, the main thread pushes them into a SoundPlayer, and its
+// audio thread runs the pool into a NullAudioSink.  Reports how
+// long a push takes on the simulation's side.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread SoundBench.cpp ../SoundPlayer.cpp ../Profiler.cpp ../FrameStats.cpp ../SelfPlay.cpp ../JobPool.cpp ../Match.cpp -o soundbench
+//
+// Usage:
+//   soundbench [matches]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "../SoundPlayer.h"
+#include "../FrameStats.h"
+#include "../SelfPlay.h"
+
+const double PASS_SECONDS = 0.005;
+
+static bool CheckPool(VoicePool& pool, NullAudioSink& sink)
+{
+	SimRandom random(3);
+	std::vector<SoundEvent> sounds;
+	TimeHistogram passTime;
+	TimeHistogram bigPassTime;
+	uint64_t goals = 0;
+	bool ok = true;
+
+	for (int pass = 0; pass < 4000; pass++)
+	{
+		double now = pass * PASS_SECONDS;
+		sounds.clear();
+
+		// Mostly quiet, then a pile-up all over the field
+		int collisions = pass % 97 == 0 ? 600 : (int)(random.Next() % 4);
+		for (int i = 0; i < collisions; i++)
+		{
+			SoundEvent sound;
+			sound.kind = SOUND_COLLISION;
+			sound.x = random.NextSigned() * FIELD_X_BOUND;
+			sound.y = random.NextSigned() * FIELD_Y_BOUND;
+			sound.strength = random.NextFloat();
+			sounds.push_back(sound);
+		}
+		if (random.Next() % 8 == 0)
+		{
+			SoundEvent sound;
+			sound.kind = SOUND_WALL;
+			sound.x = random.NextSigned() * FIELD_X_BOUND;
+			sound.y = FIELD_Y_BOUND;
+			sound.strength = random.NextFloat();
+			sounds.push_back(sound);
+		}
+		bool goal = pass % 400 == 399;
+		if (goal)
+		{
+			SoundEvent sound;
+			sound.kind = SOUND_GOAL;
+			sound.x = FIELD_X_BOUND;
+			sound.y = 0;
+			sound.strength = 1;
+			sounds.push_back(sound);
+			goals++;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		pool.Play(sounds.data(), sounds.size(), now, sink);
+		uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+		(collisions >= 600 ? bigPassTime : passTime).Record(ns);
+
+		if (pool.GetPlayingCount(now) > VOICE_COUNT || pool.GetPlayingCount(now, SOUND_COLLISION) > 10 ||
+			pool.GetPlayingCount(now, SOUND_WALL) > 4 || pool.GetPlayingCount(now, SOUND_GOAL) > 2)
+		{
+			printf("Pass %d: too many voices\n", pass);
+			ok = false;
+		}
+		if (goal && pool.GetPlayingCount(now, SOUND_GOAL) == 0)
+		{
+			printf("Pass %d: a goal went unheard\n", pass);
+			ok = false;
+		}
+	}
+
+	const VoiceStats& stats = pool.GetStats();
+	if (stats.played + stats.merged + stats.stolen + stats.dropped != stats.sounds || sink.starts != stats.played + stats.stolen)
+	{
+		printf("Sounds don't add up\n");
+		ok = false;
+	}
+
+	printf("Pool: %s - %llu sounds (%llu goals): %llu played, %llu merged, %llu stolen, %llu dropped, at most %u voices\n",
+		ok ? "ok" : "FAILED", (unsigned long long)stats.sounds, (unsigned long long)goals,
+		(unsigned long long)stats.played, (unsigned long long)stats.merged, (unsigned long long)stats.stolen,
+		(unsigned long long)stats.dropped, stats.maxPlaying);
+	printf("Pool: pass p50 %.2f us, max %.2f us; 600-collision pass p50 %.2f us, max %.2f us\n",
+		passTime.GetPercentile(0.5) / 1e3, passTime.GetMax() / 1e3,
+		bigPassTime.GetPercentile(0.5) / 1e3, bigPassTime.GetMax() / 1e3);
+	return ok;
+}
+
+// Bot matches with their sounds going out as Game sends them
+static bool RunMatches(uint32_t matches)
+{
+	SoundPlayer player(new NullAudioSink());
+	std::string error;
+	if (!player.Start(&error))
+	{
+		printf("Player: %s\n", error.c_str());
+		return false;
+	}
+
+	BotPolicy a;
+	BotPolicy b;
+	ParseBotPolicy("lead/asap", a);
+	ParseBotPolicy("track/asap", b);
+
+	std::vector<SoundEvent> stepSounds;
+	TimeHistogram pushTime;
+	uint64_t pushed = 0;
+	uint64_t steps = 0;
+	for (uint32_t m = 0; m < matches; m++)
+	{
+		Match match(m + 1);
+		match.SetSoundLog(&stepSounds);
+		MatchBot p1(1, a, m * 2 + 1);
+		MatchBot p2(2, b, m * 2 + 2);
+
+		// A frame's worth of steps, then its sounds
+		while (match.GetWinner() == 0 && match.GetStepCount() < 120 * 300)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				MatchInput input;
+				input.buttons = p1.Think(match) | (p2.Think(match) << 3);
+				match.Step(input);
+				steps++;
+			}
+
+			for (size_t i = 0; i < stepSounds.size(); i++)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				player.Push(stepSounds[i]);
+				pushTime.Record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count());
+			}
+			pushed += stepSounds.size();
+			stepSounds.clear();
+
+			// Paced so the audio thread sees frames, not one burst
+			if (steps % 240 == 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	player.Stop();
+	VoiceStats stats = player.GetStats();
+	bool ok = stats.sounds + player.GetQueueDropped() == pushed;
+
+	printf("Player: %s - %u matches, %llu steps, %llu sounds pushed (%u queue full), %llu played, %llu merged, %llu stolen, %llu dropped\n",
+		ok ? "ok" : "LOST SOUNDS", matches, (unsigned long long)steps, (unsigned long long)pushed, player.GetQueueDropped(),
+		(unsigned long long)stats.played, (unsigned long long)stats.merged, (unsigned long long)stats.stolen, (unsigned long long)stats.dropped);
+	printf("Player: push p50 %.0f ns, p99 %.0f ns, max %.2f us\n",
+		(double)pushTime.GetPercentile(0.5), (double)pushTime.GetPercentile(0.99), pushTime.GetMax() / 1e3);
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t matches = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+
+	VoicePool* pool = new VoicePool();
+	NullAudioSink sink;
+	bool ok = CheckPool(*pool, sink);
+	delete pool;
+
+	ok = RunMatches(matches) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// --------------------------------------------------------
+// Spectator - watches one match on a BallServer from a terminal
+//
+// Connects as a SpectatorClient, builds a view 60 times a second
+// the way the game would, and once a second prints what arrived:
+// snapshots, bytes per snapshot, how many were full rather than
+// deltas, decode failures, and how often the view had to
+// extrapolate past the newest snapshot or jump to catch up.
+// --draw also prints the field as text each second.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 Spectator.cpp ../SpectatorClient.cpp ../SnapshotCodec.cpp ../Match.cpp ../UdpSocket.cpp -o spectator
+//
+// Usage:
+//   spectator --server localhost:7100 [--match N] [--seconds N] [--draw]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "../SpectatorClient.h"
+
+typedef std::chrono::steady_clock Clock;
+
+const double VIEW_PERIOD_MS = 1000.0 / 60.0;
+const int DRAW_COLUMNS = 56;
+const int DRAW_ROWS = 16;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void Draw(const SpectatorView& view)
+{
+	char field[DRAW_ROWS][DRAW_COLUMNS + 1];
+	for (int row = 0; row < DRAW_ROWS; row++)
+	{
+		memset(field[row], '.', DRAW_COLUMNS);
+		field[row][DRAW_COLUMNS] = 0;
+	}
+
+	for (const SpectatorBall& ball : view.balls)
+	{
+		int column = (int)((ball.x + FIELD_X_BOUND) / (2 * FIELD_X_BOUND) * DRAW_COLUMNS);
+		int row = (int)((FIELD_Y_BOUND - ball.y) / (2 * FIELD_Y_BOUND) * DRAW_ROWS);
+		if (column < 0 || column >= DRAW_COLUMNS || row < 0 || row >= DRAW_ROWS)
+			continue;
+		field[row][column] = ball.soccer ? 'O' : 'o';
+	}
+
+	printf("  %d - %d   balls %d / %d\n", view.p1Score, view.p2Score, view.p1Balls, view.p2Balls);
+	for (int row = 0; row < DRAW_ROWS; row++)
+		printf("  %s\n", field[row]);
+}
+
+int main(int argc, char** argv)
+{
+	NetAddress server;
+	bool haveServer = false, draw = false;
+	int matchId = 0;
+	double seconds = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--draw") == 0) draw = true;
+		else if (i + 1 >= argc) break;
+		else if (strcmp(argv[i], "--server") == 0) haveServer = NetAddress::Parse(argv[++i], server);
+		else if (strcmp(argv[i], "--match") == 0) matchId = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seconds") == 0) seconds = atof(argv[++i]);
+	}
+
+	if (!haveServer || matchId < 0 || matchId > 65535)
+	{
+		printf("Usage: spectator --server host:port [--match N] [--seconds N] [--draw]\n");
+		return 1;
+	}
+
+	SpectatorClient client;
+	if (!client.Connect(server, (uint16_t)matchId))
+	{
+		printf("Couldn't open a UDP socket\n");
+		return 1;
+	}
+
+	SpectatorView view;
+	SpectatorStats last = client.GetStats();
+	Clock::time_point start = Clock::now();
+	double nextViewMs = 0, nextReportMs = 1000.0;
+	while (true)
+	{
+		double nowMs = MillisecondsSince(start);
+		if (nowMs >= seconds * 1000.0)
+			break;
+		if (nowMs < nextViewMs)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds((long long)((nextViewMs - nowMs) * 1000.0)));
+			continue;
+		}
+		nextViewMs += VIEW_PERIOD_MS;
+
+		client.Update(nowMs);
+		bool haveView = client.GetView(nowMs, view);
+
+		if (nowMs >= nextReportMs)
+		{
+			nextReportMs += 1000.0;
+			const SpectatorStats& stats = client.GetStats();
+			uint32_t snapshots = stats.snapshotsReceived - last.snapshotsReceived;
+			uint64_t bytes = stats.bytesReceived - last.bytesReceived;
+			printf("tick %u: %u snapshots, %.0f bytes each, %u failed, %u/%u views extrapolated, %u resyncs, %d balls\n",
+				client.GetNewestTick(), snapshots, snapshots ? (double)bytes / snapshots : 0.0,
+				stats.decodeFailures - last.decodeFailures,
+				stats.extrapolatedViews - last.extrapolatedViews,
+				(stats.interpolatedViews + stats.extrapolatedViews) - (last.interpolatedViews + last.extrapolatedViews),
+				stats.resyncs - last.resyncs, haveView ? (int)view.balls.size() : 0);
+			if (draw && haveView)
+				Draw(view);
+			fflush(stdout);
+			last = stats;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,286 @@
+// --------------------------------------------------------
+// SpriteQueueBench - 100k sprites through SpriteBatch's way
+// and through SpriteQueue
+//
+// The old way is SpriteBatch's, minus the D3D: an 80 byte
+// SpriteInfo per sprite, std::sort over pointers to them, and
+// RenderSprite's one-sprite-at-a-time vertices (float4 colour,
+// 36 bytes a vertex) in batches of 2048.  The new way is
+// SpriteQueue: arrays, a radix sort on one thread and then on
+// a JobPool, and four sprites at a time with SSE.
+//
+// Sprites get one of a few textures and, in the depth modes, a
+// different depth each, so both ways must put them in the same
+// order.  It checks they do, that the SSE vertices match the
+// scalar ones and the old way's, and times sorting and vertex
+// generation for each.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread SpriteQueueBench.cpp ../SpriteQueue.cpp ../JobPool.cpp -o spritequeuebench
+//
+// Usage:
+//   spritequeuebench [sprites] [threads]
+// --------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../SpriteQueue.h"
+#include "../JobPool.h"
+#include "../SimRandom.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+const int TEXTURES = 8;
+const int REPEATS = 20;
+const float VIEWPORT_WIDTH = 1280;
+const float VIEWPORT_HEIGHT = 720;
+const size_t OLD_BATCH = 2048;
+
+// SpriteBatch's SpriteInfo, field for field
+struct alignas(16) OldSprite
+{
+	float source[4];
+	float destination[4];
+	float color[4];
+	float originRotationDepth[4];
+	const void* texture;
+	int flags;
+};
+
+struct OldVertex
+{
+	float position[3];
+	float color[4];
+	float uv[2];
+};
+
+static double MsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void SortOld(std::vector<OldSprite*>& sorted, SpriteSortMode mode)
+{
+	switch (mode)
+	{
+	case SPRITE_SORT_TEXTURE:
+		std::sort(sorted.begin(), sorted.end(), [](const OldSprite* a, const OldSprite* b) { return a->texture < b->texture; });
+		break;
+	case SPRITE_SORT_BACK_TO_FRONT:
+		std::sort(sorted.begin(), sorted.end(), [](const OldSprite* a, const OldSprite* b) { return a->originRotationDepth[3] > b->originRotationDepth[3]; });
+		break;
+	case SPRITE_SORT_FRONT_TO_BACK:
+		std::sort(sorted.begin(), sorted.end(), [](const OldSprite* a, const OldSprite* b) { return a->originRotationDepth[3] < b->originRotationDepth[3]; });
+		break;
+	default:
+		break;
+	}
+}
+
+// RenderSprite without the DirectXMath: origin and source in
+// texels, rotation through sin/cos whenever it isn't zero
+static void RenderOld(const OldSprite* sprite, OldVertex* vertices)
+{
+	static const float corners[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+	float rotation = sprite->originRotationDepth[2];
+	float s = 0, c = 1;
+	if (rotation != 0)
+	{
+		s = sinf(rotation);
+		c = cosf(rotation);
+	}
+	float originX = sprite->originRotationDepth[0] / sprite->source[2];
+	float originY = sprite->originRotationDepth[1] / sprite->source[3];
+
+	for (int i = 0; i < 4; i++)
+	{
+		float localX = (corners[i][0] - originX) * sprite->destination[2];
+		float localY = (corners[i][1] - originY) * sprite->destination[3];
+		float x = sprite->destination[0] + localX * c - localY * s;
+		float y = sprite->destination[1] + localX * s + localY * c;
+
+		// SpriteBatch's vertex shader maps pixels to clip space
+		vertices[i].position[0] = x * (2 / VIEWPORT_WIDTH) - 1;
+		vertices[i].position[1] = 1 - y * (2 / VIEWPORT_HEIGHT);
+		vertices[i].position[2] = sprite->originRotationDepth[3];
+		for (int j = 0; j < 4; j++)
+			vertices[i].color[j] = sprite->color[j];
+		vertices[i].uv[0] = sprite->source[0] + corners[i][0] * sprite->source[2];
+		vertices[i].uv[1] = sprite->source[1] + corners[i][1] * sprite->source[3];
+	}
+}
+
+// Sort, then vertices a batch at a time as End would
+static void DrawOld(const std::vector<OldSprite>& queue, std::vector<OldSprite*>& sorted, std::vector<OldVertex>& vertices,
+	SpriteSortMode mode, double& sortMs, double& verticesMs)
+{
+	Clock::time_point start = Clock::now();
+	for (size_t i = 0; i < queue.size(); i++)
+		sorted[i] = const_cast<OldSprite*>(&queue[i]);
+	SortOld(sorted, mode);
+	sortMs += MsSince(start);
+
+	start = Clock::now();
+	for (size_t first = 0; first < sorted.size(); first += OLD_BATCH)
+	{
+		size_t end = std::min(sorted.size(), first + OLD_BATCH);
+		for (size_t i = first; i < end; i++)
+			RenderOld(sorted[i], &vertices[(i - first) * 4]);
+	}
+	verticesMs += MsSince(start);
+}
+
+static uint32_t PackColor(const float* color)
+{
+	uint32_t packed = 0;
+	for (int i = 0; i < 4; i++)
+		packed |= (uint32_t)(color[i] * 255 + 0.5f) << (i * 8);
+	return packed;
+}
+
+int main(int argc, char** argv)
+{
+	size_t spriteCount = argc > 1 ? (size_t)atoi(argv[1]) : 100000;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	JobPool pool(threads);
+
+	// A shuffled particle field: every sprite its own depth
+	SimRandom random(7);
+	std::vector<OldSprite> oldQueue(spriteCount);
+	std::vector<float> depths(spriteCount);
+	for (size_t i = 0; i < spriteCount; i++)
+		depths[i] = (float)i / spriteCount;
+	for (size_t i = spriteCount; i > 1; i--)
+		std::swap(depths[i - 1], depths[random.Next() % i]);
+
+	static const char textures[TEXTURES] = { 0 };
+	for (size_t i = 0; i < spriteCount; i++)
+	{
+		OldSprite& sprite = oldQueue[i];
+		float size = 4 + 28 * random.NextFloat();
+		float u = (random.Next() % 8) / 8.0f;
+		float v = (random.Next() % 8) / 8.0f;
+		float source[4] = { u, v, 0.125f, 0.125f };
+		float destination[4] = { VIEWPORT_WIDTH * random.NextFloat(), VIEWPORT_HEIGHT * random.NextFloat(), size, size };
+		float color[4] = { random.NextFloat(), random.NextFloat(), random.NextFloat(), 1 };
+		float rotation = i % 4 == 0 ? 0 : 6.2831853f * random.NextFloat();
+		float origin[4] = { 0.0625f, 0.0625f, rotation, depths[i] };
+		std::copy(source, source + 4, sprite.source);
+		std::copy(destination, destination + 4, sprite.destination);
+		std::copy(color, color + 4, sprite.color);
+		std::copy(origin, origin + 4, sprite.originRotationDepth);
+		sprite.texture = &textures[random.Next() % TEXTURES];
+		sprite.flags = 0;
+	}
+
+	SpriteQueue queue;
+	std::vector<SpriteVertex> vertices(spriteCount * SPRITE_VERTICES), scalarVertices(spriteCount * SPRITE_VERTICES);
+	std::vector<OldSprite*> oldSorted(spriteCount);
+	std::vector<OldVertex> oldVertices(OLD_BATCH * 4), oldAllVertices(spriteCount * 4);
+
+	// SpriteBatch's origin is in texels of the source; here it's
+	// pixels on screen
+	SpriteSortMode modes[3] = { SPRITE_SORT_TEXTURE, SPRITE_SORT_BACK_TO_FRONT, SPRITE_SORT_FRONT_TO_BACK };
+	const char* modeNames[3] = { "Texture", "BackToFront", "FrontToBack" };
+	bool allOk = true;
+	printf("%zu sprites, %d textures, %d threads\n", spriteCount, TEXTURES, pool.GetThreadCount());
+
+	for (int m = 0; m < 3; m++)
+	{
+		SpriteSortMode mode = modes[m];
+		queue.Begin(mode);
+		for (size_t i = 0; i < spriteCount; i++)
+		{
+			const OldSprite& sprite = oldQueue[i];
+			const float* o = sprite.originRotationDepth;
+			queue.Add((uint16_t)((const char*)sprite.texture - textures),
+				sprite.destination[0], sprite.destination[1], sprite.destination[2], sprite.destination[3],
+				sprite.source[0], sprite.source[1], sprite.source[0] + sprite.source[2], sprite.source[1] + sprite.source[3],
+				PackColor(sprite.color), o[2], o[0] / sprite.source[2] * sprite.destination[2], o[1] / sprite.source[3] * sprite.destination[3], o[3]);
+		}
+
+		// Same order as std::sort, where std::sort's order is defined
+		queue.Sort(&pool);
+		for (size_t i = 0; i < spriteCount; i++)
+			oldSorted[i] = &oldQueue[i];
+		SortOld(oldSorted, mode);
+		bool sameOrder = true;
+		for (size_t i = 0; i < spriteCount && sameOrder; i++)
+		{
+			const OldSprite* mine = &oldQueue[queue.GetSorted(i)];
+			// std::sort isn't stable, so within a texture only
+			// the radix sort's order (as added) is checked
+			if (mode == SPRITE_SORT_TEXTURE)
+			{
+				bool sameTexture = i > 0 && mine->texture == oldQueue[queue.GetSorted(i - 1)].texture;
+				sameOrder = mine->texture == oldSorted[i]->texture && (!sameTexture || queue.GetSorted(i) > queue.GetSorted(i - 1));
+			}
+			else
+				sameOrder = mine == oldSorted[i];
+		}
+
+		// Same again on one thread
+		SpriteQueue single = queue;
+		single.Sort(0);
+		for (size_t i = 0; i < spriteCount && sameOrder; i++)
+			sameOrder = single.GetSorted(i) == queue.GetSorted(i);
+
+		// Same corners as the scalar code and as SpriteBatch
+		queue.GenerateVertices(&vertices[0], VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+		queue.GenerateVerticesScalar(&scalarVertices[0], VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+		for (size_t i = 0; i < spriteCount; i++)
+			RenderOld(&oldQueue[queue.GetSorted(i)], &oldAllVertices[i * 4]);
+		float worstScalar = 0, worstOld = 0;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const SpriteVertex& a = vertices[i];
+			const SpriteVertex& b = scalarVertices[i];
+			const OldVertex& o = oldAllVertices[i];
+			worstScalar = std::max(worstScalar, std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)));
+			worstScalar = std::max(worstScalar, std::max(std::fabs(a.u - b.u), std::fabs(a.v - b.v)));
+			if (a.color != b.color || a.z != b.z)
+				worstScalar = 1;
+			worstOld = std::max(worstOld, std::max(std::fabs(a.x - o.position[0]), std::fabs(a.y - o.position[1])));
+			worstOld = std::max(worstOld, std::max(std::fabs(a.u - o.uv[0]), std::fabs(a.v - o.uv[1])));
+		}
+
+		bool ok = sameOrder && worstScalar < 1e-6f && worstOld < 1e-4f;
+		allOk = allOk && ok;
+		printf("\n%s: order %s, SSE vs scalar %.1e, vs SpriteBatch %.1e, %zu batches - %s\n", modeNames[m],
+			sameOrder ? "same" : "DIFFERENT", worstScalar, worstOld, queue.GetBatches().size(), ok ? "ok" : "FAIL");
+
+		// Times, best of REPEATS
+		double oldSort = 1e30, oldVerts = 1e30, sort1 = 1e30, sortN = 1e30, scalar = 1e30, sse = 1e30;
+		int passes = 0;
+		for (int r = 0; r < REPEATS; r++)
+		{
+			double sortMs = 0, verticesMs = 0;
+			DrawOld(oldQueue, oldSorted, oldVertices, mode, sortMs, verticesMs);
+			oldSort = std::min(oldSort, sortMs);
+			oldVerts = std::min(oldVerts, verticesMs);
+
+			queue.Sort(0);
+			sort1 = std::min(sort1, queue.GetTimes().sortMs);
+			queue.Sort(&pool);
+			sortN = std::min(sortN, queue.GetTimes().sortMs);
+			passes = queue.GetTimes().sortPasses;
+
+			queue.GenerateVerticesScalar(&scalarVertices[0], VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+			scalar = std::min(scalar, queue.GetTimes().verticesMs);
+			queue.GenerateVertices(&vertices[0], VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+			sse = std::min(sse, queue.GetTimes().verticesMs);
+		}
+		printf("  SpriteBatch: sort %7.3f ms, vertices %7.3f ms, total %7.3f ms\n", oldSort, oldVerts, oldSort + oldVerts);
+		printf("  SpriteQueue: sort %7.3f ms (%d passes) on 1 thread, %7.3f ms on %d\n", sort1, passes, sortN, pool.GetThreadCount());
+		printf("               vertices %7.3f ms scalar, %7.3f ms SSE, total %7.3f ms (%.1fx)\n", scalar, sse, sortN + sse,
+			(oldSort + oldVerts) / (sortN + sse));
+	}
+
+	printf("\n%s\n", allOk ? "All ok" : "FAILED");
+	return allOk ? 0 : 1;
+}
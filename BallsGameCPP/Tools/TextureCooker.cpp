@@ -0,0 +1,765 @@
+// --------------------------------------------------------
+// TextureCooker - offline texture compression tool
+//
+// Converts the game's PNG/JPEG textures into DDS files with a
+// full mip chain, block compressed on the CPU:
+//  - BC1 for opaque color textures
+//  - BC3 for color textures with an alpha channel
+//  - BC5 for tangent space normal maps (X/Y only, Z is
+//    rebuilt in the pixel shader)
+//
+// The game loads the results through its mapped DDS loader, so
+// there is no JPEG/PNG decode at startup and the GPU copy is
+// 4-8x smaller than the RGBA8 texture WIC would create.
+//
+// Builds on Linux (or anywhere libpng/libjpeg exist):
+//   g++ -O2 -std=c++11 -pthread TextureCooker.cpp ../DDSParser.cpp ../MappedFile.cpp -lpng -ljpeg -o texcook
+//
+// Usage:
+//   texcook [--bc1|--bc3|--bc5|--normal] [--verify] input output.dds
+// --------------------------------------------------------
+
+#include <png.h>
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../DDSParser.h"
+#include "../MappedFile.h"
+
+enum CookFormat
+{
+	FORMAT_AUTO,
+	FORMAT_BC1,
+	FORMAT_BC3,
+	FORMAT_BC5
+};
+
+// --------------------------------------------------------
+// A single uncompressed RGBA8 image (one mip level)
+// --------------------------------------------------------
+struct Image
+{
+	int width;
+	int height;
+	std::vector<uint8_t> pixels; // width * height * 4
+
+	Image() : width(0), height(0) {}
+	Image(int w, int h) : width(w), height(h), pixels((size_t)w * h * 4) {}
+
+	// Clamped lookup, used for blocks that hang off the edge of small mips
+	const uint8_t* At(int x, int y) const
+	{
+		x = std::min(std::max(x, 0), width - 1);
+		y = std::min(std::max(y, 0), height - 1);
+		return &pixels[((size_t)y * width + x) * 4];
+	}
+};
+
+static bool EndsWith(const std::string& s, const char* suffix)
+{
+	size_t n = strlen(suffix);
+	if (s.size() < n) return false;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (tolower(s[s.size() - n + i]) != suffix[i])
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Decodes a PNG to RGBA8 (16 bit sources are reduced to 8 bit)
+// --------------------------------------------------------
+static bool LoadPNG(const char* file, Image& out)
+{
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&png, file))
+		return false;
+
+	png.format = PNG_FORMAT_RGBA;
+	out = Image(png.width, png.height);
+	if (!png_image_finish_read(&png, 0, &out.pixels[0], 0, 0))
+	{
+		png_image_free(&png);
+		return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Decodes a baseline JPEG to RGBA8 (alpha is always 255)
+// --------------------------------------------------------
+static bool LoadJPEG(const char* file, Image& out)
+{
+	FILE* f = fopen(file, "rb");
+	if (!f) return false;
+
+	jpeg_decompress_struct cinfo;
+	jpeg_error_mgr jerr;
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_decompress(&cinfo);
+	jpeg_stdio_src(&cinfo, f);
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_RGB;
+	jpeg_start_decompress(&cinfo);
+
+	out = Image(cinfo.output_width, cinfo.output_height);
+	std::vector<uint8_t> row(cinfo.output_width * 3);
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		uint8_t* rowPtr = &row[0];
+		int y = cinfo.output_scanline;
+		jpeg_read_scanlines(&cinfo, &rowPtr, 1);
+		for (int x = 0; x < out.width; x++)
+		{
+			uint8_t* p = &out.pixels[((size_t)y * out.width + x) * 4];
+			p[0] = row[x * 3 + 0];
+			p[1] = row[x * 3 + 1];
+			p[2] = row[x * 3 + 2];
+			p[3] = 255;
+		}
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	fclose(f);
+	return true;
+}
+
+// --------------------------------------------------------
+// Bilinear resample, used to snap the top level to a
+// multiple of 4 (D3D11 requires this for BC textures)
+// --------------------------------------------------------
+static Image Resample(const Image& src, int w, int h)
+{
+	Image dst(w, h);
+	float sx = (float)src.width / w;
+	float sy = (float)src.height / h;
+	for (int y = 0; y < h; y++)
+	{
+		float fy = (y + 0.5f) * sy - 0.5f;
+		int y0 = (int)std::floor(fy);
+		float ty = fy - y0;
+		for (int x = 0; x < w; x++)
+		{
+			float fx = (x + 0.5f) * sx - 0.5f;
+			int x0 = (int)std::floor(fx);
+			float tx = fx - x0;
+
+			const uint8_t* a = src.At(x0, y0);
+			const uint8_t* b = src.At(x0 + 1, y0);
+			const uint8_t* c = src.At(x0, y0 + 1);
+			const uint8_t* d = src.At(x0 + 1, y0 + 1);
+			uint8_t* o = &dst.pixels[((size_t)y * w + x) * 4];
+			for (int ch = 0; ch < 4; ch++)
+			{
+				float top = a[ch] + (b[ch] - a[ch]) * tx;
+				float bottom = c[ch] + (d[ch] - c[ch]) * tx;
+				o[ch] = (uint8_t)(top + (bottom - top) * ty + 0.5f);
+			}
+		}
+	}
+	return dst;
+}
+
+// --------------------------------------------------------
+// 2x2 box filter down to the next mip level.  Normal maps
+// are renormalized so the smaller mips don't get "flatter".
+// --------------------------------------------------------
+static Image Downsample(const Image& src, bool isNormalMap)
+{
+	Image dst(std::max(1, src.width / 2), std::max(1, src.height / 2));
+	for (int y = 0; y < dst.height; y++)
+	{
+		for (int x = 0; x < dst.width; x++)
+		{
+			const uint8_t* a = src.At(x * 2, y * 2);
+			const uint8_t* b = src.At(x * 2 + 1, y * 2);
+			const uint8_t* c = src.At(x * 2, y * 2 + 1);
+			const uint8_t* d = src.At(x * 2 + 1, y * 2 + 1);
+			uint8_t* o = &dst.pixels[((size_t)y * dst.width + x) * 4];
+
+			if (isNormalMap)
+			{
+				float n[3];
+				for (int ch = 0; ch < 3; ch++)
+					n[ch] = (a[ch] + b[ch] + c[ch] + d[ch]) / (4.0f * 127.5f) - 1.0f;
+				float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (len < 1e-6f) { n[0] = 0; n[1] = 0; n[2] = 1; len = 1; }
+				for (int ch = 0; ch < 3; ch++)
+					o[ch] = (uint8_t)std::min(255.0f, std::max(0.0f, (n[ch] / len + 1.0f) * 127.5f + 0.5f));
+				o[3] = 255;
+			}
+			else
+			{
+				for (int ch = 0; ch < 4; ch++)
+					o[ch] = (uint8_t)((a[ch] + b[ch] + c[ch] + d[ch] + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+#pragma region Block Compression
+
+// 5:6:5 helpers
+static uint16_t Pack565(const float c[3])
+{
+	int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t c, float out[3])
+{
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+}
+
+// Builds the 4 entry palette from two 565 endpoints (4 color mode)
+static void BuildPalette(uint16_t c0, uint16_t c1, float palette[4][3])
+{
+	Unpack565(c0, palette[0]);
+	Unpack565(c1, palette[1]);
+	for (int ch = 0; ch < 3; ch++)
+	{
+		palette[2][ch] = (2 * palette[0][ch] + palette[1][ch]) / 3.0f;
+		palette[3][ch] = (palette[0][ch] + 2 * palette[1][ch]) / 3.0f;
+	}
+}
+
+// Picks the closest palette entry for each pixel, returns the total squared error
+static float FitIndices(const float pixels[16][3], const float palette[4][3], uint32_t& indices)
+{
+	float error = 0;
+	indices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		float best = 1e30f;
+		uint32_t bestIndex = 0;
+		for (uint32_t p = 0; p < 4; p++)
+		{
+			float dr = pixels[i][0] - palette[p][0];
+			float dg = pixels[i][1] - palette[p][1];
+			float db = pixels[i][2] - palette[p][2];
+			float d = dr * dr + dg * dg + db * db;
+			if (d < best) { best = d; bestIndex = p; }
+		}
+		indices |= bestIndex << (i * 2);
+		error += best;
+	}
+	return error;
+}
+
+// --------------------------------------------------------
+// Encodes a 4x4 block of colors as BC1 (always 4 color mode).
+//
+// Endpoints come from the principal axis of the block's colors,
+// then one least-squares pass re-solves them for the chosen indices.
+// --------------------------------------------------------
+static void EncodeBC1(const float pixels[16][3], uint8_t out[8])
+{
+	// Mean color
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int ch = 0; ch < 3; ch++)
+			mean[ch] += pixels[i][ch] / 16.0f;
+
+	// Covariance
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float r = pixels[i][0] - mean[0];
+		float g = pixels[i][1] - mean[1];
+		float b = pixels[i][2] - mean[2];
+		cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+		cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+	}
+
+	// Power iteration for the principal axis
+	float axis[3] = { 1, 1, 1 };
+	for (int iter = 0; iter < 8; iter++)
+	{
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+		if (len < 1e-6f) break;
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
+	float axisLen = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	for (int ch = 0; ch < 3; ch++) axis[ch] /= axisLen;
+
+	// Project onto the axis to find the extents
+	float minT = 1e30f, maxT = -1e30f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	float e0[3], e1[3];
+	for (int ch = 0; ch < 3; ch++)
+	{
+		e0[ch] = mean[ch] + axis[ch] * maxT;
+		e1[ch] = mean[ch] + axis[ch] * minT;
+	}
+
+	uint16_t c0 = Pack565(e0);
+	uint16_t c1 = Pack565(e1);
+	float palette[4][3];
+	BuildPalette(c0, c1, palette);
+	uint32_t indices;
+	float error = FitIndices(pixels, palette, indices);
+
+	// Least squares refinement of the endpoints for the chosen indices
+	{
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0, bb = 0, ab = 0;
+		float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			float a = weights[(indices >> (i * 2)) & 3];
+			float b = 1.0f - a;
+			aa += a * a; bb += b * b; ab += a * b;
+			for (int ch = 0; ch < 3; ch++)
+			{
+				ax[ch] += a * pixels[i][ch];
+				bx[ch] += b * pixels[i][ch];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) > 1e-6f)
+		{
+			float r0[3], r1[3];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				r0[ch] = (ax[ch] * bb - bx[ch] * ab) / det;
+				r1[ch] = (bx[ch] * aa - ax[ch] * ab) / det;
+			}
+			uint16_t n0 = Pack565(r0);
+			uint16_t n1 = Pack565(r1);
+			float newPalette[4][3];
+			BuildPalette(n0, n1, newPalette);
+			uint32_t newIndices;
+			float newError = FitIndices(pixels, newPalette, newIndices);
+			if (newError < error)
+			{
+				c0 = n0; c1 = n1; indices = newIndices; error = newError;
+			}
+		}
+	}
+
+	// 4 color mode requires c0 > c1 - swap endpoints and remap indices if needed
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+		uint32_t remapped = 0;
+		static const uint32_t swapIndex[4] = { 1, 0, 3, 2 };
+		for (int i = 0; i < 16; i++)
+			remapped |= swapIndex[(indices >> (i * 2)) & 3] << (i * 2);
+		indices = remapped;
+	}
+	else if (c0 == c1)
+	{
+		// Solid block, every pixel uses c0
+		indices = 0;
+	}
+
+	out[0] = (uint8_t)(c0 & 0xFF); out[1] = (uint8_t)(c0 >> 8);
+	out[2] = (uint8_t)(c1 & 0xFF); out[3] = (uint8_t)(c1 >> 8);
+	out[4] = (uint8_t)(indices & 0xFF);
+	out[5] = (uint8_t)((indices >> 8) & 0xFF);
+	out[6] = (uint8_t)((indices >> 16) & 0xFF);
+	out[7] = (uint8_t)((indices >> 24) & 0xFF);
+}
+
+// --------------------------------------------------------
+// Encodes a 4x4 block of a single channel as BC4 (8 value mode),
+// which is also the alpha half of BC3 and each half of BC5
+// --------------------------------------------------------
+static void EncodeBC4(const uint8_t values[16], uint8_t out[8])
+{
+	uint8_t lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		lo = std::min(lo, values[i]);
+		hi = std::max(hi, values[i]);
+	}
+
+	out[0] = hi;
+	out[1] = lo;
+
+	uint64_t bits = 0;
+	if (hi != lo)
+	{
+		// Palette: 0 = hi, 1 = lo, 2..7 = interpolated from hi towards lo
+		float palette[8];
+		palette[0] = hi;
+		palette[1] = lo;
+		for (int p = 2; p < 8; p++)
+			palette[p] = ((8 - p) * hi + (p - 1) * lo) / 7.0f;
+
+		for (int i = 0; i < 16; i++)
+		{
+			float best = 1e30f;
+			uint64_t bestIndex = 0;
+			for (int p = 0; p < 8; p++)
+			{
+				float d = std::fabs(values[i] - palette[p]);
+				if (d < best) { best = d; bestIndex = p; }
+			}
+			bits |= bestIndex << (i * 3);
+		}
+	}
+
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = (uint8_t)((bits >> (b * 8)) & 0xFF);
+}
+
+#pragma endregion
+
+#pragma region Block Decompression
+
+static void DecodeBC1(const uint8_t in[8], uint8_t out[16][4])
+{
+	uint16_t c0 = (uint16_t)(in[0] | (in[1] << 8));
+	uint16_t c1 = (uint16_t)(in[2] | (in[3] << 8));
+	uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+	float palette[4][3];
+	BuildPalette(c0, c1, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		const float* c = palette[(indices >> (i * 2)) & 3];
+		out[i][0] = (uint8_t)(c[0] + 0.5f);
+		out[i][1] = (uint8_t)(c[1] + 0.5f);
+		out[i][2] = (uint8_t)(c[2] + 0.5f);
+		out[i][3] = 255;
+	}
+}
+
+static void DecodeBC4(const uint8_t in[8], uint8_t out[16][4], int channel)
+{
+	float palette[8];
+	palette[0] = in[0];
+	palette[1] = in[1];
+	for (int p = 2; p < 8; p++)
+		palette[p] = ((8 - p) * palette[0] + (p - 1) * palette[1]) / 7.0f;
+
+	uint64_t bits = 0;
+	for (int b = 0; b < 6; b++)
+		bits |= (uint64_t)in[2 + b] << (b * 8);
+	for (int i = 0; i < 16; i++)
+		out[i][channel] = (uint8_t)(palette[(bits >> (i * 3)) & 7] + 0.5f);
+}
+
+#pragma endregion
+
+// --------------------------------------------------------
+// Compresses one mip level.  Block rows are split across
+// all hardware threads since the encoder is pure ALU work.
+// --------------------------------------------------------
+static std::vector<uint8_t> CompressLevel(const Image& img, CookFormat format)
+{
+	int blocksX = std::max(1, (img.width + 3) / 4);
+	int blocksY = std::max(1, (img.height + 3) / 4);
+	size_t blockSize = (format == FORMAT_BC1) ? 8 : 16;
+	std::vector<uint8_t> out(blocksX * blocksY * blockSize);
+
+	auto compressRows = [&](int firstRow, int lastRow)
+	{
+		float colors[16][3];
+		uint8_t channel[16];
+		for (int by = firstRow; by < lastRow; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				uint8_t* dst = &out[(by * blocksX + bx) * blockSize];
+				const uint8_t* px[16];
+				for (int i = 0; i < 16; i++)
+					px[i] = img.At(bx * 4 + (i & 3), by * 4 + (i >> 2));
+
+				switch (format)
+				{
+				case FORMAT_BC1:
+				case FORMAT_BC3:
+					if (format == FORMAT_BC3)
+					{
+						for (int i = 0; i < 16; i++) channel[i] = px[i][3];
+						EncodeBC4(channel, dst);
+						dst += 8;
+					}
+					for (int i = 0; i < 16; i++)
+					{
+						colors[i][0] = px[i][0];
+						colors[i][1] = px[i][1];
+						colors[i][2] = px[i][2];
+					}
+					EncodeBC1(colors, dst);
+					break;
+
+				case FORMAT_BC5:
+				default:
+					for (int i = 0; i < 16; i++) channel[i] = px[i][0];
+					EncodeBC4(channel, dst);
+					for (int i = 0; i < 16; i++) channel[i] = px[i][1];
+					EncodeBC4(channel, dst + 8);
+					break;
+				}
+			}
+		}
+	};
+
+	int threadCount = (int)std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, blocksY);
+	std::vector<std::thread> threads;
+	int rowsPerThread = (blocksY + threadCount - 1) / threadCount;
+	for (int t = 0; t < threadCount; t++)
+	{
+		int first = t * rowsPerThread;
+		int last = std::min(blocksY, first + rowsPerThread);
+		if (first < last)
+			threads.push_back(std::thread(compressRows, first, last));
+	}
+	for (auto& t : threads)
+		t.join();
+
+	return out;
+}
+
+// --------------------------------------------------------
+// Decodes a compressed level and returns the PSNR against the source
+// --------------------------------------------------------
+static double MeasurePSNR(const Image& img, const std::vector<uint8_t>& blocks, CookFormat format)
+{
+	int blocksX = std::max(1, (img.width + 3) / 4);
+	size_t blockSize = (format == FORMAT_BC1) ? 8 : 16;
+	int channels = (format == FORMAT_BC5) ? 2 : (format == FORMAT_BC3 ? 4 : 3);
+
+	double sumSq = 0;
+	uint8_t decoded[16][4];
+	for (int y = 0; y < img.height; y += 4)
+	{
+		for (int x = 0; x < img.width; x += 4)
+		{
+			const uint8_t* src = &blocks[((y / 4) * blocksX + (x / 4)) * blockSize];
+			if (format == FORMAT_BC1) DecodeBC1(src, decoded);
+			else if (format == FORMAT_BC3) { DecodeBC1(src + 8, decoded); DecodeBC4(src, decoded, 3); }
+			else { DecodeBC4(src, decoded, 0); DecodeBC4(src + 8, decoded, 1); }
+
+			for (int i = 0; i < 16; i++)
+			{
+				int px = x + (i & 3), py = y + (i >> 2);
+				if (px >= img.width || py >= img.height) continue;
+				const uint8_t* s = img.At(px, py);
+				for (int ch = 0; ch < channels; ch++)
+				{
+					double d = (double)s[ch] - decoded[i][ch];
+					sumSq += d * d;
+				}
+			}
+		}
+	}
+
+	double mse = sumSq / ((double)img.width * img.height * channels);
+	if (mse <= 0) return 99.0;
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+// --------------------------------------------------------
+// Writes the mip chain as a DX10-style DDS file
+// --------------------------------------------------------
+static bool WriteDDS(const char* file, int width, int height, CookFormat format, bool hasAlpha, const std::vector<std::vector<uint8_t>>& levels)
+{
+	FILE* f = fopen(file, "wb");
+	if (!f) return false;
+
+	DDSHeader header;
+	memset(&header, 0, sizeof(header));
+	header.size = sizeof(DDSHeader);
+	header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_LINEARSIZE;
+	header.height = height;
+	header.width = width;
+	header.pitchOrLinearSize = (uint32_t)levels[0].size();
+	header.mipMapCount = (uint32_t)levels.size();
+	header.ddspf.size = sizeof(DDSPixelFormat);
+	header.ddspf.flags = DDS_FOURCC;
+	header.ddspf.fourCC = DDS_MAKEFOURCC('D', 'X', '1', '0');
+	header.caps = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
+
+	DDSHeaderDXT10 dx10;
+	memset(&dx10, 0, sizeof(dx10));
+	dx10.dxgiFormat = (format == FORMAT_BC1) ? DDS_FORMAT_BC1_UNORM : (format == FORMAT_BC3 ? DDS_FORMAT_BC3_UNORM : DDS_FORMAT_BC5_UNORM);
+	dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	dx10.arraySize = 1;
+	dx10.miscFlags2 = (format == FORMAT_BC5) ? 0 : (hasAlpha ? 1 : 3); // DDS_ALPHA_MODE_STRAIGHT / OPAQUE
+
+	uint32_t magic = DDS_MAGIC;
+	fwrite(&magic, sizeof(magic), 1, f);
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(&dx10, sizeof(dx10), 1, f);
+	for (auto& level : levels)
+		fwrite(&level[0], 1, level.size(), f);
+
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+// --------------------------------------------------------
+// Maps the written file and runs it through the same parser
+// the game uses, so a bad header is caught here and not at
+// load time
+// --------------------------------------------------------
+static bool ValidateDDS(const char* file, size_t expectedMips, std::string& error)
+{
+	MappedFile mapped;
+	if (!mapped.Open(file))
+	{
+		error = "Could not map file";
+		return false;
+	}
+
+	DDSTextureInfo info;
+	std::vector<DDSSurface> surfaces;
+	if (!DDSParseHeader(mapped.GetData(), mapped.GetSize(), info, &error) ||
+		!DDSGetSurfaces(info, mapped.GetData(), mapped.GetSize(), surfaces, &error))
+		return false;
+
+	if (info.mipCount != expectedMips)
+	{
+		error = "Mip count mismatch";
+		return false;
+	}
+	return true;
+}
+
+static double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	CookFormat format = FORMAT_AUTO;
+	bool isNormalMap = false;
+	bool verify = false;
+	const char* input = 0;
+	const char* output = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--bc1") format = FORMAT_BC1;
+		else if (arg == "--bc3") format = FORMAT_BC3;
+		else if (arg == "--bc5") format = FORMAT_BC5;
+		else if (arg == "--normal") { format = FORMAT_BC5; isNormalMap = true; }
+		else if (arg == "--verify") verify = true;
+		else if (!input) input = argv[i];
+		else if (!output) output = argv[i];
+	}
+
+	if (!input || !output)
+	{
+		printf("Usage: texcook [--bc1|--bc3|--bc5|--normal] [--verify] input.(png|jpg) output.dds\n");
+		return 1;
+	}
+
+	// Decode
+	auto start = std::chrono::high_resolution_clock::now();
+	Image source;
+	std::string inputName = input;
+	bool loaded = false;
+	if (EndsWith(inputName, ".png"))
+		loaded = LoadPNG(input, source);
+	else if (EndsWith(inputName, ".jpg") || EndsWith(inputName, ".jpeg"))
+		loaded = LoadJPEG(input, source);
+
+	if (!loaded)
+	{
+		printf("Failed to load %s\n", input);
+		return 1;
+	}
+	double decodeMs = MillisecondsSince(start);
+
+	bool hasAlpha = false;
+	for (size_t i = 3; i < source.pixels.size(); i += 4)
+	{
+		if (source.pixels[i] != 255) { hasAlpha = true; break; }
+	}
+	if (format == FORMAT_AUTO)
+		format = hasAlpha ? FORMAT_BC3 : FORMAT_BC1;
+
+	// BC textures need a top level that's a multiple of 4
+	int topWidth = std::max(4, source.width & ~3);
+	int topHeight = std::max(4, source.height & ~3);
+	if (topWidth != source.width || topHeight != source.height)
+	{
+		printf("Resizing %dx%d -> %dx%d for block alignment\n", source.width, source.height, topWidth, topHeight);
+		source = Resample(source, topWidth, topHeight);
+	}
+
+	// Mip chain
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<Image> mips;
+	mips.push_back(source);
+	while (mips.back().width > 1 || mips.back().height > 1)
+		mips.push_back(Downsample(mips.back(), isNormalMap));
+	double mipMs = MillisecondsSince(start);
+
+	// Compress
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<std::vector<uint8_t>> levels;
+	size_t cookedBytes = 0, rawBytes = 0;
+	for (auto& mip : mips)
+	{
+		levels.push_back(CompressLevel(mip, format));
+		cookedBytes += levels.back().size();
+		rawBytes += mip.pixels.size();
+	}
+	double compressMs = MillisecondsSince(start);
+
+	if (!WriteDDS(output, topWidth, topHeight, format, hasAlpha, levels))
+	{
+		printf("Failed to write %s\n", output);
+		return 1;
+	}
+
+	static const char* formatNames[] = { "auto", "BC1", "BC3", "BC5" };
+	printf("%s -> %s\n", input, output);
+	printf("  %dx%d, %d mips, %s\n", topWidth, topHeight, (int)mips.size(), formatNames[format]);
+	printf("  RGBA8 %.1f KB -> %.1f KB (%.1fx smaller)\n", rawBytes / 1024.0, cookedBytes / 1024.0, (double)rawBytes / cookedBytes);
+	printf("  decode %.1f ms, mips %.1f ms, compress %.1f ms (%.1f MPix/s)\n",
+		decodeMs, mipMs, compressMs, (rawBytes / 4) / (compressMs * 1000.0));
+
+	if (verify)
+	{
+		std::string error;
+		if (!ValidateDDS(output, levels.size(), error))
+		{
+			printf("  %s failed validation: %s\n", output, error.c_str());
+			return 1;
+		}
+		printf("  header ok, top level PSNR %.2f dB\n", MeasurePSNR(mips[0], levels[0], format));
+	}
+
+	return 0;
+}
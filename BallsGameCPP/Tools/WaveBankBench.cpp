@@ -0,0 +1,515 @@
+// --------------------------------------------------------
+// WaveBankBench - the memory mapped wave bank reader against
+// wave banks written here
+//
+// Writes an in-memory bank with names, a streaming bank aligned
+// to 2048 byte sectors and a compact bank, holding 16 and 8 bit
+// PCM and MS-ADPCM, mono and stereo.  For each it checks every
+// entry reads back as written: its format, duration, loop and
+// name, that its wave data is a pointer into the mapping itself
+// and holds what was written, and that WaveBankStream decodes it
+// exactly.  Then it cuts the bank short at every length through
+// its headers and corrupts random header bytes, and every bank
+// that still opens has to play without reading outside itself
+// (build with -fsanitize=address to be sure of that).
+//
+// Then it times opening a 60 MB in-memory bank mapped against
+// reading its wave data into the heap, the way a loader that
+// copies would, both from a cold file cache.  Finally it streams
+// 32 voices from a cold streaming bank through the mixer and the
+// feeder thread, with and without the prefetcher, at twice real
+// time, and counts underruns.
+//
+// Builds on Linux:
+//   g++ -O2 -std=c++11 -pthread WaveBankBench.cpp ../WaveBank.cpp ../MappedFile.cpp ../SoftwareMixer.cpp ../AudioStream.cpp ../SoundPlayer.cpp ../FrameStats.cpp ../Profiler.cpp -o wavebankbench
+//
+// Usage:
+//   wavebankbench [seconds streamed]
+// --------------------------------------------------------
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../WaveBank.h"
+#include "../SoftwareMixer.h"
+#include "../SimRandom.h"
+
+const int ADPCM_BLOCK_PER_CHANNEL = 140;
+
+struct TestEntry
+{
+	std::string name;
+	int tag;
+	AudioFormat format;
+	bool sixteenBit;
+	int blockAlign;
+	uint32_t frames;
+	uint32_t loopStart;
+	uint32_t loopLength;
+	std::vector<int16_t> samples;	// What it should decode to
+	std::vector<uint8_t> data;		// As stored
+};
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// A tone with some noise on it, stored as asked
+static void MakeEntry(TestEntry& entry, const char* name, int tag, int sampleRate, int channels, bool sixteenBit, uint32_t frames, uint64_t seed)
+{
+	entry.name = name;
+	entry.tag = tag;
+	entry.format.sampleRate = sampleRate;
+	entry.format.channels = channels;
+	entry.sixteenBit = sixteenBit;
+	entry.loopStart = frames / 4;
+	entry.loopLength = frames / 2;
+
+	AdpcmFormat adpcm;
+	if (tag == WAVEBANK_FORMAT_ADPCM)
+	{
+		adpcm.channels = channels;
+		adpcm.blockAlign = ADPCM_BLOCK_PER_CHANNEL * channels;
+		adpcm.samplesPerBlock = GetAdpcmSamplesPerBlock(adpcm.blockAlign, channels);
+		SetDefaultAdpcmCoefficients(adpcm);
+		frames -= frames % adpcm.samplesPerBlock;
+		entry.blockAlign = adpcm.blockAlign;
+	}
+	else
+		entry.blockAlign = channels * (sixteenBit ? 2 : 1);
+	entry.frames = frames;
+
+	SimRandom random(seed);
+	std::vector<int16_t> source(frames * channels);
+	for (uint32_t i = 0; i < frames; i++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			double t = (double)i / sampleRate;
+			double tone = std::sin(2 * 3.14159265 * (220 + 110 * c + seed * 10) * t) * 0.6 + random.NextSigned() * 0.05;
+			source[i * channels + c] = (int16_t)(tone * 32767);
+		}
+	}
+
+	if (tag == WAVEBANK_FORMAT_ADPCM)
+	{
+		entry.data.resize(frames / adpcm.samplesPerBlock * adpcm.blockAlign);
+		entry.samples.resize(source.size());
+		for (uint32_t b = 0; b < frames / adpcm.samplesPerBlock; b++)
+		{
+			uint8_t* block = &entry.data[b * adpcm.blockAlign];
+			EncodeAdpcmBlock(&source[b * adpcm.samplesPerBlock * channels], adpcm, block);
+			DecodeAdpcmBlock(block, adpcm.blockAlign, adpcm, &entry.samples[b * adpcm.samplesPerBlock * channels]);
+		}
+	}
+	else if (sixteenBit)
+	{
+		entry.samples = source;
+		entry.data.resize(source.size() * 2);
+		memcpy(entry.data.data(), source.data(), entry.data.size());
+	}
+	else
+	{
+		entry.samples.resize(source.size());
+		entry.data.resize(source.size());
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			entry.data[i] = (uint8_t)((source[i] >> 8) + 128);
+			entry.samples[i] = (int16_t)((entry.data[i] - 128) * 256);
+		}
+	}
+}
+
+static void Put(std::vector<uint8_t>& out, size_t at, const void* value, size_t bytes)
+{
+	if (out.size() < at + bytes)
+		out.resize(at + bytes);
+	memcpy(&out[at], value, bytes);
+}
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Lays a bank out the way XACT does: header, bank data, entry
+// metadata, names, then each entry's wave data on an alignment
+// boundary.  A compact bank has to be all one format.
+static void BuildBank(std::vector<uint8_t>& out, const char* bankName, const std::vector<TestEntry>& entries,
+	bool streaming, bool compact, bool withNames, uint32_t alignment)
+{
+	out.clear();
+	WaveBankHeader header;
+	memset(&header, 0, sizeof(header));
+	header.signature = WAVEBANK_SIGNATURE;
+	header.version = WAVEBANK_CONTENT_VERSION;
+	header.headerVersion = WAVEBANK_HEADER_VERSION;
+
+	WaveBankData bank;
+	memset(&bank, 0, sizeof(bank));
+	bank.flags = (streaming ? WAVEBANK_TYPE_STREAMING : 0) | (compact ? WAVEBANK_FLAGS_COMPACT : 0) | (withNames ? WAVEBANK_FLAGS_ENTRYNAMES : 0);
+	bank.entryCount = (uint32_t)entries.size();
+	strncpy(bank.bankName, bankName, sizeof(bank.bankName) - 1);
+	bank.entryMetaDataElementSize = compact ? sizeof(WaveBankCompactEntry) : sizeof(WaveBankEntryData);
+	bank.entryNameElementSize = withNames ? WAVEBANK_ENTRYNAME_LENGTH : 0;
+	bank.alignment = alignment;
+	const TestEntry& first = entries[0];
+	bank.compactFormat = compact ? MakeWaveBankFormat(first.tag, first.format.channels, first.format.sampleRate, first.blockAlign, first.sixteenBit) : 0;
+
+	size_t at = sizeof(WaveBankHeader);
+	header.segments[WAVEBANK_SEGMENT_BANKDATA].offset = (uint32_t)at;
+	header.segments[WAVEBANK_SEGMENT_BANKDATA].length = sizeof(bank);
+	at += sizeof(bank);
+	header.segments[WAVEBANK_SEGMENT_ENTRYMETADATA].offset = (uint32_t)at;
+	header.segments[WAVEBANK_SEGMENT_ENTRYMETADATA].length = (uint32_t)(entries.size() * bank.entryMetaDataElementSize);
+	at += entries.size() * bank.entryMetaDataElementSize;
+	header.segments[WAVEBANK_SEGMENT_SEEKTABLES].offset = (uint32_t)at;
+	header.segments[WAVEBANK_SEGMENT_ENTRYNAMES].offset = (uint32_t)at;
+	if (withNames)
+	{
+		header.segments[WAVEBANK_SEGMENT_ENTRYNAMES].length = (uint32_t)(entries.size() * WAVEBANK_ENTRYNAME_LENGTH);
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			char name[WAVEBANK_ENTRYNAME_LENGTH] = {};
+			strncpy(name, entries[i].name.c_str(), sizeof(name) - 1);
+			Put(out, at + i * WAVEBANK_ENTRYNAME_LENGTH, name, sizeof(name));
+		}
+		at += entries.size() * WAVEBANK_ENTRYNAME_LENGTH;
+	}
+
+	size_t waveStart = AlignUp(at, alignment);
+	size_t waveAt = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const TestEntry& entry = entries[i];
+		size_t metaAt = header.segments[WAVEBANK_SEGMENT_ENTRYMETADATA].offset + i * bank.entryMetaDataElementSize;
+		if (compact)
+		{
+			uint32_t deviation = (uint32_t)(AlignUp(entry.data.size(), alignment) - entry.data.size());
+			uint32_t value = (uint32_t)(waveAt / alignment) | (deviation << 21);
+			Put(out, metaAt, &value, sizeof(value));
+		}
+		else
+		{
+			WaveBankEntryData e;
+			e.flagsAndDuration = entry.frames << 4;
+			e.format = MakeWaveBankFormat(entry.tag, entry.format.channels, entry.format.sampleRate, entry.blockAlign, entry.sixteenBit);
+			e.playRegion.offset = (uint32_t)waveAt;
+			e.playRegion.length = (uint32_t)entry.data.size();
+			e.loopStart = entry.loopStart;
+			e.loopLength = entry.loopLength;
+			Put(out, metaAt, &e, sizeof(e));
+		}
+		Put(out, waveStart + waveAt, entry.data.data(), entry.data.size());
+		waveAt = AlignUp(waveAt + entry.data.size(), alignment);
+	}
+	out.resize(waveStart + waveAt);
+	header.segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA].offset = (uint32_t)waveStart;
+	header.segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA].length = (uint32_t)waveAt;
+
+	Put(out, 0, &header, sizeof(header));
+	Put(out, sizeof(header), &bank, sizeof(bank));
+}
+
+static bool SaveFile(const char* fileName, const std::vector<uint8_t>& bytes)
+{
+	FILE* file = fopen(fileName, "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	fclose(file);
+	return ok;
+}
+
+// Drops the file from the page cache, so the next read of it
+// goes to the disk
+static void Evict(const char* fileName)
+{
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0)
+		return;
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+// Decodes a whole entry through a stream, in odd sized reads
+static bool ReadEntry(const WaveBank& bank, uint32_t index, std::vector<int16_t>& samples, std::string* error)
+{
+	WaveBankStream stream;
+	if (!stream.Reset(bank, index, 0, error))
+		return false;
+	int channels = stream.GetFormat().channels;
+	std::vector<int16_t> chunk(777 * channels);
+	samples.clear();
+	size_t read;
+	while ((read = stream.Read(chunk.data(), 777)) > 0)
+		samples.insert(samples.end(), chunk.begin(), chunk.begin() + read * channels);
+	return true;
+}
+
+static bool CheckBank(const char* label, const char* fileName, const std::vector<TestEntry>& entries, bool streaming, bool compact, bool withNames)
+{
+	WaveBank bank;
+	std::string error;
+	if (!bank.Open(fileName, &error))
+	{
+		printf("%s: %s\n", label, error.c_str());
+		return false;
+	}
+
+	bool ok = bank.GetEntryCount() == entries.size() && bank.IsStreaming() == streaming && bank.GetName() == label;
+	for (uint32_t i = 0; i < bank.GetEntryCount() && ok; i++)
+	{
+		const TestEntry& expected = entries[i];
+		WaveBankEntry entry;
+		bank.GetEntry(i, entry);
+		ok = entry.tag == expected.tag && entry.format.channels == expected.format.channels &&
+			entry.format.sampleRate == expected.format.sampleRate && entry.blockAlign == expected.blockAlign &&
+			entry.frames == expected.frames;
+		if (!compact)
+			ok = ok && entry.loopStart == expected.loopStart && entry.loopLength == expected.loopLength;
+		if (withNames)
+			ok = ok && bank.GetEntryName(i) == expected.name && bank.FindEntry(expected.name.c_str()) == (int)i;
+
+		// Zero copy: the wave data is the mapping
+		size_t bytes;
+		const uint8_t* wave = bank.GetWaveData(i, bytes);
+		ok = ok && wave >= bank.GetData() && wave + bytes <= bank.GetData() + bank.GetSize() &&
+			bytes == expected.data.size() && memcmp(wave, expected.data.data(), bytes) == 0;
+
+		std::vector<int16_t> samples;
+		ok = ok && ReadEntry(bank, i, samples, &error) && samples == expected.samples;
+		if (!ok)
+			printf("%s: entry %u (%s) doesn't read back\n", label, i, expected.name.c_str());
+	}
+	ok = ok && (!withNames || bank.FindEntry("nothing") == -1);
+
+	printf("%s: %s - %u entries, %.1f KB, %s\n", label, ok ? "ok" : "FAILED", bank.GetEntryCount(), bank.GetSize() / 1024.0,
+		streaming ? "streaming" : "in memory");
+	return ok;
+}
+
+// Plays every entry of a bank that opened, whatever it holds
+static uint64_t PlayAll(const WaveBank& bank)
+{
+	uint64_t frames = 0;
+	std::vector<int16_t> samples;
+	for (uint32_t i = 0; i < bank.GetEntryCount(); i++)
+	{
+		if (ReadEntry(bank, i, samples, 0))
+			frames += samples.size();
+		bank.GetEntryName(i);
+	}
+	return frames;
+}
+
+static bool CheckCorruption(const std::vector<uint8_t>& good)
+{
+	WaveBank bank;
+	std::string error;
+	bool ok = true;
+
+	// The headers' own checks name what's wrong
+	std::vector<uint8_t> bytes = good;
+	bytes[0] = 'X';
+	ok = ok && !bank.Parse(bytes.data(), bytes.size(), &error) && error == "not a wave bank";
+	bytes = good;
+	std::swap(bytes[0], bytes[3]);
+	std::swap(bytes[1], bytes[2]);
+	ok = ok && !bank.Parse(bytes.data(), bytes.size(), &error) && error.find("big-endian") != std::string::npos;
+	bytes = good;
+	bytes[4] = 45;
+	ok = ok && !bank.Parse(bytes.data(), bytes.size(), &error) && error == "unsupported wave bank version";
+
+	// Cut short anywhere through the headers and the first entry
+	const WaveBankHeader* header = (const WaveBankHeader*)good.data();
+	size_t headerEnd = header->segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA].offset + 64;
+	uint32_t truncatedOpened = 0;
+	for (size_t length = 0; length < headerEnd; length++)
+	{
+		// A copy of just that much, so reading past it is caught
+		std::vector<uint8_t> cut(good.begin(), good.begin() + length);
+		if (bank.Parse(cut.data(), cut.size()))
+		{
+			truncatedOpened++;
+			PlayAll(bank);
+		}
+	}
+	ok = ok && truncatedOpened == 0;
+
+	// Random bytes in the headers; whatever opens has to play
+	SimRandom random(99);
+	uint32_t opened = 0;
+	const int trials = 5000;
+	for (int t = 0; t < trials; t++)
+	{
+		bytes = good;
+		int changes = 1 + random.Next() % 4;
+		for (int c = 0; c < changes; c++)
+			bytes[random.Next() % headerEnd] = (uint8_t)random.Next();
+		if (bank.Parse(bytes.data(), bytes.size()))
+		{
+			opened++;
+			PlayAll(bank);
+		}
+	}
+
+	printf("Corruption: %s - %u truncations all rejected, %d corrupted headers: %u still opened and played, %u rejected\n",
+		ok ? "ok" : "FAILED", (unsigned)headerEnd, trials, opened, trials - opened);
+	return ok;
+}
+
+// Mapped and paged in, against fread into a heap buffer, both cold
+static void TimeOpen(const char* fileName)
+{
+	Evict(fileName);
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	WaveBank bank;
+	if (!bank.Open(fileName))
+		return;
+	double mappedMs = Since(start);
+	size_t mappedBytes = bank.GetSize();
+	bank.Close();
+
+	Evict(fileName);
+	start = std::chrono::high_resolution_clock::now();
+	FILE* file = fopen(fileName, "rb");
+	if (!file)
+		return;
+	std::vector<uint8_t> copy(mappedBytes);
+	size_t got = fread(copy.data(), 1, copy.size(), file);
+	fclose(file);
+	WaveBank parsed;
+	parsed.Parse(copy.data(), got);
+	double copiedMs = Since(start);
+
+	printf("Open %.0f MB in-memory bank, cold: mapped %.1f ms (0 bytes copied), read into the heap %.1f ms (%.0f MB copied)\n",
+		mappedBytes / 1e6, mappedMs, copiedMs, got / 1e6);
+
+	// Warm, the mapping is just the checks and the page walk
+	start = std::chrono::high_resolution_clock::now();
+	bank.Open(fileName);
+	printf("Open %.0f MB in-memory bank, warm: mapped %.2f ms\n", mappedBytes / 1e6, Since(start));
+}
+
+static void TimeStreaming(const char* fileName, int voices, double seconds, bool usePrefetcher)
+{
+	Evict(fileName);
+	WaveBank bank;
+	std::string error;
+	if (!bank.Open(fileName, &error))
+	{
+		printf("%s\n", error.c_str());
+		return;
+	}
+
+	WaveBankPrefetcher prefetcher;
+	if (usePrefetcher)
+		prefetcher.Start();
+	std::vector<WaveBankStream> streams(voices);
+	SoftwareMixer mixer(voices);
+	mixer.StartFeeder();
+	SimRandom random(4);
+	for (int v = 0; v < voices; v++)
+	{
+		streams[v].Reset(bank, v % bank.GetEntryCount(), usePrefetcher ? &prefetcher : 0);
+		mixer.Play(v, &streams[v], 0.1f, random.NextSigned(), random.NextSigned() * 0.5f, true);
+	}
+
+	std::vector<float> left(MIX_BLOCK_FRAMES);
+	std::vector<float> right(MIX_BLOCK_FRAMES);
+	double blockMs = 1000.0 * MIX_BLOCK_FRAMES / MIXER_SAMPLE_RATE;
+	int blocks = (int)(seconds * MIXER_SAMPLE_RATE / MIX_BLOCK_FRAMES);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int b = 0; b < blocks; b++)
+	{
+		std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t)(b * blockMs * 500)));
+		mixer.MixBlock(left.data(), right.data());
+	}
+	mixer.StopFeeder();
+	prefetcher.Stop();
+
+	const MixerStats& stats = mixer.GetStats();
+	printf("Stream %d voices from a cold bank, %s: %llu underruns in %llu blocks, mix p99 %.3f ms, %llu requests paged in %llu pages\n",
+		voices, usePrefetcher ? "prefetched" : "no prefetcher", (unsigned long long)stats.underruns, (unsigned long long)stats.blocks,
+		stats.mixTime.GetPercentile(0.99) / 1e6, (unsigned long long)prefetcher.GetRequests(), (unsigned long long)prefetcher.GetPagesTouched());
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+
+	std::vector<TestEntry> mixed(6);
+	MakeEntry(mixed[0], "pcm16 mono", WAVEBANK_FORMAT_PCM, 22050, 1, true, 30000, 1);
+	MakeEntry(mixed[1], "pcm16 stereo", WAVEBANK_FORMAT_PCM, 48000, 2, true, 70001, 2);
+	MakeEntry(mixed[2], "pcm8 mono", WAVEBANK_FORMAT_PCM, 11025, 1, false, 9999, 3);
+	MakeEntry(mixed[3], "adpcm mono", WAVEBANK_FORMAT_ADPCM, 22050, 1, true, 40000, 4);
+	MakeEntry(mixed[4], "adpcm stereo", WAVEBANK_FORMAT_ADPCM, 44100, 2, true, 90000, 5);
+	MakeEntry(mixed[5], "pcm8 stereo", WAVEBANK_FORMAT_PCM, 8000, 2, false, 5000, 6);
+
+	std::vector<TestEntry> same(5);
+	for (int i = 0; i < 5; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "adpcm %d", i);
+		MakeEntry(same[i], name, WAVEBANK_FORMAT_ADPCM, 22050, 1, true, 5000 + i * 3000, 10 + i);
+	}
+
+	std::vector<uint8_t> inMemory;
+	std::vector<uint8_t> streaming;
+	std::vector<uint8_t> compact;
+	BuildBank(inMemory, "in memory", mixed, false, false, true, 4);
+	BuildBank(streaming, "streaming", mixed, true, false, true, 2048);
+	BuildBank(compact, "compact", same, false, true, false, 4);
+
+	bool ok = SaveFile("wavebank_memory.xwb", inMemory) && SaveFile("wavebank_streaming.xwb", streaming) &&
+		SaveFile("wavebank_compact.xwb", compact);
+	if (!ok)
+	{
+		printf("Could not write the test banks\n");
+		return 1;
+	}
+	ok = CheckBank("in memory", "wavebank_memory.xwb", mixed, false, false, true) && ok;
+	ok = CheckBank("streaming", "wavebank_streaming.xwb", mixed, true, false, true) && ok;
+	ok = CheckBank("compact", "wavebank_compact.xwb", same, false, true, false) && ok;
+	ok = CheckCorruption(inMemory) && ok;
+	ok = CheckCorruption(compact) && ok;
+
+	// Big banks for timing: a minute of stereo 48k in 64 entries
+	std::vector<TestEntry> big(64);
+	for (int i = 0; i < 64; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "music %d", i);
+		MakeEntry(big[i], name, WAVEBANK_FORMAT_PCM, 48000, 2, true, 48000 * 5, 20 + i);
+	}
+	std::vector<uint8_t> bytes;
+	BuildBank(bytes, "big", big, false, false, true, 4);
+	ok = SaveFile("wavebank_big.xwb", bytes) && ok;
+	BuildBank(bytes, "big streaming", big, true, false, true, 2048);
+	ok = SaveFile("wavebank_big_streaming.xwb", bytes) && ok;
+	bytes.clear();
+	big.clear();
+
+	TimeOpen("wavebank_big.xwb");
+	TimeStreaming("wavebank_big_streaming.xwb", 32, seconds, false);
+	TimeStreaming("wavebank_big_streaming.xwb", 32, seconds, true);
+
+	remove("wavebank_memory.xwb");
+	remove("wavebank_streaming.xwb");
+	remove("wavebank_compact.xwb");
+	remove("wavebank_big.xwb");
+	remove("wavebank_big_streaming.xwb");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Cooks the textures the game loads into Assets/Textures/Cooked/*.dds
+# Run from the BallsGameCPP directory:  sh Tools/cook_textures.sh
+set -e
+
+g++ -O2 -std=c++11 -pthread Tools/TextureCooker.cpp DDSParser.cpp MappedFile.cpp -lpng -ljpeg -o Tools/texcook
+
+SRC=Assets/Textures
+OUT=Assets/Textures/Cooked
+mkdir -p $OUT
+
+# Color textures - BC1, or BC3 when the source has alpha.  Not
+# ballmaterial.png: the game asks for ballmaterial.jpg, which has
+# never existed, and a cooked copy would give the ball a texture
+# it's never had.
+for tex in grass.png p1Win.png p2Win.png soccer.png mainmenu.png wood.jpg \
+           blueTexture.jpg redTexture.jpg cloud.png; do
+	Tools/texcook --verify $SRC/$tex $OUT/${tex%.*}.dds
+done
+
+# Normal maps - BC5
+Tools/texcook --normal --verify $SRC/grassNormal.png $OUT/grassNormal.dds
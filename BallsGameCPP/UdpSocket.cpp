@@ -0,0 +1,197 @@
+#include "UdpSocket.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef int socklen_t;
+static const uintptr_t NO_SOCKET = (uintptr_t)INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+static const int NO_SOCKET = -1;
+#endif
+
+bool NetAddress::Parse(const char* text, NetAddress& address)
+{
+	unsigned int a, b, c, d, port;
+	char extra;
+	if (sscanf(text, "%u.%u.%u.%u:%u%c", &a, &b, &c, &d, &port, &extra) == 5)
+	{
+		if (a > 255 || b > 255 || c > 255 || d > 255 || port == 0 || port > 65535)
+			return false;
+		address.ip = (a << 24) | (b << 16) | (c << 8) | d;
+		address.port = (uint16_t)port;
+		return true;
+	}
+	if (sscanf(text, "localhost:%u%c", &port, &extra) == 1)
+	{
+		if (port == 0 || port > 65535)
+			return false;
+		address.ip = 0x7F000001;
+		address.port = (uint16_t)port;
+		return true;
+	}
+	return false;
+}
+
+// --------------------------------------------------------
+// Socket
+// --------------------------------------------------------
+UdpSocket::UdpSocket()
+{
+	handle = NO_SOCKET;
+}
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+bool UdpSocket::Open(uint16_t port)
+{
+	Close();
+
+#ifdef _WIN32
+	// Winsock counts these, so one per socket is fine
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return false;
+#endif
+
+	handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (handle == NO_SOCKET)
+	{
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	bool ready = bind(handle, (sockaddr*)&address, sizeof(address)) == 0 &&
+		ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+	bool ready = bind(handle, (sockaddr*)&address, sizeof(address)) == 0 &&
+		fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+	if (!ready)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void UdpSocket::Close()
+{
+	if (handle == NO_SOCKET)
+		return;
+
+#ifdef _WIN32
+	closesocket(handle);
+	WSACleanup();
+#else
+	close(handle);
+#endif
+	handle = NO_SOCKET;
+}
+
+bool UdpSocket::IsOpen() const
+{
+	return handle != NO_SOCKET;
+}
+
+bool UdpSocket::Send(const NetAddress& to, const void* data, size_t size)
+{
+	if (handle == NO_SOCKET)
+		return false;
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(to.ip);
+	address.sin_port = htons(to.port);
+
+	int sent = sendto(handle, (const char*)data, (int)size, 0, (sockaddr*)&address, sizeof(address));
+	return sent == (int)size;
+}
+
+size_t UdpSocket::Receive(void* buffer, size_t bufferSize, NetAddress& from)
+{
+	if (handle == NO_SOCKET)
+		return 0;
+
+	sockaddr_in address;
+	socklen_t addressSize = sizeof(address);
+	int received = recvfrom(handle, (char*)buffer, (int)bufferSize, 0, (sockaddr*)&address, &addressSize);
+	if (received <= 0)
+		return 0;
+
+	from.ip = ntohl(address.sin_addr.s_addr);
+	from.port = ntohs(address.sin_port);
+	return (size_t)received;
+}
+
+// --------------------------------------------------------
+// Conditioner
+// --------------------------------------------------------
+LinkConditioner::LinkConditioner(UdpSocket* socket, uint64_t seed)
+	: random(seed)
+{
+	this->socket = socket;
+	dropped = 0;
+}
+
+void LinkConditioner::Send(const NetAddress& to, const void* data, size_t size, double nowMs)
+{
+	if (conditions.latencyMs <= 0 && conditions.jitterMs <= 0 && conditions.lossPercent <= 0)
+	{
+		socket->Send(to, data, size);
+		return;
+	}
+
+	if (random.NextFloat() * 100.0f < conditions.lossPercent)
+	{
+		dropped++;
+		return;
+	}
+
+	Packet packet;
+	if (size > sizeof(packet.data))
+		return;
+	packet.sendAtMs = nowMs + conditions.latencyMs + random.NextFloat() * conditions.jitterMs;
+	packet.to = to;
+	packet.size = size;
+	memcpy(packet.data, data, size);
+	queue.push_back(packet);
+
+	Flush(nowMs);
+}
+
+void LinkConditioner::Flush(double nowMs)
+{
+	// Jitter lets later packets overtake earlier ones, like the real thing
+	for (size_t i = 0; i < queue.size(); )
+	{
+		if (queue[i].sendAtMs <= nowMs)
+		{
+			socket->Send(queue[i].to, queue[i].data, queue[i].size);
+			queue.erase(queue.begin() + i);
+		}
+		else
+			i++;
+	}
+}
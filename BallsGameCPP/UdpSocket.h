@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include "SimRandom.h"
+
+// --------------------------------------------------------
+// IPv4 address and port, both in host byte order
+// --------------------------------------------------------
+struct NetAddress
+{
+	uint32_t ip;
+	uint16_t port;
+
+	NetAddress() : ip(0), port(0) {}
+	NetAddress(uint32_t ip, uint16_t port) : ip(ip), port(port) {}
+
+	// "a.b.c.d:port" or "localhost:port"
+	static bool Parse(const char* text, NetAddress& address);
+
+	bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+};
+
+// --------------------------------------------------------
+// A non-blocking UDP socket (Winsock on Windows, BSD sockets
+// everywhere else)
+// --------------------------------------------------------
+class UdpSocket
+{
+public:
+	UdpSocket();
+	~UdpSocket();
+
+	// Binds to port on all interfaces (0 picks any free port)
+	bool Open(uint16_t port);
+	void Close();
+	bool IsOpen() const;
+
+	bool Send(const NetAddress& to, const void* data, size_t size);
+
+	// Size of the packet read, or 0 if nothing is waiting
+	size_t Receive(void* buffer, size_t bufferSize, NetAddress& from);
+
+private:
+	// Not copyable - the socket has a single owner
+	UdpSocket(const UdpSocket&);
+	UdpSocket& operator=(const UdpSocket&);
+
+#ifdef _WIN32
+	uintptr_t handle;
+#else
+	int handle;
+#endif
+};
+
+// --------------------------------------------------------
+// Makes a good connection look like a bad one: holds outgoing
+// packets back by a latency plus random jitter and drops a
+// percentage of them outright.  Everything a session sends goes
+// through here, so testing two processes on one machine can
+// still exercise rollback.
+// --------------------------------------------------------
+struct LinkConditions
+{
+	float latencyMs;	// One way
+	float jitterMs;		// Added on top, uniformly 0..jitterMs
+	float lossPercent;
+
+	LinkConditions() : latencyMs(0), jitterMs(0), lossPercent(0) {}
+};
+
+class LinkConditioner
+{
+public:
+	LinkConditioner(UdpSocket* socket, uint64_t seed);
+
+	void SetConditions(const LinkConditions& conditions) { this->conditions = conditions; }
+	const LinkConditions& GetConditions() const { return conditions; }
+
+	// nowMs is any steadily increasing clock
+	void Send(const NetAddress& to, const void* data, size_t size, double nowMs);
+
+	// Sends whatever has waited long enough
+	void Flush(double nowMs);
+
+	uint32_t GetDroppedCount() const { return dropped; }
+
+private:
+	struct Packet
+	{
+		double sendAtMs;
+		NetAddress to;
+		size_t size;
+		uint8_t data[512];
+	};
+
+	UdpSocket* socket;
+	LinkConditions conditions;
+	SimRandom random;
+	std::deque<Packet> queue;
+	uint32_t dropped;
+};
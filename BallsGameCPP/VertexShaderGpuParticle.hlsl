@@ -0,0 +1,39 @@
+#include "ParticleCommon.hlsli"
+
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+	float size;
+	float lifetime;
+};
+
+// What the compute shaders left alive this step
+StructuredBuffer<Particle> Particles	: register(t0);
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float fade			: FADE;
+};
+
+// --------------------------------------------------------
+// Four vertices per instance and no vertex buffers: the
+// instance picks the particle, the vertex picks the corner,
+// and the quad faces the camera as in VertexShaderParticle
+// --------------------------------------------------------
+VertexToPixel main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+	Particle p = Particles[instanceId];
+	float2 corner = float2((vertexId & 1) ? 0.5f : -0.5f, (vertexId & 2) ? -0.5f : 0.5f);
+
+	VertexToPixel output;
+	float4 viewPosition = mul(float4(p.position, 1.0f), view);
+	viewPosition.xy += corner * size;
+	output.position = mul(viewPosition, projection);
+
+	output.uv = float2(corner.x + 0.5f, 0.5f - corner.y);
+	output.fade = saturate(p.life / lifetime);
+	return output;
+}
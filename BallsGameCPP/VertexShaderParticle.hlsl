@@ -0,0 +1,40 @@
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// Slot 0 is the quad's corners, slot 1 one entry per particle
+// (see ParticleRenderer.h)
+struct VertexShaderInput
+{
+	float2 corner		: CORNER;
+	float3 position		: POSITION_PER_INSTANCE;
+	float size			: SIZE_PER_INSTANCE;
+	float fade			: FADE_PER_INSTANCE;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+	float fade			: FADE;
+};
+
+// --------------------------------------------------------
+// Expands a particle into one corner of a quad facing the
+// camera: the corner is added in view space, where the
+// camera looks straight down z
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	float4 viewPosition = mul(float4(input.position, 1.0f), view);
+	viewPosition.xy += input.corner * input.size;
+	output.position = mul(viewPosition, projection);
+
+	output.uv = float2(input.corner.x + 0.5f, 0.5f - input.corner.y);
+	output.fade = input.fade;
+	return output;
+}
@@ -0,0 +1,30 @@
+struct VertexShaderInput
+{
+	float3 position		: POSITION;		// Already in clip space
+	uint color			: COLOR;		// RGBA8, red in the low byte
+	float2 uv			: TEXCOORD;
+};
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float4 color		: COLOR;
+	float2 uv			: TEXCOORD;
+};
+
+// --------------------------------------------------------
+// Sprites from SpriteRenderer; SpriteQueue has done all the
+// placing already, so this only unpacks the colour
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+	output.position = float4(input.position, 1.0f);
+	output.color = float4(
+		input.color & 0xFF,
+		(input.color >> 8) & 0xFF,
+		(input.color >> 16) & 0xFF,
+		input.color >> 24) / 255.0f;
+	output.uv = input.uv;
+	return output;
+}
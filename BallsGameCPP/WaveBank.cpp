@@ -0,0 +1,453 @@
+#include "WaveBank.h"
+#include "ErrorMessage.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Big-endian banks were written for the Xbox 360
+const uint32_t WAVEBANK_SIGNATURE_SWAPPED = 0x57424E44;
+
+// What ADPCM's stored per channel block align is short of the real one
+const int ADPCM_BLOCKALIGN_OFFSET = 22;
+
+// How the mapping is paged in
+const size_t PAGE_BYTES = 4096;
+
+// A streaming entry asks for this much at a time, and keeps two
+// of them asked for ahead of where it's reading
+const size_t PREFETCH_BYTES = 64 * 1024;
+
+const size_t PREFETCH_QUEUE_CAPACITY = 256;
+
+uint32_t MakeWaveBankFormat(int tag, int channels, int sampleRate, int blockAlign, bool sixteenBit)
+{
+	uint32_t stored = (uint32_t)(tag == WAVEBANK_FORMAT_ADPCM ? blockAlign / channels - ADPCM_BLOCKALIGN_OFFSET : blockAlign);
+	return (uint32_t)(tag & 0x3) | ((uint32_t)(channels & 0x7) << 2) | ((uint32_t)(sampleRate & 0x3FFFF) << 5) |
+		((stored & 0xFF) << 23) | ((sixteenBit ? 1u : 0u) << 31);
+}
+
+static void UnpackFormat(uint32_t format, WaveBankEntry& entry)
+{
+	entry.tag = (int)(format & 0x3);
+	entry.format.channels = (int)((format >> 2) & 0x7);
+	entry.format.sampleRate = (int)((format >> 5) & 0x3FFFF);
+	int stored = (int)((format >> 23) & 0xFF);
+	entry.blockAlign = entry.tag == WAVEBANK_FORMAT_ADPCM ? (stored + ADPCM_BLOCKALIGN_OFFSET) * entry.format.channels : stored;
+	entry.sixteenBit = (format >> 31) != 0;
+}
+
+WaveBank::WaveBank()
+{
+	Close();
+}
+
+void WaveBank::Close()
+{
+	file.Close();
+	data = 0;
+	size = 0;
+	header = 0;
+	bank = 0;
+	entries = 0;
+	names = 0;
+	entryCount = 0;
+	entrySize = 0;
+	streaming = false;
+	compact = false;
+}
+
+bool WaveBank::Open(const char* fileName, std::string* error)
+{
+	Close();
+	if (!file.Open(fileName))
+		return Fail(error, std::string("could not map ") + fileName);
+
+	std::string parseError;
+	if (!Parse(file.GetData(), file.GetSize(), &parseError))
+	{
+		Close();
+		return Fail(error, std::string(fileName) + ": " + parseError);
+	}
+
+	// In memory means in memory: fault it all in now, not mid-mix
+	if (!streaming)
+	{
+		PROFILE_SCOPE("WaveBank::Open page in");
+		const WaveBankRegion& wave = header->segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA];
+		TouchPages(data + wave.offset, wave.length);
+	}
+	return true;
+}
+
+// Every region has to lie in the bank and every entry in the
+// wave data, so nothing read later needs checking again
+bool WaveBank::Parse(const uint8_t* bankData, size_t bankSize, std::string* error)
+{
+	header = 0;
+	bank = 0;
+	entries = 0;
+	names = 0;
+	entryCount = 0;
+
+	if (bankSize < sizeof(WaveBankHeader))
+		return Fail(error, "too small to be a wave bank");
+	const WaveBankHeader* h = (const WaveBankHeader*)bankData;
+	if (h->signature == WAVEBANK_SIGNATURE_SWAPPED)
+		return Fail(error, "big-endian (Xbox 360) wave banks aren't supported");
+	if (h->signature != WAVEBANK_SIGNATURE)
+		return Fail(error, "not a wave bank");
+	if (h->version != WAVEBANK_CONTENT_VERSION || h->headerVersion != WAVEBANK_HEADER_VERSION)
+		return Fail(error, "unsupported wave bank version");
+
+	for (int s = 0; s < WAVEBANK_SEGMENT_COUNT; s++)
+	{
+		if ((uint64_t)h->segments[s].offset + h->segments[s].length > bankSize)
+			return Fail(error, "a segment runs past the end of the file");
+	}
+
+	const WaveBankRegion& bankRegion = h->segments[WAVEBANK_SEGMENT_BANKDATA];
+	if (bankRegion.length < sizeof(WaveBankData))
+		return Fail(error, "bank data is truncated");
+	const WaveBankData* b = (const WaveBankData*)(bankData + bankRegion.offset);
+
+	bool isCompact = (b->flags & WAVEBANK_FLAGS_COMPACT) != 0;
+	uint32_t elementSize = b->entryMetaDataElementSize;
+	if (isCompact ? elementSize != sizeof(WaveBankCompactEntry) : elementSize < sizeof(WaveBankEntryData))
+		return Fail(error, "entry metadata size is wrong");
+	if (isCompact && b->alignment == 0)
+		return Fail(error, "compact bank has no alignment");
+
+	const WaveBankRegion& metaRegion = h->segments[WAVEBANK_SEGMENT_ENTRYMETADATA];
+	if ((uint64_t)b->entryCount * elementSize > metaRegion.length)
+		return Fail(error, "entry metadata is truncated");
+
+	const char* entryNames = 0;
+	if (b->flags & WAVEBANK_FLAGS_ENTRYNAMES)
+	{
+		const WaveBankRegion& nameRegion = h->segments[WAVEBANK_SEGMENT_ENTRYNAMES];
+		if (b->entryNameElementSize != WAVEBANK_ENTRYNAME_LENGTH || (uint64_t)b->entryCount * WAVEBANK_ENTRYNAME_LENGTH > nameRegion.length)
+			return Fail(error, "entry names are truncated");
+		entryNames = (const char*)(bankData + nameRegion.offset);
+	}
+
+	data = bankData;
+	size = bankSize;
+	header = h;
+	bank = b;
+	entries = bankData + metaRegion.offset;
+	names = entryNames;
+	entryCount = b->entryCount;
+	entrySize = elementSize;
+	streaming = (b->flags & WAVEBANK_TYPE_MASK) == WAVEBANK_TYPE_STREAMING;
+	compact = isCompact;
+
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		std::string entryError;
+		if (!ValidateEntry(i, &entryError))
+		{
+			char message[64];
+			snprintf(message, sizeof(message), "entry %u: ", i);
+			header = 0;
+			bank = 0;
+			entries = 0;
+			names = 0;
+			entryCount = 0;
+			return Fail(error, message + entryError);
+		}
+	}
+	return true;
+}
+
+bool WaveBank::ValidateEntry(uint32_t index, std::string* error) const
+{
+	WaveBankEntry entry;
+	GetEntry(index, entry);
+	const WaveBankRegion& wave = header->segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA];
+
+	if (entry.format.channels < 1 || entry.format.sampleRate <= 0)
+		return Fail(error, "format is bad");
+	if (entry.offset < wave.offset || (uint64_t)entry.offset + entry.length > (uint64_t)wave.offset + wave.length)
+		return Fail(error, "wave data lies outside its segment");
+	if (entry.tag == WAVEBANK_FORMAT_PCM && entry.blockAlign != entry.format.channels * (entry.sixteenBit ? 2 : 1))
+		return Fail(error, "PCM block align doesn't match its channels");
+	if (entry.tag == WAVEBANK_FORMAT_ADPCM && GetAdpcmSamplesPerBlock(entry.blockAlign, entry.format.channels) < 2)
+		return Fail(error, "ADPCM blocks are too small");
+	return true;
+}
+
+std::string WaveBank::GetName() const
+{
+	if (!bank)
+		return std::string();
+	return std::string(bank->bankName, strnlen(bank->bankName, sizeof(bank->bankName)));
+}
+
+int WaveBank::FindEntry(const char* name) const
+{
+	if (!names)
+		return -1;
+	for (uint32_t i = 0; i < entryCount; i++)
+	{
+		if (strncmp(names + i * WAVEBANK_ENTRYNAME_LENGTH, name, WAVEBANK_ENTRYNAME_LENGTH) == 0)
+			return (int)i;
+	}
+	return -1;
+}
+
+std::string WaveBank::GetEntryName(uint32_t index) const
+{
+	if (!names || index >= entryCount)
+		return std::string();
+	const char* name = names + index * WAVEBANK_ENTRYNAME_LENGTH;
+	return std::string(name, strnlen(name, WAVEBANK_ENTRYNAME_LENGTH));
+}
+
+void WaveBank::GetEntry(uint32_t index, WaveBankEntry& entry) const
+{
+	const WaveBankRegion& wave = header->segments[WAVEBANK_SEGMENT_ENTRYWAVEDATA];
+	if (!compact)
+	{
+		const WaveBankEntryData* e = (const WaveBankEntryData*)(entries + (size_t)index * entrySize);
+		UnpackFormat(e->format, entry);
+		entry.frames = e->flagsAndDuration >> 4;
+		entry.loopStart = e->loopStart;
+		entry.loopLength = e->loopLength;
+		entry.offset = (uint32_t)std::min<uint64_t>((uint64_t)wave.offset + e->playRegion.offset, 0xFFFFFFFFu);
+		entry.length = e->playRegion.length;
+		return;
+	}
+
+	// Compact entries are an offset in alignment units and how far
+	// short of the next entry this one ends; duration and format
+	// come from those and the bank
+	const WaveBankCompactEntry* e = (const WaveBankCompactEntry*)entries;
+	uint64_t start = (uint64_t)(e[index].value & 0x1FFFFF) * bank->alignment;
+	uint64_t end = index + 1 < entryCount ? (uint64_t)(e[index + 1].value & 0x1FFFFF) * bank->alignment : wave.length;
+	uint32_t deviation = e[index].value >> 21;
+	uint64_t length = end >= start + deviation ? end - start - deviation : 0;
+
+	UnpackFormat(bank->compactFormat, entry);
+	entry.loopStart = 0;
+	entry.loopLength = 0;
+	entry.offset = (uint32_t)std::min<uint64_t>(wave.offset + start, 0xFFFFFFFFu);
+	entry.length = (uint32_t)std::min<uint64_t>(length, 0xFFFFFFFFu);
+	entry.frames = 0;
+	if (entry.tag == WAVEBANK_FORMAT_PCM && entry.blockAlign > 0)
+		entry.frames = entry.length / entry.blockAlign;
+	else if (entry.tag == WAVEBANK_FORMAT_ADPCM && entry.blockAlign > 7 * entry.format.channels)
+	{
+		uint32_t blocks = entry.length / entry.blockAlign;
+		uint32_t partial = entry.length % entry.blockAlign;
+		entry.frames = blocks * GetAdpcmSamplesPerBlock(entry.blockAlign, entry.format.channels);
+		if (partial > (uint32_t)(7 * entry.format.channels))
+			entry.frames += (partial - 7 * entry.format.channels) * 2 / entry.format.channels + 2;
+	}
+}
+
+const uint8_t* WaveBank::GetWaveData(uint32_t index, size_t& bytes) const
+{
+	WaveBankEntry entry;
+	GetEntry(index, entry);
+	bytes = entry.length;
+	return data + entry.offset;
+}
+
+size_t TouchPages(const uint8_t* start, size_t bytes)
+{
+	if (bytes == 0)
+		return 0;
+
+	// Volatile so the reads happen; what they read doesn't matter
+	const volatile uint8_t* page = (const volatile uint8_t*)((uintptr_t)start & ~(uintptr_t)(PAGE_BYTES - 1));
+	const volatile uint8_t* first = start;
+	const uint8_t* end = start + bytes;
+	size_t pages = 0;
+	uint8_t sum = *first;
+	for (; (const uint8_t*)page < end; page += PAGE_BYTES)
+	{
+		sum += *std::max(page, first);
+		pages++;
+	}
+	(void)sum;
+	return pages;
+}
+
+WaveBankPrefetcher::WaveBankPrefetcher() : stopping(false), pagesTouched(0), requests(0)
+{
+	queue.reserve(PREFETCH_QUEUE_CAPACITY);
+}
+
+WaveBankPrefetcher::~WaveBankPrefetcher()
+{
+	Stop();
+}
+
+void WaveBankPrefetcher::Start()
+{
+	if (thread.joinable())
+		return;
+	stopping = false;
+	thread = std::thread(&WaveBankPrefetcher::Run, this);
+}
+
+void WaveBankPrefetcher::Stop()
+{
+	if (!thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> hold(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+	queue.clear();
+}
+
+bool WaveBankPrefetcher::Request(const uint8_t* start, size_t bytes)
+{
+	{
+		std::lock_guard<std::mutex> hold(lock);
+		if (queue.size() >= PREFETCH_QUEUE_CAPACITY)
+			return false;
+		Range range = { start, bytes };
+		queue.push_back(range);
+	}
+	requests.fetch_add(1, std::memory_order_relaxed);
+	wake.notify_one();
+	return true;
+}
+
+void WaveBankPrefetcher::Run()
+{
+	Profiler::RegisterThread("Wave Bank Prefetch");
+
+	std::vector<Range> taken;
+	taken.reserve(PREFETCH_QUEUE_CAPACITY);
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> hold(lock);
+			wake.wait(hold, [this] { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+			taken.swap(queue);
+		}
+
+		PROFILE_SCOPE("WaveBankPrefetcher::Touch");
+		for (size_t i = 0; i < taken.size(); i++)
+			pagesTouched.fetch_add(TouchPages(taken[i].start, taken[i].bytes), std::memory_order_relaxed);
+		taken.clear();
+	}
+}
+
+WaveBankStream::WaveBankStream()
+	: waveData(0), waveBytes(0), position(0), prefetched(0), prefetcher(0), tag(WAVEBANK_FORMAT_PCM), sixteenBit(true),
+	inMemory(true), frames(0), decodedFrames(0), decodedPosition(0), framesRead(0)
+{
+	format.sampleRate = 0;
+	format.channels = 1;
+}
+
+bool WaveBankStream::Reset(const WaveBank& bank, uint32_t index, WaveBankPrefetcher* prefetcher, std::string* error)
+{
+	if (index >= bank.GetEntryCount())
+		return Fail(error, "no such entry");
+
+	WaveBankEntry entry;
+	bank.GetEntry(index, entry);
+	if (entry.tag != WAVEBANK_FORMAT_PCM && entry.tag != WAVEBANK_FORMAT_ADPCM)
+		return Fail(error, "only PCM and ADPCM entries play");
+	if (entry.format.channels > 2)
+		return Fail(error, "only mono and stereo entries play");
+
+	waveData = bank.GetWaveData(index, waveBytes);
+	format = entry.format;
+	tag = entry.tag;
+	sixteenBit = entry.sixteenBit;
+	frames = entry.frames;
+	inMemory = !bank.IsStreaming();
+	this->prefetcher = inMemory ? 0 : prefetcher;
+	if (tag == WAVEBANK_FORMAT_ADPCM)
+	{
+		adpcm.channels = format.channels;
+		adpcm.blockAlign = entry.blockAlign;
+		adpcm.samplesPerBlock = GetAdpcmSamplesPerBlock(entry.blockAlign, format.channels);
+		SetDefaultAdpcmCoefficients(adpcm);
+		decoded.resize(adpcm.samplesPerBlock * format.channels);
+	}
+	Rewind();
+	return true;
+}
+
+void WaveBankStream::Rewind()
+{
+	position = 0;
+	prefetched = 0;
+	framesRead = 0;
+	decodedFrames = 0;
+	decodedPosition = 0;
+}
+
+// Keeps the next two chunks asked for
+void WaveBankStream::Prefetch()
+{
+	while (prefetched < waveBytes && prefetched < position + 2 * PREFETCH_BYTES)
+	{
+		size_t bytes = std::min(PREFETCH_BYTES, waveBytes - prefetched);
+		if (!prefetcher->Request(waveData + prefetched, bytes))
+			return;
+		prefetched += bytes;
+	}
+}
+
+size_t WaveBankStream::Read(int16_t* samples, size_t count)
+{
+	if (prefetcher)
+		Prefetch();
+
+	int channels = format.channels;
+	count = std::min(count, (size_t)(this->frames - framesRead));
+	size_t done = 0;
+	if (tag == WAVEBANK_FORMAT_PCM)
+	{
+		size_t frameBytes = channels * (sixteenBit ? 2 : 1);
+		done = std::min(count, (waveBytes - position) / frameBytes);
+		const uint8_t* in = waveData + position;
+		if (sixteenBit)
+			memcpy(samples, in, done * frameBytes);
+		else
+		{
+			// 8 bit is unsigned
+			for (size_t i = 0; i < done * channels; i++)
+				samples[i] = (int16_t)((in[i] - 128) * 256);
+		}
+		position += done * frameBytes;
+	}
+	else
+	{
+		// Whole blocks at a time, straight from the bank
+		while (done < count)
+		{
+			if (decodedPosition == decodedFrames)
+			{
+				size_t bytes = std::min((size_t)adpcm.blockAlign, waveBytes - position);
+				decodedFrames = bytes > 0 ? DecodeAdpcmBlock(waveData + position, bytes, adpcm, decoded.data()) : 0;
+				decodedPosition = 0;
+				position += bytes;
+				if (decodedFrames == 0)
+					break;
+			}
+
+			size_t run = std::min(count - done, decodedFrames - decodedPosition);
+			memcpy(samples + done * channels, &decoded[decodedPosition * channels], run * channels * sizeof(int16_t));
+			decodedPosition += run;
+			done += run;
+		}
+	}
+
+	framesRead += (uint32_t)done;
+	return done;
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioStream.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// XACT wave banks (.xwb), read straight out of a memory mapped
+// file.
+//
+// Opening a bank maps it and checks every header, region and
+// entry where they lie - nothing is read into buffers or copied
+// - so afterwards any entry can be handed out as a pointer into
+// the mapping.  An in-memory bank has its wave data paged in
+// when it opens, and plays from there as it would from a heap
+// copy.  A streaming bank is paged in as it plays, a chunk
+// ahead, by a WaveBankPrefetcher, so the page faults happen on
+// that thread rather than whichever is decoding.
+//
+// WaveBankStream plays an entry to the SoftwareMixer: 8 and 16
+// bit PCM and MS-ADPCM, mono or stereo.  XMA and WMA entries
+// parse but don't play.
+//
+// The bank's structures are declared here rather than taken
+// from the XACT headers, and files are mapped with MappedFile,
+// so the Linux tools can read banks too.
+// --------------------------------------------------------
+
+#pragma pack(push, 1)
+struct WaveBankRegion
+{
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct WaveBankHeader
+{
+	uint32_t signature;
+	uint32_t version;
+	uint32_t headerVersion;
+	WaveBankRegion segments[5];
+};
+
+struct WaveBankData
+{
+	uint32_t flags;
+	uint32_t entryCount;
+	char bankName[64];
+	uint32_t entryMetaDataElementSize;
+	uint32_t entryNameElementSize;
+	uint32_t alignment;
+	uint32_t compactFormat;
+	uint64_t buildTime;
+};
+
+struct WaveBankEntryData
+{
+	uint32_t flagsAndDuration;	// Flags in the low 4 bits
+	uint32_t format;			// A mini wave format
+	WaveBankRegion playRegion;	// Within the wave data segment
+	uint32_t loopStart;			// Samples
+	uint32_t loopLength;
+};
+
+// Offset in alignment units in the low 21 bits, and how far short
+// of the next entry's offset this one ends in the rest
+struct WaveBankCompactEntry
+{
+	uint32_t value;
+};
+#pragma pack(pop)
+
+const uint32_t WAVEBANK_SIGNATURE = 0x444E4257;	// "WBND"
+const uint32_t WAVEBANK_CONTENT_VERSION = 46;
+const uint32_t WAVEBANK_HEADER_VERSION = 44;
+
+enum WaveBankSegment
+{
+	WAVEBANK_SEGMENT_BANKDATA,
+	WAVEBANK_SEGMENT_ENTRYMETADATA,
+	WAVEBANK_SEGMENT_SEEKTABLES,
+	WAVEBANK_SEGMENT_ENTRYNAMES,
+	WAVEBANK_SEGMENT_ENTRYWAVEDATA,
+	WAVEBANK_SEGMENT_COUNT
+};
+
+const uint32_t WAVEBANK_TYPE_STREAMING = 0x00000001;
+const uint32_t WAVEBANK_TYPE_MASK = 0x00000001;
+const uint32_t WAVEBANK_FLAGS_ENTRYNAMES = 0x00010000;
+const uint32_t WAVEBANK_FLAGS_COMPACT = 0x00020000;
+
+const size_t WAVEBANK_ENTRYNAME_LENGTH = 64;
+
+// Mini wave format tags
+enum WaveBankFormatTag
+{
+	WAVEBANK_FORMAT_PCM,
+	WAVEBANK_FORMAT_XMA,
+	WAVEBANK_FORMAT_ADPCM,
+	WAVEBANK_FORMAT_WMA
+};
+
+// Packs the 32 bit mini format: tag, channels, rate, block align
+// and a 16 bit flag, low bits first.  ADPCM's block
+// align is stored per channel, less 22.
+uint32_t MakeWaveBankFormat(int tag, int channels, int sampleRate, int blockAlign, bool sixteenBit);
+
+// One entry, as read from the bank
+struct WaveBankEntry
+{
+	int tag;
+	AudioFormat format;
+	int blockAlign;			// Bytes; what the mini format says it is
+	bool sixteenBit;		// PCM only
+	uint32_t frames;		// Duration
+	uint32_t loopStart;
+	uint32_t loopLength;
+	uint32_t offset;		// From the start of the file
+	uint32_t length;		// Bytes
+};
+
+class WaveBank
+{
+public:
+	WaveBank();
+
+	// Maps the file and validates it; an in-memory bank is paged
+	// in here
+	bool Open(const char* fileName, std::string* error = 0);
+
+	// Validates a bank already in memory, which has to outlive
+	// this; Open maps the file and calls this
+	bool Parse(const uint8_t* data, size_t size, std::string* error = 0);
+	void Close();
+
+	bool IsStreaming() const { return streaming; }
+	uint32_t GetEntryCount() const { return entryCount; }
+	std::string GetName() const;
+
+	// -1 if there's no entry by that name, or no names at all
+	int FindEntry(const char* name) const;
+	std::string GetEntryName(uint32_t index) const;
+
+	// Validated when the bank opened, so these can't fail for an
+	// index below GetEntryCount
+	void GetEntry(uint32_t index, WaveBankEntry& entry) const;
+
+	// A pointer into the bank itself; nothing is copied
+	const uint8_t* GetWaveData(uint32_t index, size_t& bytes) const;
+
+	const uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+private:
+	// Not copyable - streams point into it
+	WaveBank(const WaveBank&);
+	WaveBank& operator=(const WaveBank&);
+
+	bool ValidateEntry(uint32_t index, std::string* error) const;
+
+	MappedFile file;
+	const uint8_t* data;
+	size_t size;
+	const WaveBankHeader* header;
+	const WaveBankData* bank;
+	const uint8_t* entries;
+	const char* names;
+	uint32_t entryCount;
+	uint32_t entrySize;
+	bool streaming;
+	bool compact;
+};
+
+// Touches one byte in every page of the ranges it's given, so
+// the file is read in on this thread ahead of whoever needs it
+class WaveBankPrefetcher
+{
+public:
+	WaveBankPrefetcher();
+	~WaveBankPrefetcher();
+
+	void Start();
+	void Stop();
+
+	// Queues a range; false, and nothing queued, if it's full
+	bool Request(const uint8_t* start, size_t bytes);
+
+	uint64_t GetPagesTouched() const { return pagesTouched; }
+	uint64_t GetRequests() const { return requests; }
+
+private:
+	struct Range
+	{
+		const uint8_t* start;
+		size_t bytes;
+	};
+
+	void Run();
+
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::vector<Range> queue;
+	bool stopping;
+	std::atomic<uint64_t> pagesTouched;
+	std::atomic<uint64_t> requests;
+};
+
+// Pages in [start, start + bytes) on the calling thread; returns
+// the pages touched
+size_t TouchPages(const uint8_t* start, size_t bytes);
+
+// --------------------------------------------------------
+// Plays one entry of a bank, decoding from the mapping as it's
+// read.  For a streaming bank, the next chunk's pages are asked
+// of the prefetcher, if it has one, as each is started on.
+// --------------------------------------------------------
+class WaveBankStream : public AudioStream
+{
+public:
+	WaveBankStream();
+
+	// The bank and prefetcher aren't owned
+	bool Reset(const WaveBank& bank, uint32_t index, WaveBankPrefetcher* prefetcher = 0, std::string* error = 0);
+
+	const AudioFormat& GetFormat() const { return format; }
+	size_t Read(int16_t* samples, size_t frames);
+	void Rewind();
+
+	// In-memory banks are already paged in
+	bool CanReadInline() const { return inMemory; }
+
+private:
+	void Prefetch();
+
+	const uint8_t* waveData;
+	size_t waveBytes;
+	size_t position;			// Bytes into waveData
+	size_t prefetched;			// Bytes asked for so far
+	WaveBankPrefetcher* prefetcher;
+	AudioFormat format;
+	int tag;
+	bool sixteenBit;
+	bool inMemory;
+	uint32_t frames;
+	AdpcmFormat adpcm;
+
+	// An ADPCM block decodes whole; what's left of it waits here
+	std::vector<int16_t> decoded;
+	size_t decodedFrames;
+	size_t decodedPosition;
+	uint32_t framesRead;
+};
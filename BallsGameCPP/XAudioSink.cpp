@@ -0,0 +1,110 @@
+#include "XAudioSink.h"
+#include "ErrorMessage.h"
+
+#include <cstring>
+
+using namespace DirectX;
+
+// The synthesized samples with their format in front, the way
+// SoundEffect wants them
+static std::unique_ptr<SoundEffect> CreateEffect(AudioEngine* engine, SoundKind kind)
+{
+	std::vector<int16_t> samples;
+	SynthesizeSound(kind, samples);
+	size_t audioBytes = samples.size() * sizeof(int16_t);
+	std::unique_ptr<uint8_t[]> data(new uint8_t[sizeof(WAVEFORMATEX) + audioBytes]);
+
+	WAVEFORMATEX* format = (WAVEFORMATEX*)data.get();
+	memset(format, 0, sizeof(WAVEFORMATEX));
+	format->wFormatTag = WAVE_FORMAT_PCM;
+	format->nChannels = 1;
+	format->nSamplesPerSec = SOUND_SAMPLE_RATE;
+	format->wBitsPerSample = 16;
+	format->nBlockAlign = sizeof(int16_t);
+	format->nAvgBytesPerSec = SOUND_SAMPLE_RATE * sizeof(int16_t);
+
+	uint8_t* audio = data.get() + sizeof(WAVEFORMATEX);
+	memcpy(audio, samples.data(), audioBytes);
+	return std::unique_ptr<SoundEffect>(new SoundEffect(engine, data, format, audio, audioBytes));
+}
+
+XAudioSink::XAudioSink() : comInitialized(false)
+{
+	for (int v = 0; v < VOICE_COUNT; v++)
+		playing[v] = -1;
+}
+
+XAudioSink::~XAudioSink()
+{
+	Close();
+}
+
+bool XAudioSink::Open(std::string* error)
+{
+	// XAudio2 needs COM on whichever thread drives it
+	comInitialized = SUCCEEDED(CoInitializeEx(0, COINIT_MULTITHREADED));
+
+	try
+	{
+		engine.reset(new AudioEngine(AudioEngine_Default));
+		for (int kind = 0; kind < SOUND_KIND_COUNT; kind++)
+		{
+			effects[kind] = CreateEffect(engine.get(), (SoundKind)kind);
+			for (int v = 0; v < VOICE_COUNT; v++)
+				instances[kind][v] = effects[kind]->CreateInstance();
+		}
+	}
+	catch (const std::exception& e)
+	{
+		Close();
+		return Fail(error, std::string("could not start XAudio2: ") + e.what());
+	}
+	return true;
+}
+
+void XAudioSink::Close()
+{
+	for (int kind = 0; kind < SOUND_KIND_COUNT; kind++)
+	{
+		for (int v = 0; v < VOICE_COUNT; v++)
+			instances[kind][v].reset();
+		effects[kind].reset();
+	}
+	engine.reset();
+
+	if (comInitialized)
+		CoUninitialize();
+	comInitialized = false;
+}
+
+void XAudioSink::Start(int voice, const VoiceStart& start)
+{
+	Stop(voice);
+
+	SoundEffectInstance* instance = instances[start.kind][voice].get();
+	instance->SetVolume(start.volume);
+	instance->SetPitch(start.pitch);
+	instance->SetPan(start.pan);
+	instance->Play();
+	playing[voice] = start.kind;
+}
+
+void XAudioSink::SetVolume(int voice, float volume)
+{
+	if (playing[voice] >= 0)
+		instances[playing[voice]][voice]->SetVolume(volume);
+}
+
+void XAudioSink::Stop(int voice)
+{
+	if (playing[voice] >= 0)
+		instances[playing[voice]][voice]->Stop();
+	playing[voice] = -1;
+}
+
+// After a device change or a lost device, try the default one again
+void XAudioSink::Update()
+{
+	if (!engine->Update() && engine->IsCriticalError())
+		engine->Reset();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Windows.h>
+#include <memory>
+#include <string>
+
+#include "Audio.h"
+#include "SoundPlayer.h"
+
+// --------------------------------------------------------
+// Plays the pool's voices through XAudio2 with DirectXTK
+// Audio, the sounds synthesized when it opens.  Each voice has
+// an instance of every sound ready, so starting one never
+// allocates.
+// --------------------------------------------------------
+class XAudioSink : public AudioSink
+{
+public:
+	XAudioSink();
+	~XAudioSink();
+
+	bool Open(std::string* error);
+	void Close();
+	void Start(int voice, const VoiceStart& start);
+	void SetVolume(int voice, float volume);
+	void Stop(int voice);
+	void Update();
+
+private:
+	std::unique_ptr<DirectX::AudioEngine> engine;
+	std::unique_ptr<DirectX::SoundEffect> effects[SOUND_KIND_COUNT];
+	std::unique_ptr<DirectX::SoundEffectInstance> instances[SOUND_KIND_COUNT][VOICE_COUNT];
+	int playing[VOICE_COUNT];		// Kind each voice last started, -1 for none
+	bool comInitialized;
+};